@@ -78,26 +78,38 @@ const AppContextProvider = ({ children }) => {
   };
 
   /// --- ESP32 STATUS BASED ON HEARTBEAT ---
+  // The bridge rewrites /status at most every 25 s while the station
+  // is heard from (the station itself is quiet for up to 30 s), and
+  // sets /online to false as soon as the broker reports it dropped.
+  const STATUS_STALE_MS = 75000;
+
   const fetchEspStatus = () => {
     const statusRef = ref(database, "status"); // /status in Firebase
+    const onlineRef = ref(database, "online"); // /online in Firebase
     let lastValue = null;
     let lastChangeTime = Date.now();
+    let online = true;
 
     onValue(statusRef, (snapshot) => {
       const currentValue = snapshot.val();
       if (!currentValue) return;
 
       if (lastValue === null || currentValue !== lastValue) {
-        setEspStatus("ONLINE");
+        if (online) setEspStatus("ONLINE");
         lastChangeTime = Date.now(); // reset timer on value change
       }
 
       lastValue = currentValue;
     });
 
-    // Timer to mark OFFLINE if no change in 5s
+    onValue(onlineRef, (snapshot) => {
+      online = snapshot.val() !== false;
+      if (!online) setEspStatus("OFFLINE");
+    });
+
+    // Timer to mark OFFLINE if /status goes stale
     const interval = setInterval(() => {
-      if (lastChangeTime && Date.now() - lastChangeTime > 3000) {
+      if (lastChangeTime && Date.now() - lastChangeTime > STATUS_STALE_MS) {
         setEspStatus("OFFLINE");
       }
     }, 1000); // check every 1 second
@@ -0,0 +1,201 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  EepromJournal — append-only ring of fixed-size records kept
+//  in the EEPROM emulation.
+//
+//  Region layout:
+//    [magic:2][version:1][payloadSize:1]  header
+//    [seq:4][payload:N][crc16:2][state:1] × CAPACITY slots
+//
+//  • append() writes exactly one slot (the one after the newest
+//    record) and commits it.
+//  • ack() rewrites only the state byte of one slot and does not
+//    commit; callers batch acknowledgements and call flush().
+//  • There are no head/tail cells on EEPROM. Both are recovered
+//    in begin() from the per-record sequence numbers, so no single
+//    byte is rewritten on every operation and a torn write can
+//    never leave a pointer aimed at garbage. A slot whose CRC does
+//    not match is treated as free.
+//  • Records are written round the ring, so wear is spread evenly
+//    over every slot instead of always rewriting slot 0.
+// ─────────────────────────────────────────────────────────────
+#include <Arduino.h>
+#include <EEPROM.h>
+
+#define JOURNAL_MAGIC        0x4A4C   // "JL"
+#define JOURNAL_HEADER_SIZE  4
+#define JOURNAL_SLOT_NONE    0xFFFF
+
+#define JOURNAL_STATE_PENDING 0xA5
+#define JOURNAL_STATE_ACKED   0x00    // only clears bits, so NOR-flash friendly
+
+inline uint16_t journalCrc16(const uint8_t *data, size_t len, uint16_t crc = 0xFFFF) {
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (uint8_t b = 0; b < 8; b++)
+      crc = (crc & 0x8000) ? (uint16_t)((crc << 1) ^ 0x1021) : (uint16_t)(crc << 1);
+  }
+  return crc;
+}
+
+template <uint16_t PAYLOAD_SIZE, uint16_t CAPACITY, uint8_t VERSION = 1>
+class EepromJournal {
+public:
+  static const uint16_t SLOT_SIZE   = 4 + PAYLOAD_SIZE + 2 + 1;
+  static const uint16_t REGION_SIZE = JOURNAL_HEADER_SIZE + CAPACITY * SLOT_SIZE;
+
+  static_assert(PAYLOAD_SIZE <= 255, "payload size is stored in one header byte");
+  static_assert(CAPACITY < JOURNAL_SLOT_NONE, "slot index must fit below JOURNAL_SLOT_NONE");
+
+  // Loads and recovers the ring. Returns false if the region does not
+  // hold a journal of this version/record size (caller should format()).
+  bool begin(int baseAddr) {
+    base_ = baseAddr;
+    uint8_t hdr[JOURNAL_HEADER_SIZE];
+    EEPROM.readBytes(base_, hdr, sizeof(hdr));
+    if (hdr[0] != (JOURNAL_MAGIC >> 8) || hdr[1] != (JOURNAL_MAGIC & 0xFF) ||
+        hdr[2] != VERSION || hdr[3] != PAYLOAD_SIZE) {
+      reset();
+      return false;
+    }
+    recover();
+    return true;
+  }
+
+  // Writes an empty journal over the region (one-time, on first boot
+  // or after a layout change).
+  void format() {
+    uint8_t hdr[JOURNAL_HEADER_SIZE] = {
+      (uint8_t)(JOURNAL_MAGIC >> 8), (uint8_t)(JOURNAL_MAGIC & 0xFF),
+      VERSION, (uint8_t)PAYLOAD_SIZE
+    };
+    EEPROM.writeBytes(base_, hdr, sizeof(hdr));
+    uint8_t blank[SLOT_SIZE];
+    memset(blank, 0, sizeof(blank));
+    for (uint16_t i = 0; i < CAPACITY; i++) EEPROM.writeBytes(slotAddr(i), blank, SLOT_SIZE);
+    EEPROM.commit();
+    reset();
+  }
+
+  bool append(const void *payload) {
+    if (full()) return false;
+    uint16_t slot = tail_;
+    uint8_t  buf[SLOT_SIZE];
+    uint32_t seq  = nextSeq_;
+    memcpy(buf, &seq, 4);
+    memcpy(buf + 4, payload, PAYLOAD_SIZE);
+    uint16_t crc = journalCrc16(buf, 4 + PAYLOAD_SIZE);
+    memcpy(buf + 4 + PAYLOAD_SIZE, &crc, 2);
+    buf[SLOT_SIZE - 1] = JOURNAL_STATE_PENDING;   // state goes last
+    EEPROM.writeBytes(slotAddr(slot), buf, SLOT_SIZE);
+    if (!EEPROM.commit()) return false;
+
+    seq_[slot]     = seq;
+    pending_[slot] = true;
+    if (count_ == 0) head_ = slot;
+    count_++;
+    nextSeq_++;
+    tail_ = (uint16_t)((slot + 1) % CAPACITY);
+    return true;
+  }
+
+  // Marks one record delivered. Not durable until flush().
+  bool ack(uint16_t slot) {
+    if (slot >= CAPACITY || !pending_[slot]) return false;
+    EEPROM.write(slotAddr(slot) + SLOT_SIZE - 1, JOURNAL_STATE_ACKED);
+    pending_[slot] = false;
+    count_--;
+    if (slot == head_) head_ = (count_ == 0) ? JOURNAL_SLOT_NONE : next(slot);
+    dirty_ = true;
+    return true;
+  }
+
+  bool flush() {
+    if (!dirty_) return true;
+    dirty_ = false;
+    return EEPROM.commit();
+  }
+
+  bool read(uint16_t slot, void *payload) const {
+    if (slot >= CAPACITY) return false;
+    return EEPROM.readBytes(slotAddr(slot) + 4, payload, PAYLOAD_SIZE) == PAYLOAD_SIZE;
+  }
+
+  // Oldest pending slot, or JOURNAL_SLOT_NONE.
+  uint16_t first() const { return count_ ? head_ : JOURNAL_SLOT_NONE; }
+
+  // Next pending slot after `slot` in FIFO order, or JOURNAL_SLOT_NONE.
+  uint16_t next(uint16_t slot) const {
+    if (slot >= CAPACITY) return JOURNAL_SLOT_NONE;
+    for (uint16_t i = (uint16_t)((slot + 1) % CAPACITY); i != tail_;
+         i = (uint16_t)((i + 1) % CAPACITY)) {
+      if (pending_[i]) return i;
+    }
+    return JOURNAL_SLOT_NONE;
+  }
+
+  // Pending slot holding `seq`, or JOURNAL_SLOT_NONE.
+  uint16_t find(uint32_t seq) const {
+    for (uint16_t i = 0; i < CAPACITY; i++)
+      if (pending_[i] && seq_[i] == seq) return i;
+    return JOURNAL_SLOT_NONE;
+  }
+
+  uint32_t seqAt(uint16_t slot) const { return slot < CAPACITY ? seq_[slot] : 0; }
+  uint16_t count() const { return count_; }
+  uint16_t capacity() const { return CAPACITY; }
+  bool     full() const { return count_ > 0 && pending_[tail_]; }
+
+private:
+  int      base_    = 0;
+  uint16_t head_    = JOURNAL_SLOT_NONE;
+  uint16_t tail_    = 0;
+  uint16_t count_   = 0;
+  uint32_t nextSeq_ = 1;
+  bool     dirty_   = false;
+  uint32_t seq_[CAPACITY];
+  bool     pending_[CAPACITY];
+
+  int slotAddr(uint16_t slot) const {
+    return base_ + JOURNAL_HEADER_SIZE + (int)slot * SLOT_SIZE;
+  }
+
+  void reset() {
+    memset(seq_, 0, sizeof(seq_));
+    memset(pending_, 0, sizeof(pending_));
+    head_    = JOURNAL_SLOT_NONE;
+    tail_    = 0;
+    count_   = 0;
+    nextSeq_ = 1;
+    dirty_   = false;
+  }
+
+  void recover() {
+    reset();
+    bool     any    = false;
+    uint32_t maxSeq = 0;
+    uint16_t maxAt  = 0;
+    uint8_t  buf[SLOT_SIZE];
+
+    for (uint16_t i = 0; i < CAPACITY; i++) {
+      EEPROM.readBytes(slotAddr(i), buf, SLOT_SIZE);
+      uint32_t seq;
+      uint16_t crc;
+      memcpy(&seq, buf, 4);
+      memcpy(&crc, buf + 4 + PAYLOAD_SIZE, 2);
+      if (seq == 0 || crc != journalCrc16(buf, 4 + PAYLOAD_SIZE)) continue;
+      seq_[i]     = seq;
+      pending_[i] = (buf[SLOT_SIZE - 1] == JOURNAL_STATE_PENDING);
+      if (pending_[i]) count_++;
+      if (!any || seq > maxSeq) { maxSeq = seq; maxAt = i; any = true; }
+    }
+    if (!any) return;
+
+    nextSeq_ = maxSeq + 1;
+    tail_    = (uint16_t)((maxAt + 1) % CAPACITY);
+    // Oldest pending record: walk forward from the tail round the ring
+    for (uint16_t n = 0, i = tail_; n < CAPACITY; n++, i = (uint16_t)((i + 1) % CAPACITY)) {
+      if (pending_[i]) { head_ = i; break; }
+    }
+  }
+};
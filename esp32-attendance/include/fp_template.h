@@ -0,0 +1,101 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  AS608 template transfer — char buffer 1 ⇄ host memory.
+//
+//  • fpUploadTemplate() is UpChar: getModel() starts it and the
+//    sensor answers with data packets ending in an end packet.
+//  • fpDownloadTemplate() is DownChar, which Adafruit_Fingerprint
+//    has no call for: the command packet, one ack, then the host
+//    sends the data packets. storeModel() files the result.
+//  • The library's packet reader overflows on data packets longer
+//    than ~46 bytes, so fpTemplateBegin() switches the sensor to
+//    32-byte packets once at boot.
+//  • fpBase64Encode()/fpBase64Decode() carry template bytes inside
+//    JSON for the MQTT transfer topics.
+// ─────────────────────────────────────────────────────────────
+#include <Adafruit_Fingerprint.h>
+#include <string.h>
+
+#define FP_TEMPLATE_SIZE   512   // one model as UpChar/DownChar carry it
+#define FP_TEMPLATE_CHUNK  32    // data bytes per packet (FINGERPRINT_PACKET_SIZE_32)
+#define AS608_DOWNCHAR     0x09
+
+inline bool fpTemplateBegin(Adafruit_Fingerprint &fp) {
+  return fp.setPacketSize(FINGERPRINT_PACKET_SIZE_32) == FINGERPRINT_OK;
+}
+
+// Char buffer 1 → tpl (FP_TEMPLATE_SIZE bytes)
+inline bool fpUploadTemplate(Adafruit_Fingerprint &fp, uint8_t *tpl) {
+  if (fp.getModel() != FINGERPRINT_OK) return false;
+  uint8_t  none = 0;
+  uint16_t got  = 0;
+  for (;;) {
+    Adafruit_Fingerprint_Packet pkt(FINGERPRINT_DATAPACKET, 0, &none);
+    if (fp.getStructuredPacket(&pkt) != FINGERPRINT_OK) return false;
+    if (pkt.type != FINGERPRINT_DATAPACKET && pkt.type != FINGERPRINT_ENDDATAPACKET) return false;
+    uint16_t n = pkt.length - 2;   // length counts the checksum
+    if (pkt.length < 2 || n > sizeof(pkt.data) || got + n > FP_TEMPLATE_SIZE) return false;
+    memcpy(tpl + got, pkt.data, n);
+    got += n;
+    if (pkt.type == FINGERPRINT_ENDDATAPACKET) return got == FP_TEMPLATE_SIZE;
+  }
+}
+
+// tpl → char buffer 1
+inline bool fpDownloadTemplate(Adafruit_Fingerprint &fp, const uint8_t *tpl) {
+  uint8_t cmd[] = {AS608_DOWNCHAR, 0x01};
+  fp.writeStructuredPacket(Adafruit_Fingerprint_Packet(FINGERPRINT_COMMANDPACKET, sizeof(cmd), cmd));
+  uint8_t none = 0;
+  Adafruit_Fingerprint_Packet ack(FINGERPRINT_ACKPACKET, 0, &none);
+  if (fp.getStructuredPacket(&ack) != FINGERPRINT_OK) return false;
+  if (ack.type != FINGERPRINT_ACKPACKET || ack.data[0] != FINGERPRINT_OK) return false;
+  for (uint16_t off = 0; off < FP_TEMPLATE_SIZE; off += FP_TEMPLATE_CHUNK) {
+    uint8_t type = (off + FP_TEMPLATE_CHUNK >= FP_TEMPLATE_SIZE) ? FINGERPRINT_ENDDATAPACKET
+                                                                 : FINGERPRINT_DATAPACKET;
+    fp.writeStructuredPacket(Adafruit_Fingerprint_Packet(type, FP_TEMPLATE_CHUNK,
+                                                         (uint8_t *)tpl + off));
+  }
+  return true;
+}
+
+// Standard alphabet with padding; out needs 4 * ((len + 2) / 3) + 1 bytes
+inline size_t fpBase64Encode(const uint8_t *in, size_t len, char *out) {
+  static const char abc[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  size_t o = 0;
+  for (size_t i = 0; i < len; i += 3) {
+    uint32_t v = (uint32_t)in[i] << 16;
+    if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+    if (i + 2 < len) v |= in[i + 2];
+    out[o++] = abc[v >> 18];
+    out[o++] = abc[(v >> 12) & 0x3F];
+    out[o++] = i + 1 < len ? abc[(v >> 6) & 0x3F] : '=';
+    out[o++] = i + 2 < len ? abc[v & 0x3F] : '=';
+  }
+  out[o] = '\0';
+  return o;
+}
+
+// Decoded length, or -1 on a bad character or more than cap bytes
+inline int fpBase64Decode(const char *in, size_t len, uint8_t *out, size_t cap) {
+  uint32_t v = 0;
+  uint8_t  bits = 0;
+  size_t   o = 0;
+  for (size_t i = 0; i < len && in[i] != '='; i++) {
+    char    c = in[i];
+    uint8_t d;
+    if      (c >= 'A' && c <= 'Z') d = (uint8_t)(c - 'A');
+    else if (c >= 'a' && c <= 'z') d = (uint8_t)(c - 'a' + 26);
+    else if (c >= '0' && c <= '9') d = (uint8_t)(c - '0' + 52);
+    else if (c == '+')             d = 62;
+    else if (c == '/')             d = 63;
+    else return -1;
+    v = (v << 6) | d;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      if (o == cap) return -1;
+      out[o++] = (uint8_t)(v >> bits);
+    }
+  }
+  return (int)o;
+}
@@ -0,0 +1,97 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  LatencyHist — fixed-bucket latency histogram in microseconds,
+//  recorded from any task and read from another.
+//
+//  • Buckets are half octaves: 0 µs, then [2^k, 1.5·2^k) and
+//    [1.5·2^k, 2^(k+1)) for k up to 2^20 µs; anything slower is
+//    counted in the last. 43 counters, fixed at compile time.
+//  • record() is a count-leading-zeros and a few relaxed atomic
+//    adds, cheap enough to wrap every sensor command and publish.
+//  • take() moves the counts into a Snapshot and starts a new
+//    window; peek() copies without resetting. A record racing
+//    either lands in one window or the next, never in both.
+//  • Quantiles are the upper edge of their bucket (capped at the
+//    largest value seen), so they overstate by at most half an
+//    octave.
+// ─────────────────────────────────────────────────────────────
+#include <atomic>
+#include <stdint.h>
+
+class LatencyHist {
+public:
+  static const uint8_t OCTAVES = 21;
+  static const uint8_t BUCKETS = 1 + 2 * OCTAVES;
+
+  struct Snapshot {
+    uint32_t counts[BUCKETS];
+    uint32_t n;
+    uint32_t sumUs;
+    uint32_t maxUs;
+
+    uint32_t meanUs() const { return n ? sumUs / n : 0; }
+
+    // Upper edge of the bucket holding the q-th value (0 < q <= 1)
+    uint32_t quantileUs(float q) const {
+      if (!n) return 0;
+      uint32_t rank = (uint32_t)(q * (float)n + 0.5f);
+      if (rank < 1) rank = 1;
+      uint32_t seen = 0;
+      for (uint8_t b = 0; b < BUCKETS; b++) {
+        seen += counts[b];
+        if (seen >= rank) {
+          uint32_t edge = upperEdge(b);
+          return edge < maxUs ? edge : maxUs;
+        }
+      }
+      return maxUs;
+    }
+  };
+
+  void record(uint32_t us) {
+    counts_[bucketOf(us)].fetch_add(1, std::memory_order_relaxed);
+    sumUs_.fetch_add(us, std::memory_order_relaxed);
+    uint32_t max = maxUs_.load(std::memory_order_relaxed);
+    while (us > max && !maxUs_.compare_exchange_weak(max, us, std::memory_order_relaxed)) {}
+  }
+
+  Snapshot take() { return copy(true); }
+  Snapshot peek() const { return const_cast<LatencyHist *>(this)->copy(false); }
+
+  static uint8_t bucketOf(uint32_t us) {
+    if (us == 0) return 0;
+    uint8_t k = (uint8_t)(31 - __builtin_clz(us));
+    if (k >= OCTAVES) return BUCKETS - 1;
+    uint8_t upper = k ? (uint8_t)((us >> (k - 1)) & 1) : 0;
+    return (uint8_t)(1 + 2 * k + upper);
+  }
+
+  // Smallest value above every value in bucket b
+  static uint32_t upperEdge(uint8_t b) {
+    if (b == 0) return 0;
+    if (b >= BUCKETS - 1) return UINT32_MAX;
+    uint8_t k = (uint8_t)((b - 1) / 2);
+    if (k == 0) return 2;
+    return (1UL << k) + (((b - 1) & 1) + 1) * (1UL << (k - 1));
+  }
+
+private:
+  Snapshot copy(bool reset) {
+    Snapshot s;
+    s.n = 0;
+    for (uint8_t b = 0; b < BUCKETS; b++) {
+      s.counts[b] = reset ? counts_[b].exchange(0, std::memory_order_relaxed)
+                          : counts_[b].load(std::memory_order_relaxed);
+      s.n += s.counts[b];
+    }
+    s.sumUs = reset ? sumUs_.exchange(0, std::memory_order_relaxed)
+                    : sumUs_.load(std::memory_order_relaxed);
+    s.maxUs = reset ? maxUs_.exchange(0, std::memory_order_relaxed)
+                    : maxUs_.load(std::memory_order_relaxed);
+    return s;
+  }
+
+  std::atomic<uint32_t> counts_[BUCKETS] = {};
+  std::atomic<uint32_t> sumUs_{0};
+  std::atomic<uint32_t> maxUs_{0};
+};
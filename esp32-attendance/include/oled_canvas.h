@@ -0,0 +1,111 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  OledCanvas — Adafruit_SH1107 that only sends what changed.
+//
+//  • Drawing still goes to the library framebuffer. flush() diffs
+//    it against a shadow of what the panel shows and writes only the
+//    pages and columns that really differ, so redrawing identical
+//    content costs no I2C traffic. It addresses the pages itself:
+//    the library's display() sends every page from the dirty
+//    window's first to the bottom of the panel.
+//  • centerX() caches text layout: getTextBounds() walks every
+//    glyph, and most labels are redrawn unchanged every second.
+// ─────────────────────────────────────────────────────────────
+#include <Adafruit_SH110X.h>
+#include <string.h>
+
+template <uint16_t W, uint16_t H>
+class OledCanvas : public Adafruit_SH1107 {
+public:
+  static const uint16_t PAGES = (H + 7) / 8;
+
+  OledCanvas(TwoWire *twi) : Adafruit_SH1107(W, H, twi) {}
+
+  // The next flush() sends the whole frame (after begin() or any
+  // doubt about what the panel holds).
+  void invalidate() { stale_ = true; }
+
+  // Writes each changed page, narrowed to the columns that differ.
+  // Returns false when nothing changed and nothing was sent.
+  bool flush() {
+    const uint8_t *buf  = getBuffer();
+    bool           sent = false;
+    int16_t        a, b;
+    for (int16_t p = 0; p < (int16_t)PAGES && i2c_dev; p++) {
+      if (!pageDiff(buf, p, a, b)) continue;
+      if (!sent) i2c_dev->setSpeed(i2c_preclk);
+      sendPage(buf, p, a, b);
+      memcpy(shown_ + p * W, buf + p * W, W);
+      sent = true;
+    }
+    if (sent) i2c_dev->setSpeed(i2c_postclk);
+    // Anything drawn but unchanged leaves nothing for a later display()
+    window_x1 = W; window_y1 = H; window_x2 = -1; window_y2 = -1;
+    stale_ = false;
+    return sent;
+  }
+
+  // X that centres `text` at `size` on the panel; layouts of the
+  // last few strings are remembered by content.
+  int16_t centerX(const char *text, uint8_t size) {
+    uint32_t key = 2166136261u ^ size;   // FNV-1a
+    for (const char *c = text; *c; c++) key = (key ^ (uint8_t)*c) * 16777619u;
+    for (const Layout &l : layouts_)
+      if (l.key == key && l.used) return l.x;
+
+    int16_t  x1, y1;
+    uint16_t w, h;
+    setTextSize(size);
+    getTextBounds(text, 0, 0, &x1, &y1, &w, &h);
+    Layout &slot = layouts_[next_++ % LAYOUTS];
+    slot.key  = key;
+    slot.x    = (int16_t)((W - w) / 2);
+    slot.used = true;
+    return slot.x;
+  }
+
+private:
+  static const uint8_t LAYOUTS = 6;
+
+  // Columns [a, b] of page p, as display() sends a page: set the page
+  // and start column, then data in chunks the I2C buffer holds
+  void sendPage(const uint8_t *buf, int16_t p, int16_t a, int16_t b) {
+    uint8_t col   = (uint8_t)(a + _page_start_offset);
+    uint8_t cmd[] = {0x00, (uint8_t)(SH110X_SETPAGEADDR + p),
+                     (uint8_t)(SH110X_SETHIGHCOLUMN + (col >> 4)), (uint8_t)(col & 0xF)};
+    i2c_dev->write(cmd, sizeof(cmd));
+    const uint8_t  dc    = 0x40;
+    const uint8_t *data  = buf + p * W + a;
+    size_t         left  = (size_t)(b - a + 1);
+    size_t         chunk = i2c_dev->maxBufferSize() - 1;
+    while (left) {
+      size_t n = left < chunk ? left : chunk;
+      i2c_dev->write(data, n, true, &dc, 1);
+      data += n;
+      left -= n;
+    }
+  }
+
+  // Columns [a, b] of page p that differ from the panel
+  bool pageDiff(const uint8_t *buf, int16_t p, int16_t &a, int16_t &b) const {
+    const uint8_t *row = buf + p * W, *was = shown_ + p * W;
+    if (stale_) { a = 0; b = W - 1; return true; }
+    if (memcmp(row, was, W) == 0) return false;
+    a = 0;
+    b = W - 1;
+    while (row[a] == was[a]) a++;
+    while (row[b] == was[b]) b--;
+    return true;
+  }
+
+  struct Layout {
+    uint32_t key;
+    int16_t  x;
+    bool     used;
+  };
+
+  uint8_t shown_[W * PAGES] = {0};
+  bool    stale_            = true;
+  Layout  layouts_[LAYOUTS] = {};
+  uint8_t next_             = 0;
+};
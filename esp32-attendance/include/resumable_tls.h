@@ -0,0 +1,247 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  ResumableTlsClient — TLS over a WiFiClient that offers its last
+//  session to the broker instead of running a full handshake on
+//  every reconnect.
+//
+//  • WiFiClientSecure sets up mbedTLS and handshakes in one call,
+//    so there is no point at which to hand it a saved session. This
+//    client drives mbedTLS itself: after each handshake it keeps the
+//    session (its ID, and the ticket if the broker issued one) and
+//    passes it to the next. A broker that still has it resumes in
+//    one round trip with no public-key work; one that does not
+//    falls back to a full handshake on its own.
+//  • saveSession()/loadSession() serialize the session, so the
+//    caller can keep it over a warm reboot.
+//  • The broker certificate is not verified, as with the
+//    setInsecure() client this replaces.
+//  • Not thread safe; one task owns it (with the PubSubClient).
+//  • Needs mbedTLS 2.x, as Arduino-ESP32 2.0 ships it: mbedTLS 3
+//    hides the session's master secret that resumption is told by.
+// ─────────────────────────────────────────────────────────────
+#include <Arduino.h>
+#include <WiFiClient.h>
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+#include <mbedtls/net_sockets.h>
+#include <mbedtls/ssl.h>
+#include <mbedtls/version.h>
+
+#if MBEDTLS_VERSION_MAJOR >= 3
+  #error "ResumableTlsClient reads mbedtls_ssl_session fields private in mbedTLS 3; use Arduino-ESP32 2.0 (espressif32 6.x)"
+#endif
+
+class ResumableTlsClient : public WiFiClient {
+public:
+  ResumableTlsClient() {
+    mbedtls_ssl_init(&ssl_);
+    mbedtls_ssl_config_init(&conf_);
+    mbedtls_ssl_session_init(&session_);
+    mbedtls_ctr_drbg_init(&drbg_);
+    mbedtls_entropy_init(&entropy_);
+  }
+
+  ~ResumableTlsClient() {
+    stop();
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_ssl_config_free(&conf_);
+    mbedtls_ssl_session_free(&session_);
+    mbedtls_ctr_drbg_free(&drbg_);
+    mbedtls_entropy_free(&entropy_);
+  }
+
+  void setHandshakeTimeout(uint32_t ms) { handshakeTimeoutMs_ = ms; }
+
+  int connect(IPAddress ip, uint16_t port) override {
+    return connect(ip.toString().c_str(), port);
+  }
+
+  int connect(const char *host, uint16_t port) override {
+    stop();
+    resumed_ = false;
+    if (!configured_ && !configure()) return 0;
+    if (!WiFiClient::connect(host, port)) return 0;
+
+    mbedtls_ssl_free(&ssl_);
+    mbedtls_ssl_init(&ssl_);
+    if (mbedtls_ssl_setup(&ssl_, &conf_) != 0 ||
+        mbedtls_ssl_set_hostname(&ssl_, host) != 0) {
+      WiFiClient::stop();
+      return 0;
+    }
+    mbedtls_ssl_set_bio(&ssl_, this, bioSend, bioRecv, nullptr);
+    if (haveSession_ && mbedtls_ssl_set_session(&ssl_, &session_) != 0) forgetSession();
+
+    uint32_t start = millis();
+    int      ret;
+    while ((ret = mbedtls_ssl_handshake(&ssl_)) != 0) {
+      if ((ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) ||
+          millis() - start > handshakeTimeoutMs_) {
+        // A session the broker chokes on is not offered again
+        forgetSession();
+        WiFiClient::stop();
+        return 0;
+      }
+      delay(2);
+    }
+
+    // A resumed session keeps its master secret; a full handshake
+    // derives a new one. (The ID is no guide: offering a ticket makes
+    // mbedTLS send a random one.)
+    mbedtls_ssl_session fresh;
+    mbedtls_ssl_session_init(&fresh);
+    if (mbedtls_ssl_get_session(&ssl_, &fresh) == 0) {
+      resumed_ = haveSession_ && memcmp(fresh.master, session_.master, sizeof(fresh.master)) == 0;
+      mbedtls_ssl_session_free(&session_);
+      session_     = fresh;   // takes over its buffers
+      haveSession_ = true;
+    } else {
+      mbedtls_ssl_session_free(&fresh);
+    }
+    handshakes_++;
+    if (resumed_) resumes_++;
+    open_ = true;
+    return 1;
+  }
+
+  size_t write(uint8_t b) override { return write(&b, 1); }
+
+  size_t write(const uint8_t *buf, size_t size) override {
+    if (!open_) return 0;
+    size_t done = 0;
+    while (done < size) {
+      int ret = mbedtls_ssl_write(&ssl_, buf + done, size - done);
+      if (ret > 0) { done += (size_t)ret; continue; }
+      if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+        stop();
+        break;
+      }
+      delay(1);
+    }
+    return done;
+  }
+
+  int available() override {
+    if (!open_) return 0;
+    int ret = mbedtls_ssl_read(&ssl_, nullptr, 0);   // pulls in the next record
+    if (ret < 0 && ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) {
+      stop();
+      return 0;
+    }
+    return (int)mbedtls_ssl_get_bytes_avail(&ssl_) + (peeked_ >= 0);
+  }
+
+  int read() override {
+    uint8_t b;
+    return read(&b, 1) == 1 ? b : -1;
+  }
+
+  int read(uint8_t *buf, size_t size) override {
+    if (!open_ || size == 0) return -1;
+    size_t got = 0;
+    if (peeked_ >= 0) {
+      buf[got++] = (uint8_t)peeked_;
+      peeked_    = -1;
+      if (got == size) return (int)got;
+    }
+    int ret = mbedtls_ssl_read(&ssl_, buf + got, size - got);
+    if (ret > 0) return (int)got + ret;
+    if (ret != MBEDTLS_ERR_SSL_WANT_READ && ret != MBEDTLS_ERR_SSL_WANT_WRITE) stop();
+    return got ? (int)got : -1;
+  }
+
+  int peek() override {
+    if (peeked_ < 0) {
+      uint8_t b;
+      if (open_ && mbedtls_ssl_read(&ssl_, &b, 1) == 1) peeked_ = b;
+    }
+    return peeked_;
+  }
+
+  void flush() override {}
+
+  void stop() override {
+    if (open_) mbedtls_ssl_close_notify(&ssl_);
+    open_   = false;
+    peeked_ = -1;
+    WiFiClient::stop();
+  }
+
+  uint8_t connected() override { return open_ && WiFiClient::connected(); }
+  operator bool() override { return connected(); }
+
+  // Whether the last connect() resumed a session, and running counts
+  bool     resumed() const { return resumed_; }
+  uint32_t handshakes() const { return handshakes_; }
+  uint32_t resumes() const { return resumes_; }
+
+  // Serialized session for keeping over a reboot; 0 if there is none
+  // or it does not fit in `cap`
+  size_t saveSession(uint8_t *buf, size_t cap) const {
+    size_t len = 0;
+    if (!haveSession_ || mbedtls_ssl_session_save(&session_, buf, cap, &len) != 0) return 0;
+    return len;
+  }
+
+  bool loadSession(const uint8_t *buf, size_t len) {
+    forgetSession();
+    if (mbedtls_ssl_session_load(&session_, buf, len) != 0) {
+      forgetSession();
+      return false;
+    }
+    haveSession_ = true;
+    return true;
+  }
+
+  void forgetSession() {
+    mbedtls_ssl_session_free(&session_);
+    mbedtls_ssl_session_init(&session_);
+    haveSession_ = false;
+  }
+
+private:
+  bool configure() {
+    static const char pers[] = "fp-mqtt";
+    if (mbedtls_ctr_drbg_seed(&drbg_, mbedtls_entropy_func, &entropy_,
+                              (const unsigned char *)pers, sizeof(pers) - 1) != 0 ||
+        mbedtls_ssl_config_defaults(&conf_, MBEDTLS_SSL_IS_CLIENT, MBEDTLS_SSL_TRANSPORT_STREAM,
+                                    MBEDTLS_SSL_PRESET_DEFAULT) != 0)
+      return false;
+    mbedtls_ssl_conf_authmode(&conf_, MBEDTLS_SSL_VERIFY_NONE);
+    mbedtls_ssl_conf_rng(&conf_, mbedtls_ctr_drbg_random, &drbg_);
+#if defined(MBEDTLS_SSL_SESSION_TICKETS)
+    mbedtls_ssl_conf_session_tickets(&conf_, MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+#endif
+    configured_ = true;
+    return true;
+  }
+
+  static int bioSend(void *ctx, const unsigned char *buf, size_t len) {
+    ResumableTlsClient *self = static_cast<ResumableTlsClient *>(ctx);
+    if (!self->WiFiClient::connected()) return MBEDTLS_ERR_NET_CONN_RESET;
+    size_t n = self->WiFiClient::write(buf, len);
+    return n ? (int)n : MBEDTLS_ERR_SSL_WANT_WRITE;
+  }
+
+  static int bioRecv(void *ctx, unsigned char *buf, size_t len) {
+    ResumableTlsClient *self = static_cast<ResumableTlsClient *>(ctx);
+    if (!self->WiFiClient::available())
+      return self->WiFiClient::connected() ? MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_CONN_RESET;
+    int n = self->WiFiClient::read(buf, len);
+    return n > 0 ? n : MBEDTLS_ERR_SSL_WANT_READ;
+  }
+
+  mbedtls_ssl_context      ssl_;
+  mbedtls_ssl_config       conf_;
+  mbedtls_ssl_session      session_;
+  mbedtls_ctr_drbg_context drbg_;
+  mbedtls_entropy_context  entropy_;
+  bool                     configured_         = false;
+  bool                     haveSession_        = false;
+  bool                     open_               = false;
+  bool                     resumed_            = false;
+  int                      peeked_             = -1;
+  uint32_t                 handshakeTimeoutMs_ = 10000;
+  uint32_t                 handshakes_         = 0;
+  uint32_t                 resumes_            = 0;
+};
@@ -0,0 +1,55 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  SpscQueue — bounded lock-free ring for exactly one producer
+//  task and one consumer task.
+//
+//  • head_ is written only by the producer, tail_ only by the
+//    consumer; each side reads the other's index with acquire
+//    ordering and publishes its own with release, so a popped
+//    item is always fully written and never reordered.
+//  • Indices run free and wrap at 2^32; CAPACITY is a power of
+//    two so the slot is a mask, and head - tail is the fill level
+//    even across the wrap.
+//  • push() never blocks: a full queue returns false and the
+//    caller decides what to drop.
+// ─────────────────────────────────────────────────────────────
+#include <atomic>
+#include <stdint.h>
+
+template <typename T, uint16_t CAPACITY>
+class SpscQueue {
+public:
+  static_assert(CAPACITY >= 2 && (CAPACITY & (CAPACITY - 1)) == 0,
+                "CAPACITY must be a power of two");
+
+  // Producer side.
+  bool push(const T &item) {
+    uint32_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == CAPACITY) return false;
+    slots_[head & (CAPACITY - 1)] = item;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer side.
+  bool pop(T &out) {
+    uint32_t tail = tail_.load(std::memory_order_relaxed);
+    if (head_.load(std::memory_order_acquire) == tail) return false;
+    out = slots_[tail & (CAPACITY - 1)];
+    tail_.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Either side; a snapshot that may be stale by the time it is used.
+  uint16_t size() const {
+    return (uint16_t)(head_.load(std::memory_order_acquire) -
+                      tail_.load(std::memory_order_acquire));
+  }
+  bool     empty() const { return size() == 0; }
+  uint16_t capacity() const { return CAPACITY; }
+
+private:
+  T                     slots_[CAPACITY];
+  std::atomic<uint32_t> head_{0};
+  std::atomic<uint32_t> tail_{0};
+};
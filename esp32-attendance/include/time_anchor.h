@@ -0,0 +1,213 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  TimeAnchor — wall clock carried forward from the last NTP sync
+//  on millis().
+//
+//  • sync() records the millis() value at which an NTP second
+//    began. Until the next sync, epoch() is that anchor plus the
+//    elapsed millis, so reading the time is an add and a divide
+//    rather than a trip through the libc time zone code.
+//  • format() writes ISO-8601 local time by integer math. The
+//    civil date of the current local day is cached in one atomic
+//    word, so both tasks can format without a lock.
+//  • The SNTP callback is the only writer. The anchor is a seqlock,
+//    so a reader that races a sync just reads again.
+//  • Each resync measures how far millis() had drifted from NTP
+//    since the previous one; stats() keeps the last and worst.
+// ─────────────────────────────────────────────────────────────
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+// Days since 1970-01-01 for a proleptic Gregorian date
+inline int32_t daysFromCivil(int y, int m, int d) {
+  y -= m <= 2;
+  int32_t era = (y >= 0 ? y : y - 399) / 400;
+  int32_t yoe = y - era * 400;
+  int32_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+  int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+  return era * 146097 + doe - 719468;
+}
+
+// Inverse of daysFromCivil()
+inline void civilFromDays(int32_t z, int &y, int &m, int &d) {
+  z += 719468;
+  int32_t  era = (z >= 0 ? z : z - 146096) / 146097;
+  uint32_t doe = (uint32_t)(z - era * 146097);
+  uint32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  uint32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+  uint32_t mp  = (5 * doy + 2) / 153;
+  d = (int)(doy - (153 * mp + 2) / 5 + 1);
+  m = (int)(mp < 10 ? mp + 3 : mp - 9);
+  y = (int)yoe + era * 400 + (m <= 2);
+}
+
+class TimeAnchor {
+public:
+  struct Stats {
+    uint16_t syncs;          // NTP answers since boot
+    int32_t  lastDriftMs;    // millis() clock minus NTP at the last resync; + = fast
+    int32_t  worstDriftMs;   // largest |drift| seen at any resync
+    int32_t  driftPpm;       // last drift over the interval it built up in
+    uint32_t intervalS;      // length of that interval
+  };
+
+  // `suffix` is the fixed UTC offset as printed, e.g. "+05:30"
+  TimeAnchor(int32_t utcOffsetSec, const char *suffix, uint32_t staleMs)
+      : offset_(utcOffsetSec), staleMs_(staleMs) {
+    strncpy(suffix_, suffix, sizeof(suffix_) - 1);
+    suffixLen_ = strlen(suffix_);
+  }
+
+  // Length format() needs, terminator included
+  size_t formatLen() const { return 20 + suffixLen_; }
+
+  // Writer side: NTP reported epoch + usec at local time nowMs.
+  void sync(uint32_t epoch, uint32_t usec, uint32_t nowMs) {
+    uint32_t atMs = nowMs - usec / 1000;
+    Stats    st   = stats_;
+    if (epoch_ != 0) {
+      int64_t predicted = (int64_t)epoch_ * 1000 + (int32_t)(nowMs - atMs_);
+      int64_t actual    = (int64_t)epoch * 1000 + usec / 1000;
+      int32_t drift     = (int32_t)(predicted - actual);
+      uint32_t span     = nowMs - syncMs_;
+      st.lastDriftMs = drift;
+      if ((drift < 0 ? -drift : drift) > (st.worstDriftMs < 0 ? -st.worstDriftMs : st.worstDriftMs))
+        st.worstDriftMs = drift;
+      st.driftPpm  = span ? (int32_t)((int64_t)drift * 1000000 / span) : 0;
+      st.intervalS = span / 1000;
+    }
+    st.syncs++;
+
+    seq_.fetch_add(1, std::memory_order_acq_rel);   // odd: write in progress
+    epoch_  = epoch;
+    atMs_   = atMs;
+    syncMs_ = nowMs;
+    stats_  = st;
+    seq_.fetch_add(1, std::memory_order_release);
+  }
+
+  // True while the last sync is younger than staleMs
+  bool valid(uint32_t nowMs) const {
+    uint32_t epoch, atMs, syncMs;
+    read(epoch, atMs, syncMs);
+    return epoch != 0 && nowMs - syncMs <= staleMs_;
+  }
+
+  // UTC seconds at nowMs, or 0 before the first sync
+  uint32_t epoch(uint32_t nowMs) const {
+    uint32_t epoch, atMs, syncMs;
+    read(epoch, atMs, syncMs);
+    return epoch ? epoch + (nowMs - atMs) / 1000 : 0;
+  }
+
+  Stats stats() const {
+    Stats    st;
+    uint32_t s;
+    do {
+      s  = waitEven();
+      st = stats_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (seq_.load(std::memory_order_relaxed) != s);
+    return st;
+  }
+
+  // "2026-03-24T10:49:14+05:30" into buf (formatLen() bytes)
+  void format(uint32_t epoch, char *buf, size_t len) {
+    if (len < formatLen()) {
+      if (len) buf[0] = '\0';
+      return;
+    }
+    int      y, m, d;
+    uint32_t sod = localDay(epoch, y, m, d);
+    put(buf, y, 4);
+    buf[4] = '-';
+    put(buf + 5, m, 2);
+    buf[7] = '-';
+    put(buf + 8, d, 2);
+    buf[10] = 'T';
+    putClock(buf + 11, sod);
+    memcpy(buf + 19, suffix_, suffixLen_ + 1);
+  }
+
+  // "24-03 | 10:49:14" for the status line; needs 17 bytes
+  void formatShort(uint32_t epoch, char *buf, size_t len) {
+    if (len < 17) {
+      if (len) buf[0] = '\0';
+      return;
+    }
+    int      y, m, d;
+    uint32_t sod = localDay(epoch, y, m, d);
+    put(buf, d, 2);
+    buf[2] = '-';
+    put(buf + 3, m, 2);
+    memcpy(buf + 5, " | ", 3);
+    putClock(buf + 8, sod);
+    buf[16] = '\0';
+  }
+
+private:
+  // Second of the local day; y/m/d from the cache when it is the same day
+  uint32_t localDay(uint32_t epoch, int &y, int &m, int &d) {
+    int64_t  local = (int64_t)epoch + offset_;
+    uint32_t day   = (uint32_t)(local / 86400);
+    uint32_t c     = date_.load(std::memory_order_relaxed);
+    if ((c >> 16) == (day & 0xFFFF) && c != 0) {
+      y = 2000 + (int)((c >> 9) & 0x7F);
+      m = (int)((c >> 5) & 0x0F);
+      d = (int)(c & 0x1F);
+    } else {
+      civilFromDays((int32_t)day, y, m, d);
+      if (y >= 2000 && y < 2128)
+        date_.store((day & 0xFFFF) << 16 | (uint32_t)(y - 2000) << 9 | (uint32_t)m << 5 | (uint32_t)d,
+                    std::memory_order_relaxed);
+    }
+    return (uint32_t)(local % 86400);
+  }
+
+  static void put(char *p, uint32_t v, uint8_t digits) {
+    while (digits--) {
+      p[digits] = (char)('0' + v % 10);
+      v /= 10;
+    }
+  }
+
+  static void putClock(char *p, uint32_t sod) {
+    put(p, sod / 3600, 2);
+    p[2] = ':';
+    put(p + 3, sod / 60 % 60, 2);
+    p[5] = ':';
+    put(p + 6, sod % 60, 2);
+  }
+
+  uint32_t waitEven() const {
+    uint32_t s;
+    while ((s = seq_.load(std::memory_order_acquire)) & 1) {}
+    return s;
+  }
+
+  void read(uint32_t &epoch, uint32_t &atMs, uint32_t &syncMs) const {
+    uint32_t s;
+    do {
+      s      = waitEven();
+      epoch  = epoch_;
+      atMs   = atMs_;
+      syncMs = syncMs_;
+      std::atomic_thread_fence(std::memory_order_acquire);
+    } while (seq_.load(std::memory_order_relaxed) != s);
+  }
+
+  const int32_t  offset_;
+  const uint32_t staleMs_;
+  char           suffix_[8] = {0};
+  size_t         suffixLen_ = 0;
+
+  std::atomic<uint32_t> seq_{0};
+  volatile uint32_t     epoch_  = 0;   // UTC second that began at atMs_
+  volatile uint32_t     atMs_   = 0;
+  volatile uint32_t     syncMs_ = 0;   // millis() of the sync itself
+  Stats                 stats_  = {};
+
+  std::atomic<uint32_t> date_{0};      // day:16 | year-2000:7 | month:4 | mday:5
+};
@@ -0,0 +1,102 @@
+#pragma once
+#include <Arduino.h>
+#include <HardwareSerial.h>
+#include <deque>
+#include <vector>
+
+#define FINGERPRINT_OK                 0x00
+#define FINGERPRINT_PACKETRECIEVEERR   0x01
+#define FINGERPRINT_NOFINGER           0x02
+#define FINGERPRINT_IMAGEFAIL          0x03
+#define FINGERPRINT_IMAGEMESS          0x06
+#define FINGERPRINT_FEATUREFAIL        0x07
+#define FINGERPRINT_NOMATCH            0x08
+#define FINGERPRINT_NOTFOUND           0x09
+#define FINGERPRINT_ENROLLMISMATCH     0x0A
+#define FINGERPRINT_BADLOCATION        0x0B
+#define FINGERPRINT_DBREADFAIL         0x0C
+#define FINGERPRINT_UPLOADFEATUREFAIL  0x0D
+#define FINGERPRINT_PACKETRESPONSEFAIL 0x0E
+#define FINGERPRINT_DELETEFAIL         0x10
+#define FINGERPRINT_DBCLEARFAIL        0x11
+#define FINGERPRINT_FLASHERR           0x18
+#define FINGERPRINT_TIMEOUT            0xFF
+#define FINGERPRINT_BADPACKET          0xFE
+
+#define FINGERPRINT_STARTCODE          0xEF01
+#define FINGERPRINT_COMMANDPACKET      0x1
+#define FINGERPRINT_DATAPACKET         0x2
+#define FINGERPRINT_ACKPACKET          0x7
+#define FINGERPRINT_ENDDATAPACKET      0x8
+
+#define FINGERPRINT_PACKET_SIZE_32     0x0
+#define FINGERPRINT_PACKET_SIZE_64     0x1
+#define FINGERPRINT_PACKET_SIZE_128    0x2
+#define FINGERPRINT_PACKET_SIZE_256    0x3
+
+#define DEFAULT_TIMEOUT                1000
+
+struct Adafruit_Fingerprint_Packet {
+  Adafruit_Fingerprint_Packet(uint8_t type, uint16_t length, uint8_t *data) {
+    this->start_code = FINGERPRINT_STARTCODE;
+    this->type       = type;
+    this->length     = length;
+    memset(address, 0xFF, sizeof(address));
+    memcpy(this->data, data, length < 64 ? length : 64);
+  }
+  uint16_t start_code;
+  uint8_t  address[4];
+  uint8_t  type;
+  uint16_t length;
+  uint8_t  data[64];
+};
+
+class Adafruit_Fingerprint {
+public:
+  explicit Adafruit_Fingerprint(HardwareSerial *hs, uint32_t password = 0x0);
+
+  void    begin(uint32_t baud) { (void)baud; }
+  bool    verifyPassword();
+  uint8_t getParameters();
+
+  uint8_t getImage();
+  uint8_t image2Tz(uint8_t slot = 1);
+  uint8_t createModel();
+  uint8_t storeModel(uint16_t id, uint8_t slot = 1);
+  uint8_t loadModel(uint16_t id, uint8_t slot = 1);
+  uint8_t getModel();
+  uint8_t deleteModel(uint16_t id);
+  uint8_t emptyDatabase();
+  uint8_t fingerFastSearch();
+  uint8_t fingerSearch(uint8_t slot = 1);
+  uint8_t getTemplateCount();
+  uint8_t setPacketSize(uint8_t size);
+
+  void    writeStructuredPacket(const Adafruit_Fingerprint_Packet &p);
+  uint8_t getStructuredPacket(Adafruit_Fingerprint_Packet *p, uint16_t timeout = DEFAULT_TIMEOUT);
+
+  uint16_t fingerID      = 0;
+  uint16_t confidence    = 0;
+  uint16_t templateCount = 0;
+  uint16_t capacity      = 1000;
+  uint16_t packet_len    = 128;
+
+  // Host-only: which fake sensor instance this object drives
+  uint8_t  simIndex() const { return index_; }
+
+private:
+  HardwareSerial *serial_;
+  uint8_t         index_;
+  int             charBuf_[2] = {-1, -1};
+  int             imageKey_   = -1;
+
+  // UpChar/DownChar in flight: packets the sensor still has to send,
+  // and the template the host is downloading into char buffer 1
+  struct Reply {
+    uint8_t              type;
+    std::vector<uint8_t> data;
+  };
+  std::deque<Reply>    replies_;
+  std::vector<uint8_t> download_;
+  bool                 downloading_ = false;
+};
@@ -0,0 +1,24 @@
+#pragma once
+#include <Arduino.h>
+#include <Wire.h>
+
+//  Stand-in for Adafruit_BusIO's I2C device, as Adafruit_GrayOLED
+//  holds it. Each write() is one transaction on the wire: address,
+//  prefix and data at the speed last set, charged to the display
+//  stats (the panel is the only I2C device on the bus).
+class Adafruit_I2CDevice {
+public:
+  Adafruit_I2CDevice(uint8_t addr, TwoWire *theWire = &Wire) : addr_(addr), wire_(theWire) {}
+
+  uint8_t address() const { return addr_; }
+  bool    begin(bool addr_detect = true) { (void)addr_detect; return true; }
+  bool    write(const uint8_t *buffer, size_t len, bool stop = true,
+                const uint8_t *prefix_buffer = nullptr, size_t prefix_len = 0);
+  bool    setSpeed(uint32_t desiredclk) { hz_ = desiredclk; return true; }
+  size_t  maxBufferSize() { return 128; }   // I2C_BUFFER_LENGTH on the ESP32
+
+private:
+  uint8_t  addr_;
+  TwoWire *wire_;
+  uint32_t hz_ = 100000;
+};
@@ -0,0 +1,87 @@
+#pragma once
+#include <Adafruit_I2CDevice.h>
+#include <Arduino.h>
+#include <Wire.h>
+
+#define SH110X_BLACK   0
+#define SH110X_WHITE   1
+#define SH110X_INVERSE 2
+
+#define SH110X_SETPAGEADDR   0xB0
+#define SH110X_SETLOWCOLUMN  0x00
+#define SH110X_SETHIGHCOLUMN 0x10
+
+//  Framebuffer-accurate stand-in for Adafruit_SH1107. Drawing marks
+//  a dirty window exactly like Adafruit_GrayOLED. display() writes
+//  what the library's does: the window's columns of every page from
+//  the window's first to the bottom of the panel (window_y2 is not
+//  consulted), through the I2C device begin() opened.
+class Adafruit_SH1107 {
+public:
+  Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire *twi = &Wire,
+                  int8_t rst_pin = -1, uint32_t preclk = 400000,
+                  uint32_t postclk = 100000);
+
+  bool begin(uint8_t addr = 0x3C, bool reset = true);
+  void display();
+  void clearDisplay();
+
+  void setRotation(uint8_t r) { (void)r; }
+  void setTextSize(uint8_t s) { textSize_ = s ? s : 1; }
+  void setTextColor(uint16_t c) { textColor_ = c; }
+  void setTextColor(uint16_t c, uint16_t bg) { textColor_ = c; (void)bg; }
+  void setTextWrap(bool w) { wrap_ = w; }
+  void setCursor(int16_t x, int16_t y) { cursorX_ = x; cursorY_ = y; }
+  int16_t getCursorX() const { return cursorX_; }
+  int16_t getCursorY() const { return cursorY_; }
+  int16_t width() const  { return w_; }
+  int16_t height() const { return h_; }
+
+  void drawPixel(int16_t x, int16_t y, uint16_t color);
+  bool getPixel(int16_t x, int16_t y) const;
+  void fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color);
+  void drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color);
+  void drawFastHLine(int16_t x, int16_t y, int16_t w, uint16_t color) { fillRect(x, y, w, 1, color); }
+
+  void getTextBounds(const char *s, int16_t x, int16_t y,
+                     int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h);
+  void getTextBounds(const String &s, int16_t x, int16_t y,
+                     int16_t *x1, int16_t *y1, uint16_t *w, uint16_t *h) {
+    getTextBounds(s.c_str(), x, y, x1, y1, w, h);
+  }
+
+  size_t write(uint8_t c);
+  size_t print(const char *s);
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c)          { return write((uint8_t)c); }
+  size_t print(int v)           { char b[16]; snprintf(b, sizeof(b), "%d", v); return print(b); }
+  size_t print(unsigned int v)  { char b[16]; snprintf(b, sizeof(b), "%u", v); return print(b); }
+  size_t print(long v)          { char b[24]; snprintf(b, sizeof(b), "%ld", v); return print(b); }
+  size_t print(unsigned long v) { char b[24]; snprintf(b, sizeof(b), "%lu", v); return print(b); }
+  size_t println()              { return write('\n'); }
+  template <typename T>
+  size_t println(T v)           { return print(v) + println(); }
+
+  uint8_t *getBuffer() { return buffer_; }
+
+protected:
+  // As in Adafruit_GrayOLED / Adafruit_SH110X
+  int16_t             window_x1, window_y1, window_x2, window_y2;
+  Adafruit_I2CDevice *i2c_dev = nullptr;
+  int32_t             i2c_preclk, i2c_postclk;
+  uint8_t             _page_start_offset = 0;
+
+private:
+  TwoWire           *twi_;
+  Adafruit_I2CDevice i2cDevice_;
+  uint16_t w_, h_;
+  uint8_t  buffer_[128 * 128 / 8];
+  int16_t  cursorX_ = 0, cursorY_ = 0;
+  uint8_t  textSize_ = 1;
+  uint16_t textColor_ = SH110X_WHITE;
+  bool     wrap_ = true;
+
+  void markDirty(int16_t x, int16_t y);
+  void drawChar(int16_t x, int16_t y, unsigned char c, uint16_t color, uint8_t size);
+};
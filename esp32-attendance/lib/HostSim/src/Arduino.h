@@ -0,0 +1,213 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  Host (native) stand-in for the ESP32 Arduino core.
+//
+//  Only the subset the firmware uses is provided. Time is
+//  virtual: millis()/micros() read a simulated clock that
+//  delay() and the fake peripherals advance, so a run is
+//  reproducible for a given seed and timing profile.
+// ─────────────────────────────────────────────────────────────
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdarg.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include "freertos/FreeRTOS.h"   // the ESP32 core pulls these in too
+#include "freertos/task.h"
+#include "freertos/semphr.h"
+
+using std::min;
+using std::max;
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define HIGH   1
+#define LOW    0
+#define INPUT  0x01
+#define OUTPUT 0x03
+#define INPUT_PULLUP 0x05
+
+#define RISING  0x01
+#define FALLING 0x02
+#define CHANGE  0x03
+#define IRAM_ATTR
+#define RTC_NOINIT_ATTR   // host RAM: gone with the process, like a cold power-on
+
+#define DEC 10
+#define HEX 16
+
+#define F(s) (s)
+
+//  Timing
+unsigned long millis();
+unsigned long micros();
+void          delay(uint32_t ms);
+void          delayMicroseconds(uint32_t us);
+void          yield();
+
+uint32_t      esp_random();
+
+//  GPIO
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int  digitalRead(uint8_t pin);
+#define digitalPinToInterrupt(p) (p)
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode);
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode);
+void detachInterrupt(uint8_t pin);
+
+//  ESP32 time helpers (esp32-hal-time)
+void configTime(long gmtOffset_sec, int daylightOffset_sec,
+                const char *server1, const char *server2 = nullptr,
+                const char *server3 = nullptr);
+bool getLocalTime(struct tm *info, uint32_t ms = 5000);
+
+// ─────────────────────────────────────────────────────────────
+//  String
+// ─────────────────────────────────────────────────────────────
+class String {
+public:
+  String() {}
+  String(const char *s) : s_(s ? s : "") { noteAlloc(); }
+  String(const String &o) : s_(o.s_) { noteAlloc(); }
+  String(String &&o) noexcept : s_(std::move(o.s_)) { held_ = o.held_; o.held_ = 0; }
+  explicit String(char c) : s_(1, c) { noteAlloc(); }
+  String(int v, unsigned char base = DEC)           { fromInt((long long)v, base); }
+  String(unsigned int v, unsigned char base = DEC)  { fromUInt(v, base); }
+  String(long v, unsigned char base = DEC)          { fromInt(v, base); }
+  String(unsigned long v, unsigned char base = DEC) { fromUInt(v, base); }
+  ~String() { heapBytes -= held_; }
+
+  String &operator=(const String &o) { s_ = o.s_; noteAlloc(); return *this; }
+  String &operator=(String &&o) noexcept {
+    s_ = std::move(o.s_);
+    heapBytes -= held_;
+    held_   = o.held_;
+    o.held_ = 0;
+    o.track();
+    return *this;
+  }
+  String &operator=(const char *s) { s_ = s ? s : ""; noteAlloc(); return *this; }
+
+  String &operator+=(const String &o) { s_ += o.s_; noteAlloc(); return *this; }
+  String &operator+=(const char *s)   { s_ += s ? s : ""; noteAlloc(); return *this; }
+  String &operator+=(char c)          { s_ += c; noteAlloc(); return *this; }
+
+  friend String operator+(const String &a, const String &b) { String r(a); r += b; return r; }
+  friend String operator+(const String &a, const char *b)   { String r(a); r += b; return r; }
+  friend String operator+(const char *a, const String &b)   { String r(a); r += b; return r; }
+
+  bool operator==(const String &o) const { return s_ == o.s_; }
+  bool operator==(const char *s)   const { return s_ == (s ? s : ""); }
+  bool operator!=(const String &o) const { return !(*this == o); }
+  bool operator!=(const char *s)   const { return !(*this == s); }
+
+  unsigned int length() const { return (unsigned int)s_.size(); }
+  const char  *c_str()  const { return s_.c_str(); }
+  char operator[](unsigned int i) const { return i < s_.size() ? s_[i] : 0; }
+
+  void toCharArray(char *buf, unsigned int size) const {
+    if (!buf || size == 0) return;
+    size_t n = std::min((size_t)size - 1, s_.size());
+    memcpy(buf, s_.data(), n);
+    buf[n] = '\0';
+  }
+  void replace(char from, char to) { std::replace(s_.begin(), s_.end(), from, to); }
+  void trim() {
+    size_t a = s_.find_first_not_of(" \t\r\n");
+    size_t b = s_.find_last_not_of(" \t\r\n");
+    s_ = (a == std::string::npos) ? std::string() : s_.substr(a, b - a + 1);
+    track();
+  }
+  bool startsWith(const char *p) const { return s_.rfind(p, 0) == 0; }
+  bool reserve(unsigned int n) { s_.reserve(n); noteAlloc(); return true; }
+
+  // Host-only: number of heap (re)allocations made by String objects,
+  // and the bytes live String buffers hold now and at their peak (the
+  // fake ESP.getFreeHeap()/getMinFreeHeap() are charged for them).
+  static uint32_t allocCount;
+  static int64_t  heapBytes;
+  static int64_t  heapPeak;
+
+private:
+  std::string s_;
+  size_t      held_ = 0;   // heap bytes this object is charged for
+
+  void track() {
+    size_t now = s_.capacity() > 15 ? s_.capacity() + 1 : 0;
+    heapBytes += (int64_t)now - (int64_t)held_;
+    held_ = now;
+    if (heapBytes > heapPeak) heapPeak = heapBytes;
+  }
+  void noteAlloc() {
+    if (s_.size() > 15) allocCount++;  // beyond SSO
+    track();
+  }
+  void fromUInt(unsigned long long v, unsigned char base) {
+    char buf[24];
+    snprintf(buf, sizeof(buf), base == HEX ? "%llx" : "%llu", v);
+    s_ = buf;
+  }
+  void fromInt(long long v, unsigned char base) {
+    if (base == HEX) { fromUInt((unsigned long long)v, base); return; }
+    char buf[24];
+    snprintf(buf, sizeof(buf), "%lld", v);
+    s_ = buf;
+  }
+};
+
+// ─────────────────────────────────────────────────────────────
+//  Serial
+// ─────────────────────────────────────────────────────────────
+class HostSerial {
+public:
+  void   begin(unsigned long) {}
+  size_t print(const char *s);
+  size_t print(const String &s) { return print(s.c_str()); }
+  size_t print(char c)          { char b[2] = {c, 0}; return print(b); }
+  size_t print(int v)           { return printf("%d", v); }
+  size_t print(unsigned int v)  { return printf("%u", v); }
+  size_t print(long v)          { return printf("%ld", v); }
+  size_t print(unsigned long v) { return printf("%lu", v); }
+  size_t println()                     { return print("\n"); }
+  size_t println(const char *s)        { return print(s) + println(); }
+  size_t println(const String &s)      { return print(s) + println(); }
+  template <typename T>
+  size_t println(T v)                  { return print(v) + println(); }
+  size_t printf(const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+  int    available();               // fake::serialType() input
+  int    read();
+  operator bool() const { return true; }
+};
+extern HostSerial Serial;
+
+// ─────────────────────────────────────────────────────────────
+//  ESP
+// ─────────────────────────────────────────────────────────────
+class EspClass {
+public:
+  uint64_t getEfuseMac() { return 0xA4CF12345678ULL; }
+  uint32_t getFreeHeap();
+  uint32_t getMinFreeHeap();
+  uint32_t getMaxAllocHeap();
+  void     restart() {}
+};
+extern EspClass ESP;
+
+class IPAddress {
+public:
+  IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0)
+      : a_(a), b_(b), c_(c), d_(d) {}
+  String toString() const {
+    char buf[16];
+    snprintf(buf, sizeof(buf), "%u.%u.%u.%u", a_, b_, c_, d_);
+    return String(buf);
+  }
+private:
+  uint8_t a_, b_, c_, d_;
+};
@@ -0,0 +1,25 @@
+#pragma once
+#include <Arduino.h>
+
+class EEPROMClass {
+public:
+  bool    begin(size_t size);
+  uint8_t read(int address);
+  void    write(int address, uint8_t val);
+  bool    commit();
+  size_t  length();
+  uint8_t *getDataPtr();
+
+  size_t readBytes(int address, void *value, size_t len);
+  size_t writeBytes(int address, const void *value, size_t len);
+
+  template <typename T> T &get(int address, T &t) {
+    readBytes(address, &t, sizeof(T));
+    return t;
+  }
+  template <typename T> const T &put(int address, const T &t) {
+    writeBytes(address, &t, sizeof(T));
+    return t;
+  }
+};
+extern EEPROMClass EEPROM;
@@ -0,0 +1,19 @@
+#pragma once
+#include <Arduino.h>
+
+#define SERIAL_8N1 0x800001c
+
+class HardwareSerial {
+public:
+  explicit HardwareSerial(int uartNum) : uartNum_(uartNum) {}
+  void begin(unsigned long baud, uint32_t config = SERIAL_8N1,
+             int8_t rxPin = -1, int8_t txPin = -1) {
+    (void)config; (void)rxPin; (void)txPin;
+    baud_ = baud;
+  }
+  unsigned long baudRate() const { return baud_; }
+  int uartNum() const { return uartNum_; }
+private:
+  int           uartNum_;
+  unsigned long baud_ = 0;
+};
@@ -0,0 +1,60 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFiClientSecure.h>
+#include <functional>
+#include <string>
+
+#define MQTT_CONNECTION_TIMEOUT     -4
+#define MQTT_CONNECTION_LOST        -3
+#define MQTT_CONNECT_FAILED         -2
+#define MQTT_DISCONNECTED           -1
+#define MQTT_CONNECTED               0
+
+#define MQTT_MAX_HEADER_SIZE 5
+
+typedef std::function<void(char *, uint8_t *, unsigned int)> MQTT_CALLBACK_SIGNATURE;
+
+class PubSubClient {
+public:
+  explicit PubSubClient(Client &client) : client_(&client) {}
+
+  PubSubClient &setServer(const char *domain, uint16_t port);
+  PubSubClient &setCallback(MQTT_CALLBACK_SIGNATURE cb) { callback_ = cb; return *this; }
+  PubSubClient &setKeepAlive(uint16_t s) { keepAlive_ = s; return *this; }
+  PubSubClient &setSocketTimeout(uint16_t s) { socketTimeout_ = s; return *this; }
+  bool          setBufferSize(uint16_t size) { bufferSize_ = size; return true; }
+  uint16_t      getBufferSize() const { return bufferSize_; }
+
+  bool connect(const char *id, const char *user, const char *pass);
+  bool connect(const char *id, const char *user, const char *pass,
+               const char *willTopic, uint8_t willQos, bool willRetain,
+               const char *willMessage, bool cleanSession = true);
+  void disconnect();
+  bool connected();
+
+  bool publish(const char *topic, const char *payload, bool retained = false);
+  bool publish(const char *topic, const uint8_t *payload, unsigned int len,
+               bool retained = false);
+
+  bool subscribe(const char *topic, uint8_t qos = 0);
+  bool unsubscribe(const char *topic);
+  bool loop();
+  int  state() const { return state_; }
+
+  uint16_t keepAlive() const { return keepAlive_; }
+  bool     lastCleanSession() const { return cleanSession_; }
+
+private:
+  Client                  *client_;
+  std::string              domain_;
+  uint16_t                 port_          = 0;
+  MQTT_CALLBACK_SIGNATURE  callback_;
+  uint16_t                 bufferSize_    = 256;
+  uint16_t                 keepAlive_     = 15;
+  uint16_t                 socketTimeout_ = 15;
+  bool                     cleanSession_  = true;
+  int                      state_         = MQTT_DISCONNECTED;
+  bool                     session_       = false;
+  std::string              willTopic_, willMessage_;
+  bool                     willRetain_    = false;
+};
@@ -0,0 +1,36 @@
+#pragma once
+#include <Arduino.h>
+
+typedef enum {
+  WL_IDLE_STATUS     = 0,
+  WL_NO_SSID_AVAIL   = 1,
+  WL_CONNECTED       = 3,
+  WL_CONNECT_FAILED  = 4,
+  WL_CONNECTION_LOST = 5,
+  WL_DISCONNECTED    = 6
+} wl_status_t;
+
+typedef enum {
+  WIFI_OFF = 0,
+  WIFI_STA = 1,
+} wifi_mode_t;
+
+//  The two station events the firmware listens for
+typedef enum {
+  ARDUINO_EVENT_WIFI_STA_DISCONNECTED = 5,
+  ARDUINO_EVENT_WIFI_STA_GOT_IP       = 7,
+} arduino_event_id_t;
+
+typedef void (*WiFiEventCb)(arduino_event_id_t event);
+
+class WiFiClass {
+public:
+  wl_status_t status();
+  wl_status_t begin(const char *ssid, const char *pass = nullptr);
+  bool        disconnect(bool wifioff = false);
+  bool        mode(wifi_mode_t m) { (void)m; return true; }
+  bool        setAutoReconnect(bool on);
+  int         onEvent(WiFiEventCb cb);
+  IPAddress   localIP() { return IPAddress(192, 168, 1, 50); }
+};
+extern WiFiClass WiFi;
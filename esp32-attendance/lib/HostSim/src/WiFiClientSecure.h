@@ -0,0 +1,10 @@
+#pragma once
+#include <Arduino.h>
+#include <WiFiClient.h>
+
+//  Always a full handshake (timing.tlsHandshakeUs)
+class WiFiClientSecure : public WiFiClient {
+public:
+  void setInsecure() {}
+  int  connect(const char *host, uint16_t port) override;
+};
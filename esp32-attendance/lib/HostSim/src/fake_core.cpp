@@ -0,0 +1,263 @@
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — Serial, GPIO, SNTP, heap
+// ─────────────────────────────────────────────────────────────
+#include "fake_hw.h"
+#include <esp_sntp.h>
+#include <WiFi.h>
+
+HostSerial Serial;
+EspClass   ESP;
+uint32_t   String::allocCount = 0;
+int64_t    String::heapBytes  = 0;
+int64_t    String::heapPeak   = 0;
+
+static uint8_t pinLevel[64];
+static void  (*pinIsr[64])();
+static void  (*pinIsrArg[64])(void *);
+static void   *pinArg[64];
+static int     pinIsrMode[64];
+
+namespace fake {
+
+FakeTiming timing;
+FakeStats  stats;
+bool       serialEcho = false;
+
+static std::string serialIn, serialOut;
+static uint32_t rngState  = 1;
+static uint32_t espRng    = 1;   // esp_random(); separate so timing jitter is unaffected
+static time_t   epochBase = 1774324800;   // 2026-03-24T04:00:00Z
+
+void resetDevices();   // fake_devices.cpp
+void resetClock();     // fake_rtos.cpp
+
+static uint32_t rng() {
+  rngState ^= rngState << 13;
+  rngState ^= rngState >> 17;
+  rngState ^= rngState << 5;
+  return rngState;
+}
+
+uint32_t cost(uint32_t us) {
+  if (us == 0 || timing.jitterPct == 0) return us;
+  int32_t span  = (int32_t)timing.jitterPct;
+  int32_t pct   = (int32_t)(rng() % (uint32_t)(2 * span + 1)) - span;
+  int64_t delta = (int64_t)us * pct / 100;
+  return (uint32_t)((int64_t)us + delta);
+}
+
+void setEpochBase(time_t utc) { epochBase = utc; }
+
+// ── SNTP ─────────────────────────────────────────────────────
+static sntp_sync_time_cb_t ntpCb        = nullptr;
+static bool                ntpPending   = false;
+static uint64_t            ntpDueUs     = 0;
+static bool                ntpCompleted = false;
+static bool                timeSet      = false;
+static long                tzOffsetSec  = 0;
+static bool                inPump       = false;
+
+time_t epochNow() { return epochBase + (time_t)(nowUs() / 1000000ULL); }
+
+//  What an NTP server would say now: the virtual clock is the
+//  device crystal, which gains rtcDriftPpm against true time.
+static struct timeval ntpNow() {
+  uint64_t trueUs = nowUs() * 1000000ULL / (uint64_t)(1000000 + timing.rtcDriftPpm);
+  struct timeval tv;
+  tv.tv_sec  = epochBase + (time_t)(trueUs / 1000000ULL);
+  tv.tv_usec = (suseconds_t)(trueUs % 1000000ULL);
+  return tv;
+}
+
+void pump() {
+  if (inPump) return;
+  inPump = true;
+  wifiEvents();
+  touchEvents();
+  if (ntpPending) {
+    if (WiFi.status() != WL_CONNECTED) {
+      ntpDueUs = 0;
+    } else if (ntpDueUs == 0) {
+      ntpDueUs = nowUs() + (uint64_t)cost(timing.ntpSyncMs) * 1000ULL;
+    } else if (nowUs() >= ntpDueUs) {
+      ntpPending   = false;
+      ntpCompleted = true;
+      timeSet      = true;
+      if (ntpCb) {
+        struct timeval tv = ntpNow();
+        ntpCb(&tv);
+      }
+    }
+  }
+  inPump = false;
+}
+
+void resetCore(uint32_t seed) {
+  resetClock();
+  rngState     = seed ? seed : 1;
+  espRng       = (seed * 2246822519u) | 1;
+  stats        = FakeStats();
+  ntpPending   = false;
+  ntpDueUs     = 0;
+  ntpCompleted = false;
+  timeSet      = false;
+  serialIn.clear();
+  serialOut.clear();
+  memset(pinLevel, 0, sizeof(pinLevel));
+  memset(pinIsr, 0, sizeof(pinIsr));
+  memset(pinIsrArg, 0, sizeof(pinIsrArg));
+}
+
+void serialType(const char *text) { serialIn += text; }
+
+std::string serialTake() {
+  std::string out;
+  out.swap(serialOut);
+  return out;
+}
+
+void reset(uint32_t seed) {
+  resetCore(seed);
+  resetDevices();
+}
+
+}  // namespace fake
+
+// ─────────────────────────────────────────────────────────────
+//  Arduino core
+// ─────────────────────────────────────────────────────────────
+unsigned long millis() { return (unsigned long)(fake::nowUs() / 1000ULL); }
+unsigned long micros() { return (unsigned long)fake::nowUs(); }
+
+void delay(uint32_t ms) {
+  fake::advanceUs((uint64_t)ms * 1000ULL);
+  fake::pump();
+}
+
+void delayMicroseconds(uint32_t us) { fake::advanceUs(us); }
+void yield() { fake::pump(); }
+
+void pinMode(uint8_t pin, uint8_t mode) { (void)pin; (void)mode; }
+void digitalWrite(uint8_t pin, uint8_t val) { if (pin < 64) pinLevel[pin] = val; }
+int  digitalRead(uint8_t pin) {
+  fake::pump();   // inputs driven by the fakes settle first
+  return pin < 64 ? pinLevel[pin] : LOW;
+}
+
+void attachInterrupt(uint8_t pin, void (*isr)(), int mode) {
+  if (pin >= 64) return;
+  pinIsr[pin]     = isr;
+  pinIsrMode[pin] = mode;
+}
+
+void attachInterruptArg(uint8_t pin, void (*isr)(void *), void *arg, int mode) {
+  if (pin >= 64) return;
+  pinIsrArg[pin]  = isr;
+  pinArg[pin]     = arg;
+  pinIsrMode[pin] = mode;
+}
+
+void detachInterrupt(uint8_t pin) {
+  if (pin >= 64) return;
+  pinIsr[pin]    = nullptr;
+  pinIsrArg[pin] = nullptr;
+}
+
+//  An input driven by a fake device; fires an attached ISR on a
+//  matching edge, from whichever task noticed it first.
+void fake::drivePin(uint8_t pin, uint8_t level) {
+  if (pin >= 64 || pinLevel[pin] == level) return;
+  pinLevel[pin] = level;
+  int edge = level ? RISING : FALLING;
+  if (!(pinIsrMode[pin] & edge)) return;
+  if (pinIsr[pin]) pinIsr[pin]();
+  if (pinIsrArg[pin]) pinIsrArg[pin](pinArg[pin]);
+}
+
+size_t HostSerial::print(const char *s) {
+  if (!s) return 0;
+  if (fake::serialEcho) fputs(s, stdout);
+  fake::serialOut += s;
+  if (fake::serialOut.size() > 131072) fake::serialOut.erase(0, fake::serialOut.size() - 65536);
+  return strlen(s);
+}
+
+int HostSerial::available() { return (int)fake::serialIn.size(); }
+
+int HostSerial::read() {
+  if (fake::serialIn.empty()) return -1;
+  int c = (uint8_t)fake::serialIn[0];
+  fake::serialIn.erase(0, 1);
+  return c;
+}
+
+size_t HostSerial::printf(const char *fmt, ...) {
+  char    buf[512];
+  va_list ap;
+  va_start(ap, fmt);
+  int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+  va_end(ap);
+  print(buf);
+  return n > 0 ? (size_t)n : 0;
+}
+
+uint32_t esp_random() {
+  uint32_t &s = fake::espRng;
+  s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+  return s;
+}
+
+//  The host has no fixed heap. Report a nominal ESP32 figure less
+//  what live String buffers hold, so a leak or a growing peak in the
+//  firmware shows up in its own telemetry.
+#define FAKE_HEAP_FREE   180000
+#define FAKE_HEAP_BLOCK  110000
+
+uint32_t EspClass::getFreeHeap()    { return (uint32_t)(FAKE_HEAP_FREE - String::heapBytes); }
+uint32_t EspClass::getMinFreeHeap() { return (uint32_t)(FAKE_HEAP_FREE - String::heapPeak); }
+uint32_t EspClass::getMaxAllocHeap() {
+  return (uint32_t)std::min<int64_t>(FAKE_HEAP_BLOCK, FAKE_HEAP_FREE - String::heapBytes);
+}
+
+// ─────────────────────────────────────────────────────────────
+//  Time
+// ─────────────────────────────────────────────────────────────
+void configTime(long gmtOffset_sec, int daylightOffset_sec,
+                const char *server1, const char *server2,
+                const char *server3) {
+  (void)server1; (void)server2; (void)server3;
+  fake::tzOffsetSec = gmtOffset_sec + daylightOffset_sec;
+  fake::ntpPending  = true;
+  fake::ntpDueUs    = 0;
+  fake::pump();
+}
+
+bool getLocalTime(struct tm *info, uint32_t ms) {
+  fake::pump();
+  if (!fake::timeSet) {
+    // The real helper polls every 10 ms until the timeout expires
+    delay(ms);
+    return false;
+  }
+  time_t t = fake::epochNow() + fake::tzOffsetSec;
+  gmtime_r(&t, info);
+  return true;
+}
+
+//  Before the first sync the ESP32 RTC counts from 0 at boot.
+extern "C" time_t time(time_t *out) noexcept {
+  time_t t = fake::timeSet ? fake::epochNow() : (time_t)(fake::nowUs() / 1000000ULL);
+  if (out) *out = t;
+  return t;
+}
+
+void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t cb) { fake::ntpCb = cb; }
+
+sntp_sync_status_t sntp_get_sync_status(void) {
+  fake::pump();
+  if (fake::ntpCompleted) {
+    fake::ntpCompleted = false;   // IDF resets the flag once it is read
+    return SNTP_SYNC_STATUS_COMPLETED;
+  }
+  return SNTP_SYNC_STATUS_RESET;
+}
@@ -0,0 +1,1007 @@
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — AS608, SH1107, Wi-Fi, PubSubClient, EEPROM
+// ─────────────────────────────────────────────────────────────
+#include "fake_hw.h"
+#include <Adafruit_Fingerprint.h>
+#include <Adafruit_SH110X.h>
+#include <EEPROM.h>
+#include <PubSubClient.h>
+#include <WiFi.h>
+#include <WiFiClientSecure.h>
+#include <mbedtls/ssl.h>
+#include <deque>
+#include <map>
+#include <set>
+
+TwoWire     Wire;
+WiFiClass   WiFi;
+EEPROMClass EEPROM;
+
+namespace fake {
+
+// ── Fingerprint sensors (indexed by UART number) ─────────────
+#define FAKE_MAX_SENSORS   3
+#define FAKE_SENSOR_SLOTS  1000
+
+struct Presentation {
+  int      key;
+  uint64_t startUs;
+  uint64_t endUs;
+};
+
+struct SensorState {
+  std::vector<Presentation> fingers;
+  std::vector<int>          library = std::vector<int>(FAKE_SENSOR_SLOTS, -1);
+};
+
+static SensorState sensors[FAKE_MAX_SENSORS];
+static uint64_t    imageOkUs  = 0;
+static uint64_t    fingerAtUs = 0;   // arrival of the finger behind imageOkUs
+static int         touchPin[FAKE_MAX_SENSORS] = {-1, -1, -1};
+static bool        attached[FAKE_MAX_SENSORS] = {false, true, false};
+static uint32_t    hits[FAKE_MAX_SENSORS]     = {0, 0, 0};
+static uint32_t    scriptRng  = 1;
+
+void presentFinger(int key, uint64_t atUs, uint32_t holdMs, uint8_t sensor) {
+  if (sensor >= FAKE_MAX_SENSORS) return;
+  sensors[sensor].fingers.push_back({key, atUs, atUs + (uint64_t)holdMs * 1000ULL});
+}
+
+void clearFingers() {
+  for (auto &s : sensors) s.fingers.clear();
+}
+
+void storeTemplate(uint16_t slot, int key, uint8_t sensor) {
+  if (sensor < FAKE_MAX_SENSORS && slot < FAKE_SENSOR_SLOTS)
+    sensors[sensor].library[slot] = key;
+}
+
+int templateAt(uint16_t slot, uint8_t sensor) {
+  if (sensor >= FAKE_MAX_SENSORS || slot >= FAKE_SENSOR_SLOTS) return -1;
+  return sensors[sensor].library[slot];
+}
+
+uint64_t lastImageOkUs() { return imageOkUs; }
+
+void attachSensor(uint8_t sensor, bool on) {
+  if (sensor < FAKE_MAX_SENSORS) attached[sensor] = on;
+}
+
+uint32_t searchHits(uint8_t sensor) {
+  return sensor < FAKE_MAX_SENSORS ? hits[sensor] : 0;
+}
+
+static const Presentation *fingerOn(uint8_t sensor) {
+  if (sensor >= FAKE_MAX_SENSORS) return nullptr;
+  uint64_t now = nowUs();
+  for (const Presentation &p : sensors[sensor].fingers)
+    if (now >= p.startUs && now < p.endUs) return &p;
+  return nullptr;
+}
+
+void liftFinger(uint8_t sensor) {
+  if (sensor >= FAKE_MAX_SENSORS) return;
+  uint64_t now = nowUs();
+  for (Presentation &p : sensors[sensor].fingers)
+    if (now >= p.startUs && now < p.endUs) p.endUs = now;
+}
+
+void wireTouch(int pin, uint8_t sensor) {
+  if (sensor < FAKE_MAX_SENSORS) touchPin[sensor] = pin;
+}
+
+//  The AS608 touch output is high while a finger rests on the window
+void touchEvents() {
+  for (uint8_t s = 0; s < FAKE_MAX_SENSORS; s++)
+    if (touchPin[s] >= 0) drivePin((uint8_t)touchPin[s], fingerOn(s) ? HIGH : LOW);
+}
+
+static uint32_t scriptRand() {
+  scriptRng ^= scriptRng << 13;
+  scriptRng ^= scriptRng >> 17;
+  scriptRng ^= scriptRng << 5;
+  return scriptRng;
+}
+
+uint64_t scriptArrivals(const FakeArrivals &p, int keys, uint64_t startUs,
+                        std::vector<uint64_t> *arrivals, uint8_t sensor) {
+  uint64_t at = startUs, end = startUs;
+  for (uint32_t i = 0; i < p.count; i++) {
+    if (i > 0) at += (uint64_t)((p.burst && i % p.burst == 0) ? p.pauseMs : p.gapMs) * 1000ULL;
+    uint64_t t = at + (p.jitterMs ? (uint64_t)(scriptRand() % p.jitterMs) * 1000ULL : 0);
+    presentFinger(1 + (int)(scriptRand() % (uint32_t)keys), t, p.holdMs, sensor);
+    if (arrivals) arrivals->push_back(t);
+    end = std::max<uint64_t>(end, t + (uint64_t)p.holdMs * 1000ULL);
+  }
+  return end;
+}
+
+// ── Network ──────────────────────────────────────────────────
+static bool     linkUp       = true;
+static bool     brokerUp     = true;
+static bool     wifiBegun    = false;
+static bool     wifiUp       = false;
+static uint64_t wifiAssocDue = 0;
+static bool     wifiAutoRe   = true;
+static bool     wifiReported = false;   // last state passed to the event callback
+static WiFiEventCb wifiEventCb = nullptr;
+
+struct Inbound {
+  std::string topic;
+  std::string payload;
+  uint64_t    dueUs;
+  uint8_t     qos;
+};
+static std::deque<Inbound>      inbound;
+static std::vector<FakePublish> pubs;
+static std::function<void(const FakePublish &)> pubHook;
+
+// Broker side: TLS session cache (session serial → expiry) and
+// whether persistent MQTT sessions are kept
+static bool                         tlsCacheOn   = true;
+static bool                         keepSessions = true;
+static std::map<uint64_t, uint64_t> tlsCache;
+static uint64_t                     tlsSerial    = 0;
+
+void setLinkUp(bool up) {
+  linkUp = up;
+  if (!up) {
+    wifiUp       = false;
+    wifiAssocDue = 0;
+    // Without auto-reconnect the station stays down until begin()
+    if (!wifiAutoRe) wifiBegun = false;
+  }
+}
+
+//  Reports association changes to the WiFi.onEvent() callback, as the
+//  ESP32 event task would; called from pump()
+void wifiEvents() {
+  bool up = WiFi.status() == WL_CONNECTED;
+  if (up == wifiReported) return;
+  wifiReported = up;
+  if (wifiEventCb) wifiEventCb(up ? ARDUINO_EVENT_WIFI_STA_GOT_IP
+                                  : ARDUINO_EVENT_WIFI_STA_DISCONNECTED);
+}
+
+void setBrokerUp(bool up) { brokerUp = up; }
+
+void injectMessage(const char *topic, const char *payload, uint32_t delayMs, uint8_t qos) {
+  inbound.push_back({topic, payload, nowUs() + (uint64_t)delayMs * 1000ULL, qos});
+}
+
+void brokerTlsCache(bool on) {
+  tlsCacheOn = on;
+  if (!on) tlsCache.clear();
+}
+
+void brokerKeepsSessions(bool on) { keepSessions = on; }
+void brokerRestart() { tlsCache.clear(); }
+
+const std::vector<FakePublish> &published() { return pubs; }
+void clearPublished() { pubs.clear(); }
+std::function<void(const FakePublish &)> &onPublish() { return pubHook; }
+
+// ── EEPROM (RAM cache + committed flash image) ───────────────
+static std::vector<uint8_t> eepromRam;
+static std::vector<uint8_t> eepromFlash;
+static bool                 eepromDirty = false;
+static int64_t              eepromTear  = -1;
+
+void eepromTearNextCommit(uint32_t keepBytes) { eepromTear = keepBytes; }
+
+void eepromPowerCut() {
+  eepromRam   = eepromFlash;
+  eepromDirty = false;
+  eepromTear  = -1;
+}
+
+void eepromLoad(const uint8_t *data, size_t len) {
+  eepromFlash.assign(data, data + len);
+  eepromPowerCut();
+}
+
+const uint8_t *eepromData() { return eepromFlash.data(); }
+size_t         eepromSize() { return eepromFlash.size(); }
+
+void eepromWipe() {
+  std::fill(eepromFlash.begin(), eepromFlash.end(), 0);
+  std::fill(eepromRam.begin(),   eepromRam.end(),   0);
+  eepromDirty = false;
+  eepromTear  = -1;
+}
+
+void resetDevices() {
+  for (auto &s : sensors) {
+    s.fingers.clear();
+    std::fill(s.library.begin(), s.library.end(), -1);
+  }
+  imageOkUs    = 0;
+  fingerAtUs   = 0;
+  for (int &pin : touchPin) pin = -1;
+  for (uint8_t i = 0; i < FAKE_MAX_SENSORS; i++) {
+    attached[i] = (i == 1);
+    hits[i]     = 0;
+  }
+  scriptRng    = 0x9E3779B9u;
+  linkUp       = true;
+  brokerUp     = true;
+  wifiBegun    = false;
+  wifiUp       = false;
+  wifiAssocDue = 0;
+  wifiAutoRe   = true;
+  wifiReported = false;
+  wifiEventCb  = nullptr;
+  inbound.clear();
+  pubs.clear();
+  pubHook = nullptr;
+  tlsCacheOn   = true;
+  keepSessions = true;
+  tlsCache.clear();
+  tlsSerial    = 0;
+}
+
+}  // namespace fake
+
+using fake::cost;
+using fake::timing;
+
+// ─────────────────────────────────────────────────────────────
+//  Adafruit_Fingerprint
+// ─────────────────────────────────────────────────────────────
+Adafruit_Fingerprint::Adafruit_Fingerprint(HardwareSerial *hs, uint32_t password)
+    : serial_(hs), index_((uint8_t)hs->uartNum()) {
+  (void)password;
+}
+
+bool Adafruit_Fingerprint::verifyPassword() {
+  if (index_ >= FAKE_MAX_SENSORS || !fake::attached[index_]) {
+    fake::advanceUs((uint64_t)DEFAULT_TIMEOUT * 1000ULL);   // nobody answers
+    return false;
+  }
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  return true;
+}
+
+uint8_t Adafruit_Fingerprint::getParameters() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  capacity = FAKE_SENSOR_SLOTS;
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::getImage() {
+  fake::stats.sensorCalls++;
+  const fake::Presentation *f = fake::fingerOn(index_);
+  if (!f) {
+    fake::advanceUs(cost(timing.getImageNoFingerUs));
+    imageKey_ = -1;
+    return FINGERPRINT_NOFINGER;
+  }
+  imageKey_        = f->key;
+  fake::fingerAtUs = f->startUs;
+  fake::advanceUs(cost(timing.getImageFingerUs));
+  fake::imageOkUs  = fake::nowUs();
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::image2Tz(uint8_t slot) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.image2TzUs));
+  if (slot < 1 || slot > 2) return FINGERPRINT_PACKETRECIEVEERR;
+  if (imageKey_ < 0) return FINGERPRINT_IMAGEMESS;
+  charBuf_[slot - 1] = imageKey_;
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::createModel() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.createModelUs));
+  if (charBuf_[0] < 0 || charBuf_[0] != charBuf_[1]) return FINGERPRINT_ENROLLMISMATCH;
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::storeModel(uint16_t id, uint8_t slot) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.storeModelUs));
+  if (id >= FAKE_SENSOR_SLOTS || slot < 1 || slot > 2) return FINGERPRINT_BADLOCATION;
+  fake::sensors[index_].library[id] = charBuf_[slot - 1];
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::loadModel(uint16_t id, uint8_t slot) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  if (id >= FAKE_SENSOR_SLOTS || slot < 1 || slot > 2) return FINGERPRINT_BADLOCATION;
+  if (fake::sensors[index_].library[id] < 0) return FINGERPRINT_DBREADFAIL;
+  charBuf_[slot - 1] = fake::sensors[index_].library[id];
+  return FINGERPRINT_OK;
+}
+
+//  Templates on the wire: a marker, the finger key, then filler
+//  derived from it. Anything else downloads as a model that never
+//  matches.
+static std::vector<uint8_t> encodeTemplate(int key) {
+  std::vector<uint8_t> t(512);
+  t[0] = 'F';
+  t[1] = 'K';
+  memcpy(&t[2], &key, sizeof(key));
+  for (size_t i = 2 + sizeof(key); i < t.size(); i++) t[i] = (uint8_t)(key * 31 + i);
+  return t;
+}
+
+static int decodeTemplate(const std::vector<uint8_t> &t) {
+  int key = -1;
+  if (t.size() != 512 || t[0] != 'F' || t[1] != 'K') return -1;
+  memcpy(&key, &t[2], sizeof(key));
+  return t == encodeTemplate(key) ? key : -1;
+}
+
+//  UART time for one packet: 11 framing bytes plus the payload
+static void packetTime(HardwareSerial *serial, size_t payload) {
+  unsigned long baud = serial->baudRate() ? serial->baudRate() : 57600;
+  fake::advanceUs((uint64_t)(11 + payload) * 10 * 1000000ULL / baud);
+}
+
+uint8_t Adafruit_Fingerprint::getModel() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  std::vector<uint8_t> t = encodeTemplate(charBuf_[0]);
+  replies_.clear();
+  for (size_t off = 0; off < t.size(); off += packet_len) {
+    size_t n = std::min<size_t>(packet_len, t.size() - off);
+    replies_.push_back({(uint8_t)(off + n >= t.size() ? FINGERPRINT_ENDDATAPACKET
+                                                      : FINGERPRINT_DATAPACKET),
+                        std::vector<uint8_t>(t.begin() + off, t.begin() + off + n)});
+  }
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::setPacketSize(uint8_t size) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  if (size > FINGERPRINT_PACKET_SIZE_256) return FINGERPRINT_PACKETRECIEVEERR;
+  packet_len = (uint16_t)(32 << size);
+  return FINGERPRINT_OK;
+}
+
+void Adafruit_Fingerprint::writeStructuredPacket(const Adafruit_Fingerprint_Packet &p) {
+  packetTime(serial_, p.length);
+  if (p.type == FINGERPRINT_COMMANDPACKET) {
+    fake::stats.sensorCalls++;
+    bool down    = p.length >= 2 && p.data[0] == 0x09 && p.data[1] == 1;   // DownChar
+    downloading_ = down;
+    download_.clear();
+    replies_.clear();
+    replies_.push_back({FINGERPRINT_ACKPACKET,
+                        {(uint8_t)(down ? FINGERPRINT_OK : FINGERPRINT_PACKETRECIEVEERR)}});
+    return;
+  }
+  if (!downloading_) return;
+  download_.insert(download_.end(), p.data, p.data + std::min<uint16_t>(p.length, 64));
+  if (p.type == FINGERPRINT_ENDDATAPACKET) {
+    charBuf_[0]  = decodeTemplate(download_);
+    downloading_ = false;
+  }
+}
+
+//  Same limits as the library: its reader overruns data[] on packets
+//  longer than about 46 bytes and reports a bad packet
+uint8_t Adafruit_Fingerprint::getStructuredPacket(Adafruit_Fingerprint_Packet *p, uint16_t timeout) {
+  if (replies_.empty()) {
+    fake::advanceUs((uint64_t)timeout * 1000ULL);
+    return FINGERPRINT_TIMEOUT;
+  }
+  Reply r = replies_.front();
+  replies_.pop_front();
+  packetTime(serial_, r.data.size());
+  if (r.data.size() + 2 + 17 >= sizeof(p->data)) return FINGERPRINT_BADPACKET;
+  p->start_code = FINGERPRINT_STARTCODE;
+  p->type       = r.type;
+  p->length     = (uint16_t)(r.data.size() + 2);
+  memcpy(p->data, r.data.data(), r.data.size());
+  p->data[r.data.size()] = p->data[r.data.size() + 1] = 0;   // checksum
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::deleteModel(uint16_t id) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  if (id >= FAKE_SENSOR_SLOTS) return FINGERPRINT_BADLOCATION;
+  fake::sensors[index_].library[id] = -1;
+  return FINGERPRINT_OK;
+}
+
+uint8_t Adafruit_Fingerprint::emptyDatabase() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  auto &lib = fake::sensors[index_].library;
+  std::fill(lib.begin(), lib.end(), -1);
+  return FINGERPRINT_OK;
+}
+
+static uint8_t searchLibrary(uint8_t index, int key, uint16_t &fingerID,
+                             uint16_t &confidence) {
+  if (key < 0) return FINGERPRINT_NOTFOUND;
+  const auto &lib = fake::sensors[index].library;
+  for (uint16_t i = 0; i < lib.size(); i++) {
+    if (lib[i] == key) {
+      fingerID   = i;
+      confidence = 120;
+      return FINGERPRINT_OK;
+    }
+  }
+  return FINGERPRINT_NOTFOUND;
+}
+
+uint8_t Adafruit_Fingerprint::fingerFastSearch() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.fastSearchUs));
+  uint8_t r = searchLibrary(index_, charBuf_[0], fingerID, confidence);
+  if (r == FINGERPRINT_OK) fake::hits[index_]++;
+  return r;
+}
+
+uint8_t Adafruit_Fingerprint::fingerSearch(uint8_t slot) {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.searchUs));
+  if (slot < 1 || slot > 2) return FINGERPRINT_PACKETRECIEVEERR;
+  return searchLibrary(index_, charBuf_[slot - 1], fingerID, confidence);
+}
+
+uint8_t Adafruit_Fingerprint::getTemplateCount() {
+  fake::stats.sensorCalls++;
+  fake::advanceUs(cost(timing.sensorCmdUs));
+  templateCount = 0;
+  for (int k : fake::sensors[index_].library)
+    if (k >= 0) templateCount++;
+  return FINGERPRINT_OK;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  Adafruit_I2CDevice
+// ─────────────────────────────────────────────────────────────
+bool Adafruit_I2CDevice::write(const uint8_t *buffer, size_t len, bool stop,
+                               const uint8_t *prefix_buffer, size_t prefix_len) {
+  (void)buffer; (void)stop; (void)prefix_buffer;
+  if (prefix_len + len > maxBufferSize()) return false;
+  // 9 bits per byte (with ACK) after the address byte, plus start and stop
+  uint64_t bits = (uint64_t)(1 + prefix_len + len) * 9 + 2;
+  uint32_t us   = cost((uint32_t)(bits * 1000000ULL / hz_));
+  fake::advanceUs(us);
+  fake::stats.displayUs += us;
+  fake::stats.displayWrites++;
+  fake::stats.displayBytes += prefix_len + len;
+  return true;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  Adafruit_SH1107
+// ─────────────────────────────────────────────────────────────
+Adafruit_SH1107::Adafruit_SH1107(uint16_t w, uint16_t h, TwoWire *twi,
+                                 int8_t rst_pin, uint32_t preclk,
+                                 uint32_t postclk)
+    : i2c_preclk((int32_t)preclk), i2c_postclk((int32_t)postclk), twi_(twi),
+      i2cDevice_(0x3C, twi), w_(w), h_(h) {
+  (void)rst_pin;
+  memset(buffer_, 0, sizeof(buffer_));
+  window_x1 = w_; window_y1 = h_; window_x2 = -1; window_y2 = -1;
+}
+
+bool Adafruit_SH1107::begin(uint8_t addr, bool reset) {
+  (void)reset;
+  i2cDevice_ = Adafruit_I2CDevice(addr, twi_);
+  i2c_dev    = &i2cDevice_;
+  clearDisplay();
+  return true;
+}
+
+void Adafruit_SH1107::markDirty(int16_t x, int16_t y) {
+  if (x < window_x1) window_x1 = x;
+  if (y < window_y1) window_y1 = y;
+  if (x > window_x2) window_x2 = x;
+  if (y > window_y2) window_y2 = y;
+}
+
+void Adafruit_SH1107::clearDisplay() {
+  memset(buffer_, 0, sizeof(buffer_));
+  window_x1 = 0; window_y1 = 0; window_x2 = w_ - 1; window_y2 = h_ - 1;
+}
+
+void Adafruit_SH1107::display() {
+  if (!i2c_dev) return;
+  i2c_dev->setSpeed(i2c_preclk);
+  uint8_t dc         = 0x40;
+  uint8_t pages      = (uint8_t)((h_ + 7) / 8);
+  uint8_t first_page = (uint8_t)(window_y1 / 8);
+  uint8_t page_start = (uint8_t)std::min((int16_t)w_, window_x1);
+  uint8_t page_end   = (uint8_t)std::max((int16_t)0, window_x2);
+  size_t  maxbuff    = i2c_dev->maxBufferSize() - 1;
+  for (uint8_t p = first_page; p < pages; p++) {
+    const uint8_t *ptr       = buffer_ + p * w_ + page_start;
+    int            remaining = (int)w_ - page_start - ((w_ - 1) - page_end);
+    uint8_t        col       = (uint8_t)(page_start + _page_start_offset);
+    uint8_t        cmd[]     = {0x00, (uint8_t)(SH110X_SETPAGEADDR + p),
+                                (uint8_t)(SH110X_SETHIGHCOLUMN + (col >> 4)), (uint8_t)(col & 0xF)};
+    i2c_dev->write(cmd, sizeof(cmd));
+    while (remaining > 0) {
+      size_t n = std::min((size_t)remaining, maxbuff);
+      i2c_dev->write(ptr, n, true, &dc, 1);
+      ptr       += n;
+      remaining -= (int)n;
+    }
+  }
+  i2c_dev->setSpeed(i2c_postclk);
+  window_x1 = w_; window_y1 = h_; window_x2 = -1; window_y2 = -1;
+}
+
+void Adafruit_SH1107::drawPixel(int16_t x, int16_t y, uint16_t color) {
+  if (x < 0 || y < 0 || x >= (int16_t)w_ || y >= (int16_t)h_) return;
+  uint8_t *b   = &buffer_[x + (y / 8) * w_];
+  uint8_t  bit = (uint8_t)(1 << (y & 7));
+  switch (color) {
+    case SH110X_WHITE:   *b |= bit;  break;
+    case SH110X_BLACK:   *b &= ~bit; break;
+    case SH110X_INVERSE: *b ^= bit;  break;
+  }
+  markDirty(x, y);
+}
+
+bool Adafruit_SH1107::getPixel(int16_t x, int16_t y) const {
+  if (x < 0 || y < 0 || x >= (int16_t)w_ || y >= (int16_t)h_) return false;
+  return buffer_[x + (y / 8) * w_] & (1 << (y & 7));
+}
+
+void Adafruit_SH1107::fillRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  for (int16_t j = y; j < y + h; j++)
+    for (int16_t i = x; i < x + w; i++) drawPixel(i, j, color);
+}
+
+void Adafruit_SH1107::drawRect(int16_t x, int16_t y, int16_t w, int16_t h, uint16_t color) {
+  fillRect(x, y, w, 1, color);
+  fillRect(x, y + h - 1, w, 1, color);
+  fillRect(x, y, 1, h, color);
+  fillRect(x + w - 1, y, 1, h, color);
+}
+
+void Adafruit_SH1107::drawLine(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint16_t color) {
+  int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+  int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+  int16_t err = dx + dy;
+  for (;;) {
+    drawPixel(x0, y0, color);
+    if (x0 == x1 && y0 == y1) break;
+    int16_t e2 = 2 * err;
+    if (e2 >= dy) { err += dy; x0 += sx; }
+    if (e2 <= dx) { err += dx; y0 += sy; }
+  }
+}
+
+//  Glyphs are a deterministic 5x7 pattern per character code; only
+//  the pixel footprint matters to the simulator, not legibility.
+void Adafruit_SH1107::drawChar(int16_t x, int16_t y, unsigned char c,
+                               uint16_t color, uint8_t size) {
+  if (c == ' ') return;
+  for (uint8_t col = 0; col < 5; col++) {
+    uint8_t bits = (uint8_t)(((c * 0x9Du) >> col) ^ (c + col * 37u)) & 0x7F;
+    if (!bits) bits = 0x41;
+    for (uint8_t row = 0; row < 7; row++) {
+      if (!(bits & (1 << row))) continue;
+      if (size == 1) drawPixel(x + col, y + row, color);
+      else fillRect(x + col * size, y + row * size, size, size, color);
+    }
+  }
+}
+
+size_t Adafruit_SH1107::write(uint8_t c) {
+  if (c == '\n') {
+    cursorX_ = 0;
+    cursorY_ += 8 * textSize_;
+    return 1;
+  }
+  if (c == '\r') return 1;
+  if (wrap_ && cursorX_ + 6 * textSize_ > (int16_t)w_) {
+    cursorX_ = 0;
+    cursorY_ += 8 * textSize_;
+  }
+  drawChar(cursorX_, cursorY_, c, textColor_, textSize_);
+  cursorX_ += 6 * textSize_;
+  return 1;
+}
+
+size_t Adafruit_SH1107::print(const char *s) {
+  size_t n = 0;
+  while (s && *s) n += write((uint8_t)*s++);
+  return n;
+}
+
+void Adafruit_SH1107::getTextBounds(const char *s, int16_t x, int16_t y,
+                                    int16_t *x1, int16_t *y1,
+                                    uint16_t *w, uint16_t *h) {
+  int16_t cx = x, cy = y, maxX = x - 1, maxY = y - 1;
+  for (; s && *s; s++) {
+    if (*s == '\n') { cx = 0; cy += 8 * textSize_; continue; }
+    if (*s == '\r') continue;
+    if (wrap_ && cx + 6 * textSize_ > (int16_t)w_) { cx = 0; cy += 8 * textSize_; }
+    cx += 6 * textSize_;
+    if (cx - 1 > maxX) maxX = cx - 1;
+    if (cy + 8 * textSize_ - 1 > maxY) maxY = cy + 8 * textSize_ - 1;
+  }
+  *x1 = x;
+  *y1 = y;
+  *w  = (maxX >= x) ? (uint16_t)(maxX - x + 1) : 0;
+  *h  = (maxY >= y) ? (uint16_t)(maxY - y + 1) : 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  WiFi
+// ─────────────────────────────────────────────────────────────
+wl_status_t WiFiClass::status() {
+  using namespace fake;
+  if (!wifiUp && wifiBegun && linkUp) {
+    if (wifiAssocDue == 0) wifiAssocDue = nowUs() + (uint64_t)cost(timing.wifiAssocMs) * 1000ULL;
+    if (nowUs() >= wifiAssocDue) wifiUp = true;
+  }
+  if (wifiUp) return WL_CONNECTED;
+  return wifiBegun ? WL_DISCONNECTED : WL_IDLE_STATUS;
+}
+
+wl_status_t WiFiClass::begin(const char *ssid, const char *pass) {
+  (void)ssid; (void)pass;
+  fake::stats.wifiBegins++;
+  fake::wifiBegun    = true;
+  fake::wifiUp       = false;
+  fake::wifiAssocDue = 0;
+  return status();
+}
+
+bool WiFiClass::disconnect(bool wifioff) {
+  (void)wifioff;
+  fake::wifiBegun    = false;
+  fake::wifiUp       = false;
+  fake::wifiAssocDue = 0;
+  return true;
+}
+
+bool WiFiClass::setAutoReconnect(bool on) {
+  fake::wifiAutoRe = on;
+  return true;
+}
+
+int WiFiClass::onEvent(WiFiEventCb cb) {
+  fake::wifiEventCb = cb;
+  return 1;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  TCP and TLS
+// ─────────────────────────────────────────────────────────────
+int WiFiClient::connect(const char *host, uint16_t port) {
+  (void)host; (void)port;
+  stop();
+  if (WiFi.status() != WL_CONNECTED) {
+    fake::advanceUs(cost(fake::timing.sensorCmdUs));
+    return 0;
+  }
+  if (!fake::brokerUp) {
+    // WiFiClient gives up after its 3 s connect timeout
+    fake::advanceUs(cost(std::min<uint32_t>(fake::timing.mqttConnectFailUs, 3000000)));
+    return 0;
+  }
+  fake::advanceUs(cost(fake::timing.tcpConnectUs));
+  open_ = true;
+  return 1;
+}
+
+uint8_t WiFiClient::connected() {
+  if (open_ && (WiFi.status() != WL_CONNECTED || !fake::brokerUp)) open_ = false;
+  return open_;
+}
+
+int WiFiClientSecure::connect(const char *host, uint16_t port) {
+  if (!WiFiClient::connect(host, port)) return 0;
+  fake::advanceUs(cost(fake::timing.tlsHandshakeUs));
+  fake::stats.tlsHandshakes++;
+  return 1;
+}
+
+int mbedtls_entropy_func(void *, unsigned char *output, size_t len) {
+  for (size_t i = 0; i < len; i++) output[i] = (unsigned char)esp_random();
+  return 0;
+}
+
+int mbedtls_ctr_drbg_random(void *, unsigned char *output, size_t len) {
+  return mbedtls_entropy_func(nullptr, output, len);
+}
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session *s) { memset(s, 0, sizeof(*s)); }
+void mbedtls_ssl_session_free(mbedtls_ssl_session *s) { memset(s, 0, sizeof(*s)); }
+
+int mbedtls_ssl_session_save(const mbedtls_ssl_session *s, unsigned char *buf, size_t cap, size_t *olen) {
+  *olen = sizeof(*s);
+  if (cap < sizeof(*s)) return MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL;
+  memcpy(buf, s, sizeof(*s));
+  return 0;
+}
+
+int mbedtls_ssl_session_load(mbedtls_ssl_session *s, const unsigned char *buf, size_t len) {
+  if (len != sizeof(*s)) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  memcpy(s, buf, sizeof(*s));
+  return 0;
+}
+
+void mbedtls_ssl_init(mbedtls_ssl_context *ssl) { memset(ssl, 0, sizeof(*ssl)); }
+void mbedtls_ssl_free(mbedtls_ssl_context *ssl) { memset(ssl, 0, sizeof(*ssl)); }
+
+int mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf) {
+  ssl->conf = conf;
+  return 0;
+}
+
+int mbedtls_ssl_set_hostname(mbedtls_ssl_context *, const char *) { return 0; }
+
+void mbedtls_ssl_set_bio(mbedtls_ssl_context *ssl, void *bio, mbedtls_ssl_send_t *,
+                         mbedtls_ssl_recv_t *, mbedtls_ssl_recv_timeout_t *) {
+  ssl->bio = bio;
+}
+
+int mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session) {
+  ssl->offer   = *session;
+  ssl->offered = true;
+  return 0;
+}
+
+int mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session) {
+  if (!ssl->open) return MBEDTLS_ERR_SSL_BAD_INPUT_DATA;
+  *session = ssl->session;
+  return 0;
+}
+
+//  Resumes if the broker still caches the offered session (by ID or
+//  ticket), else a full handshake that starts a new one. A session's
+//  lifetime runs from the full handshake, as in OpenSSL.
+int mbedtls_ssl_handshake(mbedtls_ssl_context *ssl) {
+  using namespace fake;
+  uint64_t serial = 0;
+  if (ssl->offered) memcpy(&serial, ssl->offer.master, sizeof(serial));
+  auto it = tlsCache.find(serial);
+  if (serial && tlsCacheOn && it != tlsCache.end() && it->second > nowUs()) {
+    advanceUs(cost(timing.tlsResumeUs));
+    stats.tlsResumes++;
+    ssl->session = ssl->offer;
+  } else {
+    advanceUs(cost(timing.tlsHandshakeUs));
+    stats.tlsHandshakes++;
+    serial = ++tlsSerial;
+    mbedtls_ssl_session_init(&ssl->session);
+    memcpy(ssl->session.master, &serial, sizeof(serial));
+    ssl->session.id_len = 32;
+    if (tlsCacheOn) tlsCache[serial] = nowUs() + (uint64_t)timing.tlsSessionLifetimeS * 1000000ULL;
+  }
+  ssl->open = true;
+  return 0;
+}
+
+int mbedtls_ssl_read(mbedtls_ssl_context *, unsigned char *, size_t) { return MBEDTLS_ERR_SSL_WANT_READ; }
+int mbedtls_ssl_write(mbedtls_ssl_context *, const unsigned char *, size_t len) { return (int)len; }
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context *) { return 0; }
+
+int mbedtls_ssl_close_notify(mbedtls_ssl_context *ssl) {
+  ssl->open = false;
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  PubSubClient
+// ─────────────────────────────────────────────────────────────
+static std::set<std::string> subscriptions;
+
+static bool topicMatches(const std::string &filter, const std::string &topic) {
+  size_t f = 0, t = 0;
+  while (f < filter.size()) {
+    if (filter[f] == '#') return true;
+    if (filter[f] == '+') {
+      while (t < topic.size() && topic[t] != '/') t++;
+      f++;
+      continue;
+    }
+    if (t >= topic.size() || filter[f] != topic[t]) return false;
+    f++; t++;
+  }
+  return t == topic.size();
+}
+
+PubSubClient &PubSubClient::setServer(const char *domain, uint16_t port) {
+  domain_ = domain ? domain : "";
+  port_   = port;
+  return *this;
+}
+
+//  What the broker drops when a connection ends or starts: every
+//  message without a persistent session to hold it, else QoS 0 ones
+static void dropUnqueued(bool session, uint64_t dueBy) {
+  for (auto it = fake::inbound.begin(); it != fake::inbound.end();) {
+    if (it->dueUs <= dueBy && (!session || it->qos == 0)) it = fake::inbound.erase(it);
+    else ++it;
+  }
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass) {
+  return connect(id, user, pass, nullptr, 0, false, nullptr, true);
+}
+
+bool PubSubClient::connect(const char *id, const char *user, const char *pass,
+                           const char *willTopic, uint8_t willQos, bool willRetain,
+                           const char *willMessage, bool cleanSession) {
+  (void)id; (void)user; (void)pass; (void)willQos;
+  fake::stats.mqttConnectAttempts++;
+  uint64_t t0 = fake::nowUs();
+  if (!client_->connect(domain_.c_str(), port_)) {
+    fake::stats.mqttConnectUs += fake::nowUs() - t0;
+    state_ = MQTT_CONNECT_FAILED;
+    return false;
+  }
+  fake::advanceUs(cost(fake::timing.mqttConnectUs));
+  fake::stats.mqttConnectUs += fake::nowUs() - t0;
+  fake::stats.lastConnectUs  = fake::nowUs() - t0;
+  fake::stats.mqttConnects++;
+  cleanSession_ = cleanSession;
+  bool present  = !cleanSession && session_ && fake::keepSessions;
+  if (!present) subscriptions.clear();
+  dropUnqueued(present, fake::nowUs());   // what fell due with no session to keep it
+  session_ = !cleanSession && fake::keepSessions;
+  state_   = MQTT_CONNECTED;
+  willTopic_   = willTopic ? willTopic : "";
+  willMessage_ = willMessage ? willMessage : "";
+  willRetain_  = willRetain;
+  return true;
+}
+
+//  A DISCONNECT that reaches the broker discards the will; one sent
+//  into a dead link is just a silent drop
+void PubSubClient::disconnect() {
+  connected();
+  client_->stop();
+  state_ = MQTT_DISCONNECTED;
+}
+
+bool PubSubClient::connected() {
+  if (state_ == MQTT_CONNECTED &&
+      (WiFi.status() != WL_CONNECTED || !fake::brokerUp)) {
+    state_ = MQTT_CONNECTION_LOST;
+    client_->stop();
+    dropUnqueued(session_, UINT64_MAX);
+    // A broker that is still up notices the silence after 1.5x the
+    // keepalive and publishes the will on the station's behalf
+    if (fake::brokerUp && !willTopic_.empty()) {
+      fake::stats.willsFired++;
+      FakePublish p{willTopic_, willMessage_, willRetain_,
+                    fake::nowUs() + (uint64_t)keepAlive_ * 1500000ULL, 0, 0};
+      fake::pubs.push_back(p);
+      if (fake::pubHook) fake::pubHook(fake::pubs.back());
+    }
+  }
+  return state_ == MQTT_CONNECTED;
+}
+
+bool PubSubClient::publish(const char *topic, const char *payload, bool retained) {
+  return publish(topic, (const uint8_t *)payload,
+                 payload ? (unsigned int)strlen(payload) : 0, retained);
+}
+
+bool PubSubClient::publish(const char *topic, const uint8_t *payload,
+                           unsigned int len, bool retained) {
+  if (!connected()) return false;
+  if (MQTT_MAX_HEADER_SIZE + 2 + strlen(topic) + len > bufferSize_) return false;
+  fake::advanceUs(cost(fake::timing.publishUs + fake::timing.publishPerByteUs * len));
+  fake::stats.publishes++;
+  FakePublish p{topic, std::string((const char *)payload, len), retained,
+                fake::nowUs(), fake::imageOkUs, fake::fingerAtUs};
+  fake::pubs.push_back(p);
+  if (fake::pubHook) fake::pubHook(fake::pubs.back());
+  return true;
+}
+
+bool PubSubClient::subscribe(const char *topic, uint8_t qos) {
+  (void)qos;
+  if (!connected()) return false;
+  fake::advanceUs(cost(fake::timing.subscribeUs));
+  subscriptions.insert(topic);
+  return true;
+}
+
+bool PubSubClient::unsubscribe(const char *topic) {
+  if (!connected()) return false;
+  subscriptions.erase(topic);
+  return true;
+}
+
+//  Delivers at most one queued inbound message per call, like the
+//  real client which reads a single packet per loop().
+bool PubSubClient::loop() {
+  if (!connected()) return false;
+  fake::advanceUs(cost(fake::timing.mqttLoopUs));
+  while (!fake::inbound.empty() && fake::inbound.front().dueUs <= fake::nowUs()) {
+    fake::Inbound m = fake::inbound.front();
+    fake::inbound.pop_front();
+    bool wanted = false;
+    for (const std::string &f : subscriptions)
+      if (topicMatches(f, m.topic)) { wanted = true; break; }
+    if (!wanted) continue;
+    if (MQTT_MAX_HEADER_SIZE + 2 + m.topic.size() + m.payload.size() > bufferSize_) continue;
+    if (callback_) {
+      std::vector<char>    t(m.topic.begin(), m.topic.end());
+      std::vector<uint8_t> p(m.payload.begin(), m.payload.end());
+      t.push_back('\0');
+      p.push_back(0);
+      callback_(t.data(), p.data(), (unsigned int)m.payload.size());
+    }
+    break;
+  }
+  return true;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  EEPROM (ESP32 semantics: RAM cache, commit() rewrites the blob)
+// ─────────────────────────────────────────────────────────────
+bool EEPROMClass::begin(size_t size) {
+  if (fake::eepromFlash.size() != size) fake::eepromFlash.assign(size, 0);
+  fake::eepromRam   = fake::eepromFlash;
+  fake::eepromDirty = false;
+  return true;
+}
+
+uint8_t EEPROMClass::read(int address) {
+  if (address < 0 || (size_t)address >= fake::eepromRam.size()) return 0;
+  return fake::eepromRam[address];
+}
+
+void EEPROMClass::write(int address, uint8_t val) {
+  if (address < 0 || (size_t)address >= fake::eepromRam.size()) return;
+  fake::stats.eepromWrites++;
+  fake::stats.eepromBytes++;
+  fake::advanceUs(fake::timing.eepromWriteUs);
+  if (fake::eepromRam[address] != val) {
+    fake::eepromRam[address] = val;
+    fake::eepromDirty        = true;
+  }
+}
+
+bool EEPROMClass::commit() {
+  if (!fake::eepromDirty) return true;
+  fake::advanceUs(cost(fake::timing.eepromCommitUs));
+  fake::stats.eepromCommits++;
+  if (fake::eepromTear >= 0) {
+    int64_t keep = fake::eepromTear;
+    fake::eepromTear = -1;
+    for (size_t i = 0; i < fake::eepromRam.size() && keep > 0; i++) {
+      if (fake::eepromFlash[i] != fake::eepromRam[i]) {
+        fake::eepromFlash[i] = fake::eepromRam[i];
+        keep--;
+      }
+    }
+    fake::eepromRam   = fake::eepromFlash;
+    fake::eepromDirty = false;
+    return false;
+  }
+  fake::eepromFlash = fake::eepromRam;
+  fake::eepromDirty = false;
+  return true;
+}
+
+size_t   EEPROMClass::length()     { return fake::eepromRam.size(); }
+uint8_t *EEPROMClass::getDataPtr() { fake::eepromDirty = true; return fake::eepromRam.data(); }
+
+size_t EEPROMClass::readBytes(int address, void *value, size_t len) {
+  if (address < 0 || (size_t)address + len > fake::eepromRam.size()) return 0;
+  memcpy(value, fake::eepromRam.data() + address, len);
+  return len;
+}
+
+size_t EEPROMClass::writeBytes(int address, const void *value, size_t len) {
+  if (address < 0 || (size_t)address + len > fake::eepromRam.size()) return 0;
+  fake::stats.eepromWrites++;
+  fake::stats.eepromBytes += len;
+  memcpy(fake::eepromRam.data() + address, value, len);
+  fake::eepromDirty = true;
+  return len;
+}
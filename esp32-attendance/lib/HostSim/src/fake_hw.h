@@ -0,0 +1,185 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — scripting and inspection API for the fakes
+//
+//  The firmware only ever sees the Arduino-style headers in this
+//  library. Scenarios in sim_main.cpp use this header to set the
+//  timing profile, script finger arrivals and network state, and
+//  read back what the firmware did.
+// ─────────────────────────────────────────────────────────────
+#include <Arduino.h>
+#include <functional>
+#include <string>
+#include <vector>
+
+//  Timing profile (microseconds unless noted). Defaults are rough
+//  figures for an AS608 at 57600 baud, an SH1107 on 400 kHz I2C,
+//  TLS MQTT over Wi-Fi and the ESP32 NVS-backed EEPROM emulation.
+struct FakeTiming {
+  uint32_t getImageNoFingerUs = 10000;
+  uint32_t getImageFingerUs   = 120000;
+  uint32_t image2TzUs         = 80000;
+  uint32_t fastSearchUs       = 20000;
+  uint32_t searchUs           = 60000;
+  uint32_t createModelUs      = 60000;
+  uint32_t storeModelUs       = 40000;
+  uint32_t sensorCmdUs        = 5000;     // any other AS608 command
+
+  uint32_t publishUs          = 6000;     // TLS record + socket write
+  uint32_t publishPerByteUs   = 20;
+  uint32_t tcpConnectUs       = 60000;    // SYN round trip to the broker
+  uint32_t tlsHandshakeUs     = 1600000;  // full: ECDHE + RSA on the ESP32, two round trips
+  uint32_t tlsResumeUs        = 120000;   // abbreviated: one round trip, no public-key work
+  uint32_t tlsSessionLifetimeS = 300;     // broker session cache / ticket lifetime
+  uint32_t mqttConnectUs      = 140000;   // CONNECT → CONNACK
+  uint32_t mqttConnectFailUs  = 5000000;  // TCP connect timeout
+  uint32_t subscribeUs        = 3000;
+  uint32_t mqttLoopUs         = 200;
+
+  uint32_t wifiAssocMs        = 2500;     // ms
+  uint32_t ntpSyncMs          = 600;      // ms after configTime()
+  int32_t  rtcDriftPpm        = 20;       // how fast millis() runs against NTP
+
+  uint32_t eepromCommitUs     = 35000;    // sector erase + write
+  uint32_t eepromWriteUs      = 1;        // per EEPROM.write()
+
+  uint8_t  jitterPct          = 10;       // ± uniform jitter on every cost
+};
+
+struct FakePublish {
+  std::string topic;
+  std::string payload;
+  bool        retained;
+  uint64_t    atUs;          // virtual time the publish completed
+  uint64_t    imageOkAtUs;   // last getImage() == FINGERPRINT_OK before it
+  uint64_t    fingerAtUs;    // when that finger was placed on the sensor
+};
+
+//  A scripted stream of arrivals for scriptArrivals(): fingers come
+//  in groups of `burst`, `gapMs` apart inside a group and `pauseMs`
+//  apart between groups (burst 0 = one endless group), each moved
+//  later by up to `jitterMs`.
+struct FakeArrivals {
+  uint32_t count    = 100;
+  uint32_t burst    = 0;
+  uint32_t gapMs    = 3000;
+  uint32_t pauseMs  = 0;
+  uint32_t jitterMs = 400;
+  uint32_t holdMs   = 800;
+};
+
+struct FakeStats {
+  uint32_t sensorCalls      = 0;
+  uint32_t displayWrites    = 0;   // I2C transactions to the panel
+  uint64_t displayBytes     = 0;   // on the wire, commands included
+  uint64_t displayUs        = 0;   // I2C time they took
+  uint32_t eepromWrites     = 0;
+  uint64_t eepromBytes      = 0;   // bytes handed to write()/writeBytes()
+  uint32_t eepromCommits    = 0;
+  uint32_t mqttConnects     = 0;   // successful
+  uint32_t mqttConnectAttempts = 0;
+  uint64_t mqttConnectUs    = 0;   // time spent inside connect()
+  uint64_t lastConnectUs    = 0;   // the last successful connect(), TCP to CONNACK
+  uint32_t tlsHandshakes    = 0;   // full
+  uint32_t tlsResumes       = 0;
+  uint32_t wifiBegins       = 0;
+  uint32_t publishes        = 0;
+  uint32_t willsFired       = 0;   // broker-side, after a silent drop
+};
+
+namespace fake {
+
+extern FakeTiming timing;
+extern FakeStats  stats;
+extern bool       serialEcho;   // mirror firmware Serial output to stdout
+
+//  Serial console: `text` becomes readable on Serial; serialTake()
+//  returns what the firmware printed since the last take or reset()
+//  (at least the last 64 KB) and clears it.
+void        serialType(const char *text);
+std::string serialTake();
+
+void     reset(uint32_t seed = 1);
+uint64_t nowUs();
+void     advanceUs(uint64_t us);
+uint32_t cost(uint32_t us);     // applies the seeded jitter
+
+//  Wall-clock epoch (UTC seconds) the virtual clock starts at
+void     setEpochBase(time_t utc);
+//  UTC seconds on the device crystal (what time() returns once set)
+time_t   epochNow();
+
+//  Fingerprint sensor. A finger is identified by `key`; enrolled
+//  templates map slot → key. Arrivals are placed on the virtual
+//  timeline and held for `holdMs`.
+//  `sensor` is the UART number the Adafruit_Fingerprint was built on.
+void     presentFinger(int key, uint64_t atUs, uint32_t holdMs, uint8_t sensor = 1);
+void     clearFingers();
+void     storeTemplate(uint16_t slot, int key, uint8_t sensor = 1);
+int      templateAt(uint16_t slot, uint8_t sensor = 1);
+uint64_t lastImageOkUs();
+//  Sensors that answer verifyPassword(); only UART1 by default
+void     attachSensor(uint8_t sensor, bool on = true);
+//  fingerFastSearch() matches on that sensor so far
+uint32_t searchHits(uint8_t sensor);
+//  Ends whatever finger rests on the sensor now
+void     liftFinger(uint8_t sensor);
+//  Places `p.count` fingers of keys 1..keys from `startUs` on; each
+//  arrival time is appended to `arrivals`. Returns when the last
+//  finger is lifted.
+uint64_t scriptArrivals(const FakeArrivals &p, int keys, uint64_t startUs,
+                        std::vector<uint64_t> *arrivals = nullptr, uint8_t sensor = 1);
+//  Wires the sensor's touch output (high while a finger rests on
+//  it) to GPIO `pin`; -1 leaves it unconnected.
+void     wireTouch(int pin, uint8_t sensor = 1);
+void     touchEvents();              // drives the wired touch lines
+//  Sets an input pin driven by a fake device, firing attached ISRs
+void     drivePin(uint8_t pin, uint8_t level);
+
+//  Network
+void     setLinkUp(bool up);         // Wi-Fi access point reachable
+void     wifiEvents();               // fires pending WiFi.onEvent() callbacks
+void     setBrokerUp(bool up);       // MQTT broker reachable
+//  Queues an inbound message; it is delivered by the first
+//  PubSubClient::loop() at least `delayMs` from now. When the
+//  connection drops, or the message falls due with none up, it is
+//  lost unless the station holds a persistent session and `qos` is 1
+//  (the broker keeps it for the next connect).
+void     injectMessage(const char *topic, const char *payload, uint32_t delayMs = 0,
+                       uint8_t qos = 1);
+//  Broker configuration, as a Mosquitto stand-in: `tlsCache` keeps TLS
+//  sessions (IDs and tickets) for timing.tlsSessionLifetimeS;
+//  `sessions` keeps the MQTT session of a client that connects with
+//  cleanSession false. Both on by default.
+void     brokerTlsCache(bool on);
+void     brokerKeepsSessions(bool on);
+//  Restarts the broker process: TLS sessions are lost, persisted MQTT
+//  sessions are not
+void     brokerRestart();
+const std::vector<FakePublish> &published();
+void     clearPublished();
+std::function<void(const FakePublish &)> &onPublish();
+
+//  EEPROM
+const uint8_t *eepromData();
+size_t         eepromSize();
+void           eepromWipe();
+//  Makes the next commit() persist only the first `keepBytes` changed
+//  bytes (in address order) and then lose power: the RAM cache is
+//  reloaded from flash and commit() returns false. Models a raw-flash
+//  write torn by a brown-out.
+void           eepromTearNextCommit(uint32_t keepBytes);
+//  Drops uncommitted bytes and any armed tear, as a reset would.
+void           eepromPowerCut();
+//  Replaces flash with an image taken by eepromData() in an earlier
+//  power-on, e.g. from another child process.
+void           eepromLoad(const uint8_t *data, size_t len);
+
+//  Longest time the named FreeRTOS task ran between two vTaskDelay()
+//  calls, i.e. its worst single pass; `reset` starts a new window.
+uint64_t taskMaxRunUs(const char *name, bool reset = false);
+
+//  Fires deferred events (NTP completion, Wi-Fi association)
+void     pump();
+
+}  // namespace fake
@@ -0,0 +1,155 @@
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — virtual clock and FreeRTOS tasks/mutexes
+//
+//  Every task owns a virtual clock. advanceUs() moves only the
+//  running task's clock and then hands the CPU to whichever live
+//  task is now furthest behind, so an action always happens at the
+//  lowest time on the timeline and no task can observe another's
+//  future. Exactly one thread runs at any moment; the baton mutex
+//  and per-task condition variables do the hand-off.
+// ─────────────────────────────────────────────────────────────
+#include "fake_hw.h"
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+struct FakeTask {
+  const char             *name;
+  uint64_t                clockUs = 0;
+  bool                    alive   = true;
+  BaseType_t              core    = 1;
+  uint64_t                yieldUs = 0;   // clock at the end of the last vTaskDelay()
+  uint64_t                maxRunUs = 0;  // longest stretch between two vTaskDelay()s
+  TaskFunction_t          fn      = nullptr;
+  void                   *param   = nullptr;
+  std::condition_variable cv;
+
+  explicit FakeTask(const char *n) : name(n) {}
+};
+
+struct FakeMutex {
+  FakeTask *owner = nullptr;
+};
+
+// Heap-allocated and never freed: detached task threads may still be
+// parked on them while the process exits.
+static std::mutex             &baton    = *new std::mutex;
+static FakeTask               *mainTask = new FakeTask("loopTask");
+static std::vector<FakeTask *> &tasks   = *new std::vector<FakeTask *>{mainTask};
+static FakeTask               *running  = mainTask;
+
+static FakeTask *furthestBehind() {
+  FakeTask *next = nullptr;
+  for (FakeTask *t : tasks)
+    if (t->alive && (!next || t->clockUs < next->clockUs)) next = t;
+  return next;
+}
+
+//  Called by the running task only. Ties keep the current task.
+static void reschedule() {
+  if (tasks.size() == 1) return;
+  FakeTask *self = running;
+  FakeTask *next = furthestBehind();
+  if (!next || next == self || next->clockUs >= self->clockUs) return;
+  std::unique_lock<std::mutex> lk(baton);
+  running = next;
+  next->cv.notify_one();
+  self->cv.wait(lk, [self] { return running == self; });
+}
+
+static void taskEntry(FakeTask *t) {
+  {
+    std::unique_lock<std::mutex> lk(baton);
+    t->cv.wait(lk, [t] { return running == t; });
+  }
+  t->fn(t->param);
+
+  // A FreeRTOS task must not return; treat it as vTaskDelete(NULL)
+  std::unique_lock<std::mutex> lk(baton);
+  t->alive = false;
+  running  = furthestBehind();
+  if (running) running->cv.notify_one();
+}
+
+namespace fake {
+
+uint64_t nowUs() { return running->clockUs; }
+
+void advanceUs(uint64_t us) {
+  running->clockUs += us;
+  reschedule();
+}
+
+void resetClock() { running->clockUs = 0; }
+
+uint64_t taskMaxRunUs(const char *name, bool reset) {
+  for (FakeTask *t : tasks) {
+    if (strcmp(t->name, name) != 0) continue;
+    uint64_t v = t->maxRunUs;
+    if (reset) t->maxRunUs = 0;
+    return v;
+  }
+  return 0;
+}
+
+}  // namespace fake
+
+// ─────────────────────────────────────────────────────────────
+//  FreeRTOS
+// ─────────────────────────────────────────────────────────────
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                   uint32_t stackDepth, void *param,
+                                   UBaseType_t priority, TaskHandle_t *handle,
+                                   BaseType_t core) {
+  (void)stackDepth; (void)priority;
+  FakeTask *t = new FakeTask(name);
+  t->clockUs = running->clockUs;
+  t->core    = core;
+  t->fn      = fn;
+  t->param   = param;
+  {
+    std::lock_guard<std::mutex> lk(baton);
+    tasks.push_back(t);
+  }
+  std::thread(taskEntry, t).detach();
+  if (handle) *handle = t;
+  return pdPASS;
+}
+
+void vTaskDelay(TickType_t ticks) {
+  FakeTask *self = running;
+  if (self->clockUs - self->yieldUs > self->maxRunUs && self->yieldUs)
+    self->maxRunUs = self->clockUs - self->yieldUs;
+  delay(ticks * portTICK_PERIOD_MS);
+  self->yieldUs = self->clockUs;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() { return running; }
+
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task) {
+  (void)task;
+  return 2048;   // no real stack to measure on the host
+}
+
+BaseType_t xPortGetCoreID() { return running->core; }
+
+SemaphoreHandle_t xSemaphoreCreateMutex() { return new FakeMutex; }
+
+//  Waiting advances the caller's clock, which lets the owner run on
+//  and release the mutex.
+BaseType_t xSemaphoreTake(SemaphoreHandle_t mutex, TickType_t ticks) {
+  uint64_t waitedUs = 0;
+  while (mutex->owner && mutex->owner != running) {
+    if (ticks != portMAX_DELAY && waitedUs >= (uint64_t)ticks * 1000ULL) return pdFALSE;
+    fake::advanceUs(100);
+    waitedUs += 100;
+  }
+  mutex->owner = running;
+  return pdTRUE;
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t mutex) {
+  if (mutex->owner != running) return pdFALSE;
+  mutex->owner = nullptr;
+  return pdTRUE;
+}
@@ -0,0 +1,23 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  Host stand-in for the FreeRTOS subset the firmware uses.
+//
+//  Tasks are real threads, but only one runs at a time: each has
+//  its own virtual clock and the scheduler always resumes the task
+//  that is furthest behind. Two tasks therefore overlap on the
+//  virtual timeline exactly as they would on two cores, and a run
+//  stays deterministic for a given seed.
+// ─────────────────────────────────────────────────────────────
+#include <stdint.h>
+
+typedef uint32_t     TickType_t;
+typedef int          BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define pdTRUE             1
+#define pdFALSE            0
+#define pdPASS             pdTRUE
+#define portMAX_DELAY      0xFFFFFFFFu
+#define portTICK_PERIOD_MS 1
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms)  ((TickType_t)(ms))
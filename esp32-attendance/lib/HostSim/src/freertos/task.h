@@ -0,0 +1,14 @@
+#pragma once
+#include "FreeRTOS.h"
+
+typedef void (*TaskFunction_t)(void *);
+typedef struct FakeTask *TaskHandle_t;
+
+BaseType_t   xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name,
+                                     uint32_t stackDepth, void *param,
+                                     UBaseType_t priority, TaskHandle_t *handle,
+                                     BaseType_t core);
+void         vTaskDelay(TickType_t ticks);
+TaskHandle_t xTaskGetCurrentTaskHandle();
+UBaseType_t  uxTaskGetStackHighWaterMark(TaskHandle_t task);
+BaseType_t   xPortGetCoreID();
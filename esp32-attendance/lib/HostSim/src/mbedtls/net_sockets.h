@@ -0,0 +1,2 @@
+#pragma once
+#include "ssl.h"   // the fake keeps the whole slice in one header
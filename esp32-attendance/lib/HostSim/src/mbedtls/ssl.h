@@ -0,0 +1,93 @@
+#pragma once
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — the slice of mbedTLS ResumableTlsClient uses.
+//  No bytes are encrypted; mbedtls_ssl_handshake() charges the
+//  virtual clock for a full or an abbreviated handshake, depending
+//  on whether the fake broker still holds the session offered with
+//  mbedtls_ssl_set_session() (see fake::brokerTlsCache()).
+// ─────────────────────────────────────────────────────────────
+#include <stddef.h>
+#include <stdint.h>
+
+#define MBEDTLS_VERSION_MAJOR              2    // 2.28, as Arduino-ESP32 2.0 ships
+
+#define MBEDTLS_ERR_SSL_WANT_READ          -0x6900
+#define MBEDTLS_ERR_SSL_WANT_WRITE         -0x6880
+#define MBEDTLS_ERR_SSL_BAD_INPUT_DATA     -0x7100
+#define MBEDTLS_ERR_SSL_BUFFER_TOO_SMALL   -0x6A00
+#define MBEDTLS_ERR_NET_CONN_RESET         -0x0050
+
+#define MBEDTLS_SSL_IS_CLIENT                0
+#define MBEDTLS_SSL_TRANSPORT_STREAM         0
+#define MBEDTLS_SSL_PRESET_DEFAULT           0
+#define MBEDTLS_SSL_VERIFY_NONE              0
+#define MBEDTLS_SSL_SESSION_TICKETS
+#define MBEDTLS_SSL_SESSION_TICKETS_ENABLED  1
+
+typedef int mbedtls_ssl_send_t(void *ctx, const unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_t(void *ctx, unsigned char *buf, size_t len);
+typedef int mbedtls_ssl_recv_timeout_t(void *ctx, unsigned char *buf, size_t len, uint32_t timeout);
+
+struct mbedtls_ssl_session {
+  unsigned char id[32];
+  size_t        id_len;
+  unsigned char master[48];   // the first 8 bytes name the session at the fake broker
+};
+
+struct mbedtls_ssl_config {
+  int authmode;
+  int tickets;
+};
+
+struct mbedtls_ssl_context {
+  const mbedtls_ssl_config *conf;
+  void                     *bio;
+  bool                      offered;
+  mbedtls_ssl_session       offer;
+  mbedtls_ssl_session       session;
+  bool                      open;
+};
+
+struct mbedtls_ctr_drbg_context { int seeded; };
+struct mbedtls_entropy_context  { int unused; };
+
+int mbedtls_entropy_func(void *data, unsigned char *output, size_t len);
+int mbedtls_ctr_drbg_random(void *p_rng, unsigned char *output, size_t len);
+
+inline void mbedtls_entropy_init(mbedtls_entropy_context *) {}
+inline void mbedtls_entropy_free(mbedtls_entropy_context *) {}
+inline void mbedtls_ctr_drbg_init(mbedtls_ctr_drbg_context *c) { c->seeded = 0; }
+inline void mbedtls_ctr_drbg_free(mbedtls_ctr_drbg_context *) {}
+inline int  mbedtls_ctr_drbg_seed(mbedtls_ctr_drbg_context *c,
+                                  int (*f_entropy)(void *, unsigned char *, size_t), void *p_entropy,
+                                  const unsigned char *custom, size_t len) {
+  (void)f_entropy; (void)p_entropy; (void)custom; (void)len;
+  c->seeded = 1;
+  return 0;
+}
+
+inline void mbedtls_ssl_config_init(mbedtls_ssl_config *c) { c->authmode = 0; c->tickets = 0; }
+inline void mbedtls_ssl_config_free(mbedtls_ssl_config *) {}
+inline int  mbedtls_ssl_config_defaults(mbedtls_ssl_config *, int, int, int) { return 0; }
+inline void mbedtls_ssl_conf_authmode(mbedtls_ssl_config *c, int mode) { c->authmode = mode; }
+inline void mbedtls_ssl_conf_rng(mbedtls_ssl_config *, int (*)(void *, unsigned char *, size_t), void *) {}
+inline void mbedtls_ssl_conf_session_tickets(mbedtls_ssl_config *c, int on) { c->tickets = on; }
+
+void mbedtls_ssl_session_init(mbedtls_ssl_session *s);
+void mbedtls_ssl_session_free(mbedtls_ssl_session *s);
+int  mbedtls_ssl_session_save(const mbedtls_ssl_session *s, unsigned char *buf, size_t cap, size_t *olen);
+int  mbedtls_ssl_session_load(mbedtls_ssl_session *s, const unsigned char *buf, size_t len);
+
+void   mbedtls_ssl_init(mbedtls_ssl_context *ssl);
+void   mbedtls_ssl_free(mbedtls_ssl_context *ssl);
+int    mbedtls_ssl_setup(mbedtls_ssl_context *ssl, const mbedtls_ssl_config *conf);
+int    mbedtls_ssl_set_hostname(mbedtls_ssl_context *ssl, const char *host);
+void   mbedtls_ssl_set_bio(mbedtls_ssl_context *ssl, void *bio, mbedtls_ssl_send_t *send,
+                           mbedtls_ssl_recv_t *recv, mbedtls_ssl_recv_timeout_t *recvTimeout);
+int    mbedtls_ssl_set_session(mbedtls_ssl_context *ssl, const mbedtls_ssl_session *session);
+int    mbedtls_ssl_get_session(const mbedtls_ssl_context *ssl, mbedtls_ssl_session *session);
+int    mbedtls_ssl_handshake(mbedtls_ssl_context *ssl);
+int    mbedtls_ssl_read(mbedtls_ssl_context *ssl, unsigned char *buf, size_t len);
+int    mbedtls_ssl_write(mbedtls_ssl_context *ssl, const unsigned char *buf, size_t len);
+size_t mbedtls_ssl_get_bytes_avail(const mbedtls_ssl_context *ssl);
+int    mbedtls_ssl_close_notify(mbedtls_ssl_context *ssl);
@@ -0,0 +1,9 @@
+#pragma once
+// Placeholder credentials for the native simulator build only.
+#define WIFI_SSID      "sim-ssid"
+#define WIFI_PASSWORD  "sim-pass"
+#define MQTT_BROKER    "sim.broker.local"
+#define MQTT_PORT      8883
+#define MQTT_USER      "sim"
+#define MQTT_PASS      "sim"
+#define MQTT_CLIENT_ID "ESP32_FP"
@@ -0,0 +1,2660 @@
+// ─────────────────────────────────────────────────────────────
+//  Host simulator — runs the unmodified firmware (setup/loop)
+//  against the fakes and reports timings on the virtual clock.
+//
+//    .pio/build/native/program <scenario> [--seed N] [--verbose] ...
+//
+//  Every scenario is deterministic for a given seed and timing
+//  profile, so numbers can be compared run-to-run across commits.
+// ─────────────────────────────────────────────────────────────
+#include "fake_hw.h"
+#include <EEPROM.h>
+#include <eeprom_journal.h>
+#include <latency_hist.h>
+#include <spsc_queue.h>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <map>
+#include <set>
+#include <sstream>
+#include <stdlib.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+void setup();
+void loop();
+bool getTimestamp(char *buf, size_t len);
+void formatTimestamp(uint32_t epoch, char *buf, size_t len);
+uint32_t parseTimestamp(const char *ts);
+uint32_t currentEpoch();
+extern std::atomic<uint32_t> scanRepeatWindowMs;
+
+#define TOPIC_ATTENDANCE "fp/attendance"
+#define TOPIC_ATT_BATCH  "fp/attendanceBatch"
+#define TOPIC_ATT_ACK    "fp/attendanceAck"
+#define TOPIC_MESSAGE    "fp/message"
+#define TOPIC_STATE_PUB  "fp/stateAck"
+#define TOPIC_SYS_STATE  "fp/systemState"
+#define TOPIC_ENROLL_DATA "fp/enrollData"
+#define TOPIC_ENROLLED   "fp/enrolled"
+#define TOPIC_HEARTBEAT  "fp/heartbeat"
+#define TOPIC_ONLINE     "fp/online"
+#define EEPROM_SIZE      4096
+#define ROSTER_RECORD    37                           // slot (2 B), name[20], regNum[15]
+#define JOURNAL_ADDR     (1 + 50 * ROSTER_RECORD)     // offline journal header
+
+// ─────────────────────────────────────────────────────────────
+//  Helpers
+// ─────────────────────────────────────────────────────────────
+static long argInt(int argc, char **argv, const char *name, long def) {
+  for (int i = 0; i < argc - 1; i++)
+    if (strcmp(argv[i], name) == 0) return strtol(argv[i + 1], nullptr, 10);
+  return def;
+}
+
+static bool argFlag(int argc, char **argv, const char *name) {
+  for (int i = 0; i < argc; i++)
+    if (strcmp(argv[i], name) == 0) return true;
+  return false;
+}
+
+static uint32_t simRandState = 0x2545F491;
+
+static uint32_t simRand() {
+  uint32_t &s = simRandState;
+  s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+  return s;
+}
+
+static void seedSim(int argc, char **argv) {
+  uint32_t seed = (uint32_t)argInt(argc, argv, "--seed", 1);
+  fake::reset(seed);
+  simRandState = 0x2545F491 ^ (seed * 2654435761u);
+  if (!simRandState) simRandState = 1;
+}
+
+static void runFor(uint32_t ms) {
+  uint64_t until = fake::nowUs() + (uint64_t)ms * 1000ULL;
+  while (fake::nowUs() < until) loop();
+}
+
+static bool runUntil(const std::function<bool()> &done, uint32_t timeoutMs) {
+  uint64_t until = fake::nowUs() + (uint64_t)timeoutMs * 1000ULL;
+  while (fake::nowUs() < until) {
+    if (done()) return true;
+    loop();
+  }
+  return done();
+}
+
+static double percentile(std::vector<double> v, double p) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t idx = (size_t)(p / 100.0 * (double)(v.size() - 1) + 0.5);
+  return v[std::min(idx, v.size() - 1)];
+}
+
+//  `sensors` AS608s answer at boot: UART1, then UART2. `prepare`
+//  runs on the fresh fakes before power-on. Returns once the station
+//  is online with NTP time, unless `settle` is false.
+static void bootDevice(int argc, char **argv, int sensors = 1,
+                       const std::function<void()> &prepare = nullptr, bool settle = true) {
+  seedSim(argc, argv);
+  fake::serialEcho = argFlag(argc, argv, "--verbose");
+  // A finger key stands for a stream of different students and comes
+  // round far sooner than a real student scans again (see repeats)
+  scanRepeatWindowMs = (uint32_t)argInt(argc, argv, "--repeat-window", 0);
+  fake::attachSensor(2, sensors > 1);
+#if defined(FP_TOUCH_PIN) && FP_TOUCH_PIN >= 0
+  fake::wireTouch(FP_TOUCH_PIN, 1);
+#endif
+#if defined(FP2_TOUCH_PIN) && FP2_TOUCH_PIN >= 0
+  fake::wireTouch(FP2_TOUCH_PIN, 2);
+#endif
+  if (prepare) prepare();
+  setup();
+  // Connectivity comes up behind verification (see boot)
+  if (!settle) return;
+  runUntil([] { return fake::stats.mqttConnects > 0 && currentEpoch() != 0; }, 60000);
+  runFor(1000);   // the connect's own publishes
+}
+
+//  Students enrolled before power-on, for bootDevice()'s `prepare`:
+//  keys 1..count in slots first..first+count-1, with their roster in
+//  flash (count byte, then ROSTER_RECORD-byte records). Flash with no
+//  offline journal gets an empty one, as the station's own first boot
+//  leaves it; without one the roster would be read as older firmware's
+//  (see upgrade). A model with no roster entry would be counted as an
+//  orphan.
+//  Fields as the firmware writes them: NUL-padded, cut to the field
+static void putField(char *field, size_t len, const char *text) {
+  memset(field, 0, len);
+  memcpy(field, text, std::min(strlen(text), len - 1));
+}
+
+static void putStudent(char *name, char *regNum, int k) {
+  char text[32];
+  snprintf(text, sizeof(text), "Student %03d", k);
+  putField(name, 20, text);
+  snprintf(text, sizeof(text), "EG/2026/%04d", k);
+  putField(regNum, 15, text);
+}
+
+static void plantStudents(int count, uint16_t first = 1) {
+  std::string image((const char *)fake::eepromData(), fake::eepromSize());
+  image.resize(EEPROM_SIZE, '\0');
+  image[0] = (char)count;
+  for (int k = 1; k <= count; k++) {
+    uint16_t slot = (uint16_t)(first + k - 1);
+    fake::storeTemplate(slot, k);
+    char *r = &image[1 + (k - 1) * ROSTER_RECORD];
+    memset(r, 0, ROSTER_RECORD);
+    memcpy(r, &slot, 2);
+    putStudent(r + 2, r + 22, k);
+  }
+  if (image[JOURNAL_ADDR] != 'J') memcpy(&image[JOURNAL_ADDR], "JL\x02\x07", 4);
+  fake::eepromLoad((const uint8_t *)image.data(), image.size());
+}
+
+//  The roster as flash holds it, slot → (name, regNum): a count byte,
+//  then ROSTER_RECORD-byte records
+typedef std::map<uint16_t, std::pair<std::string, std::string>> RosterView;
+
+static RosterView flashRoster() {
+  const uint8_t *e = fake::eepromData();
+  RosterView     view;
+  for (uint8_t i = 0; i < e[0] && i < 50; i++) {
+    const char *r = (const char *)e + 1 + i * ROSTER_RECORD;
+    uint16_t    slot;
+    memcpy(&slot, r, 2);
+    view[slot] = {std::string(r + 2, strnlen(r + 2, 20)), std::string(r + 22, strnlen(r + 22, 15))};
+  }
+  return view;
+}
+
+//  Enrolls `count` students through the real MQTT enrollment flow.
+//  The fake student follows the prompts the firmware publishes on
+//  fp/message, so the script does not depend on internal timings.
+static int enrollStudents(int count, int firstKey) {
+  int enrolled = 0;
+  auto &hook = fake::onPublish();
+  for (int i = 0; i < count; i++) {
+    int  key  = firstKey + i;
+    bool done = false;
+    hook = [&](const FakePublish &p) {
+      if (p.topic == TOPIC_MESSAGE &&
+          (p.payload.find("Place finger to enroll") != std::string::npos ||
+           p.payload.find("Place again") != std::string::npos)) {
+        fake::presentFinger(key, fake::nowUs() + 200000ULL, 1000);
+      }
+      if (p.topic == TOPIC_STATE_PUB && p.payload == "VERIFY") done = true;
+    };
+    char data[96];
+    snprintf(data, sizeof(data), "{\"name\":\"Student %03d\",\"regNum\":\"EG/2026/%04d\"}",
+             key, key);
+    fake::injectMessage(TOPIC_ENROLL_DATA, data);
+    fake::injectMessage(TOPIC_SYS_STATE, "ENROLL");
+    runUntil([&] { return done; }, 60000);
+    fake::clearFingers();
+    bool stored = false;
+    for (uint16_t s = 0; s < 1000 && !stored; s++) stored = fake::templateAt(s) == key;
+    if (stored) enrolled++;
+  }
+  hook = nullptr;
+  return enrolled;
+}
+
+//  Stand-in for the bridge's fp/attendanceBatch handler: stores each
+//  record by journal seq and acks the whole batch `rttMs` later.
+struct FakeBridge {
+  std::set<uint32_t> stored;
+  uint32_t           batches  = 0;
+  uint32_t           entries  = 0;   // including resends
+  uint64_t           lastAtUs = 0;
+};
+
+static void installBridge(FakeBridge &b, uint32_t rttMs) {
+  fake::onPublish() = [&b, rttMs](const FakePublish &p) {
+    if (p.topic != TOPIC_ATT_BATCH) return;
+    std::string acks;
+    const char *s = p.payload.c_str();
+    for (const char *q = strchr(s, '['); q; q = strchr(q + 1, '[')) {
+      if (!isdigit((unsigned char)q[1])) continue;
+      uint32_t seq = (uint32_t)strtoul(q + 1, nullptr, 10);
+      b.stored.insert(seq);
+      b.entries++;
+      if (!acks.empty()) acks += ",";
+      acks += std::to_string(seq);
+    }
+    b.batches++;
+    b.lastAtUs = p.atUs;
+    std::string msg = "{\"acks\":[" + acks + "]}";
+    fake::injectMessage(TOPIC_ATT_ACK, msg.c_str(), rttMs);
+  };
+}
+
+// ─────────────────────────────────────────────────────────────
+//  bench — p50/p99 from getImage() == FINGERPRINT_OK to the
+//  fp/attendance publish, over a stream of enrolled students.
+// ─────────────────────────────────────────────────────────────
+static int scenarioBench(int argc, char **argv) {
+  int  scans  = (int)argInt(argc, argv, "--scans", 500);
+  int  roster = (int)argInt(argc, argv, "--roster", 50);
+  long gapMs  = argInt(argc, argv, "--gap", 3000);
+
+  bootDevice(argc, argv);
+  uint64_t tEnroll  = fake::nowUs();
+  uint32_t commits0 = fake::stats.eepromCommits;
+  int enrolled = enrollStudents(roster, 1);
+  if (enrolled == 0) {
+    printf("[Bench] enrollment failed\n");
+    return 1;
+  }
+  uint32_t commits = fake::stats.eepromCommits - commits0;
+  printf("[Bench] enroll: %.0f ms per student, %u EEPROM commits for %d students\n",
+         (double)(fake::nowUs() - tEnroll) / 1000.0 / enrolled, commits, enrolled);
+  // A class enrolling back to back shares coalesced roster commits
+  bool coalesced = commits * 5 <= (uint32_t)enrolled;
+  if (!coalesced) printf("[Bench] FAILED: a commit per enrollment, not coalesced\n");
+  runFor(3000);
+  fake::clearPublished();
+
+  // Idle station: what the "Place finger..." polls and the clock cost the I2C bus
+  FakeStats idle0 = fake::stats;
+  runFor(60000);
+  printf("[Bench] idle 60 s: %u display writes, %llu B, %.1f ms I2C; %u sensor polls\n",
+         fake::stats.displayWrites - idle0.displayWrites,
+         (unsigned long long)(fake::stats.displayBytes - idle0.displayBytes),
+         (double)(fake::stats.displayUs - idle0.displayUs) / 1000.0,
+         fake::stats.sensorCalls - idle0.sensorCalls);
+
+  uint64_t t0 = fake::nowUs() + 500000ULL;
+  for (int i = 0; i < scans; i++) {
+    int      key = 1 + (int)(simRand() % (uint32_t)enrolled);
+    uint64_t at  = t0 + (uint64_t)i * gapMs * 1000ULL + (simRand() % 400) * 1000ULL;
+    fake::presentFinger(key, at, 800);
+  }
+  uint64_t loopsBefore = 0;
+  uint64_t tEnd = t0 + (uint64_t)scans * gapMs * 1000ULL + 5000000ULL;
+  while (fake::nowUs() < tEnd) { loop(); loopsBefore++; }
+
+  std::vector<double> lat;
+  for (const FakePublish &p : fake::published())
+    if (p.topic == TOPIC_ATTENDANCE && p.imageOkAtUs)
+      lat.push_back((double)(p.atUs - p.imageOkAtUs) / 1000.0);
+
+  printf("[Bench] scan→publish  roster=%d scans=%d published=%zu seed=%ld\n",
+         enrolled, scans, lat.size(), argInt(argc, argv, "--seed", 1));
+  printf("[Bench] p50=%.1f ms  p90=%.1f ms  p99=%.1f ms  max=%.1f ms\n",
+         percentile(lat, 50), percentile(lat, 90), percentile(lat, 99),
+         percentile(lat, 100));
+  printf("[Bench] loops=%llu sensorCalls=%u displayBytes=%llu eepromCommits=%u publishes=%u\n",
+         (unsigned long long)loopsBefore, fake::stats.sensorCalls,
+         (unsigned long long)fake::stats.displayBytes, fake::stats.eepromCommits,
+         fake::stats.publishes);
+  return lat.size() == (size_t)scans && coalesced ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  offline — queue scans while the broker is down, then bring it
+//  back and measure how long and how much flash the drain costs.
+//  --cut-after N drops the broker for --cut-ms once the bridge has
+//  seen N batches, to check that nothing is lost mid-drain.
+// ─────────────────────────────────────────────────────────────
+static int scenarioOffline(int argc, char **argv) {
+  int  scans    = (int)argInt(argc, argv, "--scans", 30);
+  long gapMs    = argInt(argc, argv, "--gap", 3000);
+  long holdMs   = argInt(argc, argv, "--hold", 800);
+  long rttMs    = argInt(argc, argv, "--rtt", 150);
+  long cutAfter = argInt(argc, argv, "--cut-after", 0);
+  long cutMs    = argInt(argc, argv, "--cut-ms", 4000);
+
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents((int)argInt(argc, argv, "--roster", 50), 1);
+  runFor(3000);
+
+  fake::setBrokerUp(false);
+  runFor(1000);
+  uint64_t t0 = fake::nowUs();
+  for (int i = 0; i < scans; i++)
+    fake::presentFinger(1 + (int)(simRand() % (uint32_t)enrolled),
+                        t0 + (uint64_t)i * gapMs * 1000ULL, (uint32_t)holdMs);
+  uint64_t bytes0   = fake::stats.eepromBytes;
+  uint32_t commits0 = fake::stats.eepromCommits;
+
+  // Accept latency: finger down → getImage() OK, while reconnects fail
+  std::vector<double> accept;
+  uint64_t lastOk = fake::lastImageOkUs();
+  uint64_t tEnd   = t0 + (uint64_t)(scans * gapMs + 2000) * 1000ULL;
+  while (fake::nowUs() < tEnd) {
+    loop();
+    if (fake::lastImageOkUs() == lastOk) continue;
+    lastOk = fake::lastImageOkUs();
+    uint64_t arrived = t0 + (lastOk - t0) / ((uint64_t)gapMs * 1000ULL) * (uint64_t)gapMs * 1000ULL;
+    accept.push_back((double)(lastOk - arrived) / 1000.0);
+  }
+  uint64_t queueBytes   = fake::stats.eepromBytes - bytes0;
+  uint32_t queueCommits = fake::stats.eepromCommits - commits0;
+
+  FakeBridge bridge;
+  installBridge(bridge, (uint32_t)rttMs);
+  fake::clearPublished();
+  fake::setBrokerUp(true);
+  bytes0   = fake::stats.eepromBytes;
+  commits0 = fake::stats.eepromCommits;
+  uint64_t tUp   = fake::nowUs();
+  uint64_t cutAt = 0;
+  bool     cut   = false;
+
+  // Drained once every queued scan is stored and the device has gone
+  // quiet for longer than its ack timeout (nothing left to resend)
+  runUntil([&] {
+    if (cutAfter && !cutAt && bridge.batches >= (uint32_t)cutAfter) {
+      fake::setBrokerUp(false);
+      cutAt = fake::nowUs();
+      cut   = true;
+    }
+    if (cut && fake::nowUs() - cutAt >= (uint64_t)cutMs * 1000ULL) {
+      fake::setBrokerUp(true);
+      cut = false;
+    }
+    return !cut && bridge.stored.size() >= (size_t)scans &&
+           fake::nowUs() - bridge.lastAtUs > 8000000ULL;
+  }, 600000);
+  fake::onPublish() = nullptr;
+  uint64_t tDrained = bridge.lastAtUs + (uint64_t)rttMs * 1000ULL;
+
+  printf("[Offline] queued=%d  store: %llu B written, %u commits\n", scans,
+         (unsigned long long)queueBytes, queueCommits);
+  printf("[Offline] accept while broker down: p50=%.0f ms  p99=%.0f ms  max=%.0f ms  (%zu scans)\n",
+         percentile(accept, 50), percentile(accept, 99), percentile(accept, 100), accept.size());
+  printf("[Offline] stored=%zu in %u batches (%u resent)  drain: %.0f ms after broker up%s\n",
+         bridge.stored.size(), bridge.batches,
+         bridge.entries - (uint32_t)bridge.stored.size(),
+         (double)(tDrained - tUp) / 1000.0, cutAfter ? " incl. cut" : "");
+  printf("[Offline] drain flash: %llu B written, %u commits\n",
+         (unsigned long long)(fake::stats.eepromBytes - bytes0),
+         fake::stats.eepromCommits - commits0);
+  return bridge.stored.size() >= (size_t)scans ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  flap — a steady queue of students while the access point drops
+//  out for --down ms every --period ms. Reports accepted scans per
+//  minute, how every scan was delivered, and what reconnecting cost
+//  the network task.
+// ─────────────────────────────────────────────────────────────
+static int scenarioFlap(int argc, char **argv) {
+  long durMs    = argInt(argc, argv, "--duration", 300000);
+  long periodMs = argInt(argc, argv, "--period", 30000);
+  long downMs   = argInt(argc, argv, "--down", 12000);
+  long gapMs    = argInt(argc, argv, "--gap", 2500);
+  long rttMs    = argInt(argc, argv, "--rtt", 150);
+  bool broker   = argFlag(argc, argv, "--broker");   // flap the broker, not the AP
+
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents((int)argInt(argc, argv, "--roster", 20), 1);
+  runFor(3000);
+
+  FakeBridge bridge;
+  installBridge(bridge, (uint32_t)rttMs);
+  fake::clearPublished();
+  uint32_t attempts0 = fake::stats.mqttConnectAttempts;
+  uint32_t begins0   = fake::stats.wifiBegins;
+  uint64_t connUs0   = fake::stats.mqttConnectUs;
+  fake::taskMaxRunUs("net", true);
+
+  uint64_t t0    = fake::nowUs();
+  uint64_t tEnd  = t0 + (uint64_t)durMs * 1000ULL;
+  int      scans = (int)(durMs / gapMs);
+  for (int i = 0; i < scans; i++)
+    fake::presentFinger(1 + (int)(simRand() % (uint32_t)enrolled),
+                        t0 + (uint64_t)i * gapMs * 1000ULL, 800);
+
+  // Outages start at a random offset inside each period
+  std::vector<std::pair<uint64_t, uint64_t>> outages;
+  for (uint64_t p = t0; p < tEnd; p += (uint64_t)periodMs * 1000ULL) {
+    uint64_t slack = (uint64_t)std::max(0L, periodMs - downMs);
+    uint64_t at    = p + (slack ? (simRand() % slack) * 1000ULL : 0);
+    outages.push_back({at, at + (uint64_t)downMs * 1000ULL});
+  }
+
+  uint32_t accepted = 0;
+  uint64_t lastOk   = fake::lastImageOkUs();
+  uint64_t downUs   = 0, downSince = 0;
+  bool     down     = false;
+  while (fake::nowUs() < tEnd) {
+    bool want = false;
+    for (auto &o : outages)
+      if (fake::nowUs() >= o.first && fake::nowUs() < o.second) { want = true; break; }
+    if (want != down) {
+      down = want;
+      if (broker) fake::setBrokerUp(!down); else fake::setLinkUp(!down);
+      if (down) downSince = fake::nowUs(); else downUs += fake::nowUs() - downSince;
+    }
+    loop();
+    if (fake::lastImageOkUs() != lastOk) { lastOk = fake::lastImageOkUs(); accepted++; }
+  }
+  if (down) downUs += fake::nowUs() - downSince;
+  fake::setLinkUp(true);
+  fake::setBrokerUp(true);
+  uint32_t attempts = fake::stats.mqttConnectAttempts - attempts0;
+  uint32_t begins   = fake::stats.wifiBegins - begins0;
+  uint64_t connUs   = fake::stats.mqttConnectUs - connUs0;
+  uint64_t netMaxUs = fake::taskMaxRunUs("net");
+
+  // Let the backlog drain so every accepted scan is accounted for
+  size_t live = 0;
+  runUntil([&] {
+    live = 0;
+    for (const FakePublish &p : fake::published()) live += p.topic == TOPIC_ATTENDANCE;
+    return live + bridge.stored.size() >= accepted &&
+           fake::nowUs() - bridge.lastAtUs > 8000000ULL;
+  }, 600000);
+  fake::onPublish() = nullptr;
+
+  double minutes = (double)durMs / 60000.0;
+  printf("[Flap] %s down %.0f%% of %.0f s  (%zu outages of %ld ms)\n",
+         broker ? "broker" : "AP", 100.0 * (double)downUs / ((double)durMs * 1000.0),
+         (double)durMs / 1000.0, outages.size(), downMs);
+  printf("[Flap] scans offered=%d accepted=%u  (%.1f / min)\n", scans, accepted,
+         (double)accepted / minutes);
+  printf("[Flap] delivered live=%zu  via backlog=%zu  lost=%d\n", live, bridge.stored.size(),
+         (int)accepted - (int)(live + bridge.stored.size()));
+  printf("[Flap] reconnect cost: %u WiFi.begin, %u MQTT connects, %.1f s inside connect()\n",
+         begins, attempts, (double)connUs / 1e6);
+  printf("[Flap] longest network-task pass: %.0f ms\n", (double)netMaxUs / 1000.0);
+  return live + bridge.stored.size() >= accepted ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  enroll — one slow enrollment (the student takes --think ms to
+//  place each finger) and one cancelled from the dashboard --cancel
+//  ms after the first prompt. Reports the longest loop() pass, which
+//  bounds how stale the display and command handling can get.
+// ─────────────────────────────────────────────────────────────
+static int scenarioEnroll(int argc, char **argv) {
+  long thinkMs  = argInt(argc, argv, "--think", 6000);
+  long cancelMs = argInt(argc, argv, "--cancel", 3000);
+
+  bootDevice(argc, argv);
+  runFor(3000);
+  auto &hook = fake::onPublish();
+
+  // Slow enrollment
+  bool     done = false;
+  uint64_t t0   = fake::nowUs();
+  hook = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_MESSAGE &&
+        (p.payload.find("Place finger to enroll") != std::string::npos ||
+         p.payload.find("Place again") != std::string::npos))
+      fake::presentFinger(7, fake::nowUs() + (uint64_t)thinkMs * 1000ULL, 1000);
+    if (p.topic == TOPIC_STATE_PUB && p.payload == "VERIFY") done = true;
+  };
+  fake::injectMessage(TOPIC_ENROLL_DATA, "{\"name\":\"Slow Student\",\"regNum\":\"EG/2026/0007\"}");
+  fake::injectMessage(TOPIC_SYS_STATE, "ENROLL");
+  uint64_t maxLoopUs = 0;
+  uint64_t writes0   = fake::stats.displayWrites;
+  while (!done && fake::nowUs() - t0 < 60000000ULL) {
+    uint64_t a = fake::nowUs();
+    loop();
+    maxLoopUs = std::max(maxLoopUs, fake::nowUs() - a);
+  }
+  bool enrolled = false;
+  for (uint16_t s = 0; s < 1000 && !enrolled; s++) enrolled = fake::templateAt(s) == 7;
+  printf("[Enroll] slow student: %s in %.1f s  longest loop() pass %.0f ms  %llu display writes\n",
+         enrolled ? "enrolled" : "FAILED", (double)(fake::nowUs() - t0) / 1e6,
+         (double)maxLoopUs / 1000.0,
+         (unsigned long long)(fake::stats.displayWrites - writes0));
+  fake::clearFingers();
+  runFor(2000);
+
+  // Cancelled enrollment: nobody comes to the sensor
+  done = false;
+  uint64_t cancelAt = 0, ackAt = 0;
+  hook = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_MESSAGE && !cancelAt &&
+        p.payload.find("Place finger to enroll") != std::string::npos) {
+      cancelAt = fake::nowUs() + (uint64_t)cancelMs * 1000ULL;
+      fake::injectMessage(TOPIC_SYS_STATE, "VERIFY", (uint32_t)cancelMs);
+    }
+    if (p.topic == TOPIC_STATE_PUB && p.payload == "VERIFY") { done = true; ackAt = p.atUs; }
+  };
+  fake::injectMessage(TOPIC_ENROLL_DATA, "{\"name\":\"No Show\",\"regNum\":\"EG/2026/0008\"}");
+  fake::injectMessage(TOPIC_SYS_STATE, "ENROLL");
+  runUntil([&] { return done; }, 60000);
+  hook = nullptr;
+  printf("[Enroll] cancel: VERIFY acked %.0f ms after the dashboard sent it\n",
+         cancelAt && ackAt ? (double)(ackAt - cancelAt) / 1000.0 : -1.0);
+  return enrolled && done ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  soak — a long day of scans with heartbeats going out. Counts the
+//  String heap allocations the steady state makes (should be none)
+//  and compares the heap figures the device reports at the start
+//  and end of the run.
+// ─────────────────────────────────────────────────────────────
+static int scenarioSoak(int argc, char **argv) {
+  int  scans  = (int)argInt(argc, argv, "--scans", 10000);
+  int  roster = (int)argInt(argc, argv, "--roster", 50);
+  long gapMs  = argInt(argc, argv, "--gap", 2500);
+
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents(roster, 1);
+  if (enrolled == 0) {
+    printf("[Soak] enrollment failed\n");
+    return 1;
+  }
+  runFor(5000);
+
+  std::string lastHeartbeat;
+  uint32_t    delivered = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_HEARTBEAT) lastHeartbeat = p.payload;
+    if (p.topic == TOPIC_ATTENDANCE) delivered++;
+  };
+  runUntil([&] { return !lastHeartbeat.empty(); }, 60000);
+  std::string firstHeartbeat = lastHeartbeat;
+  fake::clearPublished();
+
+  uint32_t allocs0 = String::allocCount;
+  uint32_t free0   = ESP.getFreeHeap();
+  uint64_t t0      = fake::nowUs() + 500000ULL;
+  for (int i = 0; i < scans; i++) {
+    int      key = 1 + (int)(simRand() % (uint32_t)enrolled);
+    uint64_t at  = t0 + (uint64_t)i * gapMs * 1000ULL + (simRand() % 400) * 1000ULL;
+    fake::presentFinger(key, at, 800);
+  }
+  uint64_t tEnd = t0 + (uint64_t)scans * gapMs * 1000ULL + 5000000ULL;
+  while (fake::nowUs() < tEnd) {
+    loop();
+    if (fake::published().size() > 1000) fake::clearPublished();
+  }
+  uint32_t allocs = String::allocCount - allocs0;
+  fake::onPublish() = nullptr;
+
+  printf("[Soak] %d scans over %.1f h  delivered=%u\n", scans,
+         (double)scans * gapMs / 3.6e6, delivered);
+  printf("[Soak] String heap allocations: %u (%.2f per scan)\n", allocs,
+         (double)allocs / scans);
+  printf("[Soak] free heap %u -> %u B  low-water %u B\n", free0,
+         ESP.getFreeHeap(), ESP.getMinFreeHeap());
+  printf("[Soak] first heartbeat %s\n", firstHeartbeat.c_str());
+  printf("[Soak] last  heartbeat %s\n", lastHeartbeat.c_str());
+  return delivered == (uint32_t)scans ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  clock — host CPU cost per timestamp call, then --hours of NTP
+//  resyncs to read back the drift the device reports.
+// ─────────────────────────────────────────────────────────────
+static int scenarioClock(int argc, char **argv) {
+  int  calls = (int)argInt(argc, argv, "--calls", 200000);
+  long hours = argInt(argc, argv, "--hours", 4);
+
+  bootDevice(argc, argv);
+  runFor(3000);
+
+  char     ts[32];
+  uint32_t epoch = currentEpoch();
+  auto     t0    = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++) getTimestamp(ts, sizeof(ts));
+  auto t1 = std::chrono::steady_clock::now();
+  for (int i = 0; i < calls; i++) formatTimestamp(epoch + (uint32_t)i, ts, sizeof(ts));
+  auto t2 = std::chrono::steady_clock::now();
+  printf("[Clock] getTimestamp(): %.0f ns/call  formatTimestamp(): %.0f ns/call  (host CPU)\n",
+         std::chrono::duration<double, std::nano>(t1 - t0).count() / calls,
+         std::chrono::duration<double, std::nano>(t2 - t1).count() / calls);
+
+  std::string lastHeartbeat;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_HEARTBEAT) lastHeartbeat = p.payload;
+    fake::clearPublished();
+  };
+  runFor((uint32_t)(hours * 3600000L));
+  fake::onPublish() = nullptr;
+
+  // The device's idea of now against true time under the crystal drift
+  uint64_t nowUs   = fake::nowUs();
+  uint64_t trueUs  = nowUs * 1000000ULL / (uint64_t)(1000000 + fake::timing.rtcDriftPpm);
+  uint32_t trueNow = (uint32_t)(fake::epochNow() - (time_t)(nowUs / 1000000ULL) +
+                                (time_t)(trueUs / 1000000ULL));
+  char truth[32];
+  getTimestamp(ts, sizeof(ts));
+  formatTimestamp(trueNow, truth, sizeof(truth));
+  printf("[Clock] after %ld h at %d ppm: device says %s, NTP says %s\n",
+         hours, (int)fake::timing.rtcDriftPpm, ts, truth);
+  printf("[Clock] last heartbeat %s\n", lastHeartbeat.c_str());
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  liveness — heartbeat and bridge /status traffic for an idle hour
+//  and a busy one (a scan every --gap ms), then how long after the
+//  access point vanishes the broker reports the station offline.
+//  /status writes follow the bridge's throttle (--status-ms).
+// ─────────────────────────────────────────────────────────────
+struct LivenessCount {
+  uint32_t publishes  = 0;
+  uint32_t heartbeats = 0;
+  uint32_t statusWrites = 0;
+  uint64_t lastWriteUs  = 0;
+  uint64_t maxGapUs     = 0;
+};
+
+static int scenarioLiveness(int argc, char **argv) {
+  long     gapMs    = argInt(argc, argv, "--gap", 10000);
+  uint64_t statusUs = (uint64_t)argInt(argc, argv, "--status-ms", 25000) * 1000ULL;
+
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents(10, 1);
+  runFor(5000);
+
+  LivenessCount c;
+  uint64_t      willAtUs = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_ONLINE && p.payload == "offline") { willAtUs = p.atUs; return; }
+    c.publishes++;
+    if (p.topic == TOPIC_HEARTBEAT) c.heartbeats++;
+    if (p.atUs - c.lastWriteUs >= statusUs) {
+      if (c.lastWriteUs) c.maxGapUs = std::max(c.maxGapUs, p.atUs - c.lastWriteUs);
+      c.statusWrites++;
+      c.lastWriteUs = p.atUs;
+    }
+    fake::clearPublished();
+  };
+  auto report = [&](const char *phase) {
+    printf("[Liveness] %-5s hour: %4u publishes, %4u heartbeats, %4u /status writes, "
+           "longest /status gap %.0f s\n", phase, c.publishes, c.heartbeats,
+           c.statusWrites, (double)c.maxGapUs / 1e6);
+    uint64_t last = c.lastWriteUs;
+    c = LivenessCount();
+    c.lastWriteUs = last;
+  };
+
+  runFor(3600000);
+  report("idle");
+
+  uint64_t t0 = fake::nowUs() + 500000ULL;
+  int      n  = (int)(3600000L / gapMs);
+  for (int i = 0; i < n; i++)
+    fake::presentFinger(1 + i % enrolled, t0 + (uint64_t)i * gapMs * 1000ULL, 800);
+  runFor(3600000);
+  report("busy");
+
+  uint64_t dropUs = fake::nowUs();
+  fake::setLinkUp(false);
+  runUntil([&] { return willAtUs != 0 && fake::nowUs() >= willAtUs; }, 120000);
+  fake::onPublish() = nullptr;
+  if (willAtUs)
+    printf("[Liveness] AP lost: broker published the will %.1f s later\n",
+           (double)(willAtUs - dropUs) / 1e6);
+  else
+    printf("[Liveness] AP lost: no will within 120 s\n");
+  fake::setLinkUp(true);
+  return willAtUs ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  capture — finger arrival to match under scripted arrival
+//  patterns, and what an empty hall costs the sensor link.
+//    queue:  groups of 20 students 3 s apart, 2 min between groups
+//    sparse: one student every 15-75 s
+//  Build with -DFP_TOUCH_PIN=<gpio> to run on the touch line.
+// ─────────────────────────────────────────────────────────────
+static int scenarioCapture(int argc, char **argv) {
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents(20, 1);
+  runFor(60000);
+
+  uint32_t polls0 = fake::stats.sensorCalls;
+  runFor(60000);
+  printf("[Capture] %s, empty hall: %u getImage() per minute\n",
+#if defined(FP_TOUCH_PIN) && FP_TOUCH_PIN >= 0
+         "touch line",
+#else
+         "polled",
+#endif
+         fake::stats.sensorCalls - polls0);
+
+  struct Pattern { const char *name; FakeArrivals p; };
+  Pattern patterns[2];
+  patterns[0].name = "queue";
+  patterns[0].p.count = 100; patterns[0].p.burst = 20;
+  patterns[0].p.gapMs = 3000; patterns[0].p.pauseMs = 120000;
+  patterns[1].name = "sparse";
+  patterns[1].p.count = 40; patterns[1].p.gapMs = 45000; patterns[1].p.jitterMs = 30000;
+
+  const char *only = nullptr;
+  for (int i = 1; i + 1 < argc; i++)
+    if (strcmp(argv[i], "--pattern") == 0) only = argv[i + 1];
+
+  int rc = 0;
+  for (const Pattern &pt : patterns) {
+    if (only && strcmp(only, pt.name) != 0) continue;
+    std::vector<double> lat;
+    uint32_t scans = 0, sumMs = 0, maxMs = 0;
+    fake::onPublish() = [&](const FakePublish &p) {
+      if (p.topic == TOPIC_ATTENDANCE && p.fingerAtUs)
+        lat.push_back((double)(p.atUs - p.fingerAtUs) / 1000.0);
+      if (p.topic == TOPIC_HEARTBEAT) {
+        const char *q = strstr(p.payload.c_str(), "\"scans\":");
+        if (q) {
+          uint32_t n = (uint32_t)strtoul(q + 8, nullptr, 10);
+          uint32_t m = (uint32_t)strtoul(strstr(q, "\"matchMs\":") + 10, nullptr, 10);
+          uint32_t x = (uint32_t)strtoul(strstr(q, "\"matchMaxMs\":") + 13, nullptr, 10);
+          scans += n;
+          sumMs += n * m;
+          maxMs  = std::max(maxMs, x);
+        }
+      }
+      fake::clearPublished();
+    };
+    uint32_t polls = fake::stats.sensorCalls;
+    uint64_t end   = fake::scriptArrivals(pt.p, enrolled, fake::nowUs() + 1000000ULL);
+    while (fake::nowUs() < end + 310000000ULL) loop();   // past one telemetry heartbeat
+    fake::onPublish() = nullptr;
+    printf("[Capture] %-6s %zu/%u matched  arrival→publish p50=%.0f ms p90=%.0f ms max=%.0f ms  "
+           "%u sensor calls\n", pt.name, lat.size(), pt.p.count, percentile(lat, 50),
+           percentile(lat, 90), percentile(lat, 100), fake::stats.sensorCalls - polls);
+    printf("[Capture] %-6s device detect→match: %u scans, mean %u ms, max %u ms\n", pt.name,
+           scans, scans ? sumMs / scans : 0, maxMs);
+    if (lat.size() != pt.p.count) rc = 2;
+  }
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  multi — the lecture-entrance rush with one and then two sensors.
+//  Every sensor has its own queue that never runs dry: a student
+//  keeps the finger down until the sensor matches it, lifts it
+//  --react ms later and the next one steps up --walk ms after that.
+//  Reports scans per minute, how it scales with the second sensor,
+//  and whether enrollment put every template on both. The firmware
+//  boots once per process, so each sensor count runs in a child.
+// ─────────────────────────────────────────────────────────────
+static int multiTrial(int argc, char **argv, int n, double &rate) {
+  long durMs   = argInt(argc, argv, "--duration", 300000);
+  long reactMs = argInt(argc, argv, "--react", 300);
+  long walkMs  = argInt(argc, argv, "--walk", 1000);
+
+  bootDevice(argc, argv, n);
+  int enrolled = enrollStudents(20, 1);
+  if (enrolled == 0) {
+    printf("[Multi] enrollment failed\n");
+    return 1;
+  }
+  int mirrored = 0;
+  for (int key = 1; key <= enrolled; key++)
+    for (uint16_t slot = 0; slot < 1000; slot++)
+      if (fake::templateAt(slot, 1) == key) { mirrored += fake::templateAt(slot, 2) == key; break; }
+  runFor(3000);
+
+  struct Queue {
+    bool     down    = false;
+    uint32_t hits    = 0;
+    uint64_t nextAt  = 0;   // next student steps up / current one lifts
+    uint64_t placeAt = 0;
+  } q[3];
+  std::vector<double> lat;
+  uint32_t published = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    published += p.topic == TOPIC_ATTENDANCE;
+    fake::clearPublished();
+  };
+  uint64_t t0 = fake::nowUs(), tEnd = t0 + (uint64_t)durMs * 1000ULL;
+  for (uint8_t s = 1; s <= n; s++) q[s].nextAt = t0 + (uint64_t)(s - 1) * 700000ULL;
+  while (fake::nowUs() < tEnd) {
+    uint64_t now = fake::nowUs();
+    for (uint8_t s = 1; s <= n; s++) {
+      Queue &k = q[s];
+      if (!k.down && k.nextAt && now >= k.nextAt) {
+        fake::presentFinger(1 + (int)(simRand() % (uint32_t)enrolled), now, 30000, s);
+        k.down    = true;
+        k.nextAt  = 0;
+        k.placeAt = now;
+        k.hits    = fake::searchHits(s);
+      } else if (k.down && !k.nextAt && fake::searchHits(s) != k.hits) {
+        lat.push_back((double)(now - k.placeAt) / 1000.0);
+        k.nextAt = now + (uint64_t)reactMs * 1000ULL;
+      } else if (k.down && k.nextAt && now >= k.nextAt) {
+        fake::liftFinger(s);
+        k.down   = false;
+        k.nextAt = now + (uint64_t)(walkMs + (long)(simRand() % 500)) * 1000ULL;
+      }
+    }
+    loop();
+  }
+  runFor(3000);
+  fake::onPublish() = nullptr;
+  fake::clearFingers();
+
+  rate = (double)published / ((double)durMs / 60000.0);
+  printf("[Multi] %d sensor%s: %.1f scans/min  place→match p50=%.0f ms p90=%.0f ms",
+         n, n > 1 ? "s" : " ", rate, percentile(lat, 50), percentile(lat, 90));
+  if (n > 1) printf("  templates on UART2: %d/%d", mirrored, enrolled);
+  printf("\n");
+  if (published < lat.size() || (n > 1 && mirrored != enrolled)) return 2;
+  return 0;
+}
+
+static int scenarioMulti(int argc, char **argv) {
+  double rate[3] = {0, 0, 0};
+  int    rc      = 0;
+  for (int n = 1; n <= 2; n++) {
+    int fd[2];
+    if (pipe(fd) != 0) return 1;
+    fflush(stdout);
+    pid_t pid = fork();
+    if (pid == 0) {
+      double r   = 0;
+      int    res = multiTrial(argc, argv, n, r);
+      fflush(stdout);
+      if (write(fd[1], &r, sizeof(r)) != (ssize_t)sizeof(r)) res = 1;
+      _exit(res);
+    }
+    close(fd[1]);
+    if (read(fd[0], &rate[n], sizeof(rate[n])) != (ssize_t)sizeof(rate[n])) rate[n] = 0;
+    close(fd[0]);
+    int status = 0;
+    waitpid(pid, &status, 0);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) rc = 2;
+  }
+  printf("[Multi] scaling: %.2fx with 2 sensors\n", rate[1] ? rate[2] / rate[1] : 0.0);
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  repeats — students who press two or three times. Every press
+//  must be welcomed, but only the first per student may reach the
+//  broker (online) or the journal (broker down); a student back
+//  after the window is sent again.
+// ─────────────────────────────────────────────────────────────
+static int scenarioRepeats(int argc, char **argv) {
+  int  students = (int)argInt(argc, argv, "--students", 40);
+  long rttMs    = argInt(argc, argv, "--rtt", 150);
+
+  bootDevice(argc, argv);
+  scanRepeatWindowMs = (uint32_t)argInt(argc, argv, "--repeat-window", 60000);
+  int enrolled = enrollStudents(students, 1);
+  if (enrolled != students) {
+    printf("[Repeats] enrollment failed\n");
+    return 1;
+  }
+  runFor(3000);
+
+  // Each student presses once, half again and a fifth a third time,
+  // 3 s apart; returns the number of presses
+  auto queue = [&](uint64_t &at) {
+    int presses = 0;
+    for (int k = 1; k <= students; k++) {
+      uint32_t r = simRand() % 10, n = r < 2 ? 3 : r < 7 ? 2 : 1;
+      for (uint32_t i = 0; i < n; i++, presses++) {
+        fake::presentFinger(k, at, 800);
+        at += 3000000ULL;
+      }
+    }
+    return presses;
+  };
+
+  uint32_t published = 0;
+  fake::onPublish() = [&](const FakePublish &p) { published += p.topic == TOPIC_ATTENDANCE; };
+  uint32_t hits0   = fake::searchHits(1);
+  uint64_t at      = fake::nowUs() + 500000ULL;
+  int      presses = queue(at);
+  runUntil([&] { return fake::nowUs() > at + 3000000ULL; }, 3600000);
+  uint32_t welcomed = fake::searchHits(1) - hits0;
+  printf("[Repeats] online: %d presses, %u welcomed, %u published (window %u s) — %d bridge "
+         "lookups saved\n", presses, welcomed, published, scanRepeatWindowMs.load() / 1000,
+         presses - (int)published);
+  bool ok = welcomed == (uint32_t)presses && published == (uint32_t)students;
+
+  // Broker down for a second round, past the window
+  fake::onPublish() = nullptr;
+  runFor(scanRepeatWindowMs + 1000);
+  fake::setBrokerUp(false);
+  runFor(1000);
+  hits0   = fake::searchHits(1);
+  at      = fake::nowUs() + 500000ULL;
+  presses = queue(at);
+  runUntil([&] { return fake::nowUs() > at + 3000000ULL; }, 3600000);
+  welcomed = fake::searchHits(1) - hits0;
+
+  FakeBridge bridge;
+  installBridge(bridge, (uint32_t)rttMs);
+  fake::setBrokerUp(true);
+  runUntil([&] { return bridge.stored.size() >= (size_t)students && fake::nowUs() - bridge.lastAtUs > 8000000ULL; },
+           600000);
+  printf("[Repeats] broker down: %d presses, %u welcomed, %zu journaled and replayed — %d journal "
+         "slots saved\n", presses, welcomed, bridge.stored.size(), presses - (int)bridge.stored.size());
+  ok = ok && welcomed == (uint32_t)presses && bridge.stored.size() == (size_t)students;
+
+  // Back after the window: counted again
+  published = 0;
+  fake::onPublish() = [&](const FakePublish &p) { published += p.topic == TOPIC_ATTENDANCE; };
+  runFor(scanRepeatWindowMs + 1000);
+  fake::presentFinger(1, fake::nowUs() + 100000ULL, 800);
+  runFor(3000);
+  fake::onPublish() = nullptr;
+  printf("[Repeats] same student after the window: %u published\n", published);
+  return ok && published == 1 ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  templates — provisioning a replacement station. Station A
+//  enrolls --students in person and exports its models to a fake
+//  bridge; the broker drops out for --cut-ms half way, and one
+//  model lost from the sensor must come back listed as unreadable.
+//  Station B
+//  (two sensors, empty) is then provisioned from the stored set
+//  with the same cut, and must match every student by name. Each
+//  station runs in its own child process.
+// ─────────────────────────────────────────────────────────────
+#define TOPIC_TPL_CMD    "fp/templateCmd"
+#define TOPIC_TPL_OUT    "fp/templateOut"
+#define TOPIC_TPL_ACK    "fp/templateAck"
+#define TOPIC_TPL_IN     "fp/templateIn"
+#define TOPIC_TPL_STORED "fp/templateStored"
+
+static std::string jsonStr(const std::string &p, const char *key) {
+  std::string k = std::string("\"") + key + "\":\"";
+  size_t      a = p.find(k);
+  if (a == std::string::npos) return "";
+  a += k.size();
+  return p.substr(a, p.find('"', a) - a);
+}
+
+static long jsonNum(const std::string &p, const char *key, long def) {
+  std::string k = std::string("\"") + key + "\":";
+  size_t      a = p.find(k);
+  return a == std::string::npos ? def : strtol(p.c_str() + a + k.size(), nullptr, 10);
+}
+
+//  A model as the bridge keeps it
+struct StoredTemplate {
+  int         key = -1;     // finger it came from (for the checks)
+  long        crc = -1;
+  std::string name, regNum;
+  std::string parts[2];
+};
+
+static bool brokerCut(uint64_t &cutAt, bool trigger, long cutMs) {
+  if (cutMs <= 0) return false;
+  if (trigger && !cutAt) {
+    fake::setBrokerUp(false);
+    cutAt = fake::nowUs();
+  }
+  if (cutAt && cutAt != 1 && fake::nowUs() - cutAt >= (uint64_t)cutMs * 1000ULL) {
+    fake::setBrokerUp(true);
+    cutAt = 1;   // done
+  }
+  return cutAt && cutAt != 1;
+}
+
+static int templatesExport(int argc, char **argv, std::map<uint16_t, StoredTemplate> &set,
+                           double &enrollMs) {
+  int  students = (int)argInt(argc, argv, "--students", 40);
+  long rttMs    = argInt(argc, argv, "--rtt", 150);
+  long cutMs    = argInt(argc, argv, "--cut-ms", 5000);
+
+  bootDevice(argc, argv);
+  uint64_t t0 = fake::nowUs();
+  int enrolled = enrollStudents(students, 1);
+  if (enrolled == 0) {
+    printf("[Templates] enrollment failed\n");
+    return 1;
+  }
+  enrollMs = (double)(fake::nowUs() - t0) / 1000.0 / enrolled;
+  runFor(3000);
+  // One student's model is lost from the sensor: the export must say so
+  uint16_t lost = 0;
+  for (uint16_t s = 1; s < 1000 && !lost; s++)
+    if (fake::templateAt(s, 1) == 3) lost = s;
+  fake::storeTemplate(lost, -1);
+
+  uint32_t    messages = 0, resent = 0;
+  uint64_t    bytes = 0, doneAt = 0, cutAt = 0;
+  std::string failed;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic != TOPIC_TPL_OUT) return;
+    if (p.payload.find("\"done\"") != std::string::npos) {
+      size_t a = p.payload.find("\"failed\":[");
+      if (a != std::string::npos) failed = p.payload.substr(a + 10, p.payload.find(']', a) - a - 10);
+      doneAt = p.atUs;
+      return;
+    }
+    messages++;
+    bytes += p.payload.size();
+    uint16_t        slot = (uint16_t)jsonNum(p.payload, "slot", 0);
+    long            part = jsonNum(p.payload, "part", 0);
+    StoredTemplate &t    = set[slot];
+    if (t.crc != jsonNum(p.payload, "crc", -2)) {
+      t = StoredTemplate();
+      t.crc = jsonNum(p.payload, "crc", -2);
+    } else if (!t.parts[part].empty() && part == 0) {
+      resent++;
+    }
+    t.parts[part] = jsonStr(p.payload, "data");
+    if (part == 0) {
+      t.name   = jsonStr(p.payload, "name");
+      t.regNum = jsonStr(p.payload, "regNum");
+    }
+    if (t.parts[0].empty() || t.parts[1].empty()) return;
+    std::string ack = "{\"acks\":[" + std::to_string(slot) + "]}";
+    fake::injectMessage(TOPIC_TPL_ACK, ack.c_str(), (uint32_t)rttMs);
+  };
+
+  auto complete = [&] {
+    size_t n = 0;
+    for (auto &kv : set) n += !kv.second.parts[0].empty() && !kv.second.parts[1].empty();
+    return n;
+  };
+  uint64_t tStart = fake::nowUs();
+  fake::injectMessage(TOPIC_TPL_CMD, "{\"op\":\"export\",\"from\":1}");
+  runUntil([&] {
+    bool down = brokerCut(cutAt, complete() >= (size_t)enrolled / 2, cutMs);
+    return !down && doneAt;
+  }, 600000);
+  fake::onPublish() = nullptr;
+
+  for (auto &kv : set) kv.second.key = fake::templateAt(kv.first, 1);
+  size_t stored = complete();
+  printf("[Templates] export: %zu/%d models in %.1f s (broker cut %ld ms), "
+         "%u part messages, %u models resent, %.1f KB, unreadable [%s] (lost slot %u)\n",
+         stored, enrolled, doneAt ? (double)(doneAt - tStart) / 1e6 : 0.0, cutMs,
+         messages, resent, (double)bytes / 1024.0, failed.c_str(), (unsigned)lost);
+  return stored == (size_t)enrolled - 1 && !set.count(lost) && failed == std::to_string(lost) && doneAt
+             ? 0 : 2;
+}
+
+static int templatesImport(int argc, char **argv, const std::map<uint16_t, StoredTemplate> &set,
+                           double &importMs) {
+  long rttMs  = argInt(argc, argv, "--rtt", 150);
+  long cutMs  = argInt(argc, argv, "--cut-ms", 5000);
+  const size_t   window    = 4;
+  const uint64_t timeoutUs = 10000000ULL;
+
+  bootDevice(argc, argv, 2);
+  runFor(3000);
+
+  std::vector<uint16_t>        todo;
+  std::map<uint16_t, uint64_t> inFlight;   // slot → sent at
+  std::set<uint16_t>           stored, failed;
+  uint32_t resent = 0, messages = 0, unflashed = 0;
+  bool     reconnected = false;
+  for (auto &kv : set) todo.push_back(kv.first);
+  std::reverse(todo.begin(), todo.end());
+
+  auto send = [&](uint16_t slot) {
+    const StoredTemplate &t = set.at(slot);
+    for (int part = 0; part < 2; part++) {
+      std::string msg = "{\"slot\":" + std::to_string(slot) + ",\"part\":" + std::to_string(part) +
+                        ",\"of\":2,\"crc\":" + std::to_string(t.crc) + ",\"data\":\"" + t.parts[part] + "\"";
+      if (part == 0) msg += ",\"name\":\"" + t.name + "\",\"regNum\":\"" + t.regNum + "\"";
+      msg += "}";
+      fake::injectMessage(TOPIC_TPL_IN, msg.c_str(), (uint32_t)rttMs / 2);
+      messages++;
+    }
+    inFlight[slot] = fake::nowUs();
+  };
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_ONLINE && p.payload == "online") reconnected = true;
+    if (p.topic != TOPIC_TPL_STORED) return;
+    uint16_t slot = (uint16_t)jsonNum(p.payload, "slot", 0);
+    inFlight.erase(slot);
+    if (p.payload.find("\"ok\":true") != std::string::npos) {
+      stored.insert(slot);
+      unflashed += !flashRoster().count(slot);   // answered before its commit
+    } else {
+      failed.insert(slot);
+    }
+  };
+
+  uint64_t tStart = fake::nowUs(), cutAt = 0, doneAt = 0;
+  runUntil([&] {
+    bool down = brokerCut(cutAt, stored.size() >= set.size() / 2, cutMs);
+    uint64_t now = fake::nowUs();
+    if (reconnected) {   // parts sent into the old session are gone
+      reconnected = false;
+      for (auto &kv : inFlight) { resent++; send(kv.first); }
+    }
+    for (auto &kv : inFlight)
+      if (now - kv.second > timeoutUs) { resent++; send(kv.first); }
+    while (!down && inFlight.size() < window && !todo.empty()) {
+      send(todo.back());
+      todo.pop_back();
+    }
+    if (!doneAt && todo.empty() && inFlight.empty()) doneAt = now;
+    return doneAt != 0;
+  }, 600000);
+  importMs = (double)(doneAt - tStart) / 1000.0;
+
+  int onBoth = 0;
+  for (auto &kv : set)
+    onBoth += fake::templateAt(kv.first, 1) == kv.second.key &&
+              fake::templateAt(kv.first, 2) == kv.second.key;
+
+  // Every student scans once on the new station and must come out by name
+  uint32_t named = 0, scans = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic != TOPIC_ATTENDANCE) return;
+    char want[32];
+    snprintf(want, sizeof(want), "Student %03d", set.at((uint16_t)jsonNum(p.payload, "id", 0)).key);
+    named += jsonStr(p.payload, "name") == want;
+  };
+  uint8_t sensor = 1;
+  for (auto &kv : set) {
+    fake::presentFinger(kv.second.key, fake::nowUs() + 100000ULL, 800, sensor);
+    sensor = sensor == 1 ? 2 : 1;
+    runFor(3000);
+    scans++;
+  }
+  // A student enrolled after provisioning gets a slot of their own
+  int fresh = enrollStudents(1, 900);
+  uint16_t freshSlot = 0;
+  for (uint16_t s = 0; s < 1000 && !freshSlot; s++)
+    if (fake::templateAt(s, 1) == 900) freshSlot = s;
+  fake::onPublish() = nullptr;
+
+  printf("[Templates] import: %zu/%zu models in %.1f s onto 2 sensors (broker cut %ld ms), "
+         "%u part messages, %u models resent, %zu failed, %u answered before their commit\n",
+         stored.size(), set.size(), importMs / 1000.0, cutMs, messages, resent, failed.size(),
+         unflashed);
+  printf("[Templates] new station: %d/%zu on both sensors, %u/%u scans named, "
+         "next enrollment → slot %u\n", onBoth, set.size(), named, scans, (unsigned)freshSlot);
+  bool ok = stored.size() == set.size() && unflashed == 0 && onBoth == (int)set.size() &&
+            named == scans && fresh == 1 && !set.count(freshSlot);
+  return ok ? 0 : 2;
+}
+
+//  Runs `fn` in a child; `out` carries a value back
+template <typename Fn>
+static int inChild(Fn fn, std::string &out) {
+  int fd[2];
+  if (pipe(fd) != 0) return 1;
+  fflush(stdout);
+  pid_t pid = fork();
+  if (pid == 0) {
+    close(fd[0]);
+    std::string data;
+    int         res = fn(data);
+    fflush(stdout);
+    for (size_t off = 0; off < data.size();) {
+      ssize_t n = write(fd[1], data.data() + off, data.size() - off);
+      if (n <= 0) { res = 1; break; }
+      off += (size_t)n;
+    }
+    _exit(res);
+  }
+  close(fd[1]);
+  char    buf[4096];
+  ssize_t n;
+  while ((n = read(fd[0], buf, sizeof(buf))) > 0) out.append(buf, (size_t)n);
+  close(fd[0]);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  return WIFEXITED(status) ? WEXITSTATUS(status) : 1;
+}
+
+static int scenarioTemplates(int argc, char **argv) {
+  std::map<uint16_t, StoredTemplate> set;
+  std::string data;
+  double      enrollMs = 0, importMs = 0;
+
+  // Station A → one line per model: slot key crc name|regNum|part0|part1
+  int rc = inChild([&](std::string &out) {
+    int res = templatesExport(argc, argv, set, enrollMs);
+    out = std::to_string(enrollMs) + "\n";
+    for (auto &kv : set) {
+      const StoredTemplate &t = kv.second;
+      out += std::to_string(kv.first) + " " + std::to_string(t.key) + " " + std::to_string(t.crc) +
+             " " + t.name + "|" + t.regNum + "|" + t.parts[0] + "|" + t.parts[1] + "\n";
+    }
+    return res;
+  }, data);
+  if (rc != 0) return rc;
+
+  size_t eol = data.find('\n');
+  enrollMs   = atof(data.substr(0, eol).c_str());
+  for (size_t a = eol + 1; a < data.size();) {
+    size_t      b    = data.find('\n', a);
+    std::string line = data.substr(a, b - a);
+    a = b + 1;
+    unsigned slot = 0;
+    int      key = 0, used = 0;
+    long     crc = 0;
+    if (sscanf(line.c_str(), "%u %d %ld %n", &slot, &key, &crc, &used) != 3) continue;
+    StoredTemplate t;
+    t.key = key;
+    t.crc = crc;
+    std::string rest = line.substr((size_t)used);
+    size_t p1 = rest.find('|'), p2 = rest.find('|', p1 + 1), p3 = rest.find('|', p2 + 1);
+    t.name     = rest.substr(0, p1);
+    t.regNum   = rest.substr(p1 + 1, p2 - p1 - 1);
+    t.parts[0] = rest.substr(p2 + 1, p3 - p2 - 1);
+    t.parts[1] = rest.substr(p3 + 1);
+    set[(uint16_t)slot] = t;
+  }
+
+  std::string ms;
+  rc = inChild([&](std::string &out) {
+    int res = templatesImport(argc, argv, set, importMs);
+    out = std::to_string(importMs);
+    return res;
+  }, ms);
+  importMs = atof(ms.c_str());
+  printf("[Templates] re-enrolling in person: %.1f s per student, %.1f min for %zu; "
+         "provisioning: %.1f s (%.0fx faster)\n", enrollMs / 1000.0,
+         enrollMs * (double)set.size() / 60000.0, set.size(), importMs / 1000.0,
+         importMs > 0 ? enrollMs * (double)set.size() / importMs : 0.0);
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  reconnect — what one broker reconnect costs, TCP to CONNACK,
+//  with the broker's TLS session cache off and on, after a broker
+//  restart, and once the cached session has expired. Then a batch
+//  whose ack is lost to a cut, with and without the persistent MQTT
+//  session that keeps it at the broker.
+// ─────────────────────────────────────────────────────────────
+//  Flaps the broker for `downMs`; returns the reconnect's time in
+//  connect() in ms, or -1 if it never came back
+static double brokerFlap(long downMs) {
+  uint32_t connects = fake::stats.mqttConnects;
+  fake::setBrokerUp(false);
+  runFor((uint32_t)downMs);
+  fake::setBrokerUp(true);
+  if (!runUntil([&] { return fake::stats.mqttConnects > connects; }, 60000)) return -1;
+  runFor(500);
+  return (double)fake::stats.lastConnectUs / 1000.0;
+}
+
+static int reconnectLostAck(int argc, char **argv, bool sessions, uint32_t &resent) {
+  long scans = argInt(argc, argv, "--scans", 6);
+  long rttMs = argInt(argc, argv, "--rtt", 400);
+  bootDevice(argc, argv, 1, [&] { fake::brokerKeepsSessions(sessions); });
+  int enrolled = enrollStudents((int)scans, 1);
+  runFor(3000);
+
+  fake::setBrokerUp(false);
+  runFor(1000);
+  uint64_t t0 = fake::nowUs();
+  for (int i = 0; i < enrolled; i++)
+    fake::presentFinger(1 + i, t0 + (uint64_t)i * 3000000ULL, 800);
+  runFor((uint32_t)(enrolled * 3000 + 2000));
+
+  // The first batch goes out and the link drops before its ack lands
+  FakeBridge bridge;
+  installBridge(bridge, (uint32_t)rttMs);
+  fake::setBrokerUp(true);
+  runUntil([&] { return bridge.batches > 0; }, 60000);
+  fake::setBrokerUp(false);
+  runFor(3000);
+  fake::setBrokerUp(true);
+  runUntil([&] {
+    return bridge.stored.size() >= (size_t)enrolled &&
+           fake::nowUs() - bridge.lastAtUs > 8000000ULL;
+  }, 600000);
+  fake::onPublish() = nullptr;
+  resent = bridge.entries - (uint32_t)bridge.stored.size();
+  return bridge.stored.size() >= (size_t)enrolled ? 0 : 2;
+}
+
+static int scenarioReconnect(int argc, char **argv) {
+  int  flaps  = (int)argInt(argc, argv, "--flaps", 8);
+  long downMs = argInt(argc, argv, "--down", 4000);
+  int  rc     = 0;
+
+  // Lost ack: each mode on a fresh station (forked before this one boots)
+  uint32_t resent[2] = {0, 0};
+  for (int s = 0; s < 2; s++) {
+    std::string out;
+    int res = inChild([&](std::string &o) {
+      uint32_t n = 0;
+      int r = reconnectLostAck(argc, argv, s == 1, n);
+      o = std::to_string(n);
+      return r;
+    }, out);
+    resent[s] = (uint32_t)strtoul(out.c_str(), nullptr, 10);
+    if (res) rc = res;
+  }
+
+  bootDevice(argc, argv);
+  double boot = (double)fake::stats.lastConnectUs / 1000.0;
+
+  std::vector<double> full, resumed;
+  fake::brokerTlsCache(false);
+  uint32_t hs0 = fake::stats.tlsHandshakes;
+  for (int i = 0; i < flaps; i++) full.push_back(brokerFlap(downMs));
+  uint32_t fullHs = fake::stats.tlsHandshakes - hs0;
+
+  fake::brokerTlsCache(true);
+  brokerFlap(downMs);   // a session for the broker to cache
+  hs0 = fake::stats.tlsHandshakes;
+  uint32_t res0 = fake::stats.tlsResumes;
+  for (int i = 0; i < flaps; i++) resumed.push_back(brokerFlap(downMs));
+  uint32_t resHs = fake::stats.tlsHandshakes - hs0, resRes = fake::stats.tlsResumes - res0;
+
+  // A restarted broker has forgotten the session: one full handshake,
+  // then resuming again
+  fake::brokerRestart();
+  hs0 = fake::stats.tlsHandshakes;
+  double afterRestart = brokerFlap(downMs);
+  uint32_t restartHs  = fake::stats.tlsHandshakes - hs0;
+  res0 = fake::stats.tlsResumes;
+  double nextAfter = brokerFlap(downMs);
+  bool   recovered = restartHs == 1 && fake::stats.tlsResumes - res0 == 1;
+
+  // Past the broker's session lifetime (counted from the full handshake)
+  runFor((fake::timing.tlsSessionLifetimeS + 5) * 1000);
+  hs0 = fake::stats.tlsHandshakes;
+  double afterExpiry = brokerFlap(downMs);
+  bool   expired     = fake::stats.tlsHandshakes - hs0 == 1;
+
+  printf("[Reconnect] boot connect: %.0f ms\n", boot);
+  printf("[Reconnect] %d flaps, no TLS cache:  p50=%.0f ms  max=%.0f ms  (%u full handshakes)\n",
+         flaps, percentile(full, 50), percentile(full, 100), fullHs);
+  printf("[Reconnect] %d flaps, TLS cache:     p50=%.0f ms  max=%.0f ms  (%u resumed, %u full)\n",
+         flaps, percentile(resumed, 50), percentile(resumed, 100), resRes, resHs);
+  printf("[Reconnect] after broker restart: %.0f ms (full), next %.0f ms%s\n", afterRestart,
+         nextAfter, recovered ? " (resumed)" : "  FAILED to resume again");
+  printf("[Reconnect] after session expiry: %.0f ms%s\n", afterExpiry,
+         expired ? " (full)" : "  EXPECTED a full handshake");
+  bool measured = std::find(full.begin(), full.end(), -1.0) == full.end() &&
+                  std::find(resumed.begin(), resumed.end(), -1.0) == resumed.end();
+  if (!measured || resRes != (uint32_t)flaps || resHs != 0 || !recovered || !expired ||
+      percentile(resumed, 50) * 4 > percentile(full, 50))
+    rc = 2;
+
+  printf("[Reconnect] batch ack lost to a cut: %u resent with a clean session, %u with a "
+         "persistent one\n", resent[0], resent[1]);
+  if (resent[1] != 0 || resent[0] == 0) rc = rc ? rc : 2;
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  metrics — per-stage histograms on fp/metrics. Known and unknown
+//  fingers, half of them with the broker down and the first replayed
+//  batch left unacked, must add up to the counters the station
+//  publishes; the console's "metrics" must print the open window;
+//  and the stage timers must stay under 1% of loop time.
+// ─────────────────────────────────────────────────────────────
+#define TOPIC_METRICS     "fp/metrics"
+#define MQTT_BUF_SIZE_SIM 512   // the firmware's MQTT_BUF_SIZE
+#define STAGE_SUM_COUNT   8
+
+//  [n, p50, p99, max] of one stage in a fp/metrics payload
+static bool metricStage(const std::string &p, const char *stage, long v[4]) {
+  std::string k = std::string("\"") + stage + "\":[";
+  size_t      a = p.find(k);
+  if (a == std::string::npos) return false;
+  const char *c = p.c_str() + a + k.size();
+  for (int i = 0; i < 4; i++) {
+    char *end;
+    v[i] = strtol(c, &end, 10);
+    c    = end + 1;
+  }
+  return true;
+}
+
+static int scenarioMetrics(int argc, char **argv) {
+  int  students = (int)argInt(argc, argv, "--students", 20);
+  int  scans    = (int)argInt(argc, argv, "--scans", 120);
+  long gapMs    = argInt(argc, argv, "--gap", 3000);
+
+  bootDevice(argc, argv);
+  if (enrollStudents(students, 1) != students) {
+    printf("[Metrics] enrollment failed\n");
+    return 1;
+  }
+  runFor(65000);   // let the enrollment window go out
+
+  std::vector<std::string> windows;
+  FakeBridge bridge;
+  installBridge(bridge, 150);
+  bool dropBatch = true;
+  auto ackBatch  = fake::onPublish();
+  fake::onPublish() = [&, ackBatch](const FakePublish &p) {
+    if (p.topic == TOPIC_METRICS) windows.push_back(p.payload);
+    if (p.topic != TOPIC_ATT_BATCH) return;
+    if (dropBatch) { dropBatch = false; return; }   // its records time out and go again
+    ackBatch(p);
+  };
+
+  // One press in five is a finger nobody enrolled
+  uint32_t hits0 = fake::searchHits(1), unknown = 0;
+  uint64_t loops = 0, v0 = fake::nowUs();
+  auto press = [&](int count) {
+    uint64_t at = fake::nowUs() + 500000ULL;
+    for (int i = 0; i < count; i++, at += (uint64_t)gapMs * 1000ULL) {
+      bool stranger = simRand() % 5 == 0;
+      unknown += stranger;
+      fake::presentFinger(stranger ? 900 + i : 1 + (int)(simRand() % (uint32_t)students), at, 800);
+    }
+    while (fake::nowUs() < at + 2000000ULL) { loop(); loops++; }
+  };
+  press(scans / 2);
+  fake::setBrokerUp(false);
+  press(scans - scans / 2);
+  uint32_t offlineTruth = fake::searchHits(1) - hits0;
+  fake::setBrokerUp(true);
+  while (windows.empty() || bridge.stored.size() < offlineTruth / 2 ||
+         fake::nowUs() - bridge.lastAtUs < 70000000ULL) {
+    loop();
+    loops++;
+  }
+  uint32_t matchTruth = fake::searchHits(1) - hits0;
+  offlineTruth        = (uint32_t)bridge.stored.size();
+  fake::onPublish()   = nullptr;
+
+  // Every window since the scans began, summed
+  long     stage[STAGE_SUM_COUNT][4] = {};
+  long     match = 0, nomatch = 0, offline = 0, syncFail = 0, seconds = 0;
+  size_t   biggest = 0;
+  static const char *const names[STAGE_SUM_COUNT] = {"loop", "image", "tz", "search",
+                                                     "clock", "publish", "commit", "connect"};
+  for (const std::string &w : windows) {
+    biggest = std::max(biggest, w.size());
+    seconds += jsonNum(w, "s", 0);
+    match   += jsonNum(w, "match", 0);
+    nomatch += jsonNum(w, "nomatch", 0);
+    offline += jsonNum(w, "offline", 0);
+    syncFail += jsonNum(w, "syncFail", 0);
+    for (int i = 0; i < STAGE_SUM_COUNT; i++) {
+      long v[4];
+      if (!metricStage(w, names[i], v)) continue;
+      stage[i][0] += v[0];
+      stage[i][1] = std::max(stage[i][1], v[1]);
+      stage[i][2] = std::max(stage[i][2], v[2]);
+      stage[i][3] = std::max(stage[i][3], v[3]);
+    }
+  }
+  printf("[Metrics] %zu windows over %ld s, largest payload %zu B (cap %d)\n", windows.size(),
+         seconds, biggest, MQTT_BUF_SIZE_SIM - 5 - 2 - (int)strlen(TOPIC_METRICS));
+  printf("[Metrics] stage     n   worst p50   worst p99    max (us)\n");
+  for (int i = 0; i < STAGE_SUM_COUNT; i++)
+    printf("[Metrics] %-7s %6ld %11ld %11ld %9ld\n", names[i], stage[i][0], stage[i][1],
+           stage[i][2], stage[i][3]);
+  printf("[Metrics] match %ld (sensor %u)  nomatch %ld (%u strangers, retried while held)  offline %ld (replayed %u)  "
+         "syncFail %ld\n", match, matchTruth, nomatch, unknown, offline, offlineTruth, syncFail);
+
+  // The console reads the open window without closing it
+  fake::serialTake();
+  fake::serialType("metrics\r\n");
+  loop();
+  std::string table = fake::serialTake();
+  size_t at = table.find("[Metrics] window");
+  if (at != std::string::npos) printf("%s", table.substr(at).c_str());
+  bool console = at != std::string::npos && table.find("  search ") != std::string::npos;
+
+  // Timer cost: host time of one StageTimer against the virtual loop pass
+  LatencyHist scratch;
+  const int   runs = 2000000;
+  auto        t0   = std::chrono::steady_clock::now();
+  for (int i = 0; i < runs; i++) {
+    uint32_t a = micros();
+    scratch.record(micros() - a + (uint32_t)(i & 0xFFFF));
+  }
+  double nsPer = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / runs;
+  long   timed = 0;
+  for (int i = 0; i < STAGE_SUM_COUNT; i++) timed += stage[i][0];
+  double passUs  = (double)(fake::nowUs() - v0) / (double)loops;
+  double perPass = (double)timed / (double)stage[0][0];
+  double pct     = perPass * nsPer / 1000.0 / passUs * 100.0;
+  printf("[Metrics] overhead: %.1f ns per timed stage (host), %.2f per pass of %.2f ms → %.4f%% "
+         "of loop time\n", nsPer, perPass, passUs / 1000.0, pct);
+
+  bool ok = !windows.empty() && biggest <= (size_t)(MQTT_BUF_SIZE_SIM - 5 - 2 - 10) &&
+            match == (long)matchTruth && nomatch >= (long)unknown &&
+            stage[3][0] == match + nomatch && offline == (long)offlineTruth && syncFail > 0 &&
+            console && pct < 1.0;
+  // Quantiles sit on the bucket edge above the true figure, within half an octave
+  ok = ok && stage[3][1] >= (long)(fake::timing.fastSearchUs * 9 / 10) &&
+       stage[3][1] <= (long)(fake::timing.fastSearchUs * 11 / 10 * 3 / 2);
+  printf("[Metrics] %s\n", ok ? "OK" : "FAIL");
+  return ok ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  commands — fleet operations on fp/cmd, each checked against what
+//  the fakes saw: poll and heartbeat intervals on an idle station, a
+//  delete (model gone from the sensor, the student no longer
+//  matches), a flush that resends an unacked batch at once, a
+//  metrics snapshot that leaves the minute window alone, and
+//  commands for another station or an unknown op.
+// ─────────────────────────────────────────────────────────────
+#define TOPIC_CMD     "fp/cmd"
+#define TOPIC_CMD_ACK "fp/cmdAck"
+
+static int scenarioCommands(int argc, char **argv) {
+  int students = (int)argInt(argc, argv, "--students", 4);
+  bootDevice(argc, argv);
+  if (enrollStudents(students, 1) != students) {
+    printf("[Commands] enrollment failed\n");
+    return 1;
+  }
+  runFor(65000);
+
+  std::vector<std::string> acks, metrics;
+  uint32_t heartbeats = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_CMD_ACK) acks.push_back(p.payload);
+    if (p.topic == TOPIC_METRICS) metrics.push_back(p.payload);
+    if (p.topic == TOPIC_HEARTBEAT) heartbeats++;
+  };
+  // Sends a command; returns its ack, "" if none came
+  auto command = [&](const std::string &json) {
+    size_t before = acks.size();
+    fake::injectMessage(TOPIC_CMD, json.c_str());
+    runUntil([&] { return acks.size() > before; }, 5000);
+    return acks.size() > before ? acks.back() : std::string();
+  };
+  // Sensor polls and heartbeats over `ms` of an empty hall
+  auto idle = [&](uint32_t ms, uint32_t &polls, uint32_t &beats) {
+    uint32_t calls0 = fake::stats.sensorCalls, beats0 = heartbeats;
+    runFor(ms);
+    polls = fake::stats.sensorCalls - calls0;
+    beats = heartbeats - beats0;
+  };
+  int rc = 0;
+  auto check = [&](bool ok, const char *what) {
+    if (!ok) {
+      printf("[Commands] FAILED: %s\n", what);
+      rc = 2;
+    }
+  };
+
+  // intervals
+  uint32_t polls0, beats0, polls1, beats1;
+  idle(120000, polls0, beats0);
+  std::string bad = command("{\"op\":\"intervals\",\"pollMs\":10}");
+  check(bad.find("\"ok\":false") != std::string::npos, "out-of-range intervals rejected");
+  std::string set = command("{\"op\":\"intervals\",\"idlePollMs\":2000,\"heartbeatMs\":10000}");
+  check(jsonNum(set, "idlePollMs", 0) == 2000 && jsonNum(set, "heartbeatMs", 0) == 10000 &&
+        jsonNum(set, "pollMs", 0) == 250, "intervals ack");
+  std::string station = jsonStr(set, "station");
+  idle(120000, polls1, beats1);
+  printf("[Commands] idle 2 min: %u sensor calls, %u heartbeats → after intervals: %u, %u\n",
+         polls0, beats0, polls1, beats1);
+  check(polls1 * 3 < polls0 && beats1 > beats0 * 2, "intervals applied");
+  std::string back = command("{\"op\":\"intervals\",\"idlePollMs\":500,\"heartbeatMs\":30000}");
+  check(back.find("\"ok\":true") != std::string::npos, "intervals restored");
+
+  // The repeat window: on, a second press a few seconds later is not sent
+  std::string rep = command("{\"op\":\"intervals\",\"repeatMs\":60000}");
+  fake::clearPublished();
+  fake::presentFinger(3, fake::nowUs() + 500000ULL, 800);
+  fake::presentFinger(3, fake::nowUs() + 5000000ULL, 800);
+  runFor(9000);
+  size_t once = 0;
+  for (const FakePublish &p : fake::published()) once += p.topic == TOPIC_ATTENDANCE;
+  std::string off = command("{\"op\":\"intervals\",\"repeatMs\":0}");
+  printf("[Commands] repeatMs 60000: %zu of 2 presses sent\n", once);
+  check(jsonNum(rep, "repeatMs", -1) == 60000 && once == 1 && jsonNum(off, "repeatMs", -1) == 0,
+        "repeat window set");
+
+  // delete; one whose commit fails keeps the student and their model
+  uint16_t kept = 0;
+  for (uint16_t s = 1; s < 200 && !kept; s++)
+    if (fake::templateAt(s) == 3) kept = s;
+  fake::eepromTearNextCommit(0);
+  std::string failed = command("{\"op\":\"delete\",\"slot\":" + std::to_string(kept) + "}");
+  printf("[Commands] delete slot %u with a failed commit: %s\n", (unsigned)kept, failed.c_str());
+  check(jsonStr(failed, "error") == "commit failed" && fake::templateAt(kept) == 3 &&
+        flashRoster().count(kept), "failed delete keeps the student");
+  uint16_t slot = 0;
+  for (uint16_t s = 1; s < 200 && !slot; s++)
+    if (fake::templateAt(s) == 2) slot = s;
+  std::string del = command("{\"op\":\"delete\",\"slot\":" + std::to_string(slot) + "}");
+  check(del.find("\"ok\":true") != std::string::npos && fake::templateAt(slot) != 2,
+        "delete removes the model");
+  uint32_t hits0 = fake::searchHits(1);
+  fake::clearPublished();
+  fake::presentFinger(2, fake::nowUs() + 500000ULL, 800);
+  fake::presentFinger(1, fake::nowUs() + 4000000ULL, 800);
+  runFor(8000);
+  size_t sent = 0;
+  for (const FakePublish &p : fake::published()) sent += p.topic == TOPIC_ATTENDANCE;
+  printf("[Commands] delete slot %u: %s; deleted student matched %u of 1, other %zu of 1\n",
+         (unsigned)slot, del.c_str(), fake::searchHits(1) - hits0 - (uint32_t)sent, sent);
+  check(sent == 1 && fake::searchHits(1) - hits0 == 1, "deleted student no longer matches");
+
+  // flush: the first batch's ack is lost; flush resends it at once
+  fake::setBrokerUp(false);
+  runFor(1000);
+  for (int i = 0; i < 3; i++)
+    fake::presentFinger(1 + (i % 2 ? 2 : 0), fake::nowUs() + 500000ULL + i * 3000000ULL, 800);
+  runFor(12000);
+  FakeBridge bridge;
+  installBridge(bridge, 150);
+  auto ackBatch  = fake::onPublish();
+  bool dropFirst = true;
+  uint64_t firstAt = 0, againAt = 0;
+  fake::onPublish() = [&, ackBatch](const FakePublish &p) {
+    if (p.topic == TOPIC_CMD_ACK) acks.push_back(p.payload);
+    if (p.topic != TOPIC_ATT_BATCH) return;
+    if (dropFirst) { dropFirst = false; firstAt = p.atUs; return; }
+    if (!againAt) againAt = p.atUs;
+    ackBatch(p);
+  };
+  fake::setBrokerUp(true);
+  runUntil([&] { return firstAt != 0; }, 30000);
+  std::string flush = command("{\"op\":\"flush\"}");
+  runUntil([&] { return againAt != 0; }, 30000);
+  printf("[Commands] flush: %s; unacked batch resent %.0f ms after it first went (ack timeout %d ms)\n",
+         flush.c_str(), againAt ? (double)(againAt - firstAt) / 1000.0 : -1.0, 5000);
+  check(jsonNum(flush, "queued", 0) > 0 && againAt && againAt - firstAt < 2000000ULL,
+        "flush resends at once");
+  runFor(10000);
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_CMD_ACK) acks.push_back(p.payload);
+    if (p.topic == TOPIC_METRICS) metrics.push_back(p.payload);
+  };
+
+  // metrics: a snapshot, then the minute window still runs its course
+  runUntil([&] { return !metrics.empty(); }, 70000);
+  runFor(20000);
+  metrics.clear();
+  std::string snap = command("{\"op\":\"metrics\"}");
+  runUntil([&] { return metrics.size() >= 2; }, 70000);
+  long snapS = metrics.size() > 0 ? jsonNum(metrics[0], "s", -1) : -1;
+  long nextS = metrics.size() > 1 ? jsonNum(metrics[1], "s", -1) : -1;
+  printf("[Commands] metrics snapshot after %ld s of the window; that window closed at %ld s\n",
+         snapS, nextS);
+  check(metrics.size() >= 2 && metrics[0].find("\"open\":true") != std::string::npos &&
+        nextS >= 59 && snapS <= nextS, "snapshot leaves the window open");
+
+  // addressing and unknown ops
+  size_t before = acks.size();
+  fake::injectMessage(TOPIC_CMD, "{\"op\":\"flush\",\"to\":\"ESP32_FP_other\"}");
+  runFor(2000);
+  bool ignored = acks.size() == before;
+  std::string mine = command("{\"op\":\"flush\",\"to\":\"" + station + "\"}");
+  std::string unknown = command("{\"op\":\"reboot\"}");
+  printf("[Commands] for another station: %s; for %s: %s; unknown: %s\n",
+         ignored ? "ignored" : "ANSWERED", station.c_str(), mine.empty() ? "no ack" : "acked",
+         unknown.c_str());
+  check(ignored && !mine.empty() && jsonStr(unknown, "error") == "unknown op", "addressing");
+
+  fake::onPublish() = nullptr;
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  slots — slot allocation across deletions. A deleted student's
+//  slot is not handed out while one of their scans is still queued
+//  (the replay would be credited to the next student enrolled into
+//  it), and is once the queue has drained. Models left on the sensor
+//  with no roster entry are counted after boot, kept out of new
+//  enrollments, listed on request and removed only by a delete; an
+//  enrollment followed at once by a power cut must still match as
+//  its student after the reboot.
+// ─────────────────────────────────────────────────────────────
+
+//  Boot 1 enrolls key 1 and loses power as soon as fp/enrolled is
+//  out, which waits for the coalesced roster commit; boot 2 (the
+//  sensor keeps its model) takes its census and scans key 1. Each
+//  boot is a child.
+static bool slotsEnrollThenCut(int argc, char **argv) {
+  std::string image;
+  inChild([&](std::string &out) {
+    bootDevice(argc, argv);
+    if (enrollStudents(1, 1) != 1) return 1;
+    bool early = false, told = false, inFlash = false;
+    for (const FakePublish &p : fake::published()) early |= p.topic == TOPIC_ENROLLED;
+    fake::onPublish() = [&](const FakePublish &p) {
+      if (p.topic != TOPIC_ENROLLED || told) return;
+      told    = true;
+      inFlash = flashRoster().count((uint16_t)jsonNum(p.payload, "id", 0)) > 0;
+    };
+    runUntil([&] { return told; }, 70000);
+    fake::onPublish() = nullptr;
+    printf("[Slots] fp/enrolled %s the enrollment, with the student %s flash\n",
+           early ? "sent AT" : "held past", inFlash ? "already in" : "NOT in");
+    fake::eepromPowerCut();
+    uint16_t slot = 0;
+    for (uint16_t s = 1; s < 1000 && !slot; s++)
+      if (fake::templateAt(s) == 1) slot = s;
+    out.assign((const char *)fake::eepromData(), fake::eepromSize());
+    out += std::to_string(told && inFlash && !early ? slot : 0);
+    return 0;
+  }, image);
+  const size_t flashSize = 4096;
+  uint16_t     slot      = image.size() > flashSize ? (uint16_t)atoi(image.c_str() + flashSize) : 0;
+
+  std::string report;
+  inChild([&](std::string &out) {
+    bootDevice(argc, argv, 1, [&] {
+      fake::eepromLoad((const uint8_t *)image.data(), flashSize);
+      if (slot) fake::storeTemplate(slot, 1);
+    });
+    runFor(30000);   // the orphan census
+    fake::clearPublished();
+    fake::presentFinger(1, fake::nowUs() + 200000ULL, 800);
+    runFor(3000);
+    std::string sent;
+    for (const FakePublish &p : fake::published())
+      if (p.topic == TOPIC_ATTENDANCE) sent = p.payload;
+    printf("[Slots] enrolled into slot %u, power cut once the bridge was told: after the reboot "
+           "the model is %s, scan sent as %s\n", (unsigned)slot,
+           fake::templateAt(slot) == 1 ? "kept" : "GONE",
+           sent.empty() ? "nothing" : jsonStr(sent, "name").c_str());
+    out = fake::templateAt(slot) == 1 && jsonStr(sent, "name") == "Student 001" ? "ok" : "fail";
+    return 0;
+  }, report);
+  return slot && report == "ok";
+}
+
+static int scenarioSlots(int argc, char **argv) {
+  bool enrollKept = slotsEnrollThenCut(argc, argv);
+
+  const uint16_t ORPHANS[] = {1, 300};
+  bootDevice(argc, argv, 1, [&] {
+    for (uint16_t slot : ORPHANS) fake::storeTemplate(slot, 900 + slot);
+  });
+  int rc = 0;
+  auto check = [&](bool ok, const char *what) {
+    if (!ok) {
+      printf("[Slots] FAILED: %s\n", what);
+      rc = 2;
+    }
+  };
+  auto slotOf = [](int key) {
+    for (uint16_t s = 1; s < 1000; s++)
+      if (fake::templateAt(s) == key) return (int)s;
+    return -1;
+  };
+  std::vector<std::string> acks;
+  auto command = [&](const std::string &json) {
+    size_t before = acks.size();
+    fake::onPublish() = [&](const FakePublish &p) {
+      if (p.topic == TOPIC_CMD_ACK) acks.push_back(p.payload);
+    };
+    fake::injectMessage(TOPIC_CMD, json.c_str());
+    runUntil([&] { return acks.size() > before; }, 5000);
+    fake::onPublish() = nullptr;
+    return acks.size() > before ? acks.back() : std::string();
+  };
+
+  // orphan census: the models stay, still match, and are listed
+  runFor(30000);
+  std::string log     = fake::serialTake();
+  size_t      at      = log.find(" orphan models kept");
+  long        counted = -1, checked = -1;
+  if (at != std::string::npos) {
+    size_t from = log.rfind(": ", at);
+    counted     = strtol(log.c_str() + from + 2, nullptr, 10);
+    sscanf(log.c_str() + at, " orphan models kept, slots 1-%ld", &checked);
+  }
+  fake::clearPublished();
+  fake::presentFinger(900 + ORPHANS[0], fake::nowUs() + 200000ULL, 800);
+  runFor(3000);
+  std::string unknown;
+  for (const FakePublish &p : fake::published())
+    if (p.topic == TOPIC_ATTENDANCE) unknown = p.payload;
+  std::string listed = command("{\"op\":\"orphans\"}");
+  printf("[Slots] orphan census: %ld models kept, slots 1-%ld checked; slots %u and %u hold "
+         "%d, %d; orphan finger sent as %s; listed %s\n", counted, checked, (unsigned)ORPHANS[0],
+         (unsigned)ORPHANS[1], fake::templateAt(ORPHANS[0]), fake::templateAt(ORPHANS[1]),
+         unknown.empty() ? "nothing" : jsonStr(unknown, "name").c_str(), listed.c_str());
+  check(counted == 2 && fake::templateAt(ORPHANS[0]) == 900 + ORPHANS[0] &&
+        fake::templateAt(ORPHANS[1]) == 900 + ORPHANS[1] && jsonStr(unknown, "name") == "Unknown",
+        "orphans kept");
+  check(checked == ORPHANS[1], "census stops at the last orphan");
+  check(jsonNum(listed, "count", -1) == 2 && listed.find("\"slots\":[1,300]") != std::string::npos,
+        "orphans listed");
+  check(enrollKept, "enrollment kept across a power cut");
+
+  if (enrollStudents(4, 1) != 4) {
+    printf("[Slots] enrollment failed\n");
+    return 1;
+  }
+  runFor(65000);
+  std::string dropped = command("{\"op\":\"delete\",\"slot\":300}");
+  listed = command("{\"op\":\"orphans\"}");
+  printf("[Slots] keys 1-4 enrolled from slot %d, slot %u still holds %d; delete of slot %u: %s, "
+         "leaving %s\n", slotOf(1), (unsigned)ORPHANS[0], fake::templateAt(ORPHANS[0]),
+         (unsigned)ORPHANS[1], dropped.c_str(), listed.c_str());
+  check(fake::templateAt(ORPHANS[0]) == 900 + ORPHANS[0] && slotOf(1) > 0, "orphan slot not reused");
+  check(dropped.find("\"ok\":true") != std::string::npos && fake::templateAt(ORPHANS[1]) < 0 &&
+        listed.find("\"slots\":[1]") != std::string::npos, "orphan removed by a delete");
+
+  // A scan of student 2 is queued and unacked when they are deleted
+  int gone = slotOf(2);
+  fake::setBrokerUp(false);
+  runFor(1000);
+  fake::presentFinger(2, fake::nowUs() + 500000ULL, 800);
+  runFor(5000);
+  fake::setBrokerUp(true);
+  runUntil([] { return fake::stats.mqttConnects > 1; }, 30000);
+  runFor(2000);
+  std::string del = command("{\"op\":\"delete\",\"slot\":" + std::to_string(gone) + "}");
+  check(del.find("\"ok\":true") != std::string::npos, "delete acked");
+  enrollStudents(1, 5);
+  int held = slotOf(5);
+
+  // Once the bridge has the scan, the slot is free again
+  FakeBridge bridge;
+  installBridge(bridge, 150);
+  runUntil([&] { return !bridge.stored.empty(); }, 30000);
+  runFor(3000);
+  fake::onPublish() = nullptr;
+  int other = slotOf(3);
+  command("{\"op\":\"delete\",\"slot\":" + std::to_string(other) + "}");
+  enrollStudents(1, 6);
+  int reused = slotOf(6);
+  runFor(65000);
+
+  fake::clearPublished();
+  fake::presentFinger(6, fake::nowUs() + 500000ULL, 800);
+  runFor(3000);
+  std::string sent;
+  for (const FakePublish &p : fake::published())
+    if (p.topic == TOPIC_ATTENDANCE) sent = p.payload;
+  printf("[Slots] slot %d deleted with a scan queued: next enrollment got %d; "
+         "after the drain and a delete of %d, %d (scan of the new student: id %ld, %s)\n",
+         gone, held, other, reused, jsonNum(sent, "id", -1), jsonStr(sent, "name").c_str());
+  check(gone > 0 && held > 0 && held != gone, "queued slot held back");
+  check(reused == gone && jsonNum(sent, "id", -1) == gone && jsonStr(sent, "name") == "Student 006",
+        "slot reused after the drain");
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  boot — power-on with a queue already waiting. The student at the
+//  front presses until welcomed (800 ms hold, 700 ms between tries)
+//  and the next steps up a second later. Verification must start
+//  within two seconds of reset whether the access point is there or
+//  not; Wi-Fi, NTP and the broker follow on the network task. Each
+//  power-on runs in its own child process.
+// ─────────────────────────────────────────────────────────────
+static int bootTrial(int argc, char **argv, long apDownMs, int students, long runMs) {
+  bootDevice(argc, argv, 1, [&] {
+    plantStudents(students);
+    if (apDownMs) fake::setLinkUp(false);
+  }, false);
+
+  uint64_t firstUs = 0, syncedUs = 0, onlineUs = 0, endUs = (uint64_t)runMs * 1000ULL;
+  uint32_t hits = fake::searchHits(1), served = 0, beforeSync = 0, live = 0;
+  int      next = 1;
+  uint64_t pressAt = fake::nowUs();
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_ONLINE && !onlineUs) onlineUs = p.atUs;
+    if (p.topic == TOPIC_ATTENDANCE) live++;
+  };
+  fake::serialTake();
+  while (fake::nowUs() < endUs) {
+    uint64_t now = fake::nowUs();
+    if (apDownMs && now >= (uint64_t)apDownMs * 1000ULL) fake::setLinkUp(true);
+    if (!syncedUs && currentEpoch()) syncedUs = now;
+    if (fake::searchHits(1) != hits) {
+      hits = fake::searchHits(1);
+      if (!firstUs) firstUs = now;
+      served++;
+      beforeSync += syncedUs == 0;
+      fake::liftFinger(1);
+      next    = next % students + 1;
+      pressAt = now + 1000000ULL;
+    } else if (now >= pressAt) {
+      fake::presentFinger(next, now, 800);
+      pressAt = now + 1500000ULL;
+    }
+    loop();
+  }
+  fake::onPublish() = nullptr;
+
+  std::string log = fake::serialTake();
+  size_t      at  = log.find("[Boot] First scan ");
+  long deviceMs   = at == std::string::npos ? -1 : strtol(log.c_str() + at + 18, nullptr, 10);
+  auto ms = [](uint64_t us) { return us ? (double)us / 1000.0 : -1.0; };
+  printf("[Boot] AP %s: first scan %.0f ms (device says %ld), NTP %.0f ms, broker %.0f ms; "
+         "%u served in %ld s, %u sent live, %u before NTP time\n",
+         apDownMs ? "down" : "up  ", ms(firstUs), deviceMs, ms(syncedUs), ms(onlineUs), served,
+         runMs / 1000, live, beforeSync);
+  return firstUs && firstUs <= 2000000ULL && deviceMs > 0 && onlineUs ? 0 : 2;
+}
+
+static int scenarioBoot(int argc, char **argv) {
+  int  students = (int)argInt(argc, argv, "--students", 20);
+  long apDownMs = argInt(argc, argv, "--ap-down", 20000);
+  long runMs    = argInt(argc, argv, "--run", 30000);
+  std::string unused;
+  int up   = inChild([&](std::string &) { return bootTrial(argc, argv, 0, students, runMs); }, unused);
+  int down = inChild([&](std::string &) { return bootTrial(argc, argv, apDownMs, students, runMs); }, unused);
+  return up ? up : down;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  backfill — scans taken before NTP time must still drain, dated
+//  to within BACKFILL_TOLERANCE_S of when they happened:
+//    ap-late   power on with the AP down, the AP returns
+//    two-boots boot 1 scans, gets NTP with the broker down and loses
+//              power; boot 2, an hour on, scans offline too and then
+//              drains both
+//    no-ntp    boot 1 never gets NTP before the cut; its scans go out
+//              undated and the queue still empties. Run again with a
+//              full sync window of them, acked in one message.
+//  Key k is enrolled in slot k, so a batch entry's slot names its scan.
+//  Boot 2 scans the students boot 1 left of the 50, at most as many.
+// ─────────────────────────────────────────────────────────────
+#define BACKFILL_TOLERANCE_S 2
+#define BACKFILL_EPOCH_BASE  1767261600L   // 2026-01-01 10:00 UTC
+#define BACKFILL_WINDOW      40            // SYNC_WINDOW_RECORDS
+
+typedef std::map<uint16_t, long> ScanTimes;   // slot → UTC second, -1 = undated
+
+//  Presents keys first.. in turn, each until it is matched, noting the
+//  true UTC second of each match
+static void scanEach(int first, int count, ScanTimes &at) {
+  for (int k = first; k < first + count; k++) {
+    uint32_t hits = fake::searchHits(1);
+    fake::presentFinger(k, fake::nowUs(), 800);
+    if (runUntil([&] { return fake::searchHits(1) != hits; }, 3000)) at[(uint16_t)k] = (long)fake::epochNow();
+    fake::liftFinger(1);
+    runFor(2500);   // welcome hold
+  }
+}
+
+//  Acks every batch and keeps the first timestamp seen per slot
+static void backfillBridge(ScanTimes &got) {
+  fake::onPublish() = [&got](const FakePublish &p) {
+    if (p.topic != TOPIC_ATT_BATCH) return;
+    std::string acks;
+    for (const char *q = strchr(p.payload.c_str(), '['); q; q = strchr(q + 1, '[')) {
+      unsigned seq, slot;
+      int      used = 0;
+      if (sscanf(q, "[%u,%u,\"%n", &seq, &slot, &used) != 2 || !used) continue;
+      std::string ts(q + used, strcspn(q + used, "\""));
+      if (!got.count((uint16_t)slot)) got[(uint16_t)slot] = ts.empty() ? -1 : (long)parseTimestamp(ts.c_str());
+      acks += (acks.empty() ? "" : ",") + std::to_string(seq);
+    }
+    fake::injectMessage(TOPIC_ATT_ACK, ("{\"acks\":[" + acks + "]}").c_str(), 150);
+  };
+}
+
+//  Boot 1 of a two-boot trial: scans with the AP down, then `ntp`
+//  brings the AP back behind a dead broker. `out` carries the flash
+//  image and the true times.
+static int backfillFirstBoot(int argc, char **argv, int scans, int students, bool ntp,
+                             std::string &out) {
+  bootDevice(argc, argv, 1, [&] {
+    plantStudents(students);
+    fake::setEpochBase(BACKFILL_EPOCH_BASE);
+    fake::setLinkUp(false);
+    fake::setBrokerUp(false);
+  }, false);
+  ScanTimes truth;
+  scanEach(1, scans, truth);
+  if (ntp) {
+    fake::setLinkUp(true);
+    runUntil([] { return currentEpoch() != 0; }, 30000);
+    runFor(2000);
+  }
+  fake::eepromPowerCut();
+  out.assign((const char *)fake::eepromData(), fake::eepromSize());
+  for (auto &kv : truth) out += std::to_string(kv.first) + " " + std::to_string(kv.second) + "\n";
+  return 0;
+}
+
+//  Counts entries against `truth`: dated within tolerance, undated,
+//  and missing or wrong
+static void backfillTally(const ScanTimes &truth, const ScanTimes &got, int &dated, int &undated,
+                          int &bad, long &worstS) {
+  for (auto &kv : truth) {
+    auto g = got.find(kv.first);
+    if (g == got.end()) { bad++; continue; }
+    if (g->second < 0) { undated++; continue; }
+    long err = labs(g->second - kv.second);
+    worstS   = std::max(worstS, err);
+    if (err <= BACKFILL_TOLERANCE_S) dated++;
+    else bad++;
+  }
+}
+
+static int scenarioBackfill(int argc, char **argv) {
+  int scans = std::min((int)argInt(argc, argv, "--scans", 12), 49);
+  int fails = 0;
+
+  // ap-late: one power-on, AP down for the first scans
+  std::string report;
+  inChild([&](std::string &out) {
+    bootDevice(argc, argv, 1, [&] {
+      plantStudents(scans);
+      fake::setLinkUp(false);
+    }, false);
+    ScanTimes truth, got;
+    scanEach(1, scans, truth);
+    backfillBridge(got);
+    fake::setLinkUp(true);
+    runUntil([&] { return got.size() >= truth.size(); }, 120000);
+    int dated = 0, undated = 0, bad = 0;
+    long worst = 0;
+    backfillTally(truth, got, dated, undated, bad, worst);
+    printf("[Backfill] ap-late:   %d scans before NTP, %d dated (worst %ld s), %d undated, %d bad\n",
+           (int)truth.size(), dated, worst, undated, bad);
+    out = dated == scans ? "ok" : "fail";
+    return 0;
+  }, report);
+  fails += report != "ok";
+
+  // (ntp, boot 1 scans); boot 2 scans the students left of the 50
+  std::vector<std::pair<bool, int>> trials = {{true, scans}, {false, scans}};
+  if (scans != BACKFILL_WINDOW) trials.push_back({false, BACKFILL_WINDOW});
+  for (auto &trial : trials) {
+    bool        ntp    = trial.first;
+    int         scans1 = trial.second, scans2 = std::min(scans1, 50 - scans1);
+    std::string image;
+    inChild([&](std::string &out) {
+      return backfillFirstBoot(argc, argv, scans1, scans1 + scans2, ntp, out);
+    }, image);
+    const size_t flashSize = 4096;
+    if (image.size() < flashSize) { fails++; continue; }
+    ScanTimes truth1;
+    std::istringstream lines(image.substr(flashSize));
+    for (long slot, at; lines >> slot >> at;) truth1[(uint16_t)slot] = at;
+
+    report.clear();
+    inChild([&](std::string &out) {
+      bootDevice(argc, argv, 1, [&] {
+        fake::eepromLoad((const uint8_t *)image.data(), flashSize);
+        plantStudents(scans1 + scans2);
+        fake::setEpochBase(BACKFILL_EPOCH_BASE + 3600);
+        fake::setLinkUp(false);
+      }, false);
+      ScanTimes truth2, got;
+      scanEach(scans1 + 1, scans2, truth2);
+      backfillBridge(got);
+      fake::setLinkUp(true);
+      runUntil([&] { return got.size() >= truth1.size() + truth2.size(); }, 120000);
+      runFor(2000);    // the last acks land
+      fake::serialTake();
+      runFor(10000);   // nothing may be left to send
+      int d1 = 0, u1 = 0, b1 = 0, d2 = 0, u2 = 0, b2 = 0;
+      long worst = 0;
+      backfillTally(truth1, got, d1, u1, b1, worst);
+      backfillTally(truth2, got, d2, u2, b2, worst);
+      size_t left = fake::serialTake().find("[Sync] Syncing");
+      printf("[Backfill] %s %2d scans, boot 1: %d dated, %d undated, %d bad; boot 2: %d dated, "
+             "%d bad (worst %ld s)%s\n", ntp ? "two-boots:" : "no-ntp:   ", scans1, d1, u1, b1, d2, b2, worst,
+             left == std::string::npos ? "" : ", scans left behind");
+      bool ok = d2 == scans2 && b1 == 0 && (ntp ? d1 == scans1 : u1 == scans1) && left == std::string::npos;
+      out = ok ? "ok" : "fail";
+      return 0;
+    }, report);
+    fails += report != "ok";
+  }
+  return fails ? 2 : 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  roster — versioned roster deltas from the bridge's change log.
+//  A station enrolled offline from the bridge catches up from v0,
+//  takes live renames and deletes, catches up after an outage in one
+//  message, and then has its delta commits torn at random. Whenever
+//  it announces a version, every slot the log last changed at or
+//  before that version must read back from flash as the log has it.
+// ─────────────────────────────────────────────────────────────
+#define TOPIC_ROSTER_VER   "fp/rosterVersion"
+#define TOPIC_ROSTER_DELTA "fp/rosterDelta"
+
+struct RosterEntry {
+  uint16_t    slot    = 0;
+  bool        deleted = false;
+  std::string name, regNum;
+};
+
+//  The bridge's change log with its collapse-and-pack (server.js)
+struct FakeRosterLog {
+  std::vector<RosterEntry> log;   // log[v - 1] is change v
+
+  uint32_t version() const { return (uint32_t)log.size(); }
+
+  RosterView viewAt(uint32_t v) const {
+    RosterView view;
+    for (uint32_t i = 0; i < v && i < log.size(); i++) {
+      if (log[i].deleted) view.erase(log[i].slot);
+      else view[log[i].slot] = {log[i].name, log[i].regNum};
+    }
+    return view;
+  }
+
+  static size_t entryBytes(const RosterEntry &e) {
+    return (e.deleted ? std::to_string(e.slot).size()
+                      : std::to_string(e.slot).size() + e.name.size() + e.regNum.size() + 8) + 1;
+  }
+
+  std::vector<std::string> delta(uint32_t from) const {
+    std::string head = "{\"from\":" + std::to_string(from) + ",\"to\":";
+    if (from > version()) return {head + "0,\"part\":0,\"of\":1,\"up\":[],\"del\":[]}"};
+    std::map<uint16_t, const RosterEntry *> slots;
+    for (uint32_t v = from + 1; v <= version(); v++) slots[log[v - 1].slot] = &log[v - 1];
+
+    struct Part { std::string up, del; size_t n = 0, bytes = 80; };
+    std::vector<Part> parts;
+    for (auto &kv : slots) {
+      const RosterEntry &e = *kv.second;
+      size_t n = entryBytes(e);
+      if (parts.empty() || parts.back().n == 12 || parts.back().bytes + n > 480) parts.emplace_back();
+      Part        &p   = parts.back();
+      std::string &out = e.deleted ? p.del : p.up;
+      if (!out.empty()) out += ",";
+      out += e.deleted ? std::to_string(e.slot)
+                       : "[" + std::to_string(e.slot) + ",\"" + e.name + "\",\"" + e.regNum + "\"]";
+      p.n++;
+      p.bytes += n;
+    }
+    if (parts.empty()) parts.emplace_back();
+    std::vector<std::string> out;
+    for (size_t i = 0; i < parts.size(); i++)
+      out.push_back(head + std::to_string(version()) + ",\"part\":" + std::to_string(i) +
+                    ",\"of\":" + std::to_string(parts.size()) + ",\"up\":[" + parts[i].up +
+                    "],\"del\":[" + parts[i].del + "]}");
+    return out;
+  }
+
+  //  Slots last changed at or before v hold their state at v
+  bool heldBy(uint32_t v, const RosterView &station) const {
+    std::map<uint16_t, uint32_t> last;
+    for (uint32_t i = 0; i < log.size(); i++) last[log[i].slot] = i + 1;
+    RosterView want = viewAt(v);
+    for (auto &kv : last) {
+      if (kv.second > v) continue;
+      auto w = want.find(kv.first);
+      auto s = station.find(kv.first);
+      if ((w == want.end()) != (s == station.end())) return false;
+      if (w != want.end() && w->second != s->second) return false;
+    }
+    return true;
+  }
+};
+
+static int scenarioRoster(int argc, char **argv) {
+  int  students = (int)argInt(argc, argv, "--students", 20);
+  int  trials   = (int)argInt(argc, argv, "--trials", 200);
+  long rttMs    = argInt(argc, argv, "--rtt", 150);
+
+  bootDevice(argc, argv);
+  int enrolled = enrollStudents(students, 1);
+  if (enrolled != students) {
+    printf("[Roster] enrollment failed\n");
+    return 1;
+  }
+  runFor(12000);   // roster commit
+
+  // The bridge logged each fp/enrolled; the station has never synced
+  FakeRosterLog log;
+  char name[32], reg[32];
+  for (int k = 1; k <= students; k++) {
+    RosterEntry e;
+    e.slot = (uint16_t)k;
+    snprintf(name, sizeof(name), "Student %03d", k);
+    snprintf(reg, sizeof(reg), "EG/2026/%04d", k);
+    e.name   = name;
+    e.regNum = reg;
+    log.log.push_back(e);
+  }
+
+  long     held = -1;
+  uint32_t deltas = 0, rejects = 0, violations = 0, atZero = 0;
+  uint64_t bytes = 0;
+  auto send = [&](uint32_t from) {
+    for (const std::string &d : log.delta(from)) {
+      deltas++;
+      bytes += d.size();
+      fake::injectMessage(TOPIC_ROSTER_DELTA, d.c_str(), (uint32_t)rttMs);
+    }
+  };
+  // The bridge answers every announce with what the station lacks
+  auto bridge = [&](const FakePublish &p) {
+    if (p.topic != TOPIC_ROSTER_VER) return;
+    held = jsonNum(p.payload, "v", -1);
+    if (p.payload.find("\"error\"") != std::string::npos) { rejects++; return; }
+    if (held == 0) atZero++;
+    else if (!log.heldBy((uint32_t)held, flashRoster())) violations++;
+    if ((uint32_t)held != log.version()) send((uint32_t)held);
+  };
+  fake::onPublish() = bridge;
+  auto current = [&] { return held == (long)log.version(); };
+  // Dashboard edits: appended to the log and broadcast from the old head
+  auto edit = [&](const std::vector<RosterEntry> &changes, bool broadcast) {
+    uint32_t from = log.version();
+    for (const RosterEntry &e : changes) log.log.push_back(e);
+    if (broadcast) send(from);
+  };
+  auto rename = [&](int slot, int tag) {
+    RosterEntry e;
+    e.slot = (uint16_t)slot;
+    snprintf(name, sizeof(name), "Renamed %03d-%d", slot, tag);
+    snprintf(reg, sizeof(reg), "EG/2027/%04d", slot);
+    e.name   = name;
+    e.regNum = reg;
+    return e;
+  };
+  auto remove = [&](int slot) {
+    RosterEntry e;
+    e.slot    = (uint16_t)slot;
+    e.deleted = true;
+    return e;
+  };
+  auto reconnect = [&](uint32_t downMs) {
+    fake::setBrokerUp(false);
+    runFor(downMs);
+    fake::setBrokerUp(true);
+  };
+
+  // 1. First sync: the whole log from v0
+  uint64_t t0 = fake::nowUs();
+  reconnect(2000);
+  runUntil(current, 30000);
+  printf("[Roster] first sync v0→v%u: %u parts, %llu B, %.1f s incl. reconnect\n", log.version(),
+         deltas, (unsigned long long)bytes, (double)(fake::nowUs() - t0) / 1e6);
+  bool ok = current();
+
+  // 2. Live: three renames and two deletes while online
+  deltas = 0;
+  bytes  = 0;
+  t0     = fake::nowUs();
+  edit({rename(3, 1), rename(7, 1), rename(11, 1), remove(5), remove(9)}, true);
+  runUntil(current, 30000);
+  printf("[Roster] live edit v%u: %u delta, %llu B, applied in %.0f ms\n", log.version(), deltas,
+         (unsigned long long)bytes, (double)(fake::nowUs() - t0) / 1000.0);
+  ok = ok && current();
+
+  RosterView want = log.viewAt(log.version());
+  uint32_t   named = 0, wrong = 0;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic != TOPIC_ATTENDANCE) return;
+    auto w = want.find((uint16_t)jsonNum(p.payload, "id", 0));
+    if (w != want.end() && jsonStr(p.payload, "name") == w->second.first) named++;
+    else wrong++;
+  };
+  for (int k = 1; k <= students; k++) {
+    fake::presentFinger(k, fake::nowUs() + 100000ULL, 800);
+    runFor(3000);
+  }
+  printf("[Roster] scans after edit: %u/%zu named as the dashboard has them, %u wrong or unmatched "
+         "(deleted slots must not match)\n", named, want.size(), wrong);
+  ok = ok && named == want.size() && wrong == 0;
+
+  // 3. Offline: changes pile up, one message on reconnect
+  fake::onPublish() = bridge;
+  deltas = 0;
+  bytes  = 0;
+  fake::setBrokerUp(false);
+  runFor(5000);
+  for (int s : {1, 2, 4, 6, 8, 10}) edit({rename(s, 2)}, false);
+  edit({remove(12), rename(5, 2)}, false);
+  held = -1;
+  t0   = fake::nowUs();
+  fake::setBrokerUp(true);
+  runUntil(current, 30000);
+  size_t fullBytes = 0, fullMsgs = 0;
+  for (const std::string &d : log.delta(0)) {
+    fullBytes += d.size();
+    fullMsgs++;
+  }
+  printf("[Roster] catch-up after outage, %d changes: %u message, %llu B, current %.1f s after "
+         "the broker returned (full reload: %zu messages, %zu B)\n", 8, deltas,
+         (unsigned long long)bytes, (double)(fake::nowUs() - t0) / 1e6, fullMsgs, fullBytes);
+  ok = ok && current() && deltas == 1;
+
+  // 4. Torn commits: every delta commit loses power part way
+  ok     = ok && violations == 0 && rejects == 0;
+  deltas = atZero = 0;
+  int converged = 0;
+  for (int t = 0; t < trials; t++) {
+    std::vector<RosterEntry> changes;
+    std::set<int>            picked;
+    RosterView               now = log.viewAt(log.version());
+    int n = 1 + (int)(simRand() % 3);
+    while ((int)changes.size() < n) {
+      int slot = 1 + (int)(simRand() % students);
+      if (!picked.insert(slot).second) continue;
+      changes.push_back(now.count((uint16_t)slot) && simRand() % 3 == 0 ? remove(slot) : rename(slot, (int)(simRand() % 100000)));
+    }
+    fake::eepromTearNextCommit(simRand() % 24);   // a delta changes ~5-40 bytes
+    edit(changes, true);
+    converged += runUntil(current, 30000);
+    if (!log.heldBy(log.version(), flashRoster()) || flashRoster() != log.viewAt(log.version()))
+      violations++;
+  }
+  printf("[Roster] torn commits: %d/%d trials converged, %u reloads from v0, %u parts resent, "
+         "%u stamps that did not match their version, %u rejected\n", converged, trials, atZero,
+         deltas - (uint32_t)trials, violations, rejects);
+  ok = ok && converged == trials && violations == 0 && rejects == 0;
+
+  // 5. A delete whose commit fails: the entry flash brings back keeps its model
+  uint16_t victim = log.viewAt(log.version()).begin()->first;
+  fake::storeTemplate(victim, 99);   // trials above cleared most models
+  int rowBack = -1, modelBack = -1;
+  fake::onPublish() = [&](const FakePublish &p) {
+    if (p.topic == TOPIC_ROSTER_VER && rowBack < 0) {   // the announce after the failed commit
+      rowBack   = (int)flashRoster().count(victim);
+      modelBack = fake::templateAt(victim) >= 0;
+    }
+    bridge(p);
+  };
+  fake::eepromTearNextCommit(0);
+  edit({remove(victim)}, true);
+  bool deleted = runUntil(current, 30000);
+  printf("[Roster] delete with a failed commit: slot %u back in flash %s its model; "
+         "gone from both once resent: %s\n", (unsigned)victim, modelBack == 1 ? "with" : "WITHOUT",
+         deleted && !flashRoster().count(victim) && fake::templateAt(victim) < 0 ? "yes" : "NO");
+  ok = ok && rowBack == 1 && modelBack == 1 && deleted && !flashRoster().count(victim) &&
+       fake::templateAt(victim) < 0;
+  fake::onPublish() = nullptr;
+  return ok ? 0 : 2;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  upgrade — power-on over flash written by the firmware before the
+//  offline journal: one-byte roster slots and a flat queue of full
+//  records with ISO timestamps. The students must still be recognised
+//  and every queued scan must reach the bridge, at its true time or,
+//  stamped before NTP, undated. A roster delta then names a slot above
+//  255 and both flash and the scan of its model must carry it whole.
+// ─────────────────────────────────────────────────────────────
+#define LEGACY_RECORD  36                                   // slot (1 B), name[20], regNum[15]
+#define LEGACY_QUEUE   (1 + 50 * LEGACY_RECORD)             // [count][record × 30]
+#define LEGACY_SCAN    (LEGACY_RECORD + 26)                 // ... timestamp[26]
+
+//  Keys 1..students in slots 1..; keys 1..scans queued a minute apart
+//  from `base`, the even ones stamped before NTP as that firmware did
+static void plantLegacyStation(int students, int scans, long base) {
+  std::string image((const char *)fake::eepromData(), fake::eepromSize());
+  image.resize(EEPROM_SIZE, '\0');
+  auto record = [&](char *r, int k) {
+    r[0] = (char)k;
+    putStudent(r + 1, r + 21, k);
+  };
+  image[0] = (char)students;
+  for (int k = 1; k <= students; k++) {
+    fake::storeTemplate((uint16_t)k, k);
+    record(&image[1 + (k - 1) * LEGACY_RECORD], k);
+  }
+  image[LEGACY_QUEUE] = (char)scans;
+  for (int k = 1; k <= scans; k++) {
+    char *r = &image[LEGACY_QUEUE + 1 + (k - 1) * LEGACY_SCAN];
+    record(r, k);
+    time_t local = (time_t)(base + k * 60 + 19800);   // IST, as the station stamped it
+    struct tm tm;
+    gmtime_r(&local, &tm);
+    char ts[32] = "1970-01-01T00:00:00+05:30";
+    if (k % 2) strftime(ts, sizeof(ts), "%Y-%m-%dT%H:%M:%S+05:30", &tm);
+    memcpy(r + LEGACY_RECORD, ts, strlen(ts) + 1);
+  }
+  fake::eepromLoad((const uint8_t *)image.data(), image.size());
+}
+
+static int scenarioUpgrade(int argc, char **argv) {
+  int  students = 3, scans = 6;
+  long base     = BACKFILL_EPOCH_BASE;
+  int  rc       = 0;
+  auto check = [&](bool ok, const char *what) {
+    if (!ok) {
+      printf("[Upgrade] FAILED: %s\n", what);
+      rc = 2;
+    }
+  };
+
+  ScanTimes got;
+  bootDevice(argc, argv, 1, [&] {
+    plantLegacyStation(students, scans, base);
+    fake::setEpochBase(base + 3600);
+    backfillBridge(got);
+  }, false);
+  std::string log = fake::serialTake();
+  runUntil([&] { return (int)got.size() >= scans; }, 60000);
+  int atTime = 0;
+  for (int k = 1; k <= scans; k++)
+    if (got.count((uint16_t)k) && got[(uint16_t)k] == (k % 2 ? base + k * 60 : -1)) atTime++;
+  RosterView roster = flashRoster();
+  int  named = 0;
+  char name[32];
+  for (int k = 1; k <= students; k++) {
+    snprintf(name, sizeof(name), "Student %03d", k);
+    if (roster.count((uint16_t)k) && roster[(uint16_t)k].first == name) named++;
+  }
+  printf("[Upgrade] %d/%d students carried over, %d/%d queued scans sent at their time or undated%s\n", named,
+         students, atTime, scans, log.find("Layout migrated") != std::string::npos ? "" : " (no migration logged)");
+  check(named == students && (int)roster.size() == students, "roster carried over");
+  check(atTime == scans, "queued scans carried over");
+
+  fake::onPublish() = nullptr;
+  fake::injectMessage(TOPIC_ROSTER_DELTA,
+                      "{\"from\":0,\"to\":1,\"part\":0,\"of\":1,"
+                      "\"up\":[[700,\"Student 700\",\"EG/2026/0700\"]],\"del\":[]}", 150);
+  runFor(65000);   // roster commit; the orphan census is long done
+  fake::storeTemplate(700, 9);
+  fake::clearPublished();
+  fake::presentFinger(9, fake::nowUs() + 500000ULL, 800);
+  runFor(3000);
+  std::string sent;
+  for (const FakePublish &p : fake::published())
+    if (p.topic == TOPIC_ATTENDANCE) sent = p.payload;
+  roster = flashRoster();
+  printf("[Upgrade] slot 700 in flash: %s; its scan: id %ld, %s\n",
+         roster.count(700) ? roster[700].first.c_str() : "missing", jsonNum(sent, "id", -1),
+         jsonStr(sent, "name").c_str());
+  check(roster.count(700) && roster[700].first == "Student 700", "slot 700 in flash");
+  check(jsonNum(sent, "id", -1) == 700 && jsonStr(sent, "name") == "Student 700", "slot 700 scanned");
+  return rc;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  journal — random appends/acks on an EepromJournal with commits
+//  torn at random byte counts (power cut mid-write). After every
+//  cut the journal is reloaded and must hold exactly the committed
+//  records, uncorrupted and in FIFO order.
+// ─────────────────────────────────────────────────────────────
+struct JournalTestRec {
+  uint32_t value;
+  char     text[24];
+};
+
+static int scenarioJournal(int argc, char **argv) {
+  typedef EepromJournal<sizeof(JournalTestRec), 30> TestJournal;
+  long ops = argInt(argc, argv, "--ops", 20000);
+  seedSim(argc, argv);
+  fake::eepromWipe();
+  EEPROM.begin(4096);
+
+  static TestJournal j;
+  if (!j.begin(64)) j.format();
+
+  std::map<uint32_t, uint32_t> committed;   // seq → value, durable state
+  std::map<uint32_t, uint32_t> ackedDirty;  // acked but not yet flushed
+  uint32_t nextValue = 1, cuts = 0, appends = 0, acks = 0;
+  uint64_t appendBytes = 0, ackBytes = 0;
+
+  auto makeRec = [](uint32_t v) {
+    JournalTestRec r;
+    memset(&r, 0, sizeof(r));
+    r.value = v;
+    snprintf(r.text, sizeof(r.text), "record-%08u", v);
+    return r;
+  };
+
+  for (long op = 0; op < ops; op++) {
+    bool tear = (simRand() % 50) == 0;
+    if (tear) fake::eepromTearNextCommit(simRand() % (TestJournal::SLOT_SIZE + 4));
+    uint32_t r = simRand() % 100;
+
+    if (r < 55 && !j.full()) {
+      JournalTestRec rec = makeRec(nextValue);
+      uint32_t       seq = 0;
+      uint64_t       b0  = fake::stats.eepromBytes;
+      bool ok = j.append(&rec);
+      appendBytes += fake::stats.eepromBytes - b0;
+      appends++;
+      if (ok) {
+        for (uint16_t s = j.first(); s != JOURNAL_SLOT_NONE; s = j.next(s)) seq = j.seqAt(s);
+        committed[seq] = nextValue;
+        for (auto &kv : ackedDirty) committed.erase(kv.first);   // commit flushed them too
+        ackedDirty.clear();
+      }
+      nextValue++;
+    } else if (r < 90 && j.count() > 0) {
+      uint16_t s  = j.first();
+      uint64_t b0 = fake::stats.eepromBytes;
+      ackedDirty[j.seqAt(s)] = 1;
+      j.ack(s);
+      ackBytes += fake::stats.eepromBytes - b0;
+      acks++;
+    } else {
+      if (j.flush()) {
+        for (auto &kv : ackedDirty) committed.erase(kv.first);
+        ackedDirty.clear();
+      }
+    }
+
+    if (!tear) continue;
+    // Power cut: tear whatever is still unflushed, drop the RAM cache
+    // and check the invariants on the reloaded journal
+    j.flush();
+    fake::eepromPowerCut();
+    cuts++;
+    EEPROM.begin(4096);
+    if (!j.begin(64)) {
+      printf("[Journal] FAIL header lost after cut %u\n", cuts);
+      return 1;
+    }
+    uint32_t lastSeq = 0;
+    std::map<uint32_t, uint32_t> seen;
+    for (uint16_t s = j.first(); s != JOURNAL_SLOT_NONE; s = j.next(s)) {
+      JournalTestRec rec;
+      j.read(s, &rec);
+      JournalTestRec want = makeRec(rec.value);
+      if (memcmp(&rec, &want, sizeof(rec)) != 0 || j.seqAt(s) <= lastSeq) {
+        printf("[Journal] FAIL corrupt or out-of-order record at slot %u\n", s);
+        return 1;
+      }
+      lastSeq = j.seqAt(s);
+      seen[lastSeq] = rec.value;
+    }
+    // Everything committed must survive; acks that were never flushed
+    // may reappear; only the torn append may be the extra record.
+    for (auto &kv : committed) {
+      if (!seen.count(kv.first) && !ackedDirty.count(kv.first)) {
+        printf("[Journal] FAIL lost committed seq %u after cut %u\n", kv.first, cuts);
+        return 1;
+      }
+    }
+    if (seen.size() > committed.size() + 1) {
+      printf("[Journal] FAIL phantom records after cut %u\n", cuts);
+      return 1;
+    }
+    committed = seen;
+    ackedDirty.clear();
+  }
+
+  printf("[Journal] ops=%ld appends=%u acks=%u powerCuts=%u  OK\n", ops, appends, acks, cuts);
+  printf("[Journal] bytes written: %.1f per append, %.1f per ack (slot=%u B)\n",
+         appends ? (double)appendBytes / appends : 0.0,
+         acks ? (double)ackBytes / acks : 0.0, (unsigned)TestJournal::SLOT_SIZE);
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  spsc — two real threads hammer a SpscQueue of the firmware's
+//  size. Every item carries its sequence number and a payload
+//  derived from it, so a lost, duplicated, reordered or torn item
+//  is caught. Runs on wall-clock time, not the virtual clock.
+// ─────────────────────────────────────────────────────────────
+struct SpscStressItem {
+  uint32_t seq;
+  uint32_t words[17];   // about the size of a NetEvent
+};
+
+static int scenarioSpsc(int argc, char **argv) {
+  static SpscQueue<SpscStressItem, 32> q;
+  uint32_t items = (uint32_t)argInt(argc, argv, "--items", 5000000);
+  uint32_t seed  = (uint32_t)argInt(argc, argv, "--seed", 1);
+  uint64_t fullSpins = 0, emptySpins = 0;
+  uint32_t bad = 0, badSeq = 0;
+
+  auto fill = [](SpscStressItem &it, uint32_t seq) {
+    it.seq = seq;
+    for (uint32_t w = 0; w < 17; w++) it.words[w] = seq * 2654435761u + w;
+  };
+
+  std::thread producer([&] {
+    uint32_t r = seed | 1;
+    SpscStressItem it;
+    for (uint32_t seq = 0; seq < items; seq++) {
+      fill(it, seq);
+      while (!q.push(it)) { fullSpins++; std::this_thread::yield(); }
+      r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+      if ((r & 0xFF) == 0) std::this_thread::yield();   // uneven bursts
+    }
+  });
+  std::thread consumer([&] {
+    uint32_t r = (seed * 7) | 1;
+    SpscStressItem it, want;
+    for (uint32_t seq = 0; seq < items; seq++) {
+      while (!q.pop(it)) { emptySpins++; std::this_thread::yield(); }
+      fill(want, seq);
+      if (memcmp(&it, &want, sizeof(it)) != 0 && !bad++) badSeq = seq;
+      r ^= r << 13; r ^= r >> 17; r ^= r << 5;
+      if ((r & 0xFF) == 0) std::this_thread::yield();
+    }
+  });
+  producer.join();
+  consumer.join();
+
+  if (bad || !q.empty()) {
+    printf("[SPSC] FAIL %u bad items (first at seq %u), %u left in queue\n",
+           bad, badSeq, (unsigned)q.size());
+    return 1;
+  }
+  printf("[SPSC] items=%u  full spins=%llu  empty spins=%llu  OK\n", items,
+         (unsigned long long)fullSpins, (unsigned long long)emptySpins);
+  return 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  Scenario table
+// ─────────────────────────────────────────────────────────────
+struct Scenario {
+  const char *name;
+  const char *help;
+  int (*run)(int argc, char **argv);
+};
+
+static const Scenario scenarios[] = {
+  {"bench",   "scan→publish latency  [--scans N] [--roster N] [--gap ms]", scenarioBench},
+  {"offline", "queue while broker down, then drain  [--scans N] [--gap ms] [--hold ms] [--rtt ms] [--cut-after N] [--cut-ms ms]", scenarioOffline},
+  {"flap",    "scan throughput while the link flaps  [--duration ms] [--period ms] [--down ms] [--gap ms] [--broker]", scenarioFlap},
+  {"enroll",  "slow and cancelled enrollment  [--think ms] [--cancel ms]", scenarioEnroll},
+  {"soak",    "heap allocations and telemetry over a long run  [--scans N] [--roster N] [--gap ms]", scenarioSoak},
+  {"clock",   "timestamp cost and clock drift between resyncs  [--calls N] [--hours N]", scenarioClock},
+  {"liveness", "heartbeat and /status traffic, offline detection  [--gap ms] [--status-ms ms]", scenarioLiveness},
+  {"capture", "arrival→match under scripted arrivals  [--pattern queue|sparse]", scenarioCapture},
+  {"multi",   "scans/min with one and two sensors under a rush  [--duration ms] [--react ms] [--walk ms]", scenarioMulti},
+  {"repeats", "double presses: welcomed, sent once  [--students N] [--rtt ms] [--repeat-window ms]", scenarioRepeats},
+  {"commands", "fp/cmd operations: intervals, delete, flush, metrics snapshot, addressing  [--students N]", scenarioCommands},
+  {"slots",   "slot reuse after deletes with scans queued, orphan model census", scenarioSlots},
+  {"boot",    "power-on with a queue waiting: time to the first scan, AP up and down  [--students N] [--ap-down ms] [--run ms]", scenarioBoot},
+  {"backfill", "scans before NTP time dated once it arrives, across reboots  [--scans N]", scenarioBackfill},
+  {"templates", "export a station's models, provision a new one from them  [--students N] [--rtt ms] [--cut-ms ms]", scenarioTemplates},
+  {"roster",  "roster deltas: first sync, live edits, outage catch-up, torn commits  [--students N] [--trials N] [--rtt ms]", scenarioRoster},
+  {"upgrade", "power-on over the one-byte-slot layout: roster and queued scans kept, slots above 255", scenarioUpgrade},
+  {"reconnect", "reconnect cost with TLS resumption, lost acks with a persistent session  [--flaps N] [--down ms] [--scans N] [--rtt ms]", scenarioReconnect},
+  {"metrics", "stage histograms and counters on fp/metrics, serial query, overhead  [--students N] [--scans N] [--gap ms]", scenarioMetrics},
+  {"journal", "offline journal under torn writes  [--ops N]", scenarioJournal},
+  {"spsc",    "sensor→network queue under two real threads  [--items N]", scenarioSpsc},
+};
+
+int main(int argc, char **argv) {
+  const char *name = argc > 1 ? argv[1] : "bench";
+  for (const Scenario &s : scenarios)
+    if (strcmp(s.name, name) == 0) return s.run(argc, argv);
+
+  printf("usage: %s <scenario> [--seed N] [--verbose]\n", argv[0]);
+  for (const Scenario &s : scenarios) printf("  %-12s %s\n", s.name, s.help);
+  return 1;
+}
@@ -3,33 +3,130 @@
 #include <Adafruit_Fingerprint.h>
 #include <HardwareSerial.h>
 #include <WiFi.h>
-#include <WiFiClientSecure.h>
 #include <PubSubClient.h>
 #include <ArduinoJson.h>
 #include "time.h"
 #include "esp_sntp.h"
 #include "secrets.h"
 #include <EEPROM.h>
+#include "eeprom_journal.h"
+#include "spsc_queue.h"
+#include "oled_canvas.h"
+#include "time_anchor.h"
+#include "fp_template.h"
+#include "latency_hist.h"
+#include "resumable_tls.h"
 
 //  OLED
 #define SCREEN_WIDTH  128
 #define SCREEN_HEIGHT 128
-Adafruit_SH1107 display(SCREEN_WIDTH, SCREEN_HEIGHT, &Wire);
+OledCanvas<SCREEN_WIDTH, SCREEN_HEIGHT> display(&Wire);
 
-int16_t  tx1, ty1;
-uint16_t tw, th;
-String   bottomMsg  = "Waiting...";
+#define BOTTOM_MSG_LEN 48
+char     bottomMsg[BOTTOM_MSG_LEN] = "Waiting...";
 unsigned long lastTopUpdate = 0;
 
-//  AS608
-HardwareSerial mySerial(1);
-#define RX_PIN 18
-#define TX_PIN 19
-Adafruit_Fingerprint finger(&mySerial);
+// What the bottom half currently shows, so an unchanged redraw is
+// skipped before any drawing. BOTTOM_OTHER: the progress bar or
+// anything else drew over it.
+enum BottomView : uint8_t { BOTTOM_OTHER, BOTTOM_MESSAGE, BOTTOM_STATE };
+BottomView bottomView    = BOTTOM_OTHER;
+int16_t    bottomOffline = -1;   // "Offline: N" shown, -1 = hidden
+bool       topDrawn      = false;
+
+//  LEDs (one pair per sensor)
+#define GREEN_LED   2
+#define RED_LED     4
+#define GREEN_LED_2 25
+#define RED_LED_2   26
+
+//  AS608 sensors. One controller serves a queue per sensor: each
+//  port has its own capture state machine (see VERIFICATION) and
+//  they share the roster, netQueue and the display. A port whose
+//  AS608 does not answer at boot is left unused. Enrollment runs on
+//  the first sensor and copies the template to the others.
+#define FP_SENSOR_PORTS 2
+
+// AS608 touch output (TOUCH/WAKEUP, high while a finger rests on the
+// window). Build with -DFP_TOUCH_PIN=<gpio> (FP2_TOUCH_PIN for the
+// second sensor) when it is wired: that sensor is then only read
+// after the line goes high. Without it getImage() is polled at a
+// rate that follows the arrivals at that sensor:
+//   queue   (two fingers within CAPTURE_BUSY_GAP_MS) → CAPTURE_POLL_FAST_MS
+//   recent  (a finger within CAPTURE_IDLE_AFTER_MS)  → capturePollMs
+//   idle    (empty hall)                             → capturePollIdleMs
+// The last two default to CAPTURE_POLL_MS and CAPTURE_POLL_IDLE_MS and
+// can be changed remotely (see COMMANDS).
+#ifndef FP_TOUCH_PIN
+#define FP_TOUCH_PIN  -1
+#endif
+#ifndef FP2_TOUCH_PIN
+#define FP2_TOUCH_PIN -1
+#endif
+#define CAPTURE_POLL_FAST_MS   50
+#define CAPTURE_POLL_MS        250
+#define CAPTURE_POLL_IDLE_MS   500
+#define CAPTURE_POLL_MAX_MS    2000    // fp/cmd "intervals" limits
+#define CAPTURE_POLL_IDLE_MAX_MS 5000
+#define CAPTURE_BUSY_GAP_MS    10000
+#define CAPTURE_IDLE_AFTER_MS  60000
+#define WELCOME_HOLD_MS        2000    // matched sensor rests, name stays up
+// A student matched again within the window is welcomed but nothing is
+// sent or queued; the last SCAN_REPEAT_SLOTS students are remembered
+#define SCAN_REPEAT_WINDOW_MS  60000UL   // default for scanRepeatWindowMs, 0 = off
+#define SCAN_REPEAT_WINDOW_MAX_MS 3600000UL   // a class period
+#define SCAN_REPEAT_SLOTS      32
+#define SENSOR_MSG_HOLD_MS     1000    // "No Match!" etc. before the idle prompt returns
+
+struct SensorPort {
+  uint8_t uart;
+  int8_t  rx, tx;
+  int8_t  touch;              // TOUCH output GPIO, -1 = not wired
+  uint8_t greenLed, redLed;
+};
+
+const SensorPort SENSOR_PORTS[FP_SENSOR_PORTS] = {
+  {1, 18, 19, FP_TOUCH_PIN,  GREEN_LED,   RED_LED},
+  {2, 16, 17, FP2_TOUCH_PIN, GREEN_LED_2, RED_LED_2},
+};
+
+enum CaptureStep : uint8_t {
+  CAPTURE_WAIT,      // polling, or waiting for the touch line
+  CAPTURE_CONVERT,   // image taken; image2Tz() next
+  CAPTURE_SEARCH,    // features in buffer 1; fingerFastSearch() next
+  CAPTURE_HOLD,      // matched; the sensor rests until holdUntil
+};
+
+struct Sensor {
+  Sensor(const SensorPort &p) : port(p), serial(p.uart), fp(&serial) {}
+
+  const SensorPort     &port;
+  HardwareSerial        serial;
+  Adafruit_Fingerprint  fp;
+  bool                  present = false;
+
+  CaptureStep   step         = CAPTURE_WAIT;
+  unsigned long lastPollAt   = 0;
+  unsigned long lastFingerAt = 0;   // last getImage() that saw a finger
+  unsigned long prevFingerAt = 0;   // the one before it
+  unsigned long detectAt     = 0;   // when the finger being matched arrived
+  unsigned long holdUntil    = 0;
+  uint8_t       ledLit       = 0;   // LED pin lit, 0 = none
+  unsigned long ledOffAt     = 0;
+
+  volatile uint32_t touchAtMs = 0;  // set by onTouch()
+  std::atomic<bool> touched{false};
+
+  bool     counting    = false;   // orphan census (see SLOT ALLOCATION)
+  uint16_t censusNext  = 0;
+  uint16_t censusLast  = 0;       // last slot the library has
+  uint16_t censusLeft  = 0;       // orphans not found yet
+  uint16_t censusFound = 0;
+};
 
-//  LEDs
-#define GREEN_LED 2
-#define RED_LED   4
+Sensor sensors[FP_SENSOR_PORTS] = {{SENSOR_PORTS[0]}, {SENSOR_PORTS[1]}};
+Adafruit_Fingerprint &finger = sensors[0].fp;   // enrollment sensor
+uint8_t sensorCount = 0;                        // ports whose AS608 answered
 
 //  NTP / Time
 const char *ntpServer          = "pool.ntp.org";
@@ -42,27 +139,66 @@ const int   daylightOffset_sec = 0;
 #define NTP_STALE_MS            7200000UL
 
 volatile bool ntpSynced     = false;
-unsigned long ntpSyncedAtMs = 0;
 unsigned long lastNTPResync = 0;
 
-// Welcome message 2-second hold
-// 0 = no hold active. Set to millis() on match. Cleared by loop() after 2000ms.
+// Wall clock between syncs: NTP anchor + millis(), formatted without libc
+TimeAnchor clockAnchor(gmtOffset_sec + daylightOffset_sec, TZ_SUFFIX, NTP_STALE_MS);
+
+// Welcome message hold on the display
+// 0 = no hold active. Set to millis() on match. Cleared by loop() after WELCOME_HOLD_MS.
 unsigned long welcomeShownAt = 0;
+unsigned long sensorMsgUntil = 0;   // idle prompt waits until then
 
 //  EEPROM layout
 #define EEPROM_SIZE             4096
 #define MAX_STUDENTS            50
-#define MAX_OFFLINE_ATTENDANCE  30
 #define STUDENT_NAME_LEN        20
 #define STUDENT_REG_LEN         15
 #define TS_LEN                  26
-#define STUDENT_RECORD_SIZE     (1 + STUDENT_NAME_LEN + STUDENT_REG_LEN)
-#define STUDENTS_EEPROM_SIZE    (1 + (MAX_STUDENTS * STUDENT_RECORD_SIZE))
-#define OFFLINE_RECORD_SIZE     (1 + STUDENT_NAME_LEN + STUDENT_REG_LEN + TS_LEN)
-#define OFFLINE_EEPROM_SIZE     (1 + (MAX_OFFLINE_ATTENDANCE * OFFLINE_RECORD_SIZE))
+#define STUDENT_RECORD_SIZE     (2 + STUDENT_NAME_LEN + STUDENT_REG_LEN)
+#define STUDENTS_EEPROM_SIZE    (1 + (MAX_STUDENTS * STUDENT_RECORD_SIZE))   // count + records
+#define STUDENT_RECORD_ADDR(i)  (1 + (i) * STUDENT_RECORD_SIZE)
+#define OFFLINE_RECORD_SIZE     (2 + 4 + 1)                         // slot + epoch + flags
+#define OFFLINE_SLOT_SIZE       (4 + OFFLINE_RECORD_SIZE + 2 + 1)   // seq + record + crc + state
 #define OFFLINE_START_ADDR      (STUDENTS_EEPROM_SIZE)
-
-#if (STUDENTS_EEPROM_SIZE + OFFLINE_EEPROM_SIZE) > EEPROM_SIZE
+#define ROSTER_META_SIZE        8                                   // magic + version + crc16
+#define BOOT_ANCHORS            2                                   // boots whose clock is kept
+#define BOOT_META_SIZE          (1 + BOOT_ANCHORS * 5 + 2)          // boot + (boot, epoch) × n + crc16
+#define SLOT_MAP_SIZE           ((FP_LIBRARY_SLOTS + 7) / 8 + 2)    // bit per sensor slot + crc16
+// The offline journal takes every byte the roster, its version stamp,
+// the boot clocks and the slot map leave free; those three sit in the
+// tail the slots do not fill
+#define MAX_OFFLINE_ATTENDANCE  ((EEPROM_SIZE - OFFLINE_START_ADDR - JOURNAL_HEADER_SIZE - ROSTER_META_SIZE - BOOT_META_SIZE - SLOT_MAP_SIZE) / OFFLINE_SLOT_SIZE)
+#define OFFLINE_EEPROM_SIZE     (JOURNAL_HEADER_SIZE + (MAX_OFFLINE_ATTENDANCE * OFFLINE_SLOT_SIZE))
+#define ROSTER_META_ADDR        (OFFLINE_START_ADDR + OFFLINE_EEPROM_SIZE)
+#define ROSTER_META_MAGIC       0x5256                              // "RV"
+#define BOOT_META_ADDR          (ROSTER_META_ADDR + ROSTER_META_SIZE)
+#define SLOT_MAP_ADDR           (BOOT_META_ADDR + BOOT_META_SIZE)
+#define BOOT_MAX                127                                 // boot numbers 1..127 fit in Attendance.flags
+
+// Layout written by earlier firmware, only read once to migrate: the
+// roster with one-byte slots, then a flat offline queue of full
+// name/regNum/ISO-timestamp records, [count][record × 30]
+#define LEGACY_RECORD_SIZE      (1 + STUDENT_NAME_LEN + STUDENT_REG_LEN)
+#define LEGACY_RECORD_ADDR(i)   (1 + (i) * LEGACY_RECORD_SIZE)
+#define LEGACY_OFFLINE_START    (1 + MAX_STUDENTS * LEGACY_RECORD_SIZE)
+#define LEGACY_MAX_OFFLINE      30
+#define LEGACY_SCAN_SIZE        (1 + STUDENT_NAME_LEN + STUDENT_REG_LEN + TS_LEN)
+
+// Roster writes are coalesced: one commit once enrollments pause for
+// ROSTER_COMMIT_QUIET_MS, and never later than ROSTER_COMMIT_MAX_MS
+// after the first unsaved change. fp/enrolled and fp/templateStored
+// wait for that commit (up to ROSTER_HELD_MAX of them; one more forces
+// it), so the bridge never hears of a student flash could still lose.
+#define ROSTER_COMMIT_QUIET_MS  10000UL
+#define ROSTER_COMMIT_MAX_MS    60000UL
+#define ROSTER_HELD_MAX         16
+
+//  AS608 template library size (largest module variant)
+#define FP_LIBRARY_SLOTS        1000
+#define SLOT_UNMAPPED           0xFF
+
+#if (STUDENTS_EEPROM_SIZE + OFFLINE_EEPROM_SIZE + ROSTER_META_SIZE + BOOT_META_SIZE + SLOT_MAP_SIZE) > EEPROM_SIZE
   #error "EEPROM layout exceeds EEPROM_SIZE"
 #endif
 
@@ -74,77 +210,528 @@ unsigned long welcomeShownAt = 0;
 #define TOPIC_STATE_PUB    "fp/stateAck"
 #define TOPIC_SYS_STATE    "fp/systemState"
 #define TOPIC_ENROLL_DATA  "fp/enrollData"
+#define TOPIC_ATT_BATCH    "fp/attendanceBatch"
+#define TOPIC_ATT_ACK      "fp/attendanceAck"
+#define TOPIC_ONLINE       "fp/online"           // retained; "offline" is the will
+#define TOPIC_TPL_CMD      "fp/templateCmd"      // bridge → export / stop
+#define TOPIC_TPL_OUT      "fp/templateOut"      // exported model parts, then {"done":true,"failed":[…]}
+#define TOPIC_TPL_ACK      "fp/templateAck"      // bridge has stored these slots
+#define TOPIC_TPL_IN       "fp/templateIn"       // model parts to store here
+#define TOPIC_TPL_STORED   "fp/templateStored"   // outcome of one imported model
+#define TOPIC_ROSTER_VER   "fp/rosterVersion"    // roster version held here
+#define TOPIC_ROSTER_DELTA "fp/rosterDelta"      // bridge → changes from one version to another
+#define TOPIC_METRICS      "fp/metrics"          // stage latency histograms and counters
+#define TOPIC_CMD          "fp/cmd"              // bridge → fleet operations (see COMMANDS)
+#define TOPIC_CMD_ACK      "fp/cmdAck"           // outcome of one command
 #define MQTT_BUF_SIZE 512
+// PubSubClient packs fixed header + topic length + topic + payload into its buffer
+#define MQTT_PAYLOAD_MAX(topic) (MQTT_BUF_SIZE - 5 - 2 - (sizeof(topic) - 1))
+
+//  Tasks: fingerprint polling, enrollment and the OLED stay in the
+//  Arduino loop task (core 1). Wi-Fi, MQTT, NTP and the offline
+//  journal belong to the network task on core 0, so a TLS stall or
+//  a reconnect never delays a scan.
+#define NET_TASK_CORE         0
+#define NET_TASK_STACK        8192
+#define NET_TASK_PRIORITY     1
+#define NET_TASK_PERIOD_MS    10
+#define NET_QUEUE_LEN         32       // sensor → network events, power of two
+#define INBOUND_QUEUE_LEN     4        // fp/systemState, fp/enrollData → loop task, power of two
+
+// Connection state machine (see linkStep()). Failed Wi-Fi joins and
+// broker connects back off exponentially from LINK_BACKOFF_MIN_MS to
+// LINK_BACKOFF_MAX_MS; each wait is drawn from [d/2, d] so a fleet
+// that lost the same AP does not retry in lockstep.
+#define WIFI_JOIN_TIMEOUT_MS   10000
+#define LINK_BACKOFF_MIN_MS    1000
+#define LINK_BACKOFF_MAX_MS    20000
+#define MQTT_SOCKET_TIMEOUT_S  3        // bounds the one blocking call, connect()
+
+// Reconnect cost. The TLS client offers the broker its last session,
+// which turns a ~1.6 s ECDHE/RSA handshake into one round trip while
+// the broker still caches it (Mosquitto/OpenSSL: 300 s). The session
+// also outlives a warm reboot in RTC memory. The MQTT session is
+// persistent (cleanSession false, fixed client ID), so QoS 1 acks and
+// roster deltas published while the link is down wait at the broker.
+#define TLS_HANDSHAKE_TIMEOUT_MS 8000
+#define TLS_SESSION_KEEP_MAX     1024     // serialized session kept over a warm reboot
+#define TLS_SESSION_KEEP_MAGIC   0x544C5331UL   // "TLS1"
+
+// Liveness: any publish counts as a heartbeat, so fp/heartbeat only
+// goes out after heartbeatIdleMs without one (and at least every
+// HEARTBEAT_TELEMETRY_MS, for the heap and clock figures it carries).
+// A station that dies silently is reported by its will on
+// fp/online, which the broker sends ~1.5x MQTT_KEEPALIVE_S later.
+#define HEARTBEAT_IDLE_MS       30000
+#define HEARTBEAT_TELEMETRY_MS  300000UL
+#define HEARTBEAT_IDLE_MIN_MS   5000     // fp/cmd "intervals" floor
+#define MQTT_KEEPALIVE_S        15
+
+// Stage latencies (latency_hist.h): sent and reset on this period,
+// and printed on demand by the "metrics" console command
+#define METRICS_INTERVAL_MS     60000UL
+#define METRICS_CALIBRATE_RUNS  256      // timed record() calls at boot
+#define CONSOLE_LINE_LEN        32
+
+// Offline replay: records sent but not yet confirmed on fp/attendanceAck
+#define SYNC_WINDOW_RECORDS   40       // ~3 full batches in flight
+#define SYNC_ACK_TIMEOUT_MS   5000     // resend a record not acked by then
+
+// Template transfer (see TEMPLATE TRANSFER). A model travels as
+// TEMPLATE_PARTS base64 parts of TEMPLATE_PART_BYTES, each in its own
+// message; up to TEMPLATE_WINDOW exported models may be unacked.
+#define TEMPLATE_PART_BYTES      256
+#define TEMPLATE_PARTS           (FP_TEMPLATE_SIZE / TEMPLATE_PART_BYTES)
+#define TEMPLATE_PART_B64        (4 * ((TEMPLATE_PART_BYTES + 2) / 3))
+#define TEMPLATE_WINDOW          4
+#define TEMPLATE_ACK_TIMEOUT_MS  10000
+#define TEMPLATE_QUEUE_LEN       4        // each direction, power of two
+#define TEMPLATE_END             0        // slot of the end-of-export marker
+#define ROSTER_MAX_SLOT          (FP_LIBRARY_SLOTS - 1)   // slots run from 1
+
+// Roster sync (see ROSTER SYNC)
+#define ROSTER_DELTA_MAX          12      // changes in one fp/rosterDelta part
+#define ROSTER_DELTA_QUEUE_LEN    8       // parts arrive back to back; 50 students are 5
+#define STUDENT_DELETE_QUEUE_LEN  8       // fp/cmd deletes not yet done, power of two
+#define ROSTER_ANNOUNCE_MIN_MS    5000    // re-announce after an out-of-step delta
+#define ORPHAN_CENSUS_PERIOD_MS   20      // one unheld slot checked per sensor each period
+#define ORPHANS_LISTED            24      // slots one orphan report names
+
+// Enrollment timeouts (see enrollStep())
+#define ENROLL_DATA_TIMEOUT_MS     12000   // ENROLL received, fp/enrollData not yet
+#define ENROLL_CAPTURE_TIMEOUT_MS  15000   // per finger placement or removal
+#define ENROLL_POLL_MS             80
+#define ENROLL_LIFT_SETTLE_MS      800     // "Remove finger" before polling for it
 
 //  MQTT client
-WiFiClientSecure wifiSecure;
-PubSubClient     mqttClient(wifiSecure);
-bool             mqttConnected = false;
+ResumableTlsClient tlsClient;
+PubSubClient       mqttClient(tlsClient);
+volatile bool      mqttConnected = false;   // owned by the network task
+char               stationId[40];           // MQTT client ID, "to" in fp/cmd
+
+// The last TLS session, kept over a warm reboot (software reset,
+// watchdog, brown-out). A cold power-on leaves garbage that fails the
+// crc. Network task only.
+struct TlsSessionKeep {
+  uint32_t magic;
+  uint16_t len;
+  uint16_t crc;
+  uint8_t  blob[TLS_SESSION_KEEP_MAX];
+};
+RTC_NOINIT_ATTR TlsSessionKeep tlsKeep;
 
-volatile bool newStateReceived  = false;
-volatile bool newEnrollReceived = false;
-char mqttStateBuf[16]                    = "VERIFY";
-char mqttEnrollNameBuf[STUDENT_NAME_LEN] = {0};
-char mqttEnrollRegBuf[STUDENT_REG_LEN]   = {0};
+enum LinkState : uint8_t {
+  LINK_WIFI_IDLE,      // station stopped; WiFi.begin() once the backoff expires
+  LINK_WIFI_JOINING,   // WiFi.begin() issued, waiting for GOT_IP
+  LINK_MQTT_WAIT,      // Wi-Fi up; broker connect once the backoff expires
+  LINK_UP,             // broker session live
+};
+LinkState     linkState      = LINK_WIFI_IDLE;
+unsigned long linkDeadline   = 0;   // join timeout, or end of the current backoff
+uint8_t       wifiFailures   = 0;
+uint8_t       mqttFailures   = 0;
+uint32_t      linkReconnects = 0;
+
+// Set from the Wi-Fi event task, consumed by linkStep()
+std::atomic<bool> wifiGotIp{false};
+std::atomic<bool> wifiLost{false};
 
 //  Data structures
 struct Student {
+  uint16_t id;
+  char     name[STUDENT_NAME_LEN];
+  char     regNum[STUDENT_REG_LEN];
+};
+Student students[MAX_STUDENTS];
+uint8_t studentCount = 0;
+
+// EEPROM image of one roster entry
+struct __attribute__((packed)) StudentRecord {
+  uint16_t id;
+  char     name[STUDENT_NAME_LEN];
+  char     regNum[STUDENT_REG_LEN];
+};
+static_assert(sizeof(StudentRecord) == STUDENT_RECORD_SIZE, "StudentRecord out of step with STUDENT_RECORD_SIZE");
+
+// The same before the slot took two bytes; only read once, to migrate
+struct __attribute__((packed)) LegacyStudentRecord {
   uint8_t id;
   char    name[STUDENT_NAME_LEN];
   char    regNum[STUDENT_REG_LEN];
 };
-Student students[MAX_STUDENTS];
-uint8_t studentCount = 0;
+static_assert(sizeof(LegacyStudentRecord) == LEGACY_RECORD_SIZE, "legacy record layout");
+
+// Roster version stamp at ROSTER_META_ADDR. The crc covers the count,
+// the records in use and the version, so a roster commit torn part
+// way through reads back as version 0 and the station catches up
+// from the start of the bridge's log.
+struct __attribute__((packed)) RosterMeta {
+  uint16_t magic;
+  uint32_t version;
+  uint16_t crc;
+};
+static_assert(sizeof(RosterMeta) == ROSTER_META_SIZE, "RosterMeta out of step with ROSTER_META_SIZE");
+
+// Boot number and the clocks of recent boots at BOOT_META_ADDR. A scan
+// taken before NTP is journaled with the boot's number and its uptime;
+// once that boot has an anchor (the UTC second its uptime started at)
+// the stamp becomes a real time. The crc covers the rest, so a torn
+// write reads back as a fresh boot counter with no clocks.
+struct __attribute__((packed)) BootMeta {
+  uint8_t  boot;                       // this boot, 1..BOOT_MAX
+  uint8_t  anchorBoot[BOOT_ANCHORS];   // 0 = empty
+  uint32_t anchorEpoch[BOOT_ANCHORS];
+  uint16_t crc;
+};
+static_assert(sizeof(BootMeta) == BOOT_META_SIZE, "BootMeta out of step with BOOT_META_SIZE");
+
+// Sensor slots that hold, or may hold, a model, at SLOT_MAP_ADDR (see
+// SLOT ALLOCATION). Staged and committed with the roster; a map whose
+// crc fails is rebuilt from the roster and the census adds the rest.
+struct __attribute__((packed)) SlotMap {
+  uint8_t  used[(FP_LIBRARY_SLOTS + 7) / 8];
+  uint16_t crc;
+};
+static_assert(sizeof(SlotMap) == SLOT_MAP_SIZE, "SlotMap out of step with SLOT_MAP_SIZE");
+static_assert(SLOT_MAP_ADDR + SLOT_MAP_SIZE <= EEPROM_SIZE, "SlotMap runs past the EEPROM");
+
+BootMeta          bootMeta;                    // loop task writes, under EepromLock
+bool              bootAnchored = false;        // loop task
+std::atomic<bool> bootUnsyncedStored{false};   // a scan of this boot waits on its clock
+
+// Server version of the roster this station holds (loop task writes,
+// the network task announces it)
+std::atomic<uint32_t> rosterVersion{0};
+
+// Bit i set: students[i] differs from its EEPROM record
+uint64_t      rosterDirty         = 0;
+bool          rosterCommitPending = false;
+unsigned long rosterFirstChangeAt = 0;
+unsigned long rosterLastChangeAt  = 0;
+
+#if MAX_STUDENTS > 64
+  #error "rosterDirty is a 64-bit mask; MAX_STUDENTS must not exceed 64"
+#endif
+
+// Sensor slot → index into students[], SLOT_UNMAPPED if none.
+// Direct-indexed so a match costs the same for any roster size.
+uint8_t slotToStudent[FP_LIBRARY_SLOTS];
+
+// Loop task; written into the EEPROM cache with the roster
+SlotMap slotMap;
+bool    slotMapDirty = false;
 
-struct Attendance {
+#if MAX_STUDENTS >= SLOT_UNMAPPED
+  #error "slotToStudent[] entries are uint8_t; MAX_STUDENTS must stay below SLOT_UNMAPPED"
+#endif
+
+// Queued scan as stored in the offline journal. Name and regNum are
+// not kept: the device re-joins them from the roster on replay and
+// the bridge falls back to /students/{id}.
+struct __attribute__((packed)) Attendance {
+  uint16_t id;       // AS608 slot
+  uint32_t epoch;    // UTC seconds at scan; uptime seconds if ATT_FLAG_UNSYNCED
+  uint8_t  flags;    // ATT_FLAG_*, boot number above ATT_BOOT_SHIFT
+};
+#define ATT_FLAG_UNSYNCED  0x01   // taken before NTP time; dated from its boot's clock
+#define ATT_BOOT_SHIFT     1      // boot 0: stamped by older firmware, cannot be dated
+
+static_assert(sizeof(Attendance) == OFFLINE_RECORD_SIZE, "Attendance is stored as-is in the journal");
+static_assert(offsetof(Attendance, id) == 0 && offsetof(Attendance, epoch) == 2 &&
+              offsetof(Attendance, flags) == 6, "Attendance layout is persisted; do not reorder");
+
+struct LegacyAttendance {
   uint8_t id;
   char    name[STUDENT_NAME_LEN];
   char    regNum[STUDENT_REG_LEN];
   char    timestamp[TS_LEN];
 };
-Attendance offlineAttendance[MAX_OFFLINE_ATTENDANCE];
-uint8_t    offlineCount = 0;
+static_assert(sizeof(LegacyAttendance) == LEGACY_SCAN_SIZE, "legacy scan layout");
+
+// Offline queue: append-only ring journal in EEPROM (see eeprom_journal.h)
+typedef EepromJournal<OFFLINE_RECORD_SIZE, MAX_OFFLINE_ATTENDANCE, 2> OfflineJournal;
+static_assert(OfflineJournal::REGION_SIZE == OFFLINE_EEPROM_SIZE, "OFFLINE_EEPROM_SIZE out of step with journal");
+static_assert(LEGACY_OFFLINE_START + 1 + LEGACY_MAX_OFFLINE * LEGACY_SCAN_SIZE <= EEPROM_SIZE, "legacy layout ran past the EEPROM");
+OfflineJournal offlineJournal;
+
+// Sensor task → network task. Everything the sensor side wants sent
+// goes through this queue; only the network task touches mqttClient
+// and the offline journal.
+enum NetEventType : uint8_t {
+  NET_ATTENDANCE,   // slot, epoch, student → fp/attendance or the journal
+  NET_ENROLLED,     // slot, epoch, student → fp/enrolled
+  NET_MESSAGE,      // text → fp/message
+  NET_STATE_ACK,    // text → fp/stateAck (retained)
+  NET_TEMPLATE_STORED,   // slot, text (error, "" = stored) → fp/templateStored
+  NET_ROSTER_VERSION,    // text (error, "" = none) → fp/rosterVersion
+  NET_STUDENT_DELETED,   // slot, text (error, "" = deleted) → fp/cmdAck
+  NET_ORPHANS,           // slot (how many), slots (the first ORPHANS_LISTED) → fp/cmdAck
+};
+
+struct NetEvent {
+  NetEventType type;
+  uint16_t     slot;
+  uint32_t     epoch;     // 0 if the clock was not synced
+  uint32_t     uptimeS;   // NET_ATTENDANCE: dates the scan later when epoch is 0
+  union {
+    struct {
+      char name[STUDENT_NAME_LEN];
+      char regNum[STUDENT_REG_LEN];
+    } student;
+    char     text[48];
+    uint16_t slots[ORPHANS_LISTED];
+  };
+};
+
+SpscQueue<NetEvent, NET_QUEUE_LEN> netQueue;
+uint32_t     netQueueDrops = 0;
+TaskHandle_t netTaskHandle = nullptr;
+
+// fp/enrolled and fp/templateStored waiting for the roster commit
+// that puts their student in flash (loop task, see commitRosterIfDue())
+NetEvent rosterHeld[ROSTER_HELD_MAX];
+uint8_t  rosterHeldCount = 0;
+
+// One model between the sensor side and the network task
+struct TemplateBlock {
+  uint16_t slot;                        // TEMPLATE_END: the export is complete
+  uint16_t crc;                         // journalCrc16() over data; at the end, slots unread
+  char     name[STUDENT_NAME_LEN];      // roster entry, "" = keep / unknown
+  char     regNum[STUDENT_REG_LEN];
+  uint8_t  data[FP_TEMPLATE_SIZE];      // at the end, the unread slots as uint16_t
+};
+static_assert(MAX_STUDENTS * sizeof(uint16_t) <= FP_TEMPLATE_SIZE, "unread slots fit the end block");
+
+SpscQueue<TemplateBlock, TEMPLATE_QUEUE_LEN> templateOut;   // export: sensor → network
+SpscQueue<TemplateBlock, TEMPLATE_QUEUE_LEN> templateIn;    // import: network → sensor
+std::atomic<uint16_t> exportRequest{0};   // (re)start the export at this slot, 0 = none
+std::atomic<bool>     exportCancel{false};
+
+// One fp/rosterDelta, parsed by the network task and applied whole
+// by the sensor task
+struct RosterChange {
+  uint16_t slot;
+  bool     remove;
+  char     name[STUDENT_NAME_LEN];
+  char     regNum[STUDENT_REG_LEN];
+};
+
+struct RosterDelta {
+  uint32_t     from, to;
+  uint8_t      part, of;
+  uint8_t      count;
+  RosterChange changes[ROSTER_DELTA_MAX];
+};
+
+SpscQueue<RosterDelta, ROSTER_DELTA_QUEUE_LEN> rosterDeltas;
+
+// fp/systemState and fp/enrollData, copied out of the payload by the
+// network task and acted on by the loop task
+struct SystemStateMsg {
+  char state[16];
+};
+
+struct EnrollData {
+  char name[STUDENT_NAME_LEN];
+  char regNum[STUDENT_REG_LEN];
+};
+
+SpscQueue<SystemStateMsg, INBOUND_QUEUE_LEN> stateIn;
+SpscQueue<EnrollData, INBOUND_QUEUE_LEN>     enrollIn;
+EnrollData enrollData;   // loop task: the student being enrolled
+
+// Slots an fp/cmd "delete" names, done by the sensor task
+SpscQueue<uint16_t, STUDENT_DELETE_QUEUE_LEN> studentDeletes;
+std::atomic<bool> orphanReportRequest{false};   // fp/cmd "orphans", answered by the sensor task
+
+// Network task → UI. Single-slot mailboxes the loop task drains;
+// only string literals are posted as notices.
+// Detect-to-match latency since the last heartbeat (sensor task
+// writes, the heartbeat reads and resets)
+std::atomic<uint32_t> matchCount{0};
+std::atomic<uint32_t> matchSumMs{0};
+std::atomic<uint32_t> matchMaxMs{0};
+std::atomic<uint32_t> repeatCount{0};   // matches inside scanRepeatWindowMs
+
+// Time spent in each stage, recorded by whichever task runs it; the
+// network task publishes and resets the lot every METRICS_INTERVAL_MS
+enum Stage : uint8_t {
+  ST_LOOP,      // one loop() pass, delay excluded
+  ST_IMAGE,     // getImage(), finger or not
+  ST_CONVERT,   // image2Tz(1)
+  ST_SEARCH,    // fingerFastSearch()
+  ST_CLOCK,     // reading the wall clock for a scan
+  ST_PUBLISH,   // mqttPublish()
+  ST_COMMIT,    // EEPROM.commit(): roster, journal append and flush
+  ST_CONNECT,   // a broker connect that succeeded, TCP to CONNACK
+  STAGE_COUNT
+};
+const char *const STAGE_NAMES[STAGE_COUNT] = {"loop", "image", "tz", "search",
+                                              "clock", "publish", "commit", "connect"};
+LatencyHist stageHist[STAGE_COUNT];
+
+struct StageTimer {
+  explicit StageTimer(Stage st) : hist(stageHist[st]), startUs(micros()) {}
+  ~StageTimer() { hist.record(micros() - startUs); }
+  LatencyHist &hist;
+  uint32_t     startUs;
+};
+
+// Counted over the same window as stageHist
+std::atomic<uint32_t> metricMatches{0};
+std::atomic<uint32_t> metricNoMatches{0};
+std::atomic<uint32_t> metricOffline{0};     // scans journaled instead of sent
+std::atomic<uint32_t> metricSyncFails{0};   // failed batches and unacked records
+std::atomic<uint32_t> metricTlsResumes{0};  // connects that resumed a TLS session
+std::atomic<uint32_t> metricsWindowAt{0};   // millis() the window opened
+uint32_t              recordCostNs = 0;     // one StageTimer, measured at boot
+uint32_t              bootReadyMs  = 0;     // millis() when verification started
+std::atomic<uint32_t> firstScanMs{0};       // millis() of the first match since boot, 0 = none yet
+
+// Recent matches by slot (sensor task only); slot 0 = free entry
+struct RecentScan {
+  uint16_t slot;
+  uint32_t atMs;
+};
+RecentScan            recentScans[SCAN_REPEAT_SLOTS];
+std::atomic<uint32_t> scanRepeatWindowMs{SCAN_REPEAT_WINDOW_MS};   // fp/cmd "intervals" sets it
+
+// Poll intervals without a touch line; fp/cmd "intervals" sets them
+// from the network task until the next reboot
+std::atomic<uint32_t> capturePollMs{CAPTURE_POLL_MS};
+std::atomic<uint32_t> capturePollIdleMs{CAPTURE_POLL_IDLE_MS};
+
+std::atomic<const char *> netNotice{nullptr};
+std::atomic<int8_t>       netProgress{-1};   // -1 = no change, else sync bar %
+
+// The roster (loop task) and the journal (network task) share one
+// EEPROM cache and one commit; hold this around either.
+SemaphoreHandle_t eepromMutex = nullptr;
+
+struct EepromLock {
+  EepromLock()  { xSemaphoreTake(eepromMutex, portMAX_DELAY); }
+  ~EepromLock() { xSemaphoreGive(eepromMutex); }
+};
 
 enum SystemState { VERIFY, ENROLL };
 SystemState currentState = VERIFY;
 
+// Enrollment runs as a state machine that loop() advances one short
+// step per pass, so the display, remote commands and cancellation
+// keep working while a student is at the sensor.
+enum EnrollStep : uint8_t {
+  ENROLL_IDLE,
+  ENROLL_WAIT_DATA,   // ENROLL received, waiting for fp/enrollData
+  ENROLL_FIRST,       // polling for the first image
+  ENROLL_LIFT,        // waiting for the finger to come off
+  ENROLL_SECOND,      // polling for the second image
+  ENROLL_RESULT,      // outcome and LED shown until enrollHoldUntil
+  ENROLL_CLOSING,     // "Enrollment Complete!" shown until enrollHoldUntil
+};
+EnrollStep    enrollStage     = ENROLL_IDLE;
+unsigned long enrollStageAt   = 0;   // when the current step began
+unsigned long enrollNextPoll  = 0;
+unsigned long enrollHoldUntil = 0;
+uint8_t       enrollLed       = 0;   // LED lit for ENROLL_RESULT, 0 = none
+bool          enrollClosing   = false;
+int8_t        enrollBarPct    = -1;
+uint16_t      enrollSlot      = 0;   // picked before buffer 1 holds the first image
+
 //  Function prototypes
 void    oledTop();
-void    oledBottom(const String &msg, bool sendToMQTT = false);
+void    oledBottom(const char *msg, bool sendToMQTT = false);
 void    oledBottomRefresh();
 void    oledProgressBar(uint8_t percent);
 void    oledShowState();
-void    enrollFinger();
+void    enrollBegin();
+void    enrollStep();
+void    enrollCancel();
 void    verifyFingerNonBlocking();
-bool    mqttPublish(const char *topic, const String &payload, bool retained = false);
-String  getTimestamp();
+void    onTouch(void *arg);
+void    beginSensors();
+void    mirrorRoster();
+uint8_t mirrorTemplate(uint16_t slot);
+void    sensorLedsStep();
+void    templateStep();
+void    rosterSyncStep();
+void    studentDeleteStep();
+bool    deleteSlotModels(uint16_t slot);
+bool    slotInUse(uint16_t slot);
+void    markSlotInUse(uint16_t slot, bool used);
+void    beginOrphanCensus();
+void    orphanCensusStep();
+void    onRosterDelta(JsonDocument &doc);
+void    serialConsoleStep();
+void    metricsCalibrate();
+void    publishMetrics(bool closeWindow = true);
+void    removeStudent(uint8_t index);
+uint16_t rosterCrc(uint32_t version);
+void    templateExportStep();
+void    onTemplateCmd(const char *op, uint16_t from);
+void    onTemplatePart(JsonDocument &doc);
+void    onTemplateAck(uint16_t slot);
+void    resetTemplateInFlight();
+uint16_t freeRosterSlot();
+void    resetSlotMap();
+bool    mqttPublish(const char *topic, const char *payload, bool retained = false);
+bool    getTimestamp(char *buf, size_t len);
+uint32_t currentEpoch();
+void    formatTimestamp(uint32_t epoch, char *buf, size_t len);
+uint32_t parseTimestamp(const char *ts);
 bool    isTimeSynced();
-bool    waitForNTPSync(uint32_t timeoutMs);
 void    triggerNTPResync();
-void    reconnectWiFi();
-void    reconnectMQTT();
+void    onWiFiEvent(arduino_event_id_t event);
+void    linkStep();
+void    linkBackoff(LinkState next, uint8_t &failures);
+void    onMqttConnected();
+void    restoreTlsSession();
+void    keepTlsSession();
 void    mqttCallback(char *topic, byte *payload, unsigned int length);
+void    publishCommandAck(JsonDocument &reply, const char *err);
+void    markStudentDirty(uint8_t index);
 void    saveStudentsToEEPROM();
+bool    commitRosterIfDue(bool force = false);
+void    restageRoster();
+void    postAfterCommit(const NetEvent &e);
 void    loadStudentsFromEEPROM();
-void    saveOfflineAttendanceToEEPROM();
+void    rebuildSlotIndex();
+const Student *studentForSlot(uint16_t slot);
 void    loadOfflineAttendanceFromEEPROM();
-void    syncOfflineAttendance();
-void    removeOfflineRecordAt(uint8_t idx);
-bool    safeEEPROMWrite(int addr, const uint8_t *buf, size_t len);
+void    beginBootClock();
+void    bootClockStep();
+uint32_t uptimeS();
+void    migrateLegacyLayout();
+bool    syncOfflineAttendance();
+bool    netPost(const NetEvent &e);
+void    netPostText(NetEventType type, const char *text);
+void    showNetNotices();
+void    networkTask(void *param);
+void    networkStep();
+void    drainNetQueue();
+void    deliverAttendance(const NetEvent &e);
+void    onAttendanceAck(uint32_t seq);
+void    resetOfflineInFlight();
 String  sanitizeKey(const String &s);
 
 // ─────────────────────────────────────────────────────────────
 //  NTP
 // ─────────────────────────────────────────────────────────────
 void ntpSyncCallback(struct timeval *tv) {
-  ntpSynced     = true;
-  ntpSyncedAtMs = millis();
-  Serial.printf("[NTP] Synced — epoch=%llu\n", (unsigned long long)tv->tv_sec);
+  clockAnchor.sync((uint32_t)tv->tv_sec, (uint32_t)tv->tv_usec, millis());
+  ntpSynced = true;
+  TimeAnchor::Stats st = clockAnchor.stats();
+  if (st.syncs > 1) {
+    Serial.printf("[NTP] Synced — epoch=%llu  drift %+ld ms over %lu s (%+ld ppm)\n",
+                  (unsigned long long)tv->tv_sec, (long)st.lastDriftMs,
+                  (unsigned long)st.intervalS, (long)st.driftPpm);
+  } else {
+    Serial.printf("[NTP] Synced — epoch=%llu\n", (unsigned long long)tv->tv_sec);
+  }
 }
 
 bool isTimeSynced() {
   if (!ntpSynced) return false;
-  if ((millis() - ntpSyncedAtMs) > NTP_STALE_MS) {
+  if (!clockAnchor.valid(millis())) {
     ntpSynced = false;
     Serial.println("[NTP] Sync stale — forcing resync");
     return false;
@@ -152,38 +739,40 @@ bool isTimeSynced() {
   return true;
 }
 
-bool waitForNTPSync(uint32_t timeoutMs = 10000) {
-  uint32_t start = millis();
-  while (sntp_get_sync_status() == SNTP_SYNC_STATUS_RESET) {
-    if (millis() - start > timeoutMs) {
-      Serial.println("[NTP] Sync timeout");
-      return false;
-    }
-    delay(100);
-  }
-  ntpSynced     = true;
-  ntpSyncedAtMs = millis();
-  return true;
-}
-
 void triggerNTPResync() {
   Serial.println("[NTP] Forcing resync...");
   configTime(gmtOffset_sec, daylightOffset_sec, ntpServer, ntpServer2);
 }
 
-String getTimestamp() {
-  if (!isTimeSynced()) {
+// ISO-8601 local time into buf (TS_LEN bytes); false while unsynced
+bool getTimestamp(char *buf, size_t len) {
+  uint32_t epoch = currentEpoch();
+  if (!epoch) {
     Serial.println("[Time] Not synced");
-    return "";
-  }
-  struct tm timeinfo;
-  if (!getLocalTime(&timeinfo)) {
-    Serial.println("[Time] getLocalTime() failed");
-    return "";
+    return false;
   }
-  char buffer[TS_LEN];
-  strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%S" TZ_SUFFIX, &timeinfo);
-  return String(buffer);
+  clockAnchor.format(epoch, buf, len);
+  return true;
+}
+
+// UTC seconds, or 0 while the clock cannot be trusted
+uint32_t currentEpoch() {
+  if (!isTimeSynced()) return 0;
+  uint32_t now = clockAnchor.epoch(millis());
+  return (now > 1577836800) ? now : 0;   // 2020-01-01
+}
+
+void formatTimestamp(uint32_t epoch, char *buf, size_t len) {
+  clockAnchor.format(epoch, buf, len);
+}
+
+// Inverse of formatTimestamp(); 0 for anything before 2020 or malformed
+uint32_t parseTimestamp(const char *ts) {
+  int Y, M, D, h, m, s;
+  if (sscanf(ts, "%4d-%2d-%2dT%2d:%2d:%2d", &Y, &M, &D, &h, &m, &s) != 6) return 0;
+  if (Y < 2020 || M < 1 || M > 12 || D < 1 || D > 31) return 0;
+  int64_t local = (int64_t)daysFromCivil(Y, M, D) * 86400 + h * 3600 + m * 60 + s;
+  return (uint32_t)(local - gmtOffset_sec - daylightOffset_sec);
 }
 
 // ─────────────────────────────────────────────────────────────
@@ -199,9 +788,12 @@ void setup() {
   digitalWrite(GREEN_LED, LOW);
   digitalWrite(RED_LED,   LOW);
 
+  eepromMutex = xSemaphoreCreateMutex();
+  metricsCalibrate();
   if (!EEPROM.begin(EEPROM_SIZE)) Serial.println("[EEPROM] begin failed!");
+  loadOfflineAttendanceFromEEPROM();   // first: brings an older layout over whole
   loadStudentsFromEEPROM();
-  loadOfflineAttendanceFromEEPROM();
+  beginBootClock();
 
   Wire.begin(21, 22);
   if (!display.begin(0x3C, true)) {
@@ -209,17 +801,25 @@ void setup() {
     while (1) delay(10);
   }
   display.clearDisplay();
+  display.invalidate();
   display.setRotation(0);
   display.setTextSize(1);
   display.setTextColor(SH110X_WHITE);
   oledBottom("System Booting...");
 
-  mySerial.begin(57600, SERIAL_8N1, RX_PIN, TX_PIN);
-  delay(100);
   oledBottom("Checking AS608...");
-  if (finger.verifyPassword()) {
-    oledBottom("AS608 Found!");
-    Serial.println("[FP] AS608 found");
+  beginSensors();
+  if (sensors[0].present) {
+    char msg[BOTTOM_MSG_LEN];
+    if (sensorCount > 1) snprintf(msg, sizeof(msg), "%u x AS608 Found!", (unsigned)sensorCount);
+    else                 strcpy(msg, "AS608 Found!");
+    oledBottom(msg);
+    Serial.printf("[FP] %u AS608 found\n", (unsigned)sensorCount);
+    if (sensorCount > 1) {
+      oledBottom("Syncing sensors...");
+      mirrorRoster();
+    }
+    beginOrphanCensus();
   } else {
     oledBottom("AS608 NOT FOUND!");
     Serial.println("[FP] AS608 NOT FOUND");
@@ -227,672 +827,2513 @@ void setup() {
     while (1) delay(1);
   }
 
-  oledBottom("Connecting WiFi...");
-  reconnectWiFi();
-  oledBottom(WiFi.status() == WL_CONNECTED ? "WiFi OK!" : "WiFi FAILED!");
-
-  sntp_set_time_sync_notification_cb(ntpSyncCallback);
-  configTime(gmtOffset_sec, daylightOffset_sec, ntpServer, ntpServer2);
-
-  oledBottom("Syncing time...");
-  if (waitForNTPSync(12000)) {
-    struct tm t;
-    if (getLocalTime(&t) && t.tm_year > 100) {
-      oledBottom("Time synced!");
-      Serial.printf("[NTP] OK: %04d-%02d-%02d %02d:%02d:%02d\n",
-                    t.tm_year + 1900, t.tm_mon + 1, t.tm_mday,
-                    t.tm_hour, t.tm_min, t.tm_sec);
-    } else {
-      ntpSynced = false;
-      oledBottom("Time: bad value!");
-      Serial.println("[NTP] getLocalTime returned insane value");
-    }
-  } else {
-    oledBottom("Time sync failed!");
-  }
-  lastNTPResync = millis();
-
-  wifiSecure.setInsecure();
+  snprintf(stationId, sizeof(stationId), "%s_%lx", MQTT_CLIENT_ID,
+           (unsigned long)(uint32_t)ESP.getEfuseMac());
+  tlsClient.setHandshakeTimeout(TLS_HANDSHAKE_TIMEOUT_MS);
+  restoreTlsSession();
   mqttClient.setServer(MQTT_BROKER, MQTT_PORT);
   mqttClient.setCallback(mqttCallback);
   mqttClient.setBufferSize(MQTT_BUF_SIZE);
+  mqttClient.setSocketTimeout(MQTT_SOCKET_TIMEOUT_S);
+  mqttClient.setKeepAlive(MQTT_KEEPALIVE_S);
 
-  oledBottom("Connecting MQTT...");
-  reconnectMQTT();
-  oledBottom(mqttConnected ? "MQTT Ready!" : "MQTT Failed!");
-  delay(600);
+  WiFi.mode(WIFI_STA);
+  WiFi.setAutoReconnect(false);   // linkStep() owns retries and their backoff
+  WiFi.onEvent(onWiFiEvent);
+  sntp_set_time_sync_notification_cb(ntpSyncCallback);
 
+  // Verify straight away. Joining, NTP (started by linkStep() once
+  // there is an IP) and the broker all come up on the network task;
+  // the status line shows their progress, and scans taken meanwhile
+  // go to the offline journal.
   currentState = VERIFY;
-  bottomMsg    = "Place finger...";
+  strcpy(bottomMsg, "Place finger...");
   oledShowState();
+
+  xTaskCreatePinnedToCore(networkTask, "net", NET_TASK_STACK, nullptr,
+                          NET_TASK_PRIORITY, &netTaskHandle, NET_TASK_CORE);
+  bootReadyMs = millis();
+  Serial.printf("[Boot] Verifying %lu ms after reset\n", (unsigned long)bootReadyMs);
 }
 
 // ─────────────────────────────────────────────────────────────
-//  LOOP
+//  LOOP — sensor/UI task
 // ─────────────────────────────────────────────────────────────
-unsigned long lastHeartbeat   = 0;
-unsigned long lastOfflineSync = 0;
-
 void loop() {
-  if (!mqttClient.connected()) {
-    mqttConnected = false;
-    reconnectMQTT();
-  } else {
-    mqttConnected = true;
-  }
-  mqttClient.loop();
-
-  if (WiFi.status() != WL_CONNECTED) reconnectWiFi();
-
-  if (WiFi.status() == WL_CONNECTED &&
-      millis() - lastNTPResync > NTP_RESYNC_INTERVAL_MS) {
-    triggerNTPResync();
-    lastNTPResync = millis();
-  }
-
+  uint32_t passStartUs = micros();
   if (millis() - lastTopUpdate > 1000) {
     oledTop();
     lastTopUpdate = millis();
   }
 
-  // ── Welcome message 2-second hold ──────────────────────────
-  // After 2s, clear hold and revert display to VERIFY state
-  if (welcomeShownAt > 0 && millis() - welcomeShownAt >= 2000) {
+  // ── Welcome message hold ───────────────────────────────────
+  // After WELCOME_HOLD_MS, clear hold and revert display to VERIFY state
+  if (welcomeShownAt > 0 && millis() - welcomeShownAt >= WELCOME_HOLD_MS) {
     welcomeShownAt = 0;
-    bottomMsg = "Place finger...";
+    strcpy(bottomMsg, "Place finger...");
     oledShowState();
   }
 
-  if (mqttConnected && millis() - lastHeartbeat > 2000) {
-    String ts = getTimestamp();
-    if (ts.length() > 0) {
-      StaticJsonDocument<128> hb;
-      hb["ts"]     = ts;
-      hb["synced"] = isTimeSynced();
-      String hbPayload;
-      serializeJson(hb, hbPayload);
-      mqttPublish(TOPIC_HEARTBEAT, hbPayload);
-    }
-    lastHeartbeat = millis();
-  }
-
-  if (mqttConnected && isTimeSynced() &&
-      offlineCount > 0 && millis() - lastOfflineSync > 3000) {
-    syncOfflineAttendance();
-    lastOfflineSync = millis();
-  }
-
-  if (newStateReceived) {
-    newStateReceived = false;
-    String s(mqttStateBuf);
-    Serial.printf("[State] → %s\n", s.c_str());
-    if (s == "ENROLL") {
-      currentState = ENROLL;
+  showNetNotices();
+  commitRosterIfDue();
+  bootClockStep();
+  sensorLedsStep();
+  serialConsoleStep();
+
+  SystemStateMsg state;
+  while (stateIn.pop(state)) {
+    Serial.printf("[State] → %s\n", state.state);
+    if (strcmp(state.state, "ENROLL") == 0) {
+      if (currentState != ENROLL) enrollBegin();
+    } else if (currentState == ENROLL) {
+      enrollCancel();
     } else {
-      currentState   = VERIFY;
       welcomeShownAt = 0;
-      bottomMsg      = "Place finger...";
+      strcpy(bottomMsg, "Place finger...");
       oledShowState();
     }
   }
 
   if (currentState == ENROLL) {
-    welcomeShownAt = 0;
-    oledBottom("Enrollment Started...", true);
-    Serial.println("[Enroll] Waiting for fp/enrollData...");
-
-    unsigned long waitStart = millis();
-    while (!newEnrollReceived && millis() - waitStart < 12000) {
-      mqttClient.loop();
-      if (millis() - lastTopUpdate > 1000) { oledTop(); lastTopUpdate = millis(); }
-      delay(50);
-    }
-
-    if (newEnrollReceived) {
-      newEnrollReceived = false;
-      Serial.printf("[Enroll] Data: name=%s regNum=%s\n",
-                    mqttEnrollNameBuf, mqttEnrollRegBuf);
-      enrollFinger();
-      oledBottom("Enrollment Complete!", true);
-      delay(1000);
-    } else {
-      Serial.println("[Enroll] Timeout — no fp/enrollData received");
-      oledBottom("No enroll data!", true);
-      digitalWrite(RED_LED, HIGH); delay(1500); digitalWrite(RED_LED, LOW);
-    }
-
-    memset(mqttEnrollNameBuf, 0, STUDENT_NAME_LEN);
-    memset(mqttEnrollRegBuf,  0, STUDENT_REG_LEN);
-    newEnrollReceived = false;
-
-    currentState = VERIFY;
-    mqttPublish(TOPIC_STATE_PUB, "VERIFY", true);
-    bottomMsg = "Place finger...";
-    oledShowState();
+    enrollStep();
   }
 
   if (currentState == VERIFY) {
     verifyFingerNonBlocking();
+    templateStep();
+    rosterSyncStep();
+    studentDeleteStep();
+    orphanCensusStep();
   }
 
+  stageHist[ST_LOOP].record(micros() - passStartUs);
   delay(10);
 }
 
-// ─────────────────────────────────────────────────────────────
-//  MQTT CALLBACK
-// ─────────────────────────────────────────────────────────────
-void mqttCallback(char *topic, byte *payload, unsigned int length) {
-  char buf[MQTT_BUF_SIZE];
-  unsigned int len = min(length, (unsigned int)(MQTT_BUF_SIZE - 1));
-  memcpy(buf, payload, len);
-  buf[len] = '\0';
-
-  String topicStr(topic);
-  Serial.printf("[MQTT] ← %s : %s\n", topic, buf);
-
-  if (topicStr == TOPIC_SYS_STATE) {
-    strncpy(mqttStateBuf, buf, sizeof(mqttStateBuf) - 1);
-    mqttStateBuf[sizeof(mqttStateBuf) - 1] = '\0';
-    newStateReceived = true;
-    return;
-  }
+//  Sensor side of netQueue. A full queue means the network task has
+//  been stalled for NET_QUEUE_LEN events; the caller reports it.
+bool netPost(const NetEvent &e) {
+  if (netQueue.push(e)) return true;
+  netQueueDrops++;
+  Serial.printf("[Net] Queue full — event %d dropped (%lu so far)\n",
+                (int)e.type, (unsigned long)netQueueDrops);
+  return false;
+}
 
-  if (topicStr == TOPIC_ENROLL_DATA) {
-    StaticJsonDocument<256> doc;
-    if (deserializeJson(doc, buf) == DeserializationError::Ok) {
-      strncpy(mqttEnrollNameBuf, doc["name"]   | "", STUDENT_NAME_LEN - 1);
-      strncpy(mqttEnrollRegBuf,  doc["regNum"] | "", STUDENT_REG_LEN  - 1);
-      mqttEnrollNameBuf[STUDENT_NAME_LEN - 1] = '\0';
-      mqttEnrollRegBuf[STUDENT_REG_LEN   - 1] = '\0';
-      newEnrollReceived = true;
-      Serial.printf("[MQTT] Enroll parsed: %s / %s\n",
-                    mqttEnrollNameBuf, mqttEnrollRegBuf);
-    } else {
-      Serial.println("[MQTT] fp/enrollData parse FAILED");
-    }
-    return;
-  }
+void netPostText(NetEventType type, const char *text) {
+  NetEvent e;
+  e.type  = type;
+  e.slot  = 0;
+  e.epoch = 0;
+  strncpy(e.text, text, sizeof(e.text) - 1);
+  e.text[sizeof(e.text) - 1] = '\0';
+  netPost(e);
 }
 
-// ─────────────────────────────────────────────────────────────
-//  MQTT publish helper
-// ─────────────────────────────────────────────────────────────
-bool mqttPublish(const char *topic, const String &payload, bool retained) {
-  if (!mqttClient.connected()) return false;
-  bool ok = mqttClient.publish(topic, payload.c_str(), retained);
-  Serial.printf("[MQTT] %s → %s\n", ok ? "PUB" : "FAIL", topic);
-  return ok;
+//  Shows what the network task posted. Waits out the welcome hold so
+//  sync chatter never hides a student's name.
+void showNetNotices() {
+  if (welcomeShownAt > 0) return;
+  const char *notice = netNotice.exchange(nullptr);
+  if (notice) oledBottom(notice);
+  int8_t progress = netProgress.exchange(-1);
+  if (progress >= 0) oledProgressBar((uint8_t)progress);
 }
 
 // ─────────────────────────────────────────────────────────────
-//  OLED — top half
+//  NETWORK TASK
 // ─────────────────────────────────────────────────────────────
-void oledTop() {
-  display.fillRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
-  display.setTextSize(1);
-
-  display.setCursor(0, 0);
-  display.print(WiFi.status() == WL_CONNECTED ? "WiFi:Ok" : "WiFi:X");
-  display.setCursor(85, 0);
-  display.print(mqttConnected ? "MQTT:Ok" : "MQTT:X");
-
-  struct tm t;
-  char buf[22];
-  if (isTimeSynced() && getLocalTime(&t)) {
-    strftime(buf, sizeof(buf), "%d-%m | %H:%M:%S", &t);
-  } else {
-    strncpy(buf, "No time sync", sizeof(buf));
+unsigned long lastHeartbeat    = 0;
+unsigned long lastPublishAt    = 0;   // any successful publish
+uint32_t      heartbeatIdleMs  = HEARTBEAT_IDLE_MS;
+unsigned long lastOfflineSync  = 0;
+bool          offlineDraining  = false;
+bool          offlineSyncNow   = false;   // fp/cmd "flush": skip the wait
+uint16_t      offlineSyncTotal = 0;
+
+void networkTask(void *param) {
+  (void)param;
+  Serial.printf("[Net] Task running on core %d\n", (int)xPortGetCoreID());
+  for (;;) {
+    networkStep();
+    vTaskDelay(pdMS_TO_TICKS(NET_TASK_PERIOD_MS));
   }
-  display.getTextBounds(buf, 0, 20, &tx1, &ty1, &tw, &th);
-  display.setCursor((SCREEN_WIDTH - tw) / 2, 20);
-  display.println(buf);
-
-  String label = "FOC - SE";
-  display.setTextSize(2);
-  display.getTextBounds(label, 0, 40, &tx1, &ty1, &tw, &th);
-  display.setCursor((SCREEN_WIDTH - tw) / 2, 40);
-  display.println(label);
-  display.setTextSize(1);
-
-  display.drawLine(0, SCREEN_HEIGHT / 2 - 1,
-                   SCREEN_WIDTH, SCREEN_HEIGHT / 2 - 1, SH110X_WHITE);
-  display.display();
 }
 
-// ─────────────────────────────────────────────────────────────
-//  OLED — bottom half
-// ─────────────────────────────────────────────────────────────
-void oledBottom(const String &msg, bool sendToMQTT) {
-  bottomMsg = msg;
-  display.fillRect(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
-  display.setCursor(0, SCREEN_HEIGHT / 2 + 2);
-  display.println(bottomMsg);
+void networkStep() {
+  linkStep();
+  if (linkState == LINK_UP) mqttClient.loop();
 
-  if (WiFi.status() != WL_CONNECTED || !mqttConnected) {
-    display.setCursor(0, SCREEN_HEIGHT - 10);
-    display.print("Offline: ");
-    display.print(offlineCount);
+  if (linkState >= LINK_MQTT_WAIT &&
+      millis() - lastNTPResync > NTP_RESYNC_INTERVAL_MS) {
+    triggerNTPResync();
+    lastNTPResync = millis();
   }
-  display.display();
 
-  if (sendToMQTT && mqttConnected) {
-    StaticJsonDocument<128> doc;
-    doc["msg"] = bottomMsg;
-    String p;
-    serializeJson(doc, p);
-    mqttPublish(TOPIC_MESSAGE, p);
+  drainNetQueue();
+  if (mqttConnected) templateExportStep();
+
+  if (mqttConnected && (millis() - lastPublishAt >= heartbeatIdleMs ||
+                        millis() - lastHeartbeat >= HEARTBEAT_TELEMETRY_MS)) {
+    // Sent unsynced too (without ts): liveness does not depend on NTP.
+    // Heap figures let the dashboard spot fragmentation on a
+    // long-running station: heapMin is the low-water mark since
+    // boot, heapBlock the largest single allocation still possible
+    char     ts[TS_LEN];
+    uint32_t epoch = currentEpoch();
+    StaticJsonDocument<256> hb;
+    if (epoch) {
+      formatTimestamp(epoch, ts, sizeof(ts));
+      hb["ts"] = ts;
+    }
+    hb["synced"]    = epoch != 0;
+    hb["heap"]      = ESP.getFreeHeap();
+    hb["heapMin"]   = ESP.getMinFreeHeap();
+    hb["heapBlock"] = ESP.getMaxAllocHeap();
+    // How far millis() had wandered from NTP at the last resync
+    TimeAnchor::Stats clk = clockAnchor.stats();
+    hb["driftMs"]   = clk.lastDriftMs;
+    hb["driftPpm"]  = clk.driftPpm;
+    uint32_t matches = matchCount.exchange(0);
+    uint32_t sumMs   = matchSumMs.exchange(0);
+    uint32_t maxMs   = matchMaxMs.exchange(0);
+    if (matches) {
+      hb["scans"]      = matches;
+      hb["matchMs"]    = sumMs / matches;
+      hb["matchMaxMs"] = maxMs;
+    }
+    uint32_t repeats = repeatCount.exchange(0);
+    if (repeats) hb["repeats"] = repeats;
+    char payload[MQTT_PAYLOAD_MAX(TOPIC_HEARTBEAT) + 1];
+    serializeJson(hb, payload, sizeof(payload));
+    mqttPublish(TOPIC_HEARTBEAT, payload);
+    lastHeartbeat = lastPublishAt = millis();   // no retry storm if it failed
   }
-}
 
-void oledBottomRefresh() { oledBottom(bottomMsg); }
+  if (mqttConnected && millis() - metricsWindowAt >= METRICS_INTERVAL_MS) publishMetrics();
 
-void oledShowState() {
-  display.fillRect(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
-  display.setTextSize(2);
-  String stateLabel = (currentState == ENROLL) ? "ENROLL" : "VERIFY";
-  display.getTextBounds(stateLabel, 0, SCREEN_HEIGHT / 2 + 2, &tx1, &ty1, &tw, &th);
-  display.setCursor((SCREEN_WIDTH - tw) / 2, SCREEN_HEIGHT / 2 + 2);
-  display.println(stateLabel);
-  display.setTextSize(1);
-  display.setCursor(0, SCREEN_HEIGHT / 2 + 22);
-  display.println(bottomMsg);
-  if (WiFi.status() != WL_CONNECTED || !mqttConnected) {
-    display.setCursor(0, SCREEN_HEIGHT - 10);
-    display.print("Offline: ");
-    display.print(offlineCount);
+  // One batch per pass so queued events keep flowing while a backlog drains
+  if (mqttConnected && isTimeSynced() && offlineJournal.count() > 0 &&
+      (offlineDraining || offlineSyncNow || millis() - lastOfflineSync > 3000)) {
+    offlineSyncNow  = false;
+    offlineDraining = syncOfflineAttendance();
+    lastOfflineSync = millis();
   }
-  display.display();
 }
 
-void oledProgressBar(uint8_t percent) {
-  uint8_t barWidth  = SCREEN_WIDTH - 4;
-  uint8_t fillWidth = (barWidth * percent) / 100;
-  display.fillRect(2, SCREEN_HEIGHT - 12, barWidth, 10, SH110X_BLACK);
-  display.drawRect(2, SCREEN_HEIGHT - 12, barWidth, 10, SH110X_WHITE);
-  if (fillWidth > 0)
-    display.fillRect(2, SCREEN_HEIGHT - 12, fillWidth, 10, SH110X_WHITE);
-  display.display();
-}
+void drainNetQueue() {
+  NetEvent e;
+  while (netQueue.pop(e)) {
+    switch (e.type) {
+      case NET_ATTENDANCE:
+        deliverAttendance(e);
+        break;
 
-// ─────────────────────────────────────────────────────────────
-//  ENROLLMENT
-// ─────────────────────────────────────────────────────────────
-void enrollFinger() {
-  if (studentCount >= MAX_STUDENTS) {
-    oledBottom("Max students!", true);
-    digitalWrite(RED_LED, HIGH); delay(1000); digitalWrite(RED_LED, LOW);
-    return;
-  }
+      case NET_ENROLLED: {
+        char enrolledAt[TS_LEN] = "";
+        if (e.epoch) formatTimestamp(e.epoch, enrolledAt, sizeof(enrolledAt));
+        StaticJsonDocument<256> doc;
+        doc["id"]         = e.slot;
+        doc["name"]       = e.student.name;
+        doc["regNum"]     = e.student.regNum;
+        doc["enrolledAt"] = enrolledAt;
+        char payload[MQTT_PAYLOAD_MAX(TOPIC_ENROLLED) + 1];
+        serializeJson(doc, payload, sizeof(payload));
+        mqttPublish(TOPIC_ENROLLED, payload);
+        break;
+      }
 
-  String name   = String(mqttEnrollNameBuf);
-  String regNum = String(mqttEnrollRegBuf);
+      case NET_MESSAGE: {
+        if (!mqttConnected) break;   // prompts are only useful live
+        StaticJsonDocument<128> doc;
+        doc["msg"] = e.text;
+        char payload[MQTT_PAYLOAD_MAX(TOPIC_MESSAGE) + 1];
+        serializeJson(doc, payload, sizeof(payload));
+        mqttPublish(TOPIC_MESSAGE, payload);
+        break;
+      }
 
-  if (name.length() == 0 || regNum.length() == 0) {
-    oledBottom("Invalid data!", true);
-    digitalWrite(RED_LED, HIGH); delay(1000); digitalWrite(RED_LED, LOW);
-    return;
-  }
+      case NET_STATE_ACK:
+        mqttPublish(TOPIC_STATE_PUB, e.text, true);
+        break;
 
-  uint8_t id = studentCount + 1;
-  int p      = -1;
+      case NET_ROSTER_VERSION: {
+        StaticJsonDocument<96> doc;
+        doc["v"] = rosterVersion.load();
+        if (e.text[0]) doc["error"] = e.text;
+        char payload[MQTT_PAYLOAD_MAX(TOPIC_ROSTER_VER) + 1];
+        serializeJson(doc, payload, sizeof(payload));
+        mqttPublish(TOPIC_ROSTER_VER, payload);   // lost offline: announced again on connect
+        break;
+      }
 
-  oledProgressBar(0);
-  oledBottom("Place finger to enroll...", true);
-  unsigned long start = millis();
-
-  while ((p = finger.getImage()) != FINGERPRINT_OK) {
-    if (p != FINGERPRINT_NOFINGER) oledBottom("Image error!", true);
-    oledProgressBar((uint8_t)min(100UL, (millis() - start) * 100UL / 15000UL));
-    if (millis() - lastTopUpdate > 1000) { oledTop(); lastTopUpdate = millis(); }
-    if (millis() - start > 15000UL) {
-      oledBottom("Enroll timeout", true);
-      oledProgressBar(0);
-      return;
-    }
-    delay(80);
-  }
-  oledProgressBar(0);
+      case NET_STUDENT_DELETED: {
+        StaticJsonDocument<160> reply;
+        reply["op"]   = "delete";
+        reply["slot"] = e.slot;
+        publishCommandAck(reply, e.text[0] ? e.text : nullptr);   // lost offline, like any ack
+        break;
+      }
 
-  if (finger.image2Tz(1) != FINGERPRINT_OK) {
-    oledBottom("Image fail", true);
-    digitalWrite(RED_LED, HIGH); delay(1000); digitalWrite(RED_LED, LOW);
-    return;
-  }
+      case NET_ORPHANS: {
+        char   payload[MQTT_PAYLOAD_MAX(TOPIC_CMD_ACK) + 1];
+        size_t len = snprintf(payload, sizeof(payload),
+                              "{\"op\":\"orphans\",\"station\":\"%s\",\"ok\":true,\"count\":%u,\"slots\":[",
+                              stationId, (unsigned)e.slot);
+        for (uint8_t i = 0; i < e.slot && i < ORPHANS_LISTED; i++)
+          len += snprintf(payload + len, sizeof(payload) - len, "%s%u", i ? "," : "", (unsigned)e.slots[i]);
+        snprintf(payload + len, sizeof(payload) - len, "]}");
+        mqttPublish(TOPIC_CMD_ACK, payload);
+        break;
+      }
 
-  if (finger.fingerSearch() == FINGERPRINT_OK) {
-    oledBottom("Already Enrolled!", true);
-    digitalWrite(RED_LED, HIGH); delay(1000); digitalWrite(RED_LED, LOW);
-    return;
+      case NET_TEMPLATE_STORED: {
+        // Lost while offline: the bridge sends the model again
+        StaticJsonDocument<128> doc;
+        doc["slot"] = e.slot;
+        doc["ok"]   = e.text[0] == '\0';
+        if (e.text[0]) doc["error"] = e.text;
+        char payload[MQTT_PAYLOAD_MAX(TOPIC_TPL_STORED) + 1];
+        serializeJson(doc, payload, sizeof(payload));
+        mqttPublish(TOPIC_TPL_STORED, payload);
+        break;
+      }
+    }
   }
+}
 
-  oledBottom("Remove finger", true);
-  delay(800);
-  while (finger.getImage() != FINGERPRINT_NOFINGER) delay(20);
+//  Publishes a scan live, or journals it when that is not possible.
+void deliverAttendance(const NetEvent &e) {
+  char timestamp[TS_LEN] = "";
+  if (e.epoch) formatTimestamp(e.epoch, timestamp, sizeof(timestamp));
 
-  oledProgressBar(0);
-  oledBottom("Place again...", true);
-  start = millis();
-
-  while ((p = finger.getImage()) != FINGERPRINT_OK) {
-    if (p != FINGERPRINT_NOFINGER) oledBottom("Image error!", true);
-    oledProgressBar((uint8_t)min(100UL, (millis() - start) * 100UL / 15000UL));
-    if (millis() - lastTopUpdate > 1000) { oledTop(); lastTopUpdate = millis(); }
-    if (millis() - start > 15000UL) {
-      oledBottom("Enroll timeout", true);
-      oledProgressBar(0);
-      return;
-    }
-    delay(80);
+  if (mqttConnected && e.epoch) {
+    StaticJsonDocument<300> doc;
+    doc["id"]        = e.slot;
+    doc["name"]      = e.student.name;
+    doc["regNum"]    = e.student.regNum;
+    doc["timestamp"] = timestamp;
+    doc["ntpSynced"] = true;
+    char payload[MQTT_PAYLOAD_MAX(TOPIC_ATTENDANCE) + 1];
+    serializeJson(doc, payload, sizeof(payload));
+    if (mqttPublish(TOPIC_ATTENDANCE, payload)) return;
   }
-  oledProgressBar(0);
 
-  if (finger.image2Tz(2) != FINGERPRINT_OK) {
-    oledBottom("2nd fail", true);
-    digitalWrite(RED_LED, HIGH); delay(900); digitalWrite(RED_LED, LOW);
-    return;
+  Attendance rec;
+  rec.id    = e.slot;
+  rec.epoch = e.epoch ? e.epoch : e.uptimeS;
+  rec.flags = e.epoch ? 0 : (uint8_t)(ATT_FLAG_UNSYNCED | bootMeta.boot << ATT_BOOT_SHIFT);
+  bool stored;
+  {
+    EepromLock lock;
+    StageTimer t(ST_COMMIT);
+    // Set first: an anchor written before this commits with it, one
+    // written after sees the flag and commits itself
+    if (!e.epoch) bootUnsyncedStored = true;
+    stored = offlineJournal.append(&rec);
   }
-  if (finger.createModel() != FINGERPRINT_OK) {
-    oledBottom("Model fail", true);
-    digitalWrite(RED_LED, HIGH); delay(900); digitalWrite(RED_LED, LOW);
-    return;
-  }
-  if (finger.storeModel(id) != FINGERPRINT_OK) {
-    oledBottom("Store fail", true);
-    digitalWrite(RED_LED, HIGH); delay(900); digitalWrite(RED_LED, LOW);
-    return;
+  if (stored) {
+    metricOffline++;
+    if (mqttConnected) netNotice = "Saved offline!";
+    Serial.printf("[Verify] Stored offline (%d queued)\n", offlineJournal.count());
+  } else {
+    netNotice = "Offline full!";
+    Serial.println("[Verify] Offline buffer full");
   }
-
-  students[studentCount].id = id;
-  memset(students[studentCount].name,   0, STUDENT_NAME_LEN);
-  memset(students[studentCount].regNum, 0, STUDENT_REG_LEN);
-  name.toCharArray(students[studentCount].name,     STUDENT_NAME_LEN);
-  regNum.toCharArray(students[studentCount].regNum, STUDENT_REG_LEN);
-  studentCount++;
-  saveStudentsToEEPROM();
-
-  StaticJsonDocument<256> doc;
-  doc["id"]         = id;
-  doc["name"]       = name;
-  doc["regNum"]     = regNum;
-  doc["enrolledAt"] = getTimestamp();
-  String payload;
-  serializeJson(doc, payload);
-  mqttPublish(TOPIC_ENROLLED, payload);
-
-  oledBottom("Enroll Success: " + name, true);
-  Serial.printf("[Enroll] OK id=%d name=%s\n", id, name.c_str());
-  digitalWrite(GREEN_LED, HIGH); delay(900); digitalWrite(GREEN_LED, LOW);
 }
 
 // ─────────────────────────────────────────────────────────────
-//  VERIFICATION  (non-blocking, polled every 300ms)
+//  MQTT CALLBACK — inbound dispatch
 //
-//  Welcome hold:
-//    welcomeShownAt > 0  →  hold active, skip all sensor polling
-//    loop() clears it after 2000ms and reverts display
+//  INBOUND_ROUTES maps each subscribed topic to its handler; a topic
+//  is matched on its length (fixed at compile time) before its bytes.
+//  Payloads are parsed where PubSubClient received them, in
+//  ArduinoJson's zero-copy mode: strings in the document point into
+//  that buffer, so a handler copies what it keeps and reads nothing
+//  from the document after it publishes (a publish reuses the buffer).
+//  The table is also the subscription list (onMqttConnected()).
 // ─────────────────────────────────────────────────────────────
-void verifyFingerNonBlocking() {
-  static unsigned long lastCheck = 0;
+static bool parseInPlace(JsonDocument &doc, byte *payload, unsigned int length) {
+  return deserializeJson(doc, payload, length) == DeserializationError::Ok;
+}
 
-  // Block all sensor polling while welcome message is showing
-  if (welcomeShownAt > 0) return;
+// Each returns false if the payload does not parse
+static bool onSystemStateMsg(byte *payload, unsigned int length) {
+  SystemStateMsg m;
+  unsigned int n = min(length, (unsigned int)(sizeof(m.state) - 1));
+  memcpy(m.state, payload, n);
+  m.state[n] = '\0';
+  if (!stateIn.push(m)) Serial.println("[MQTT] State queue full — dropped");
+  return true;
+}
 
-  if (millis() - lastCheck < 300) return;
-  lastCheck = millis();
+static bool onEnrollDataMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<256> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  EnrollData d;
+  memset(&d, 0, sizeof(d));
+  strncpy(d.name,   doc["name"]   | "", STUDENT_NAME_LEN - 1);
+  strncpy(d.regNum, doc["regNum"] | "", STUDENT_REG_LEN  - 1);
+  Serial.printf("[MQTT] Enroll parsed: %s / %s\n", d.name, d.regNum);
+  if (!enrollIn.push(d)) Serial.println("[MQTT] Enroll data queue full — dropped");
+  return true;
+}
 
-  int p = finger.getImage();
-  if (p == FINGERPRINT_NOFINGER) {
-    if (!isTimeSynced()) {
-      oledBottom("No time sync!");
-    } else {
-      oledBottom("Place finger...");
-    }
-    return;
-  }
-  if (p != FINGERPRINT_OK)                  { oledBottom("Image error!");    return; }
-  if (finger.image2Tz(1) != FINGERPRINT_OK) { oledBottom("Image conv fail"); return; }
+// Sized for a whole window: an ack lists every seq of its batch, and
+// the bridge acks undated records together
+static bool onAttendanceAckMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<JSON_OBJECT_SIZE(1) + JSON_ARRAY_SIZE(SYNC_WINDOW_RECORDS)> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  for (JsonVariant seq : doc["acks"].as<JsonArray>()) onAttendanceAck(seq.as<uint32_t>());
+  return true;
+}
 
-  if (finger.fingerFastSearch() == FINGERPRINT_OK) {
-    uint8_t id     = finger.fingerID;
-    String  name   = "Unknown";
-    String  regNum = "";
+static bool onTemplateCmdMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<128> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  onTemplateCmd(doc["op"] | "", doc["from"] | (uint16_t)1);
+  return true;
+}
 
-    for (uint8_t i = 0; i < studentCount; i++) {
-      if (students[i].id == id) {
-        name   = String(students[i].name);
-        regNum = String(students[i].regNum);
-        break;
-      }
-    }
+static bool onTemplateAckMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<256> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  for (JsonVariant slot : doc["acks"].as<JsonArray>()) onTemplateAck(slot.as<uint16_t>());
+  return true;
+}
 
-    String timestamp  = getTimestamp();
-    bool   timeSyncOk = (timestamp.length() > 0);
+static bool onTemplateInMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<256> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  onTemplatePart(doc);
+  return true;
+}
 
-    if (timeSyncOk) {
-      // Show welcome and start the 2-second hold
-      oledBottom("Welcome:\n-> " + name);
-      welcomeShownAt = millis();
-    } else {
-      Serial.println("[Verify] Time not synced — storing offline");
-      oledBottom("No time sync!\nStored offline.");
-      // No hold for warning messages
+static bool onRosterDeltaMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<1024> doc;
+  if (!parseInPlace(doc, payload, length)) return false;
+  onRosterDelta(doc);
+  return true;
+}
+
+static bool onCommandMsg(byte *payload, unsigned int length);
+
+struct InboundRoute {
+  const char *topic;
+  uint8_t     len;
+  bool        quiet;   // not logged: model parts arrive back to back, mostly base64
+  bool      (*handle)(byte *payload, unsigned int length);
+};
+#define INBOUND_ROUTE(topic, quiet, handle) {topic, sizeof(topic) - 1, quiet, handle}
+
+// Busiest first: a model import is a stream of fp/templateIn
+const InboundRoute INBOUND_ROUTES[] = {
+  INBOUND_ROUTE(TOPIC_TPL_IN,       true,  onTemplateInMsg),
+  INBOUND_ROUTE(TOPIC_ATT_ACK,      false, onAttendanceAckMsg),
+  INBOUND_ROUTE(TOPIC_SYS_STATE,    false, onSystemStateMsg),
+  INBOUND_ROUTE(TOPIC_ENROLL_DATA,  false, onEnrollDataMsg),
+  INBOUND_ROUTE(TOPIC_ROSTER_DELTA, false, onRosterDeltaMsg),
+  INBOUND_ROUTE(TOPIC_TPL_ACK,      false, onTemplateAckMsg),
+  INBOUND_ROUTE(TOPIC_TPL_CMD,      false, onTemplateCmdMsg),
+  INBOUND_ROUTE(TOPIC_CMD,          false, onCommandMsg),
+};
+
+void mqttCallback(char *topic, byte *payload, unsigned int length) {
+  size_t topicLen = strlen(topic);
+  for (const InboundRoute &r : INBOUND_ROUTES) {
+    if (r.len != topicLen || memcmp(r.topic, topic, topicLen) != 0) continue;
+    if (!r.quiet) Serial.printf("[MQTT] ← %s : %.*s\n", topic, (int)length, (const char *)payload);
+    if (!r.handle(payload, length)) Serial.printf("[MQTT] %s parse FAILED\n", topic);
+    return;
+  }
+}
+
+// ─────────────────────────────────────────────────────────────
+//  COMMANDS — fleet operations on fp/cmd
+//
+//    {"op":"delete","slot":12}   the model on every sensor and the
+//                                roster entry, in one commit
+//    {"op":"intervals","pollMs":250,"idlePollMs":500,"heartbeatMs":30000,
+//     "repeatMs":60000}          any of them, until the next reboot
+//    {"op":"flush"}              send the offline backlog now,
+//                                resending what awaits an ack
+//    {"op":"metrics"}            publish the open fp/metrics window
+//                                without closing it
+//    {"op":"orphans"}            list the slots whose models have no
+//                                roster entry (see SLOT ALLOCATION)
+//
+//  With "to":"<client id>" only that station acts; without it every
+//  station that hears the command does. Each one is answered on
+//  fp/cmdAck with {"op","station","ok"} plus "error" or what it set;
+//  the sensor task answers a delete once it is done, and "orphans"
+//  with "count" and the first ORPHANS_LISTED "slots". A delete is
+//  local: the roster version stays, so it suits a bad model on one
+//  station or an orphan, while deleting under /students removes a
+//  student from every station through the roster log.
+// ─────────────────────────────────────────────────────────────
+static const char CMD_LATER[] = "";   // answered by the sensor task
+
+static const char *cmdDelete(JsonDocument &cmd, JsonDocument &reply) {
+  uint16_t slot = cmd["slot"] | (uint16_t)0;
+  reply["slot"] = slot;
+  if (slot == 0 || slot > ROSTER_MAX_SLOT) return "bad slot";
+  return studentDeletes.push(slot) ? CMD_LATER : "busy";
+}
+
+static const char *cmdOrphans(JsonDocument &, JsonDocument &) {
+  orphanReportRequest = true;
+  return CMD_LATER;
+}
+
+static const char *cmdIntervals(JsonDocument &cmd, JsonDocument &reply) {
+  uint32_t poll = cmd["pollMs"]      | capturePollMs.load();
+  uint32_t idle = cmd["idlePollMs"]  | capturePollIdleMs.load();
+  uint32_t hb   = cmd["heartbeatMs"] | heartbeatIdleMs;
+  uint32_t rep  = cmd["repeatMs"]    | scanRepeatWindowMs.load();
+  // All or nothing
+  if (poll < CAPTURE_POLL_FAST_MS || poll > CAPTURE_POLL_MAX_MS ||
+      idle < poll || idle > CAPTURE_POLL_IDLE_MAX_MS ||
+      hb < HEARTBEAT_IDLE_MIN_MS || hb > HEARTBEAT_TELEMETRY_MS ||
+      rep > SCAN_REPEAT_WINDOW_MAX_MS)
+    return "out of range";
+  capturePollMs      = poll;
+  capturePollIdleMs  = idle;
+  heartbeatIdleMs    = hb;
+  scanRepeatWindowMs = rep;
+  reply["pollMs"]      = poll;
+  reply["idlePollMs"]  = idle;
+  reply["heartbeatMs"] = hb;
+  reply["repeatMs"]    = rep;
+  Serial.printf("[Cmd] Poll %lu / %lu ms, heartbeat %lu ms, repeat window %lu ms\n",
+                (unsigned long)poll, (unsigned long)idle, (unsigned long)hb, (unsigned long)rep);
+  return nullptr;
+}
+
+static const char *cmdFlush(JsonDocument &, JsonDocument &reply) {
+  uint16_t queued = offlineJournal.count();
+  reply["queued"] = queued;
+  if (queued && !isTimeSynced()) return "no time yet";
+  if (queued) {
+    resetOfflineInFlight();   // the bridge stores by seq, so a resend is harmless
+    offlineSyncNow = true;
+  }
+  return nullptr;
+}
+
+static const char *cmdMetrics(JsonDocument &, JsonDocument &) {
+  publishMetrics(false);
+  return nullptr;
+}
+
+struct StationCommand {
+  const char *op;
+  const char *(*run)(JsonDocument &cmd, JsonDocument &reply);   // error, nullptr = done
+};
+
+const StationCommand STATION_COMMANDS[] = {
+  {"delete",    cmdDelete},
+  {"intervals", cmdIntervals},
+  {"flush",     cmdFlush},
+  {"metrics",   cmdMetrics},
+  {"orphans",   cmdOrphans},
+};
+
+static bool onCommandMsg(byte *payload, unsigned int length) {
+  StaticJsonDocument<256> cmd;
+  if (!parseInPlace(cmd, payload, length)) return false;
+  const char *to = cmd["to"] | "";
+  if (to[0] && strcmp(to, stationId) != 0) return true;   // for another station
+
+  StaticJsonDocument<192> reply;
+  const char *op  = cmd["op"] | "";
+  const char *err = "unknown op";
+  reply["op"] = op;
+  for (const StationCommand &c : STATION_COMMANDS) {
+    if (strcmp(c.op, op) != 0) continue;
+    reply["op"] = c.op;   // `op` lives in the receive buffer, which a publish reuses
+    err = c.run(cmd, reply);
+    break;
+  }
+  if (err != CMD_LATER) publishCommandAck(reply, err);
+  return true;
+}
+
+void publishCommandAck(JsonDocument &reply, const char *err) {
+  reply["station"] = stationId;
+  reply["ok"]      = err == nullptr;
+  if (err) reply["error"] = err;
+  char payload[MQTT_PAYLOAD_MAX(TOPIC_CMD_ACK) + 1];
+  serializeJson(reply, payload, sizeof(payload));
+  mqttPublish(TOPIC_CMD_ACK, payload);
+}
+
+//  Sensor side of "delete", in the roster delta's order: the entry and
+//  the slot's map bit, committed at once, then the models. A failed
+//  commit reloads both from flash, so the model stays.
+void studentDeleteStep() {
+  uint16_t slot;
+  if (!studentDeletes.pop(slot)) return;
+  const char *err = "";
+  uint8_t     idx = slotToStudent[slot];
+  if (idx != SLOT_UNMAPPED || slotInUse(slot)) {
+    if (idx != SLOT_UNMAPPED) removeStudent(idx);
+    markSlotInUse(slot, false);
+    saveStudentsToEEPROM();
+    if (!commitRosterIfDue(true)) {
+      loadStudentsFromEEPROM();   // the entry is back, and keeps its model
+      err = "commit failed";
     }
+  }
+  if (!err[0] && !deleteSlotModels(slot)) err = "sensor error";
+  Serial.printf("[Cmd] Delete slot %u: %s (%u students)\n", (unsigned)slot,
+                err[0] ? err : "done", (unsigned)studentCount);
+  NetEvent e;
+  e.type  = NET_STUDENT_DELETED;
+  e.slot  = slot;
+  e.epoch = 0;
+  strncpy(e.text, err, sizeof(e.text) - 1);
+  e.text[sizeof(e.text) - 1] = '\0';
+  netPost(e);
+}
 
-    digitalWrite(GREEN_LED, HIGH); delay(180); digitalWrite(GREEN_LED, LOW);
-    Serial.printf("[Verify] id=%d name=%s ts=%s synced=%d\n",
-                  id, name.c_str(), timestamp.c_str(), (int)timeSyncOk);
+// ─────────────────────────────────────────────────────────────
+//  MQTT publish helper
+// ─────────────────────────────────────────────────────────────
+bool mqttPublish(const char *topic, const char *payload, bool retained) {
+  if (!mqttClient.connected()) return false;
+  bool ok;
+  {
+    StageTimer t(ST_PUBLISH);
+    ok = mqttClient.publish(topic, payload, retained);
+  }
+  if (ok) lastPublishAt = millis();   // doubles as a heartbeat
+  Serial.printf("[MQTT] %s → %s\n", ok ? "PUB" : "FAIL", topic);
+  return ok;
+}
 
-    Attendance rec;
-    rec.id = id;
-    memset(rec.name,      0, STUDENT_NAME_LEN);
-    memset(rec.regNum,    0, STUDENT_REG_LEN);
-    memset(rec.timestamp, 0, TS_LEN);
-    name.toCharArray(rec.name,     STUDENT_NAME_LEN);
-    regNum.toCharArray(rec.regNum, STUDENT_REG_LEN);
-    if (timeSyncOk) {
-      timestamp.toCharArray(rec.timestamp, TS_LEN);
-    } else {
-      strncpy(rec.timestamp, "1970-01-01T00:00:00+05:30", TS_LEN - 1);
+// ─────────────────────────────────────────────────────────────
+//  METRICS — stage latencies on fp/metrics and the serial console
+//
+//  Each stage is a LatencyHist of µs. Every METRICS_INTERVAL_MS the
+//  network task takes the window and publishes, per stage that ran,
+//  [count, p50, p99, max], then the counters:
+//    {"s":60,"loop":[5890,48,192,2210],"image":[...],...,
+//     "match":3,"nomatch":1,"offline":0,"syncFail":0,"resumed":1,
+//     "ovhPpm":21,"bootMs":712,"firstScanMs":1530}
+//  ovhPpm is what the timers themselves cost over the window, from
+//  recordCostNs. bootMs and firstScanMs are since reset: verification
+//  starting, and the first match (0 until there is one). The
+//  console's "metrics" prints the open window without resetting it.
+// ─────────────────────────────────────────────────────────────
+void metricsCalibrate() {
+  LatencyHist scratch;
+  uint32_t    t0 = micros();
+  for (uint16_t i = 0; i < METRICS_CALIBRATE_RUNS; i++) {
+    uint32_t a = micros();
+    scratch.record(micros() - a);
+  }
+  recordCostNs    = (micros() - t0) * 1000UL / METRICS_CALIBRATE_RUNS;
+  metricsWindowAt = millis();
+  Serial.printf("[Metrics] %lu ns per timed stage\n", (unsigned long)recordCostNs);
+}
+
+static uint32_t overheadPpm(uint32_t records, uint32_t windowMs) {
+  return windowMs ? (uint32_t)((uint64_t)records * recordCostNs / windowMs) : 0;
+}
+
+//  closeWindow false (fp/cmd "metrics") publishes the open window,
+//  marked "open":true, and leaves it running
+void publishMetrics(bool closeWindow) {
+  uint32_t now      = millis();
+  uint32_t windowMs = now - metricsWindowAt;
+  if (closeWindow) metricsWindowAt = now;
+
+  static char payload[MQTT_PAYLOAD_MAX(TOPIC_METRICS) + 1];
+  uint32_t records = 0;
+  size_t   len = snprintf(payload, sizeof(payload), "{%s\"s\":%lu", closeWindow ? "" : "\"open\":true,",
+                          (unsigned long)(windowMs / 1000));
+  auto     count = [closeWindow](std::atomic<uint32_t> &c) {
+    return (unsigned long)(closeWindow ? c.exchange(0) : c.load());
+  };
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    LatencyHist::Snapshot snap = closeWindow ? stageHist[i].take() : stageHist[i].peek();
+    records += snap.n;
+    if (!snap.n || len + 200 > sizeof(payload)) continue;   // room for this and the counters
+    len += snprintf(payload + len, sizeof(payload) - len, ",\"%s\":[%lu,%lu,%lu,%lu]",
+                    STAGE_NAMES[i], (unsigned long)snap.n, (unsigned long)snap.quantileUs(0.5f),
+                    (unsigned long)snap.quantileUs(0.99f), (unsigned long)snap.maxUs);
+  }
+  snprintf(payload + len, sizeof(payload) - len,
+           ",\"match\":%lu,\"nomatch\":%lu,\"offline\":%lu,\"syncFail\":%lu,\"resumed\":%lu"
+           ",\"ovhPpm\":%lu,\"bootMs\":%lu,\"firstScanMs\":%lu}",
+           count(metricMatches), count(metricNoMatches), count(metricOffline),
+           count(metricSyncFails), count(metricTlsResumes),
+           (unsigned long)overheadPpm(records, windowMs), (unsigned long)bootReadyMs,
+           (unsigned long)firstScanMs.load());
+  mqttPublish(TOPIC_METRICS, payload);   // lost if it fails; the next window starts clean
+}
+
+static void printMetrics() {
+  uint32_t windowMs = millis() - metricsWindowAt;
+  uint32_t records  = 0;
+  Serial.printf("[Metrics] window %lu s\n", (unsigned long)(windowMs / 1000));
+  Serial.println("  stage         n     p50us     p99us     maxus    meanus");
+  for (uint8_t i = 0; i < STAGE_COUNT; i++) {
+    LatencyHist::Snapshot snap = stageHist[i].peek();
+    records += snap.n;
+    Serial.printf("  %-7s %7lu %9lu %9lu %9lu %9lu\n", STAGE_NAMES[i], (unsigned long)snap.n,
+                  (unsigned long)snap.quantileUs(0.5f), (unsigned long)snap.quantileUs(0.99f),
+                  (unsigned long)snap.maxUs, (unsigned long)snap.meanUs());
+  }
+  uint32_t ppm = overheadPpm(records, windowMs);
+  Serial.printf("  match %lu  nomatch %lu  offline %lu  syncFail %lu  resumed %lu  overhead %lu.%02lu%%\n",
+                (unsigned long)metricMatches.load(), (unsigned long)metricNoMatches.load(),
+                (unsigned long)metricOffline.load(), (unsigned long)metricSyncFails.load(),
+                (unsigned long)metricTlsResumes.load(),
+                (unsigned long)(ppm / 10000), (unsigned long)(ppm / 100 % 100));
+  Serial.printf("  boot: verifying at %lu ms, first scan at %lu ms\n", (unsigned long)bootReadyMs,
+                (unsigned long)firstScanMs.load());
+}
+
+//  Line-at-a-time commands from the USB serial port (loop task)
+void serialConsoleStep() {
+  static char    line[CONSOLE_LINE_LEN];
+  static uint8_t len = 0;
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if (c < 0) break;
+    if (c == '\r') continue;
+    if (c != '\n') {
+      if (len < sizeof(line) - 1) line[len++] = (char)c;
+      continue;
     }
+    line[len] = '\0';
+    len = 0;
+    if (line[0] == '\0') continue;
+    if (strcmp(line, "metrics") == 0) printMetrics();
+    else Serial.printf("[Console] Unknown command '%s' (try: metrics)\n", line);
+  }
+}
 
-    StaticJsonDocument<300> doc;
-    doc["id"]        = id;
-    doc["name"]      = name;
-    doc["regNum"]    = regNum;
-    doc["timestamp"] = rec.timestamp;
-    doc["ntpSynced"] = timeSyncOk;
-    String payload;
-    serializeJson(doc, payload);
-
-    bool shouldPublish = mqttConnected && timeSyncOk;
-
-    if (shouldPublish && mqttPublish(TOPIC_ATTENDANCE, payload)) {
-      // Published OK — welcome holds for 2s, loop() reverts display
-    } else {
-      if (offlineCount < MAX_OFFLINE_ATTENDANCE) {
-        offlineAttendance[offlineCount] = rec;
-        offlineCount++;
-        saveOfflineAttendanceToEEPROM();
-        if (timeSyncOk) {
-          welcomeShownAt = 0;   // cancel hold, show offline notice instead
-          oledBottom(mqttConnected ? "Saved offline!" : "Offline stored!");
+// ─────────────────────────────────────────────────────────────
+//  OLED — top half
+//
+//  The label and divider are drawn once; later calls repaint only
+//  the status and clock rows, and flush() sends just the columns
+//  that changed (normally the seconds digits).
+// ─────────────────────────────────────────────────────────────
+void oledTop() {
+  if (!topDrawn) {
+    display.fillRect(0, 0, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
+    const char *label = "FOC - SE";
+    display.setTextSize(2);
+    display.setCursor(display.centerX(label, 2), 40);
+    display.println(label);
+    display.drawLine(0, SCREEN_HEIGHT / 2 - 1,
+                     SCREEN_WIDTH, SCREEN_HEIGHT / 2 - 1, SH110X_WHITE);
+    topDrawn = true;
+  }
+  display.setTextSize(1);
+
+  display.fillRect(0, 0, SCREEN_WIDTH, 8, SH110X_BLACK);
+  display.setCursor(0, 0);
+  display.print(WiFi.status() == WL_CONNECTED ? "WiFi:Ok" : "WiFi:X");
+  display.setCursor(85, 0);
+  display.print(mqttConnected ? "MQTT:Ok" : "MQTT:X");
+
+  char     buf[22];
+  uint32_t epoch = currentEpoch();
+  if (epoch) {
+    clockAnchor.formatShort(epoch, buf, sizeof(buf));
+  } else {
+    strncpy(buf, "No time sync", sizeof(buf));
+  }
+  display.fillRect(0, 20, SCREEN_WIDTH, 8, SH110X_BLACK);
+  display.setCursor(display.centerX(buf, 1), 20);
+  display.println(buf);
+
+  display.flush();
+}
+
+// ─────────────────────────────────────────────────────────────
+//  OLED — bottom half
+// ─────────────────────────────────────────────────────────────
+static int16_t offlineShown() {
+  if (WiFi.status() == WL_CONNECTED && mqttConnected) return -1;
+  return (int16_t)offlineJournal.count();
+}
+
+static void oledOfflineLine(int16_t offline) {
+  bottomOffline = offline;
+  if (offline < 0) return;
+  display.setCursor(0, SCREEN_HEIGHT - 10);
+  display.print("Offline: ");
+  display.print((int)offline);
+}
+
+void oledBottom(const char *msg, bool sendToMQTT) {
+  int16_t offline = offlineShown();
+  if (bottomView != BOTTOM_MESSAGE || offline != bottomOffline || strcmp(msg, bottomMsg) != 0) {
+    if (msg != bottomMsg) {
+      strncpy(bottomMsg, msg, BOTTOM_MSG_LEN - 1);
+      bottomMsg[BOTTOM_MSG_LEN - 1] = '\0';
+    }
+    bottomView = BOTTOM_MESSAGE;
+    display.fillRect(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
+    display.setTextSize(1);
+    display.setCursor(0, SCREEN_HEIGHT / 2 + 2);
+    display.println(bottomMsg);
+    oledOfflineLine(offline);
+    display.flush();
+  }
+
+  if (sendToMQTT && mqttConnected) netPostText(NET_MESSAGE, bottomMsg);
+}
+
+void oledBottomRefresh() {
+  bottomView = BOTTOM_OTHER;
+  oledBottom(bottomMsg);
+}
+
+void oledShowState() {
+  bottomView = BOTTOM_STATE;
+  display.fillRect(0, SCREEN_HEIGHT / 2, SCREEN_WIDTH, SCREEN_HEIGHT / 2, SH110X_BLACK);
+  const char *stateLabel = (currentState == ENROLL) ? "ENROLL" : "VERIFY";
+  display.setTextSize(2);
+  display.setCursor(display.centerX(stateLabel, 2), SCREEN_HEIGHT / 2 + 2);
+  display.println(stateLabel);
+  display.setTextSize(1);
+  display.setCursor(0, SCREEN_HEIGHT / 2 + 22);
+  display.println(bottomMsg);
+  oledOfflineLine(offlineShown());
+  display.flush();
+}
+
+void oledProgressBar(uint8_t percent) {
+  uint8_t barWidth  = SCREEN_WIDTH - 4;
+  uint8_t fillWidth = (barWidth * percent) / 100;
+  bottomView = BOTTOM_OTHER;
+  display.fillRect(2, SCREEN_HEIGHT - 12, barWidth, 10, SH110X_BLACK);
+  display.drawRect(2, SCREEN_HEIGHT - 12, barWidth, 10, SH110X_WHITE);
+  if (fillWidth > 0)
+    display.fillRect(2, SCREEN_HEIGHT - 12, fillWidth, 10, SH110X_WHITE);
+  display.flush();
+}
+
+// ─────────────────────────────────────────────────────────────
+//  ENROLLMENT
+//
+//    WAIT_DATA ─▶ FIRST ─▶ LIFT ─▶ SECOND ─▶ RESULT ─▶ CLOSING ─▶ VERIFY
+//
+//  Each enrollStep() call makes at most one sensor transaction and
+//  returns, so loop() keeps the top bar, notices and the roster
+//  commit running. A fp/systemState other than ENROLL cancels the
+//  enrollment at any step.
+// ─────────────────────────────────────────────────────────────
+static void enrollEnter(EnrollStep step) {
+  enrollStage    = step;
+  enrollStageAt  = millis();
+  enrollNextPoll = enrollStageAt;
+  enrollBarPct   = -1;
+}
+
+//  Shows the outcome with its LED for holdMs. Outcomes reached after
+//  the enroll data arrived are followed by "Enrollment Complete!".
+static void enrollFinish(const char *msg, uint8_t led, uint32_t holdMs, bool closing = true) {
+  oledProgressBar(0);
+  oledBottom(msg, true);
+  enrollLed       = led;
+  enrollClosing   = closing;
+  enrollHoldUntil = millis() + holdMs;
+  if (led) digitalWrite(led, HIGH);
+  enrollEnter(ENROLL_RESULT);
+}
+
+static void enrollExit() {
+  if (enrollLed) digitalWrite(enrollLed, LOW);
+  enrollLed = 0;
+  while (enrollIn.pop(enrollData)) {}   // data for an enrollment that is over
+  memset(&enrollData, 0, sizeof(enrollData));
+  enrollStage       = ENROLL_IDLE;
+
+  currentState = VERIFY;
+  netPostText(NET_STATE_ACK, "VERIFY");
+  strcpy(bottomMsg, "Place finger...");
+  oledShowState();
+}
+
+void enrollBegin() {
+  currentState   = ENROLL;
+  welcomeShownAt = 0;
+  for (Sensor &s : sensors) s.step = CAPTURE_WAIT;   // buffer 1 is about to be reused
+  oledBottom("Enrollment Started...", true);
+  Serial.println("[Enroll] Waiting for fp/enrollData...");
+  enrollEnter(ENROLL_WAIT_DATA);
+}
+
+void enrollCancel() {
+  Serial.printf("[Enroll] Cancelled at step %d\n", (int)enrollStage);
+  oledProgressBar(0);
+  oledBottom("Enroll cancelled", true);
+  enrollExit();
+}
+
+//  Polls for a finger on the sensor. Returns true once an image is
+//  captured; a timeout finishes the enrollment.
+static bool enrollCapture() {
+  unsigned long now     = millis();
+  unsigned long elapsed = now - enrollStageAt;
+  if (elapsed > ENROLL_CAPTURE_TIMEOUT_MS) {
+    enrollFinish("Enroll timeout", 0, 0);
+    return false;
+  }
+  if ((long)(now - enrollNextPoll) < 0) return false;
+  enrollNextPoll = now + ENROLL_POLL_MS;
+
+  int p = finger.getImage();
+  if (p == FINGERPRINT_OK) {
+    oledProgressBar(0);
+    return true;
+  }
+  if (p != FINGERPRINT_NOFINGER) oledBottom("Image error!", true);
+  int8_t pct = (int8_t)(elapsed * 100UL / ENROLL_CAPTURE_TIMEOUT_MS);
+  if (pct != enrollBarPct) {
+    enrollBarPct = pct;
+    oledProgressBar((uint8_t)pct);
+  }
+  return false;
+}
+
+void enrollStep() {
+  unsigned long now = millis();
+
+  switch (enrollStage) {
+    case ENROLL_IDLE:
+      enrollBegin();
+      return;
+
+    case ENROLL_WAIT_DATA:
+      if (enrollIn.pop(enrollData)) {
+        Serial.printf("[Enroll] Data: name=%s regNum=%s\n",
+                      enrollData.name, enrollData.regNum);
+        if (studentCount >= MAX_STUDENTS) {
+          enrollFinish("Max students!", RED_LED, 1000);
+        } else if (!enrollData.name[0] || !enrollData.regNum[0]) {
+          enrollFinish("Invalid data!", RED_LED, 1000);
+        } else {
+          oledProgressBar(0);
+          oledBottom("Place finger to enroll...", true);
+          enrollEnter(ENROLL_FIRST);
         }
-        Serial.println("[Verify] Stored offline");
+      } else if (now - enrollStageAt >= ENROLL_DATA_TIMEOUT_MS) {
+        Serial.println("[Enroll] Timeout — no fp/enrollData received");
+        enrollFinish("No enroll data!", RED_LED, 1500, false);
+      }
+      return;
+
+    case ENROLL_FIRST:
+      if (!enrollCapture()) return;
+      enrollSlot = freeRosterSlot();   // may load a model into buffer 1
+      if (!enrollSlot) {
+        enrollFinish("No free slot!", RED_LED, 1000);
+      } else if (finger.image2Tz(1) != FINGERPRINT_OK) {
+        enrollFinish("Image fail", RED_LED, 1000);
+      } else if (finger.fingerSearch() == FINGERPRINT_OK) {
+        enrollFinish("Already Enrolled!", RED_LED, 1000);
       } else {
-        welcomeShownAt = 0;
-        oledBottom("Offline full!");
-        Serial.println("[Verify] Offline buffer full");
+        oledBottom("Remove finger", true);
+        enrollEnter(ENROLL_LIFT);
+        enrollNextPoll = now + ENROLL_LIFT_SETTLE_MS;
       }
+      return;
+
+    case ENROLL_LIFT:
+      if (now - enrollStageAt > ENROLL_CAPTURE_TIMEOUT_MS) {
+        enrollFinish("Enroll timeout", 0, 0);
+        return;
+      }
+      if ((long)(now - enrollNextPoll) < 0) return;
+      enrollNextPoll = now + ENROLL_POLL_MS;
+      if (finger.getImage() != FINGERPRINT_NOFINGER) return;
+      oledProgressBar(0);
+      oledBottom("Place again...", true);
+      enrollEnter(ENROLL_SECOND);
+      return;
+
+    case ENROLL_SECOND: {
+      if (!enrollCapture()) return;
+      uint16_t id = enrollSlot;
+      if (finger.image2Tz(2) != FINGERPRINT_OK) {
+        enrollFinish("2nd fail", RED_LED, 900);
+        return;
+      }
+      if (finger.createModel() != FINGERPRINT_OK) {
+        enrollFinish("Model fail", RED_LED, 900);
+        return;
+      }
+      if (finger.storeModel(id) != FINGERPRINT_OK) {
+        enrollFinish("Store fail", RED_LED, 900);
+        return;
+      }
+      markSlotInUse(id, true);
+
+      Student &st = students[studentCount];
+      st.id = id;
+      memset(st.name,   0, STUDENT_NAME_LEN);
+      memset(st.regNum, 0, STUDENT_REG_LEN);
+      strncpy(st.name,   enrollData.name,   STUDENT_NAME_LEN - 1);
+      strncpy(st.regNum, enrollData.regNum, STUDENT_REG_LEN - 1);
+      slotToStudent[id] = studentCount;
+      markStudentDirty(studentCount);
+      studentCount++;
+      saveStudentsToEEPROM();
+      if (sensorCount > 1) {
+        oledBottom("Copying to sensors...");
+        mirrorTemplate(id);
+      }
+
+      NetEvent e;
+      e.type  = NET_ENROLLED;
+      e.slot  = id;
+      e.epoch = currentEpoch();
+      memcpy(e.student.name,   st.name,   STUDENT_NAME_LEN);
+      memcpy(e.student.regNum, st.regNum, STUDENT_REG_LEN);
+      postAfterCommit(e);
+
+      Serial.printf("[Enroll] OK id=%d name=%s\n", id, st.name);
+      char msg[BOTTOM_MSG_LEN];
+      snprintf(msg, sizeof(msg), "Enroll Success: %s", st.name);
+      enrollFinish(msg, GREEN_LED, 900);
+      return;
     }
-  } else {
-    oledBottom("No Match!");
-    digitalWrite(RED_LED, HIGH); delay(150); digitalWrite(RED_LED, LOW);
+
+    case ENROLL_RESULT:
+      if ((long)(now - enrollHoldUntil) < 0) return;
+      if (enrollLed) digitalWrite(enrollLed, LOW);
+      enrollLed = 0;
+      if (!enrollClosing) { enrollExit(); return; }
+      oledBottom("Enrollment Complete!", true);
+      enrollHoldUntil = now + 1000;
+      enrollEnter(ENROLL_CLOSING);
+      return;
+
+    case ENROLL_CLOSING:
+      if ((long)(now - enrollHoldUntil) >= 0) enrollExit();
+      return;
   }
 }
 
 // ─────────────────────────────────────────────────────────────
-//  WiFi reconnect
+//  VERIFICATION  (non-blocking; the sensors take turns, one UART
+//  transaction each, so a scan on one never holds up the others)
+//
+//    WAIT ──image──▶ CONVERT ──▶ SEARCH ──match──▶ HOLD ──▶ WAIT
+//      ▲  (captureDue())            │ no match       │ WELCOME_HOLD_MS
+//      └────────────────────────────┴────────────────┘
+//
+//  Welcome hold:
+//    welcomeShownAt > 0  →  the name stays on the display
+//    loop() clears it after WELCOME_HOLD_MS and reverts the display;
+//    the sensor that matched is not polled meanwhile
 // ─────────────────────────────────────────────────────────────
-void reconnectWiFi() {
-  if (WiFi.status() == WL_CONNECTED) return;
-  Serial.println("[WiFi] Reconnecting...");
-  WiFi.disconnect();
-  WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
-  unsigned long start = millis();
-  while (WiFi.status() != WL_CONNECTED && millis() - start < 10000)
-    delay(200);
-  if (WiFi.status() == WL_CONNECTED) {
-    Serial.println("[WiFi] Connected: " + WiFi.localIP().toString());
-    triggerNTPResync();
-    lastNTPResync = millis();
+void IRAM_ATTR onTouch(void *arg) {
+  Sensor *s    = (Sensor *)arg;
+  s->touchAtMs = millis();
+  s->touched   = true;
+}
+
+// Whether getImage() is worth a UART transaction now. s.detectAt is
+// when the finger most likely arrived: the touch edge, or without
+// the line, midway between the last empty poll and this one.
+static bool captureDue(Sensor &s) {
+  unsigned long now = millis();
+  if (s.port.touch >= 0) {
+    bool edge = s.touched.exchange(false);
+    if (!edge && (digitalRead(s.port.touch) == LOW || now - s.lastPollAt < CAPTURE_POLL_FAST_MS))
+      return false;
+    s.detectAt = s.touchAtMs;
+  } else {
+    uint32_t quiet    = now - s.lastFingerAt;
+    uint32_t interval = capturePollIdleMs.load(std::memory_order_relaxed);
+    if (s.lastFingerAt && quiet <= CAPTURE_IDLE_AFTER_MS)
+      interval = capturePollMs.load(std::memory_order_relaxed);
+    if (s.prevFingerAt && quiet <= CAPTURE_BUSY_GAP_MS &&
+        s.lastFingerAt - s.prevFingerAt <= CAPTURE_BUSY_GAP_MS)
+      interval = CAPTURE_POLL_FAST_MS;
+    if (now - s.lastPollAt < interval) return false;
+    s.detectAt = s.lastPollAt + (now - s.lastPollAt) / 2;
+  }
+  s.lastPollAt = now;
+  return true;
+}
+
+static void noteMatchLatency(uint32_t ms) {
+  matchCount++;
+  matchSumMs += ms;
+  if (ms > matchMaxMs.load()) matchMaxMs = ms;
+}
+
+// True if `slot` was sent within scanRepeatWindowMs
+static bool isRepeatScan(uint16_t slot, uint32_t now) {
+  uint32_t window = scanRepeatWindowMs.load(std::memory_order_relaxed);
+  for (const RecentScan &r : recentScans)
+    if (r.slot == slot && now - r.atMs < window) return true;
+  return false;
+}
+
+// Reuses the slot's own entry, else a free one, else the oldest
+static void rememberScan(uint16_t slot, uint32_t now) {
+  RecentScan *use = &recentScans[0];
+  for (RecentScan &r : recentScans) {
+    if (r.slot == slot) { use = &r; break; }
+    if (use->slot != 0 && (r.slot == 0 || now - r.atMs > now - use->atMs)) use = &r;
+  }
+  use->slot = slot;
+  use->atMs = now;
+}
+
+static void showIdlePrompt() {
+  if ((long)(millis() - sensorMsgUntil) < 0) return;   // another sensor's result is up
+  oledBottom(isTimeSynced() ? "Place finger..." : "No time sync!");
+}
+
+static void sensorMessage(const char *msg) {
+  oledBottom(msg);
+  sensorMsgUntil = millis() + SENSOR_MSG_HOLD_MS;
+}
+
+// Lights one of the sensor's LEDs for ms; sensorLedsStep() turns it off
+static void flashLed(Sensor &s, uint8_t pin, uint32_t ms) {
+  if (s.ledLit && s.ledLit != pin) digitalWrite(s.ledLit, LOW);
+  digitalWrite(pin, HIGH);
+  s.ledLit   = pin;
+  s.ledOffAt = millis() + ms;
+}
+
+void sensorLedsStep() {
+  unsigned long now = millis();
+  for (Sensor &s : sensors) {
+    if (!s.ledLit || (long)(now - s.ledOffAt) < 0) continue;
+    digitalWrite(s.ledLit, LOW);
+    s.ledLit = 0;
+  }
+}
+
+static void onMatch(Sensor &s, uint16_t id) {
+  noteMatchLatency(millis() - s.detectAt);
+  const Student *st     = studentForSlot(id);
+  const char    *name   = st ? st->name   : "Unknown";
+  const char    *regNum = st ? st->regNum : "";
+
+  uint32_t epoch;
+  {
+    StageTimer t(ST_CLOCK);
+    epoch = currentEpoch();
+  }
+  bool     timeSyncOk = (epoch != 0);
+  uint32_t now        = millis();
+  bool     repeat     = isRepeatScan(id, now);
+  metricMatches++;
+  if (firstScanMs.load() == 0) {
+    firstScanMs = now | 1;   // 0 means "none yet"
+    Serial.printf("[Boot] First scan %lu ms after reset\n", (unsigned long)now);
+  }
+
+  // Hand the scan over first; publishing or journaling it is the
+  // network task's job and never holds up the display below. A
+  // repeat was handed over already.
+  if (repeat) {
+    repeatCount++;
   } else {
-    Serial.println("[WiFi] Failed");
+    NetEvent e;
+    e.type  = NET_ATTENDANCE;
+    e.slot  = id;
+    e.epoch   = epoch;
+    e.uptimeS = uptimeS();
+    strncpy(e.student.name,   name,   STUDENT_NAME_LEN - 1);
+    strncpy(e.student.regNum, regNum, STUDENT_REG_LEN  - 1);
+    e.student.name[STUDENT_NAME_LEN - 1] = '\0';
+    e.student.regNum[STUDENT_REG_LEN - 1] = '\0';
+    if (!netPost(e)) {
+      sensorMessage("Busy! Scan again");
+      flashLed(s, s.port.redLed, 150);
+      return;
+    }
+    rememberScan(id, now);
+  }
+
+  // Without NTP the scan is journaled by uptime and dated once this
+  // boot's clock is anchored (see BOOT CLOCK), so it counts all the same
+  if (!timeSyncOk && !repeat) Serial.println("[Verify] Time not synced — stamped by uptime");
+
+  // Show welcome and rest this sensor for the hold
+  char msg[BOTTOM_MSG_LEN];
+  snprintf(msg, sizeof(msg), "Welcome:\n-> %s", name);
+  oledBottom(msg);
+  welcomeShownAt = millis();
+  s.step         = CAPTURE_HOLD;
+  s.holdUntil    = welcomeShownAt + WELCOME_HOLD_MS;
+
+  flashLed(s, s.port.greenLed, 180);
+  Serial.printf("[Verify] sensor=%u id=%d name=%s epoch=%lu synced=%d%s\n",
+                (unsigned)s.port.uart, id, name, (unsigned long)epoch, (int)timeSyncOk,
+                repeat ? " repeat, not sent" : "");
+}
+
+// One transaction at most; true while a scan is part way through
+static bool captureStep(Sensor &s) {
+  unsigned long now = millis();
+
+  switch (s.step) {
+    case CAPTURE_HOLD:
+      // The blind time is not counted against the next arrival
+      s.lastPollAt = now;
+      if ((long)(now - s.holdUntil) >= 0) s.step = CAPTURE_WAIT;
+      return false;
+
+    case CAPTURE_WAIT: {
+      if (!captureDue(s)) {
+        if (s.port.touch >= 0) showIdlePrompt();   // no empty polls to refresh it
+        return false;
+      }
+      int p;
+      {
+        StageTimer t(ST_IMAGE);
+        p = s.fp.getImage();
+      }
+      if (p == FINGERPRINT_NOFINGER) {
+        showIdlePrompt();
+        return false;
+      }
+      s.prevFingerAt = s.lastFingerAt;
+      s.lastFingerAt = millis();
+      if (p != FINGERPRINT_OK) { sensorMessage("Image error!"); return false; }
+      s.step = CAPTURE_CONVERT;
+      return true;
+    }
+
+    case CAPTURE_CONVERT: {
+      s.step = CAPTURE_WAIT;
+      int p;
+      {
+        StageTimer t(ST_CONVERT);
+        p = s.fp.image2Tz(1);
+      }
+      if (p != FINGERPRINT_OK) { sensorMessage("Image conv fail"); return false; }
+      s.step = CAPTURE_SEARCH;
+      return true;
+    }
+
+    case CAPTURE_SEARCH: {
+      s.step = CAPTURE_WAIT;
+      int p;
+      {
+        StageTimer t(ST_SEARCH);
+        p = s.fp.fingerFastSearch();
+      }
+      if (p != FINGERPRINT_OK) {
+        metricNoMatches++;
+        sensorMessage("No Match!");
+        flashLed(s, s.port.redLed, 150);
+        return false;
+      }
+      onMatch(s, s.fp.fingerID);
+      return false;
+    }
+  }
+  return false;
+}
+
+//  Round-robin until no scan is part way through: at most three
+//  rounds, and never more than one transaction between two turns of
+//  the same sensor.
+void verifyFingerNonBlocking() {
+  bool busy = true;
+  while (busy) {
+    busy = false;
+    for (Sensor &s : sensors)
+      if (s.present && captureStep(s)) busy = true;
   }
 }
 
 // ─────────────────────────────────────────────────────────────
-//  MQTT reconnect
+//  SENSORS — bring-up and template mirroring
+//
+//  Every sensor holds the same templates in the same slots, so a
+//  match on any of them maps through slotToStudent[] unchanged.
+//  Templates are copied from the first sensor over the host:
+//  loadModel() → UpChar → DownChar → storeModel().
 // ─────────────────────────────────────────────────────────────
-void reconnectMQTT() {
-  if (WiFi.status() != WL_CONNECTED) return;
-  if (mqttClient.connected()) { mqttConnected = true; return; }
+uint8_t templateBuf[FP_TEMPLATE_SIZE];
+
+void beginSensors() {
+  for (Sensor &s : sensors) {
+    s.serial.begin(57600, SERIAL_8N1, s.port.rx, s.port.tx);
+    pinMode(s.port.greenLed, OUTPUT);
+    pinMode(s.port.redLed,   OUTPUT);
+    digitalWrite(s.port.greenLed, LOW);
+    digitalWrite(s.port.redLed,   LOW);
+  }
+  delay(100);
+
+  sensorCount = 0;
+  for (Sensor &s : sensors) {
+    s.present = s.fp.verifyPassword();
+    if (!s.present) {
+      Serial.printf("[FP] No AS608 on UART%u\n", (unsigned)s.port.uart);
+      continue;
+    }
+    sensorCount++;
+    if (!fpTemplateBegin(s.fp))
+      Serial.printf("[FP] UART%u: packet size not set, template copies will fail\n",
+                    (unsigned)s.port.uart);
+    if (s.port.touch >= 0) {
+      pinMode(s.port.touch, INPUT);
+      attachInterruptArg(digitalPinToInterrupt(s.port.touch), onTouch, &s, RISING);
+    }
+  }
+}
 
-  String clientId = String(MQTT_CLIENT_ID) + "_" +
-                    String((uint32_t)ESP.getEfuseMac(), HEX);
-  Serial.printf("[MQTT] Connecting as %s...\n", clientId.c_str());
+//  Copies `slot` from the first sensor into the same slot of `to`.
+static bool copyTemplate(uint16_t slot, Sensor &to) {
+  if (finger.loadModel(slot) != FINGERPRINT_OK) return false;
+  if (!fpUploadTemplate(finger, templateBuf))   return false;
+  if (!fpDownloadTemplate(to.fp, templateBuf))  return false;
+  return to.fp.storeModel(slot) == FINGERPRINT_OK;
+}
+
+//  After an enrollment: the new template goes to every other sensor.
+//  Returns how many copies failed; mirrorRoster() retries at boot.
+uint8_t mirrorTemplate(uint16_t slot) {
+  uint8_t failed = 0;
+  for (uint8_t i = 1; i < FP_SENSOR_PORTS; i++) {
+    if (!sensors[i].present || copyTemplate(slot, sensors[i])) continue;
+    Serial.printf("[FP] Copy of slot %u to UART%u FAILED\n",
+                  (unsigned)slot, (unsigned)sensors[i].port.uart);
+    failed++;
+  }
+  return failed;
+}
+
+//  Boot: fills roster slots a sensor is missing (one fitted later,
+//  or a copy that failed during an enrollment).
+void mirrorRoster() {
+  for (uint8_t i = 1; i < FP_SENSOR_PORTS; i++) {
+    Sensor &s = sensors[i];
+    if (!s.present) continue;
+    uint8_t copied = 0, failed = 0;
+    for (uint8_t k = 0; k < studentCount; k++) {
+      uint16_t slot = students[k].id;
+      if (s.fp.loadModel(slot) == FINGERPRINT_OK) continue;
+      if (copyTemplate(slot, s)) copied++;
+      else                       failed++;
+    }
+    Serial.printf("[FP] UART%u: %u templates copied, %u failed\n",
+                  (unsigned)s.port.uart, copied, failed);
+  }
+}
 
-  if (mqttClient.connect(clientId.c_str(), MQTT_USER, MQTT_PASS)) {
-    mqttConnected = true;
-    mqttClient.subscribe(TOPIC_SYS_STATE,   1);
-    mqttClient.subscribe(TOPIC_ENROLL_DATA, 1);
-    Serial.println("[MQTT] Connected & subscribed");
-    mqttPublish(TOPIC_STATE_PUB, "VERIFY", true);
-    mqttPublish(TOPIC_MESSAGE,   "ESP32 online");
+// ─────────────────────────────────────────────────────────────
+//  TEMPLATE TRANSFER — bulk export to the bridge and provisioning
+//  from it, so a replaced sensor or a new station gets the stored
+//  set instead of every student re-enrolling in person.
+//
+//  Export ({"op":"export","from":slot} on fp/templateCmd):
+//    sensor task   reads one roster model per loop pass ─▶ templateOut
+//    network task  keeps up to TEMPLATE_WINDOW models unacked on
+//                  fp/templateOut; the bridge acks each on
+//                  fp/templateAck once it is stored
+//  A full templateOut holds the sensor side back, so the export runs
+//  at the pace of the acks. Unacked models go out again after
+//  TEMPLATE_ACK_TIMEOUT_MS and straight after a reconnect; the
+//  bridge resumes an export lost to a reboot by asking again from
+//  the first slot it has not stored. A roster slot whose model cannot
+//  be read is skipped and listed in the closing {"done"}.
+//
+//  Import (fp/templateIn, any time in VERIFY):
+//    network task  reassembles the parts and checks the crc ─▶ templateIn
+//    sensor task   stores the model on every sensor, upserts the
+//                  roster entry and answers on fp/templateStored
+//  The bridge holds the window and resends anything unanswered;
+//  storing the same model twice is harmless.
+//
+//  Part on the wire (name/regNum only in part 0):
+//    {"slot":12,"part":0,"of":2,"crc":40311,"data":"<base64>","name":"…","regNum":"…"}
+// ─────────────────────────────────────────────────────────────
+static_assert(FP_TEMPLATE_SIZE % TEMPLATE_PART_BYTES == 0, "a model splits into whole parts");
+static_assert(TEMPLATE_PART_B64 + 40 + 80 <= MQTT_PAYLOAD_MAX(TOPIC_TPL_IN),
+              "a model part must fit one MQTT message");
+
+// Sensor side
+TemplateBlock xferBlock;
+uint16_t      exportCursor  = 0;   // next slot to read, 0 = no export running
+uint16_t      exportRead    = 0;
+uint16_t      exportTotal   = 0;
+uint16_t      exportFailed[MAX_STUDENTS];   // roster slots whose model could not be read
+uint8_t       exportFailedCount = 0;
+uint16_t      importedCount = 0;   // since boot, for the display
+
+static void importTemplate(const TemplateBlock &b) {
+  const char *err = nullptr;
+  if (b.slot == 0 || b.slot > ROSTER_MAX_SLOT) {
+    err = "bad slot";
+  } else if (!studentForSlot(b.slot) && studentCount >= MAX_STUDENTS) {
+    err = "roster full";
   } else {
+    for (Sensor &s : sensors) {
+      if (!s.present) continue;
+      if (!fpDownloadTemplate(s.fp, b.data) || s.fp.storeModel(b.slot) != FINGERPRINT_OK) {
+        err = "store failed";
+        break;
+      }
+      markSlotInUse(b.slot, true);   // kept if a later sensor refuses: the model is there
+    }
+  }
+
+  if (!err) {
+    uint8_t idx = slotToStudent[b.slot];
+    if (idx == SLOT_UNMAPPED) {
+      idx = studentCount++;
+      memset(&students[idx], 0, sizeof(Student));
+      students[idx].id      = b.slot;
+      slotToStudent[b.slot] = idx;
+    }
+    if (b.name[0]) {
+      memcpy(students[idx].name,   b.name,   STUDENT_NAME_LEN);
+      memcpy(students[idx].regNum, b.regNum, STUDENT_REG_LEN);
+    }
+    markStudentDirty(idx);
+    saveStudentsToEEPROM();
+    importedCount++;
+    char msg[BOTTOM_MSG_LEN];
+    snprintf(msg, sizeof(msg), "Provisioning...\n%u stored", (unsigned)importedCount);
+    oledBottom(msg);
+  }
+  Serial.printf("[Xfer] Import slot %u: %s\n", (unsigned)b.slot, err ? err : "stored");
+
+  NetEvent e;
+  e.type  = NET_TEMPLATE_STORED;
+  e.slot  = b.slot;
+  e.epoch = 0;
+  strncpy(e.text, err ? err : "", sizeof(e.text) - 1);
+  e.text[sizeof(e.text) - 1] = '\0';
+  if (err) netPost(e);
+  else     postAfterCommit(e);
+}
+
+static void exportNext() {
+  if (templateOut.size() == templateOut.capacity()) return;   // waiting on acks
+  while (exportCursor < FP_LIBRARY_SLOTS && slotToStudent[exportCursor] == SLOT_UNMAPPED)
+    exportCursor++;
+
+  TemplateBlock &b = xferBlock;
+  if (exportCursor >= FP_LIBRARY_SLOTS) {
+    b.slot = TEMPLATE_END;
+    b.crc  = exportFailedCount;
+    memcpy(b.data, exportFailed, exportFailedCount * sizeof(uint16_t));
+    templateOut.push(b);
+    exportCursor = 0;
+    Serial.printf("[Xfer] Export read %u models, %u unreadable\n", (unsigned)exportRead,
+                  (unsigned)exportFailedCount);
+    return;
+  }
+
+  uint16_t slot = exportCursor++;
+  if (finger.loadModel(slot) != FINGERPRINT_OK || !fpUploadTemplate(finger, b.data)) {
+    Serial.printf("[Xfer] Slot %u unreadable — not exported\n", (unsigned)slot);
+    if (exportFailedCount < MAX_STUDENTS) exportFailed[exportFailedCount++] = slot;
+    return;
+  }
+  const Student *st = studentForSlot(slot);
+  b.slot = slot;
+  b.crc  = journalCrc16(b.data, FP_TEMPLATE_SIZE);
+  memcpy(b.name,   st->name,   STUDENT_NAME_LEN);
+  memcpy(b.regNum, st->regNum, STUDENT_REG_LEN);
+  templateOut.push(b);
+  exportRead++;
+  oledProgressBar((uint8_t)(exportRead * 100UL / (exportTotal ? exportTotal : 1)));
+}
+
+//  One model at most per call, and only between scans: buffer 1 of
+//  the sensors is free once verifyFingerNonBlocking() returns.
+void templateStep() {
+  if (exportCancel.exchange(false) && exportCursor) {
+    exportCursor = 0;
+    oledBottomRefresh();
+  }
+  uint16_t from = exportRequest.exchange(0);
+  if (from) {
+    exportCursor = from;
+    exportRead   = 0;
+    exportTotal  = 0;
+    for (uint8_t i = 0; i < studentCount; i++) exportTotal += students[i].id >= from;
+    uint8_t kept = 0;   // a resumed export reads the slots from `from` again
+    for (uint8_t i = 0; i < exportFailedCount; i++)
+      if (exportFailed[i] < from) exportFailed[kept++] = exportFailed[i];
+    exportFailedCount = kept;
+    Serial.printf("[Xfer] Export of %u models from slot %u\n", (unsigned)exportTotal, (unsigned)from);
+    oledBottom("Exporting templates...");
+  }
+
+  if (templateIn.pop(xferBlock)) {
+    importTemplate(xferBlock);
+    // The bridge sends the next models once these are answered: one
+    // commit per window rather than a wait for the quiet period
+    if (templateIn.empty() && !commitRosterIfDue(true)) restageRoster();
+    return;
+  }
+  if (exportCursor) exportNext();
+}
+
+// Network side
+TemplateBlock tplWindow[TEMPLATE_WINDOW];   // slot 0 = free
+uint32_t      tplSentAt[TEMPLATE_WINDOW];   // 0 = due to be sent
+bool          tplEndPending    = false;     // all read; {"done"} once the window drains
+uint16_t      tplFailed[MAX_STUDENTS];      // unread slots the {"done"} lists
+uint8_t       tplFailedCount   = 0;
+TemplateBlock tplIncoming;                  // import being reassembled
+uint8_t       tplIncomingParts = 0;         // bit p: part p arrived
+
+static bool publishTemplate(const TemplateBlock &b) {
+  static char payload[MQTT_PAYLOAD_MAX(TOPIC_TPL_OUT) + 1];
+  char        data[TEMPLATE_PART_B64 + 1];
+  for (uint8_t part = 0; part < TEMPLATE_PARTS; part++) {
+    fpBase64Encode(b.data + part * TEMPLATE_PART_BYTES, TEMPLATE_PART_BYTES, data);
+    StaticJsonDocument<256> doc;
+    doc["slot"] = b.slot;
+    doc["part"] = part;
+    doc["of"]   = TEMPLATE_PARTS;
+    doc["crc"]  = b.crc;
+    doc["data"] = (const char *)data;
+    if (part == 0) {
+      doc["name"]   = b.name;
+      doc["regNum"] = b.regNum;
+    }
+    serializeJson(doc, payload, sizeof(payload));
+    if (!mqttPublish(TOPIC_TPL_OUT, payload)) return false;
+  }
+  return true;
+}
+
+// {"done":true,"failed":[slot,…]}: the bridge records the unread slots
+static bool publishTemplateEnd() {
+  char   payload[32 + MAX_STUDENTS * 4];
+  size_t len = snprintf(payload, sizeof(payload), "{\"done\":true,\"failed\":[");
+  for (uint8_t i = 0; i < tplFailedCount; i++)
+    len += snprintf(payload + len, sizeof(payload) - len, "%s%u", i ? "," : "", (unsigned)tplFailed[i]);
+  snprintf(payload + len, sizeof(payload) - len, "]}");
+  return mqttPublish(TOPIC_TPL_OUT, payload);
+}
+
+void templateExportStep() {
+  uint32_t now   = millis();
+  bool     empty = true;
+  for (uint8_t i = 0; i < TEMPLATE_WINDOW; i++) {
+    TemplateBlock &b = tplWindow[i];
+    if (!b.slot) {
+      if (tplEndPending || !templateOut.pop(b)) continue;
+      if (b.slot == TEMPLATE_END) {
+        tplFailedCount = (uint8_t)min(b.crc, (uint16_t)MAX_STUDENTS);
+        memcpy(tplFailed, b.data, tplFailedCount * sizeof(uint16_t));
+        tplEndPending = true;
+        continue;
+      }
+      tplSentAt[i] = 0;
+    }
+    empty = false;
+    if (tplSentAt[i] && now - tplSentAt[i] < TEMPLATE_ACK_TIMEOUT_MS) continue;
+    if (tplSentAt[i])
+      Serial.printf("[Xfer] Slot %u not acked — resending\n", (unsigned)b.slot);
+    if (!publishTemplate(b)) return;   // link trouble; resent after the reconnect
+    tplSentAt[i] = millis() | 1;
+  }
+  if (tplEndPending && empty && publishTemplateEnd()) {
+    tplEndPending = false;
+    netProgress   = 0;
+    netNotice     = "Export complete!";
+  }
+}
+
+void onTemplateAck(uint16_t slot) {
+  for (uint8_t i = 0; i < TEMPLATE_WINDOW; i++)
+    if (slot && tplWindow[i].slot == slot) tplWindow[i].slot = 0;
+}
+
+void onTemplateCmd(const char *op, uint16_t from) {
+  bool start = strcmp(op, "export") == 0;
+  if (!start && strcmp(op, "stop") != 0) {
+    Serial.printf("[Xfer] Unknown op '%s'\n", op);
+    return;
+  }
+  // Whatever the last run had in flight is the bridge's to ask for again
+  for (TemplateBlock &b : tplWindow) b.slot = 0;
+  while (templateOut.pop(tplWindow[0])) {}
+  tplWindow[0].slot = 0;
+  tplEndPending     = false;
+  if (start) exportRequest = from ? from : 1;
+  else       exportCancel  = true;
+}
+
+void onTemplatePart(JsonDocument &doc) {
+  uint16_t    slot = doc["slot"] | (uint16_t)0;
+  uint8_t     part = doc["part"] | (uint8_t)0xFF;
+  uint16_t    crc  = doc["crc"]  | (uint16_t)0;
+  const char *data = doc["data"] | "";
+  if (slot == 0 || part >= TEMPLATE_PARTS || (doc["of"] | 0) != TEMPLATE_PARTS) {
+    Serial.println("[Xfer] Bad template part — dropped");
+    return;
+  }
+
+  TemplateBlock &b = tplIncoming;
+  if (b.slot != slot || b.crc != crc) {   // a new model, or a resend of a changed one
+    b.slot = slot;
+    b.crc  = crc;
+    b.name[0] = b.regNum[0] = '\0';
+    tplIncomingParts = 0;
+  }
+  if (fpBase64Decode(data, strlen(data), b.data + part * TEMPLATE_PART_BYTES,
+                     TEMPLATE_PART_BYTES) != TEMPLATE_PART_BYTES) {
+    Serial.printf("[Xfer] Slot %u part %u: bad data — dropped\n", (unsigned)slot, part);
+    return;
+  }
+  if (part == 0) {
+    strncpy(b.name,   doc["name"]   | "", STUDENT_NAME_LEN - 1);
+    strncpy(b.regNum, doc["regNum"] | "", STUDENT_REG_LEN  - 1);
+    b.name[STUDENT_NAME_LEN - 1]  = '\0';
+    b.regNum[STUDENT_REG_LEN - 1] = '\0';
+  }
+  tplIncomingParts |= 1 << part;
+  if (tplIncomingParts != (1 << TEMPLATE_PARTS) - 1) return;
+
+  tplIncomingParts = 0;
+  if (journalCrc16(b.data, FP_TEMPLATE_SIZE) != b.crc) {
+    Serial.printf("[Xfer] Slot %u: crc mismatch — dropped\n", (unsigned)slot);
+  } else if (!templateIn.push(b)) {
+    Serial.printf("[Xfer] Slot %u: import queue full — dropped\n", (unsigned)slot);
+  }
+  b.slot = 0;   // a resend reassembles from scratch
+}
+
+void resetTemplateInFlight() {
+  memset(tplSentAt, 0, sizeof(tplSentAt));
+  tplIncomingParts = 0;
+  tplIncoming.slot = 0;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  ROSTER SYNC — the bridge's /students as a versioned log
+//
+//  The bridge numbers every roster change it sees (dashboard edits,
+//  enrollments reported on fp/enrolled) and keeps the log. The
+//  station announces the version it holds on fp/rosterVersion at
+//  every connect and after every delta; the bridge answers with
+//    {"from":10,"to":14,"part":0,"of":1,
+//     "up":[[slot,"name","regNum"],...],"del":[slot,...]}
+//  on fp/rosterDelta, each changed slot once in its state at `to`,
+//  so a station that was away catches up in one message. More than
+//  ROSTER_DELTA_MAX slots come as several parts, sent back to back.
+//
+//  A part applies only on top of `from`, after the part before it,
+//  and in full or not at all: it is checked first, then its records
+//  go to EEPROM in one commit, with the version moving to `to` in
+//  the commit of the last part. A slot the parts touch is therefore
+//  one changed after the version the station holds, and a torn
+//  commit reads back as version 0 (see RosterMeta). Deleting a
+//  student also clears the slot on every sensor, once the commit has
+//  landed: a commit that fails reloads the roster from flash, and an
+//  entry it brings back must still have its model. A part for another
+//  version (meant for another station, or after a live change this
+//  one missed) or out of order makes it announce again, at most
+//  every ROSTER_ANNOUNCE_MIN_MS.
+// ─────────────────────────────────────────────────────────────
+RosterDelta   rosterIncoming;
+uint8_t       rosterPartNext    = 0;
+unsigned long rosterAnnouncedAt = 0;
+
+static void announceRoster(const char *err) {
+  netPostText(NET_ROSTER_VERSION, err);
+  rosterAnnouncedAt = millis();
+}
+
+// Why the delta cannot be applied as a whole, nullptr if it can
+static const char *rosterDeltaError(const RosterDelta &d) {
+  int16_t count = studentCount;
+  for (uint8_t i = 0; i < d.count; i++) {
+    const RosterChange &c = d.changes[i];
+    if (c.slot == 0 || c.slot > ROSTER_MAX_SLOT) return "bad slot";
+    for (uint8_t j = 0; j < i; j++)
+      if (d.changes[j].slot == c.slot) return "slot repeated";
+    bool held = slotToStudent[c.slot] != SLOT_UNMAPPED;
+    if (c.remove && held)   count--;
+    if (!c.remove && !held) count++;
+  }
+  return count > MAX_STUDENTS ? "roster full" : nullptr;
+}
+
+void rosterSyncStep() {
+  if (!rosterDeltas.pop(rosterIncoming)) return;
+  const RosterDelta &d    = rosterIncoming;
+  uint32_t           held = rosterVersion.load();
+  if (d.from != held || (d.part != 0 && d.part != rosterPartNext)) {
+    if (d.to != held && millis() - rosterAnnouncedAt >= ROSTER_ANNOUNCE_MIN_MS) announceRoster("");
+    return;
+  }
+  const char *err = rosterDeltaError(d);
+  if (err) {
+    Serial.printf("[Roster] Delta v%lu→v%lu part %u rejected: %s\n", (unsigned long)d.from,
+                  (unsigned long)d.to, (unsigned)d.part, err);
+    rosterPartNext = 0;
+    announceRoster(err);
+    return;
+  }
+
+  uint16_t removed[ROSTER_DELTA_MAX];   // models cleared after the commit
+  uint8_t  removedCount = 0;
+  for (uint8_t i = 0; i < d.count; i++) {
+    const RosterChange &c   = d.changes[i];
+    uint8_t             idx = slotToStudent[c.slot];
+    if (c.remove) {
+      if (idx != SLOT_UNMAPPED) removeStudent(idx);
+      markSlotInUse(c.slot, false);
+      removed[removedCount++] = c.slot;
+      continue;
+    }
+    if (idx == SLOT_UNMAPPED) {
+      idx = studentCount++;
+      students[idx].id      = c.slot;
+      slotToStudent[c.slot] = idx;
+    }
+    memcpy(students[idx].name,   c.name,   STUDENT_NAME_LEN);
+    memcpy(students[idx].regNum, c.regNum, STUDENT_REG_LEN);
+    markStudentDirty(idx);
+  }
+  bool last = d.part + 1 >= d.of;
+  if (last) rosterVersion = d.to;
+  saveStudentsToEEPROM();
+  rosterPartNext = last ? 0 : d.part + 1;
+  if (!commitRosterIfDue(true)) {
+    loadStudentsFromEEPROM();   // back to what flash holds; the bridge resends
+    rosterPartNext = 0;
+    announceRoster("");
+    return;
+  }
+  for (uint8_t i = 0; i < removedCount; i++)
+    if (!deleteSlotModels(removed[i]))
+      Serial.printf("[Roster] Slot %u: a sensor kept its model\n", (unsigned)removed[i]);
+  Serial.printf("[Roster] v%lu → v%lu part %u/%u: %u changes, %u students\n",
+                (unsigned long)d.from, (unsigned long)d.to, (unsigned)d.part + 1, (unsigned)d.of,
+                (unsigned)d.count, (unsigned)studentCount);
+  if (last) announceRoster("");
+}
+
+// Network side: parsed in place, queued whole
+void onRosterDelta(JsonDocument &doc) {
+  static RosterDelta d;
+  JsonArray up  = doc["up"].as<JsonArray>();
+  JsonArray del = doc["del"].as<JsonArray>();
+  d.from  = doc["from"] | (uint32_t)0;
+  d.to    = doc["to"]   | (uint32_t)0;
+  d.part  = doc["part"] | (uint8_t)0;
+  d.of    = doc["of"]   | (uint8_t)1;
+  d.count = 0;
+  if (d.to == d.from || d.part >= d.of || up.size() + del.size() > ROSTER_DELTA_MAX) {
+    Serial.println("[Roster] Bad delta — dropped");
+    return;
+  }
+  for (JsonVariant v : up) {
+    RosterChange &c = d.changes[d.count++];
+    memset(&c, 0, sizeof(c));
+    c.slot = v[0] | (uint16_t)0;
+    strncpy(c.name,   v[1] | "", STUDENT_NAME_LEN - 1);
+    strncpy(c.regNum, v[2] | "", STUDENT_REG_LEN  - 1);
+  }
+  for (JsonVariant v : del) {
+    RosterChange &c = d.changes[d.count++];
+    memset(&c, 0, sizeof(c));
+    c.slot   = v.as<uint16_t>();
+    c.remove = true;
+  }
+  if (!rosterDeltas.push(d)) Serial.println("[Roster] Delta queue full — dropped");
+}
+
+// ─────────────────────────────────────────────────────────────
+//  Connection state machine
+//
+//    WIFI_IDLE ──backoff──▶ WIFI_JOINING ──GOT_IP──▶ MQTT_WAIT
+//        ▲                      │ timeout                │ backoff, connect()
+//        └──────────────────────┘                        ▼
+//        ◀──────────── Wi-Fi lost (any state) ────── LINK_UP
+//
+//  linkStep() never waits: Wi-Fi association runs in the driver and
+//  is reported through onWiFiEvent(). The only blocking call left is
+//  mqttClient.connect(), bounded by MQTT_SOCKET_TIMEOUT_S and made at
+//  most once per backoff period instead of on every pass.
+// ─────────────────────────────────────────────────────────────
+void onWiFiEvent(arduino_event_id_t event) {
+  switch (event) {
+    case ARDUINO_EVENT_WIFI_STA_GOT_IP:       wifiGotIp = true; break;
+    case ARDUINO_EVENT_WIFI_STA_DISCONNECTED: wifiLost  = true; break;
+    default: break;
+  }
+}
+
+void linkBackoff(LinkState next, uint8_t &failures) {
+  uint32_t ceiling = (uint32_t)LINK_BACKOFF_MIN_MS << (failures < 7 ? failures : 7);
+  if (ceiling > LINK_BACKOFF_MAX_MS) ceiling = LINK_BACKOFF_MAX_MS;
+  uint32_t wait = ceiling / 2 + esp_random() % (ceiling / 2 + 1);
+  if (failures < 255) failures++;
+  linkState    = next;
+  linkDeadline = millis() + wait;
+  Serial.printf("[Link] Retry in %lu ms (attempt %d)\n", (unsigned long)wait, failures);
+}
+
+void linkStep() {
+  unsigned long now = millis();
+
+  // The driver also reports DISCONNECTED for every failed association
+  // attempt; while joining, only the join timeout counts
+  if (wifiLost.exchange(false) && linkState >= LINK_MQTT_WAIT) {
+    Serial.println("[WiFi] Lost");
+    if (linkState == LINK_UP) mqttClient.disconnect();
     mqttConnected = false;
-    Serial.printf("[MQTT] Failed, state=%d\n", mqttClient.state());
+    linkState     = LINK_WIFI_IDLE;
+    linkDeadline  = now;   // first rejoin is immediate, later ones back off
   }
+
+  switch (linkState) {
+    case LINK_WIFI_IDLE:
+      if ((long)(now - linkDeadline) < 0) return;
+      Serial.println("[WiFi] Joining...");
+      wifiGotIp = false;
+      WiFi.disconnect();
+      WiFi.begin(WIFI_SSID, WIFI_PASSWORD);
+      linkState    = LINK_WIFI_JOINING;
+      linkDeadline = now + WIFI_JOIN_TIMEOUT_MS;
+      return;
+
+    case LINK_WIFI_JOINING:
+      if (wifiGotIp.exchange(false) || WiFi.status() == WL_CONNECTED) {
+        Serial.println("[WiFi] Connected: " + WiFi.localIP().toString());
+        wifiFailures = 0;
+        linkState    = LINK_MQTT_WAIT;
+        linkDeadline = now;
+        triggerNTPResync();
+        lastNTPResync = now;
+      } else if ((long)(now - linkDeadline) >= 0) {
+        Serial.println("[WiFi] Join timed out");
+        linkBackoff(LINK_WIFI_IDLE, wifiFailures);
+      }
+      return;
+
+    case LINK_MQTT_WAIT: {
+      if ((long)(now - linkDeadline) < 0) return;
+      Serial.printf("[MQTT] Connecting as %s...\n", stationId);
+      uint32_t startUs = micros();
+      if (mqttClient.connect(stationId, MQTT_USER, MQTT_PASS,
+                             TOPIC_ONLINE, 1, true, "offline", false)) {
+        uint32_t tookUs = micros() - startUs;
+        stageHist[ST_CONNECT].record(tookUs);
+        if (tlsClient.resumed()) metricTlsResumes++;
+        else keepTlsSession();   // a new session; the old copy is stale
+        Serial.printf("[MQTT] Connected in %lu ms, TLS %s\n", (unsigned long)(tookUs / 1000),
+                      tlsClient.resumed() ? "resumed" : "full handshake");
+        onMqttConnected();
+      } else {
+        Serial.printf("[MQTT] Failed, state=%d\n", mqttClient.state());
+        linkBackoff(LINK_MQTT_WAIT, mqttFailures);
+      }
+      return;
+    }
+
+    case LINK_UP:
+      if (mqttClient.connected()) return;
+      Serial.println("[MQTT] Connection lost");
+      mqttConnected = false;
+      linkState     = LINK_MQTT_WAIT;
+      linkDeadline  = now;   // first retry is immediate, later ones back off
+      return;
+  }
+}
+
+//  Setup: offers the session a warm reboot left in RTC memory
+void restoreTlsSession() {
+  if (tlsKeep.magic != TLS_SESSION_KEEP_MAGIC || tlsKeep.len > TLS_SESSION_KEEP_MAX ||
+      tlsKeep.crc != journalCrc16(tlsKeep.blob, tlsKeep.len)) return;
+  if (tlsClient.loadSession(tlsKeep.blob, tlsKeep.len))
+    Serial.printf("[MQTT] TLS session kept over reboot (%u B)\n", tlsKeep.len);
+}
+
+void keepTlsSession() {
+  tlsKeep.magic = 0;   // invalid while being rewritten
+  tlsKeep.len   = (uint16_t)tlsClient.saveSession(tlsKeep.blob, sizeof(tlsKeep.blob));
+  if (!tlsKeep.len) return;   // larger than the RTC copy; reconnects still resume
+  tlsKeep.crc   = journalCrc16(tlsKeep.blob, tlsKeep.len);
+  tlsKeep.magic = TLS_SESSION_KEEP_MAGIC;
+}
+
+//  Subscriptions are renewed on every connect: PubSubClient does not
+//  report whether the broker kept the session, and a SUBSCRIBE costs
+//  no round trip. A kept session still delivers what was queued for
+//  it while the link was down.
+void onMqttConnected() {
+  mqttFailures  = 0;
+  linkState     = LINK_UP;
+  mqttConnected = true;
+  linkReconnects++;
+  for (const InboundRoute &r : INBOUND_ROUTES) mqttClient.subscribe(r.topic, 1);
+  Serial.println("[MQTT] Connected & subscribed");
+  resetOfflineInFlight();    // acks for the old connection are not coming
+  resetTemplateInFlight();
+  mqttPublish(TOPIC_ONLINE,    "online", true);   // clears a will left by the last drop
+  mqttPublish(TOPIC_STATE_PUB, "VERIFY", true);
+  mqttPublish(TOPIC_MESSAGE,   "ESP32 online");
+  char announce[24];
+  snprintf(announce, sizeof(announce), "{\"v\":%lu}", (unsigned long)rosterVersion.load());
+  mqttPublish(TOPIC_ROSTER_VER, announce);   // the bridge answers with what changed since
+}
+
+// ─────────────────────────────────────────────────────────────
+//  BOOT CLOCK — dating scans taken before NTP
+//
+//  Each power-on takes the next boot number (1..BOOT_MAX). A scan
+//  with no NTP time is journaled as (boot, uptime seconds). The first
+//  NTP time of a boot anchors it: anchor = epoch − uptime, the UTC
+//  second that boot's uptime started at, kept for the last
+//  BOOT_ANCHORS boots. A record is then sent as anchor + uptime, so a
+//  station that came up without network still drains its whole queue:
+//    boot anchored             → dated to the second
+//    this boot, no NTP yet     → waits
+//    earlier boot never synced → sent undated, quarantined by the bridge
+// ─────────────────────────────────────────────────────────────
+static uint16_t bootMetaCrc(const BootMeta &m) {
+  return journalCrc16((const uint8_t *)&m, offsetof(BootMeta, crc));
+}
+
+static void saveBootMeta() {
+  bootMeta.crc = bootMetaCrc(bootMeta);
+  EEPROM.writeBytes(BOOT_META_ADDR, &bootMeta, sizeof(bootMeta));
+}
+
+//  Seconds since reset (loop task). Called every pass, so it sees each
+//  millis() wrap and carries it.
+uint32_t uptimeS() {
+  static uint32_t lastMs = 0, wraps = 0;
+  uint32_t ms = millis();
+  if (ms < lastMs) wraps++;
+  lastMs = ms;
+  return (uint32_t)((((uint64_t)wraps << 32) | ms) / 1000);
+}
+
+//  Setup, after the journal is loaded: takes the boot number after the
+//  last one, skipping any a queued scan still carries, and frees the
+//  clocks of boots with nothing left in the queue. Left in the EEPROM cache; whichever commit
+//  comes next saves it, and a scan of this boot is always one.
+void beginBootClock() {
+  EEPROM.readBytes(BOOT_META_ADDR, &bootMeta, sizeof(bootMeta));
+  if (bootMeta.crc != bootMetaCrc(bootMeta) || bootMeta.boot > BOOT_MAX)
+    memset(&bootMeta, 0, sizeof(bootMeta));
+
+  bool queued[BOOT_MAX + 1] = {false};
+  for (uint16_t slot = offlineJournal.first(); slot != JOURNAL_SLOT_NONE;
+       slot = offlineJournal.next(slot)) {
+    Attendance rec;
+    offlineJournal.read(slot, &rec);
+    if (rec.flags & ATT_FLAG_UNSYNCED) queued[rec.flags >> ATT_BOOT_SHIFT] = true;
+  }
+  uint8_t boot = bootMeta.boot;
+  for (uint8_t tries = 0; tries < BOOT_MAX; tries++) {
+    boot = (uint8_t)(boot % BOOT_MAX + 1);
+    if (!queued[boot]) break;
+  }
+  bootMeta.boot = boot;
+  for (uint8_t i = 0; i < BOOT_ANCHORS; i++)   // free clocks no queued scan needs
+    if (!queued[bootMeta.anchorBoot[i]] || bootMeta.anchorBoot[i] == boot) bootMeta.anchorBoot[i] = 0;
+  saveBootMeta();
+  Serial.printf("[Boot] Boot #%u\n", boot);
+}
+
+//  Loop task: anchors this boot at its first NTP time, over the clock
+//  of the boot furthest back. Committed straight away only when scans
+//  of this boot are waiting on it.
+void bootClockStep() {
+  uint32_t up = uptimeS();
+  if (bootAnchored) return;
+  uint32_t epoch = currentEpoch();
+  if (epoch == 0) return;
+
+  EepromLock lock;
+  uint8_t slot = 0, furthest = 0;
+  for (uint8_t i = 0; i < BOOT_ANCHORS; i++) {
+    uint8_t age = bootMeta.anchorBoot[i]
+                ? (uint8_t)((bootMeta.boot + BOOT_MAX - bootMeta.anchorBoot[i]) % BOOT_MAX)
+                : BOOT_MAX;   // empty goes first
+    if (age >= furthest) { furthest = age; slot = i; }
+  }
+  bootMeta.anchorBoot[slot]  = bootMeta.boot;
+  bootMeta.anchorEpoch[slot] = epoch - up;
+  saveBootMeta();
+  bootAnchored = true;
+  Serial.printf("[Boot] Clock anchored: boot #%u started at epoch %lu\n", bootMeta.boot,
+                (unsigned long)(epoch - up));
+  if (bootUnsyncedStored) {
+    StageTimer t(ST_COMMIT);
+    EEPROM.commit();
+  }
+}
+
+//  UTC seconds of a journaled scan in `epoch`, 0 if it can never be
+//  dated. False while it belongs to this boot and the clock is not
+//  anchored yet.
+static bool scanEpoch(const Attendance &rec, const BootMeta &clocks, uint32_t &epoch) {
+  epoch = rec.epoch;
+  if (!(rec.flags & ATT_FLAG_UNSYNCED)) return true;
+  uint8_t boot = rec.flags >> ATT_BOOT_SHIFT;
+  for (uint8_t i = 0; boot && i < BOOT_ANCHORS; i++) {
+    if (clocks.anchorBoot[i] == boot) {
+      epoch = clocks.anchorEpoch[i] + rec.epoch;
+      return true;
+    }
+  }
+  epoch = 0;
+  return boot != clocks.boot;
 }
 
 // ─────────────────────────────────────────────────────────────
 //  Offline sync
 // ─────────────────────────────────────────────────────────────
-void syncOfflineAttendance() {
-  if (offlineCount == 0) return;
+uint32_t offlineSentAt[MAX_OFFLINE_ATTENDANCE];   // per journal slot, 0 = not in flight
+uint16_t offlineInFlight = 0;
+
+//  Replays the queue as fp/attendanceBatch messages, each packing as
+//  many records as fit in one MQTT buffer:
+//    {"records":[[seq,id,"timestamp"],...]}
+//  The bridge joins name/regNum from /students and confirms every
+//  journal seq it has stored on fp/attendanceAck; only then is the
+//  record dropped from the journal. Up to SYNC_WINDOW_RECORDS may be
+//  unconfirmed at once, and any not acked within SYNC_ACK_TIMEOUT_MS
+//  is sent again. Sends at most one batch per call; returns true
+//  while the drain is still in progress.
+bool syncOfflineAttendance() {
+  uint16_t pending = offlineJournal.count();
+  if (pending == 0) return false;
   if (!isTimeSynced()) {
     Serial.println("[Sync] Skipped — time not synced");
-    return;
+    return false;
   }
 
-  oledBottom("Syncing offline...");
-  Serial.printf("[Sync] Syncing %d records...\n", offlineCount);
+  if (!offlineDraining) {
+    offlineSyncTotal = pending;
+    netNotice = "Syncing offline...";
+    Serial.printf("[Sync] Syncing %d records...\n", pending);
+  }
 
-  int i = 0;
-  while (i < offlineCount) {
-    if (strncmp(offlineAttendance[i].timestamp, "1970", 4) == 0) {
-      Serial.printf("[Sync] Skipping record %d — bad timestamp\n", i);
-      i++;
-      continue;
+  // Expire unconfirmed records so they go out again below
+  uint32_t now = millis();
+  for (uint16_t slot = offlineJournal.first(); slot != JOURNAL_SLOT_NONE && offlineInFlight;
+       slot = offlineJournal.next(slot)) {
+    if (offlineSentAt[slot] && now - offlineSentAt[slot] > SYNC_ACK_TIMEOUT_MS) {
+      Serial.printf("[Sync] seq %lu not acked — resending\n",
+                    (unsigned long)offlineJournal.seqAt(slot));
+      offlineSentAt[slot] = 0;
+      offlineInFlight--;
+      metricSyncFails++;
     }
+  }
+  if (offlineInFlight >= SYNC_WINDOW_RECORDS) return true;
 
-    uint8_t percent = ((i + 1) * 100) / (offlineCount ? offlineCount : 1);
-    oledProgressBar(percent);
+  BootMeta clocks;
+  {
+    EepromLock lock;
+    clocks = bootMeta;
+  }
 
-    StaticJsonDocument<300> doc;
-    doc["id"]        = offlineAttendance[i].id;
-    doc["name"]      = String(offlineAttendance[i].name);
-    doc["regNum"]    = String(offlineAttendance[i].regNum);
-    doc["timestamp"] = String(offlineAttendance[i].timestamp);
-    doc["ntpSynced"] = true;
-    String payload;
-    serializeJson(doc, payload);
+  static char payload[MQTT_PAYLOAD_MAX(TOPIC_ATT_BATCH) + 1];
+  const size_t cap = sizeof(payload) - 1 - 2;   // room for the closing "]}" and NUL
+  uint16_t batch[SYNC_WINDOW_RECORDS];
+  uint16_t n   = 0;
+  size_t   len = snprintf(payload, sizeof(payload), "{\"records\":[");
 
-    if (mqttPublish(TOPIC_ATTENDANCE, payload)) {
-      removeOfflineRecordAt(i);
-    } else {
-      Serial.printf("[Sync] Failed at record %d — retry later\n", i);
-      oledBottom("Sync failed! Retry later...");
-      break;
-    }
-    delay(200);
+  for (uint16_t slot = offlineJournal.first();
+       slot != JOURNAL_SLOT_NONE && offlineInFlight + n < SYNC_WINDOW_RECORDS;
+       slot = offlineJournal.next(slot)) {
+    if (offlineSentAt[slot]) continue;
+    Attendance rec;
+    offlineJournal.read(slot, &rec);
+    uint32_t epoch;
+    if (!scanEpoch(rec, clocks, epoch)) continue;   // waits for this boot's clock
+
+    char ts[TS_LEN] = "";   // undated: the bridge quarantines it
+    char entry[64];
+    if (epoch) formatTimestamp(epoch, ts, sizeof(ts));
+    size_t el = snprintf(entry, sizeof(entry), "%s[%lu,%u,\"%s\"]", n ? "," : "",
+                         (unsigned long)offlineJournal.seqAt(slot), (unsigned)rec.id, ts);
+    if (len + el > cap) break;
+    memcpy(payload + len, entry, el);
+    len += el;
+    batch[n++] = slot;
+  }
+  if (n == 0) {
+    if (offlineInFlight) return true;   // everything sendable is awaiting its ack
+    Serial.println("[Sync] Nothing sendable — remaining scans wait for this boot's clock");
+    { EepromLock lock; offlineJournal.flush(); }
+    return false;
+  }
+  memcpy(payload + len, "]}", 3);
+
+  if (!mqttPublish(TOPIC_ATT_BATCH, payload)) {
+    metricSyncFails++;
+    Serial.printf("[Sync] Batch of %d failed at seq %lu — retry later\n", n,
+                  (unsigned long)offlineJournal.seqAt(batch[0]));
+    { EepromLock lock; offlineJournal.flush(); }
+    netProgress = 0;
+    netNotice   = "Sync failed! Retry later...";
+    return false;
   }
+  now = millis() | 1;   // 0 means "not in flight"
+  for (uint16_t i = 0; i < n; i++) offlineSentAt[batch[i]] = now;
+  offlineInFlight += n;
+  Serial.printf("[Sync] Batch of %d sent, %d in flight\n", n, offlineInFlight);
 
-  oledProgressBar(0);
-  oledBottom("Sync complete!");
+  uint16_t done = (offlineSyncTotal > pending) ? offlineSyncTotal - pending : 0;
+  netProgress = (int8_t)((done * 100UL) / offlineSyncTotal);
+  return true;
+}
+
+void onAttendanceAck(uint32_t seq) {
+  EepromLock lock;
+  uint16_t   slot = offlineJournal.find(seq);
+  if (slot == JOURNAL_SLOT_NONE) return;   // duplicate ack, already dropped
+  offlineJournal.ack(slot);
+  if (offlineSentAt[slot]) {
+    offlineSentAt[slot] = 0;
+    offlineInFlight--;
+  }
+  if (offlineInFlight > 0) return;
+
+  // One commit per drained window. A power cut before it only
+  // re-sends records, which the bridge de-duplicates.
+  {
+    StageTimer t(ST_COMMIT);
+    offlineJournal.flush();
+  }
+  if (offlineJournal.count() == 0) {
+    offlineDraining = false;
+    netProgress = 0;
+    netNotice   = "Sync complete!";
+  }
 }
 
-void removeOfflineRecordAt(uint8_t idx) {
-  if (idx >= offlineCount) return;
-  for (uint8_t i = idx; i < offlineCount - 1; i++)
-    offlineAttendance[i] = offlineAttendance[i + 1];
-  offlineCount--;
-  saveOfflineAttendanceToEEPROM();
+void resetOfflineInFlight() {
+  memset(offlineSentAt, 0, sizeof(offlineSentAt));
+  offlineInFlight = 0;
 }
 
 // ─────────────────────────────────────────────────────────────
 //  EEPROM helpers
 // ─────────────────────────────────────────────────────────────
-bool safeEEPROMWrite(int addr, const uint8_t *buf, size_t len) {
-  if (addr < 0 || (addr + (int)len) > EEPROM_SIZE) return false;
-  for (size_t i = 0; i < len; i++) EEPROM.write(addr + i, buf[i]);
-  return true;
+void markStudentDirty(uint8_t index) {
+  if (index < MAX_STUDENTS) rosterDirty |= (1ULL << index);
+}
+
+static void recordFor(uint8_t i, StudentRecord &rec) {
+  rec.id = students[i].id;
+  memcpy(rec.name,   students[i].name,   STUDENT_NAME_LEN);
+  memcpy(rec.regNum, students[i].regNum, STUDENT_REG_LEN);
 }
 
+// Over the count, the records in use and `version`, as saved
+uint16_t rosterCrc(uint32_t version) {
+  uint16_t crc = journalCrc16(&studentCount, 1);
+  for (uint8_t i = 0; i < studentCount; i++) {
+    StudentRecord rec;
+    recordFor(i, rec);
+    crc = journalCrc16((const uint8_t *)&rec, sizeof(rec), crc);
+  }
+  return journalCrc16((const uint8_t *)&version, sizeof(version), crc);
+}
+
+//  Writes only the dirty records (one block copy each), the count, the
+//  version stamp and a changed slot map into the EEPROM cache. The
+//  flash commit is deferred to commitRosterIfDue() so a run of
+//  enrollments shares one commit.
 void saveStudentsToEEPROM() {
-  int addr = 0;
-  EEPROM.write(addr++, studentCount);
-  for (int i = 0; i < studentCount; i++) {
-    safeEEPROMWrite(addr, (uint8_t *)&students[i].id,    1);                addr += 1;
-    safeEEPROMWrite(addr, (uint8_t *)students[i].name,   STUDENT_NAME_LEN); addr += STUDENT_NAME_LEN;
-    safeEEPROMWrite(addr, (uint8_t *)students[i].regNum, STUDENT_REG_LEN);  addr += STUDENT_REG_LEN;
+  EepromLock lock;
+  if (EEPROM.read(0) != studentCount) EEPROM.write(0, studentCount);
+  uint8_t written = 0;
+  for (uint8_t i = 0; i < studentCount; i++) {
+    if (!(rosterDirty & (1ULL << i))) continue;
+    StudentRecord rec;
+    recordFor(i, rec);
+    EEPROM.writeBytes(STUDENT_RECORD_ADDR(i), &rec, sizeof(rec));
+    written++;
+  }
+  rosterDirty = 0;
+  RosterMeta meta = {ROSTER_META_MAGIC, rosterVersion.load(), rosterCrc(rosterVersion.load())};
+  EEPROM.writeBytes(ROSTER_META_ADDR, &meta, sizeof(meta));
+  if (slotMapDirty) {
+    slotMap.crc = journalCrc16(slotMap.used, sizeof(slotMap.used));
+    EEPROM.writeBytes(SLOT_MAP_ADDR, &slotMap, sizeof(slotMap));
+    slotMapDirty = false;
+  }
+
+  unsigned long now = millis();
+  if (!rosterCommitPending) rosterFirstChangeAt = now;
+  rosterLastChangeAt  = now;
+  rosterCommitPending = true;
+  Serial.printf("[EEPROM] Students staged: %d (%d records written)\n", studentCount, written);
+}
+
+//  False only when a commit was made and failed. A forced commit that
+//  fails is the caller's to handle (reload or restageRoster()); one
+//  the timers made is staged again and retried after the quiet period.
+//  Held announcements go out once their commit lands, for students
+//  the roster still holds.
+bool commitRosterIfDue(bool force) {
+  if (!rosterCommitPending && !rosterHeldCount) return true;
+  unsigned long now = millis();
+  if (!force && now - rosterLastChangeAt < ROSTER_COMMIT_QUIET_MS &&
+      now - rosterFirstChangeAt < ROSTER_COMMIT_MAX_MS) return true;
+  bool ok;
+  {
+    EepromLock lock;
+    StageTimer t(ST_COMMIT);
+    ok = EEPROM.commit();
+  }
+  rosterCommitPending = false;
+  Serial.printf("[EEPROM] Students commit %s: %d\n", ok ? "done" : "FAILED", studentCount);
+  if (!ok) {
+    if (!force) restageRoster();
+    return false;
+  }
+  for (uint8_t i = 0; i < rosterHeldCount; i++)
+    if (slotToStudent[rosterHeld[i].slot] != SLOT_UNMAPPED) netPost(rosterHeld[i]);
+  rosterHeldCount = 0;
+  return true;
+}
+
+//  Writes the whole roster into the cache again after a failed commit,
+//  which may have left the cache as flash had it
+void restageRoster() {
+  for (uint8_t i = 0; i < studentCount; i++) markStudentDirty(i);
+  slotMapDirty = true;
+  saveStudentsToEEPROM();
+}
+
+//  Sends `e` once the roster change it reports is committed
+void postAfterCommit(const NetEvent &e) {
+  if (rosterHeldCount == ROSTER_HELD_MAX && !commitRosterIfDue(true)) restageRoster();
+  if (rosterHeldCount == ROSTER_HELD_MAX) {
+    Serial.printf("[EEPROM] Slot %u not announced: roster commit failing\n", (unsigned)e.slot);
+    return;
   }
-  EEPROM.commit();
-  Serial.printf("[EEPROM] Students saved: %d\n", studentCount);
+  rosterHeld[rosterHeldCount++] = e;
+}
+
+//  A torn roster commit can leave a slot in two records (a swap-remove
+//  half written) or a record with no slot; keeps the first of each.
+//  The whole roster is then replayed from version 0 over what is left.
+static void dropRepeatedSlots() {
+  uint32_t seen[(ROSTER_MAX_SLOT + 32) / 32] = {0};
+  uint8_t  kept = 0;
+  for (uint8_t i = 0; i < studentCount; i++) {
+    uint16_t id = students[i].id;
+    if (id == 0 || id > ROSTER_MAX_SLOT || (seen[id / 32] & (1UL << (id % 32)))) continue;
+    seen[id / 32] |= 1UL << (id % 32);
+    if (kept != i) {
+      students[kept] = students[i];
+      markStudentDirty(kept);
+    }
+    kept++;
+  }
+  if (kept == studentCount) return;
+  Serial.printf("[EEPROM] Dropped %d repeated roster records\n", studentCount - kept);
+  studentCount = kept;
+  saveStudentsToEEPROM();
 }
 
 void loadStudentsFromEEPROM() {
-  int     addr = 0;
-  uint8_t cnt  = EEPROM.read(addr++);
+  uint8_t cnt  = EEPROM.read(0);
   studentCount = (cnt > MAX_STUDENTS) ? 0 : cnt;
   for (int i = 0; i < studentCount; i++) {
-    students[i].id = EEPROM.read(addr++);
-    for (int j = 0; j < STUDENT_NAME_LEN; j++) students[i].name[j]   = EEPROM.read(addr++);
-    for (int j = 0; j < STUDENT_REG_LEN;  j++) students[i].regNum[j] = EEPROM.read(addr++);
+    StudentRecord rec;
+    EEPROM.readBytes(STUDENT_RECORD_ADDR(i), &rec, sizeof(rec));
+    students[i].id = rec.id;
+    memcpy(students[i].name,   rec.name,   STUDENT_NAME_LEN);
+    memcpy(students[i].regNum, rec.regNum, STUDENT_REG_LEN);
     students[i].name[STUDENT_NAME_LEN - 1]  = '\0';
     students[i].regNum[STUDENT_REG_LEN - 1] = '\0';
   }
-  Serial.printf("[EEPROM] Loaded %d students\n", studentCount);
+  rosterDirty         = 0;
+  rosterCommitPending = false;
+
+  RosterMeta meta;
+  EEPROM.readBytes(ROSTER_META_ADDR, &meta, sizeof(meta));
+  bool stamped  = meta.magic == ROSTER_META_MAGIC && meta.crc == rosterCrc(meta.version);
+  rosterVersion = stamped ? meta.version : 0;
+  if (!stamped) dropRepeatedSlots();
+  rebuildSlotIndex();
+  Serial.printf("[EEPROM] Loaded %d students, roster v%lu%s\n", studentCount,
+                (unsigned long)rosterVersion.load(), stamped ? "" : " (no valid stamp)");
+
+  EEPROM.readBytes(SLOT_MAP_ADDR, &slotMap, sizeof(slotMap));
+  slotMapDirty = false;
+  if (slotMap.crc != journalCrc16(slotMap.used, sizeof(slotMap.used))) {
+    resetSlotMap();
+    Serial.println("[EEPROM] Slot map rebuilt from the roster");
+  }
+}
+
+//  Marks the roster's slots only; the census finds any other models
+void resetSlotMap() {
+  memset(slotMap.used, 0, sizeof(slotMap.used));
+  for (uint8_t i = 0; i < studentCount; i++) markSlotInUse(students[i].id, true);
+  slotMapDirty = true;
+}
+
+
+// ─────────────────────────────────────────────────────────────
+//  Slot → student index
+// ─────────────────────────────────────────────────────────────
+void rebuildSlotIndex() {
+  memset(slotToStudent, SLOT_UNMAPPED, sizeof(slotToStudent));
+  for (uint8_t i = 0; i < studentCount; i++) {
+    if (students[i].id < FP_LIBRARY_SLOTS) slotToStudent[students[i].id] = i;
+  }
+}
+
+const Student *studentForSlot(uint16_t slot) {
+  if (slot >= FP_LIBRARY_SLOTS) return nullptr;
+  uint8_t idx = slotToStudent[slot];
+  return (idx == SLOT_UNMAPPED) ? nullptr : &students[idx];
+}
+
+// Swaps the last entry into `index`; the count shrinks by one
+void removeStudent(uint8_t index) {
+  uint8_t last = studentCount - 1;
+  slotToStudent[students[index].id] = SLOT_UNMAPPED;
+  for (RecentScan &r : recentScans)
+    if (r.slot == students[index].id) r.slot = 0;   // the slot may go to someone else
+  if (index != last) {
+    students[index] = students[last];
+    slotToStudent[students[index].id] = index;
+    markStudentDirty(index);
+  }
+  memset(&students[last], 0, sizeof(Student));
+  studentCount--;
+}
+
+// ─────────────────────────────────────────────────────────────
+//  SLOT ALLOCATION
+//
+//  A sensor slot is free when no roster entry holds it, no queued scan
+//  names it and the slot map does not mark it. A deleted student's
+//  slot waits until the journal has sent their scans: the bridge joins
+//  a scan to /students by slot, so one replayed after the slot went to
+//  someone new would be credited to them.
+//
+//  The slot map is for models with no roster entry: an enrollment or
+//  import cut off by a power loss before its roster commit, a sensor
+//  that was unplugged during a delete, a module moved from another
+//  station. Such a model still matches, as "Unknown", and is kept: it
+//  may be a student the bridge can still claim, so only an fp/cmd
+//  "delete" removes it. A store sets its slot's bit and a delete
+//  clears it before the model goes, each staged with the roster, so
+//  the map and the roster share their commits.
+//
+//  What the map missed (it was rebuilt, or a store never reached a
+//  commit) the census finds. At boot each sensor reports how many
+//  models it holds; when that is more than the roster, the loop task
+//  checks the slots neither held nor marked from 1, one per
+//  ORPHAN_CENSUS_PERIOD_MS between scans, and marks each model it
+//  finds. It stops once the unheld marks account for them all or at
+//  the end of the sensor's library, then reports the orphans on
+//  fp/cmdAck. A slot the census has not reached yet is checked on the
+//  spot before an enrollment takes it.
+// ─────────────────────────────────────────────────────────────
+
+bool slotInUse(uint16_t slot) {
+  return slot < FP_LIBRARY_SLOTS && (slotMap.used[slot / 8] & (1u << (slot % 8)));
+}
+
+// The caller stages the change with saveStudentsToEEPROM()
+void markSlotInUse(uint16_t slot, bool used) {
+  if (slot >= FP_LIBRARY_SLOTS || slotInUse(slot) == used) return;
+  slotMap.used[slot / 8] ^= 1u << (slot % 8);
+  slotMapDirty = true;
+}
+
+// True if a sensor whose census has not passed `slot` holds a model
+// there; the slot is then marked
+static bool censusAhead(uint16_t slot) {
+  for (Sensor &s : sensors) {
+    if (!s.present || !s.counting || slot < s.censusNext) continue;
+    if (s.fp.loadModel(slot) == FINGERPRINT_OK) {
+      markSlotInUse(slot, true);
+      return true;
+    }
+  }
+  return false;
+}
+
+// Lowest slot (from 1) not in the roster, a queued scan or the slot
+// map; 0 when all ROSTER_MAX_SLOT are. Imported models keep the slots
+// they had on their old station, so the roster can have gaps.
+uint16_t freeRosterSlot() {
+  uint32_t taken[(ROSTER_MAX_SLOT + 32) / 32] = {0};
+  for (uint8_t i = 0; i < studentCount; i++)
+    if (students[i].id <= ROSTER_MAX_SLOT) taken[students[i].id / 32] |= 1UL << (students[i].id % 32);
+  {
+    EepromLock lock;   // the network task acks and flushes the journal
+    for (uint16_t j = offlineJournal.first(); j != JOURNAL_SLOT_NONE; j = offlineJournal.next(j)) {
+      Attendance rec;
+      offlineJournal.read(j, &rec);
+      if (rec.id <= ROSTER_MAX_SLOT) taken[rec.id / 32] |= 1UL << (rec.id % 32);
+    }
+  }
+  for (uint16_t slot = 1; slot <= ROSTER_MAX_SLOT; slot++)
+    if (!(taken[slot / 32] & (1UL << (slot % 32))) && !slotInUse(slot) && !censusAhead(slot)) return slot;
+  return 0;
+}
+
+// Deletes the slot's model from every sensor. False if a sensor refused.
+bool deleteSlotModels(uint16_t slot) {
+  bool ok = true;
+  for (Sensor &s : sensors)
+    if (s.present && s.fp.deleteModel(slot) != FINGERPRINT_OK) ok = false;
+  return ok;
+}
+
+// Marked slots the roster does not hold: how many, and the first `max`
+static uint16_t listOrphans(uint16_t *slots, uint8_t max) {
+  uint16_t n = 0;
+  for (uint16_t slot = 1; slot <= ROSTER_MAX_SLOT; slot++) {
+    if (!slotInUse(slot) || slotToStudent[slot] != SLOT_UNMAPPED) continue;
+    if (n < max) slots[n] = slot;
+    n++;
+  }
+  return n;
 }
 
-void saveOfflineAttendanceToEEPROM() {
-  int addr = OFFLINE_START_ADDR;
-  EEPROM.write(addr++, offlineCount);
-  for (int i = 0; i < offlineCount; i++) {
-    EEPROM.write(addr++, offlineAttendance[i].id);
-    safeEEPROMWrite(addr, (uint8_t *)offlineAttendance[i].name,      STUDENT_NAME_LEN); addr += STUDENT_NAME_LEN;
-    safeEEPROMWrite(addr, (uint8_t *)offlineAttendance[i].regNum,    STUDENT_REG_LEN);  addr += STUDENT_REG_LEN;
-    safeEEPROMWrite(addr, (uint8_t *)offlineAttendance[i].timestamp, TS_LEN);           addr += TS_LEN;
+static void postOrphans(uint16_t count, const uint16_t *slots) {
+  NetEvent e;
+  e.type  = NET_ORPHANS;
+  e.slot  = count;
+  e.epoch = 0;
+  memcpy(e.slots, slots, min(count, (uint16_t)ORPHANS_LISTED) * sizeof(uint16_t));
+  netPost(e);
+}
+
+void beginOrphanCensus() {
+  for (Sensor &s : sensors) {
+    if (!s.present || s.fp.getTemplateCount() != FINGERPRINT_OK) continue;
+    if (s.fp.templateCount <= studentCount) continue;
+    Serial.printf("[FP] UART%u: %u models for %u students, counting\n", (unsigned)s.port.uart,
+                  (unsigned)s.fp.templateCount, (unsigned)studentCount);
+    s.counting    = true;
+    s.censusNext  = 1;
+    s.censusLast  = ROSTER_MAX_SLOT;
+    s.censusLeft  = s.fp.templateCount - studentCount;
+    s.censusFound = 0;
+    if (s.fp.getParameters() == FINGERPRINT_OK && s.fp.capacity && s.fp.capacity - 1 < s.censusLast)
+      s.censusLast = s.fp.capacity - 1;
   }
-  EEPROM.commit();
-  Serial.printf("[EEPROM] Offline saved: %d\n", offlineCount);
+}
+
+void orphanCensusStep() {
+  uint16_t listed[ORPHANS_LISTED];
+  if (orphanReportRequest.exchange(false)) {
+    uint16_t n = listOrphans(listed, ORPHANS_LISTED);
+    postOrphans(n, listed);
+  }
+
+  static unsigned long lastAt = 0;
+  unsigned long        now    = millis();
+  if (now - lastAt < ORPHAN_CENSUS_PERIOD_MS) return;
+  lastAt = now;
+  bool finished = false;
+  for (Sensor &s : sensors) {
+    if (!s.counting || !s.present || s.step != CAPTURE_WAIT) continue;
+    // Marked slots count without asking the sensor
+    while (s.censusLeft && s.censusNext <= s.censusLast &&
+           (slotToStudent[s.censusNext] != SLOT_UNMAPPED || slotInUse(s.censusNext))) {
+      if (slotToStudent[s.censusNext] == SLOT_UNMAPPED) {
+        s.censusFound++;
+        s.censusLeft--;
+      }
+      s.censusNext++;
+    }
+    if (s.censusLeft && s.censusNext <= s.censusLast) {
+      uint16_t slot = s.censusNext++;
+      if (s.fp.loadModel(slot) == FINGERPRINT_OK) {
+        markSlotInUse(slot, true);
+        s.censusFound++;
+        s.censusLeft--;
+      }
+    }
+    if (s.censusLeft && s.censusNext <= s.censusLast) continue;
+    s.counting = false;
+    finished   = true;
+    Serial.printf("[FP] UART%u: %u orphan models kept, slots 1-%u checked\n",
+                  (unsigned)s.port.uart, (unsigned)s.censusFound, (unsigned)(s.censusNext - 1));
+  }
+  if (!finished) return;
+  for (const Sensor &s : sensors)
+    if (s.counting) return;
+  if (slotMapDirty) saveStudentsToEEPROM();   // committed with the next roster change or the timers
+  uint16_t n = listOrphans(listed, ORPHANS_LISTED);
+  if (n) postOrphans(n, listed);
 }
 
 void loadOfflineAttendanceFromEEPROM() {
-  int     addr = OFFLINE_START_ADDR;
-  uint8_t cnt  = EEPROM.read(addr++);
-  if (cnt > MAX_OFFLINE_ATTENDANCE) cnt = 0;
-  offlineCount = 0;
-  for (int i = 0; i < cnt; i++) {
-    offlineAttendance[i].id = EEPROM.read(addr++);
-    for (int j = 0; j < STUDENT_NAME_LEN; j++) offlineAttendance[i].name[j]      = EEPROM.read(addr++);
-    for (int j = 0; j < STUDENT_REG_LEN;  j++) offlineAttendance[i].regNum[j]    = EEPROM.read(addr++);
-    for (int j = 0; j < TS_LEN;           j++) offlineAttendance[i].timestamp[j] = EEPROM.read(addr++);
-    offlineAttendance[i].name[STUDENT_NAME_LEN - 1]  = '\0';
-    offlineAttendance[i].regNum[STUDENT_REG_LEN - 1] = '\0';
-    offlineAttendance[i].timestamp[TS_LEN - 1]       = '\0';
-    offlineCount++;
-  }
-  Serial.printf("[EEPROM] Loaded %d offline records\n", offlineCount);
+  if (!offlineJournal.begin(OFFLINE_START_ADDR)) migrateLegacyLayout();
+  Serial.printf("[EEPROM] Loaded %d offline records\n", offlineJournal.count());
+}
+
+// Flash written by the firmware before the offline journal: one-byte
+// roster slots and a flat queue of full records. All of it is read out
+// first (the wider roster overlaps the old queue), then written back in
+// this layout and committed by the journal format. The roster keeps its
+// students at version 0 and catches up from the bridge's log; queued
+// scans keep their order, and one whose timestamp does not parse goes
+// out undated (boot 0). Blank flash comes through as an empty roster
+// and journal.
+void migrateLegacyLayout() {
+  LegacyAttendance legacy[LEGACY_MAX_OFFLINE];
+  uint8_t          cnt = EEPROM.read(LEGACY_OFFLINE_START);
+  if (cnt > LEGACY_MAX_OFFLINE) cnt = 0;
+  EEPROM.readBytes(LEGACY_OFFLINE_START + 1, legacy, cnt * LEGACY_SCAN_SIZE);
+
+  uint8_t n    = EEPROM.read(0);
+  studentCount = (n > MAX_STUDENTS) ? 0 : n;
+  for (uint8_t i = 0; i < studentCount; i++) {
+    LegacyStudentRecord rec;
+    EEPROM.readBytes(LEGACY_RECORD_ADDR(i), &rec, sizeof(rec));
+    students[i].id = rec.id;
+    memcpy(students[i].name,   rec.name,   STUDENT_NAME_LEN);
+    memcpy(students[i].regNum, rec.regNum, STUDENT_REG_LEN);
+    students[i].name[STUDENT_NAME_LEN - 1]  = '\0';
+    students[i].regNum[STUDENT_REG_LEN - 1] = '\0';
+    markStudentDirty(i);
+  }
+  rosterVersion = 0;
+  resetSlotMap();
+  saveStudentsToEEPROM();
+  BootMeta clocks;
+  memset(&clocks, 0, sizeof(clocks));   // fails its crc: a fresh boot counter
+  EEPROM.writeBytes(BOOT_META_ADDR, &clocks, sizeof(clocks));
+
+  offlineJournal.format();
+  uint8_t kept = 0;
+  for (uint8_t i = 0; i < cnt; i++) {
+    legacy[i].timestamp[TS_LEN - 1] = '\0';
+    Attendance rec;
+    rec.id    = legacy[i].id;
+    rec.epoch = parseTimestamp(legacy[i].timestamp);
+    rec.flags = rec.epoch ? 0 : ATT_FLAG_UNSYNCED;
+    if (offlineJournal.append(&rec)) kept++;
+  }
+  Serial.printf("[EEPROM] Layout migrated: %d students, offline journal %d slots, %d of %d records kept\n",
+                studentCount, (int)MAX_OFFLINE_ATTENDANCE, kept, cnt);
 }
 
 // ─────────────────────────────────────────────────────────────
@@ -28,14 +28,28 @@ console.log("[Firebase] Connected to:", process.env.FIREBASE_DB_URL);
 //  MQTT Topics  — must match ESP32 defines exactly
 // ================================================================
 const T_ATTENDANCE = "fp/attendance";
+const T_ATT_BATCH = "fp/attendanceBatch";
+const T_ATT_ACK = "fp/attendanceAck";
 const T_ENROLLED = "fp/enrolled";
 const T_HEARTBEAT = "fp/heartbeat";
 const T_MESSAGE = "fp/message";
 const T_STATE_ACK = "fp/stateAck";
+const T_ONLINE = "fp/online";
 
 const T_SYS_STATE = "fp/systemState";
 const T_ENROLL_DATA = "fp/enrollData";
 
+const T_TPL_CMD = "fp/templateCmd";
+const T_TPL_OUT = "fp/templateOut";
+const T_TPL_ACK = "fp/templateAck";
+const T_TPL_IN = "fp/templateIn";
+const T_TPL_STORED = "fp/templateStored";
+const T_ROSTER_VER = "fp/rosterVersion";
+const T_ROSTER_DELTA = "fp/rosterDelta";
+const T_METRICS = "fp/metrics";
+const T_CMD = "fp/cmd";
+const T_CMD_ACK = "fp/cmdAck";
+
 // ================================================================
 //  Timestamp validation
 //
@@ -88,6 +102,17 @@ async function attendanceRecordExists(path) {
   return snap.exists();
 }
 
+// ================================================================
+//  Helper — student name/regNum for a fingerprint slot
+//
+//  Replayed offline scans carry only the slot id; the roster copy
+//  under /students fills in the rest.
+// ================================================================
+async function lookupStudent(id) {
+  const student = (await db.ref(`/students/${id}`).once("value")).val() || {};
+  return { name: student.name || "Unknown", regNum: student.regNum || "" };
+}
+
 // ================================================================
 //  Helper — sanitise Firebase key  (mirrors ESP32 sanitizeKey)
 // ================================================================
@@ -99,6 +124,35 @@ function sanitizeKey(s) {
     .trim() || "unknown";
 }
 
+// ================================================================
+//  Station liveness
+//
+//  Any message from the ESP32 proves it is alive; it only sends
+//  fp/heartbeat after 30 s without other traffic. /status (the
+//  last time the station was heard from) and any pending telemetry
+//  are written at most once per STATUS_WRITE_MIN_MS. A station that
+//  drops off is reported by its MQTT will on fp/online, which the
+//  broker publishes once the keepalive lapses; that is written
+//  to /online immediately.
+// ================================================================
+const STATUS_WRITE_MIN_MS = Number(process.env.STATUS_WRITE_MIN_MS) || 25000;
+let lastStatusWriteMs = 0;
+let pendingTelemetry = {};
+
+async function noteStationAlive(espTs, telemetry = {}) {
+  Object.assign(pendingTelemetry, telemetry);
+  const nowMs = Date.now();
+  if (nowMs - lastStatusWriteMs < STATUS_WRITE_MIN_MS) return;
+  lastStatusWriteMs = nowMs;
+  const updates = {
+    "/status": espTs && validateTimestamp(espTs).ok ? espTs : new Date(nowMs).toISOString(),
+    "/online": true,
+    ...pendingTelemetry,
+  };
+  pendingTelemetry = {};
+  await db.ref().update(updates);
+}
+
 // ================================================================
 //  Helper — publish with logging
 // ================================================================
@@ -111,6 +165,350 @@ function mqttPublish(topic, payload, opts = { qos: 1 }) {
   });
 }
 
+// ================================================================
+//  Template transfer — /templates/{slot} holds every model a station
+//  exported, so a replaced sensor or a new station can be provisioned
+//  without students re-enrolling in person.
+//
+//  Started by writing /provision/op:
+//    "export"  station → fp/templateOut parts; each model is checked
+//              against its crc, stored, then acked on fp/templateAck.
+//              The station keeps 4 models unacked and resends on its
+//              own after a reconnect; if nothing arrives for
+//              TEMPLATE_STALL_MS (station rebooted, command lost) the
+//              export is asked for again from the first slot after the
+//              last one stored. Roster slots whose model the station
+//              could not read come back in the closing "failed" list.
+//    "import"  /templates → fp/templateIn parts, TEMPLATE_WINDOW models
+//              unanswered at most. A model not answered on
+//              fp/templateStored within TEMPLATE_ACK_TIMEOUT_MS, or in
+//              flight when the station reconnects, is sent again.
+//    "stop"    abandons either.
+//  Progress and the outcome are written to /provision/status.
+// ================================================================
+const TEMPLATE_PART_BYTES = 256;
+const TEMPLATE_WINDOW = 4;
+const TEMPLATE_ACK_TIMEOUT_MS = 10000;
+const TEMPLATE_STALL_MS = 30000;
+const STUDENT_NAME_MAX = 19;   // ESP32 roster field sizes, less the NUL
+const STUDENT_REG_MAX = 14;
+
+// CRC-16/CCITT-FALSE, as the ESP32's journalCrc16()
+function crc16(buf) {
+  let crc = 0xffff;
+  for (const b of buf) {
+    crc ^= b << 8;
+    for (let i = 0; i < 8; i++) crc = crc & 0x8000 ? ((crc << 1) ^ 0x1021) & 0xffff : (crc << 1) & 0xffff;
+  }
+  return crc;
+}
+
+let xfer = null;   // the transfer in progress, if any
+
+async function provisionStatus(fields) {
+  await db.ref("/provision/status").update({ ...fields, updatedAtMs: Date.now() });
+}
+
+async function startExport(from = 1) {
+  xfer = { op: "export", parts: new Map(), stored: 0, lastSlot: from - 1, lastAtMs: Date.now() };
+  await provisionStatus({ op: "export", state: "running", stored: 0, failed: null,
+    startedAtMs: Date.now() });
+  await mqttPublish(T_TPL_CMD, JSON.stringify({ op: "export", from }));
+}
+
+async function onTemplateOut(data) {
+  if (!xfer || xfer.op !== "export") return;
+  xfer.lastAtMs = Date.now();
+  if (data.done) {
+    const stored = xfer.stored;
+    const failed = (Array.isArray(data.failed) ? data.failed : [])
+      .filter(Number.isInteger)
+      .map((slot) => ({ slot, error: "unreadable" }));
+    xfer = null;
+    await db.ref("/provision/op").remove();
+    await provisionStatus({ state: "exported", stored, failed: failed.length ? failed : null,
+      finishedAtMs: Date.now() });
+    console.log(`[Bridge] Template export complete — ${stored} models, ${failed.length} unreadable`);
+    return;
+  }
+
+  const { slot, part, of, crc } = data;
+  if (!Number.isInteger(slot) || !Number.isInteger(part) || part >= of) return;
+  let entry = xfer.parts.get(slot);
+  if (!entry || entry.crc !== crc) {
+    entry = { crc, chunks: new Array(of).fill(null) };
+    xfer.parts.set(slot, entry);
+  }
+  entry.chunks[part] = Buffer.from(data.data || "", "base64");
+  if (part === 0) {
+    entry.name = data.name || "";
+    entry.regNum = data.regNum || "";
+  }
+  if (entry.chunks.some((c) => c === null)) return;
+
+  xfer.parts.delete(slot);
+  const model = Buffer.concat(entry.chunks);
+  if (crc16(model) !== crc) {
+    // Not acked: the station sends it again after its timeout
+    console.warn(`[Bridge] Template ${slot}: crc mismatch — waiting for resend`);
+    return;
+  }
+  await db.ref(`/templates/${slot}`).set({
+    slot,
+    crc,
+    data: model.toString("base64"),
+    name: entry.name,
+    regNum: entry.regNum,
+    storedAtMs: Date.now(),
+  });
+  await mqttPublish(T_TPL_ACK, JSON.stringify({ acks: [slot] }));
+  xfer.stored++;
+  xfer.lastSlot = Math.max(xfer.lastSlot, slot);
+  if (xfer.stored % 10 === 0) await provisionStatus({ stored: xfer.stored });
+}
+
+async function startImport() {
+  const snap = await db.ref("/templates").once("value");
+  const models = Object.values(snap.val() || {})
+    .filter((t) => t && Number.isInteger(t.slot) && t.data)
+    .sort((a, b) => b.slot - a.slot);   // popped from the end: lowest slot first
+  xfer = { op: "import", todo: models, inFlight: new Map(), stored: 0, failed: [], total: models.length };
+  await provisionStatus({ op: "import", state: "running", total: models.length, stored: 0,
+    failed: null, startedAtMs: Date.now() });
+  console.log(`[Bridge] Template import of ${models.length} models`);
+  await pumpImport();
+}
+
+async function sendTemplate(t) {
+  const model = Buffer.from(t.data, "base64");
+  const of = Math.ceil(model.length / TEMPLATE_PART_BYTES);
+  xfer.inFlight.set(t.slot, { t, sentAtMs: Date.now() });
+  for (let part = 0; part < of; part++) {
+    const msg = {
+      slot: t.slot,
+      part,
+      of,
+      crc: t.crc,
+      data: model.subarray(part * TEMPLATE_PART_BYTES, (part + 1) * TEMPLATE_PART_BYTES).toString("base64"),
+    };
+    if (part === 0) {
+      msg.name = String(t.name || "").slice(0, STUDENT_NAME_MAX);
+      msg.regNum = String(t.regNum || "").slice(0, STUDENT_REG_MAX);
+    }
+    await mqttPublish(T_TPL_IN, JSON.stringify(msg));
+  }
+}
+
+async function pumpImport() {
+  while (xfer && xfer.op === "import" && xfer.inFlight.size < TEMPLATE_WINDOW && xfer.todo.length) {
+    await sendTemplate(xfer.todo.pop());
+  }
+  if (xfer && xfer.op === "import" && !xfer.todo.length && !xfer.inFlight.size) {
+    const { stored, failed } = xfer;
+    xfer = null;
+    await db.ref("/provision/op").remove();
+    await provisionStatus({ state: "imported", stored, failed: failed.length ? failed : null,
+      finishedAtMs: Date.now() });
+    console.log(`[Bridge] Template import complete — ${stored} stored, ${failed.length} failed`);
+  }
+}
+
+async function onTemplateStored(data) {
+  if (!xfer || xfer.op !== "import" || !xfer.inFlight.has(data.slot)) return;
+  xfer.inFlight.delete(data.slot);
+  if (data.ok) xfer.stored++;
+  else xfer.failed.push({ slot: data.slot, error: data.error || "unknown" });
+  if ((xfer.stored + xfer.failed.length) % 10 === 0) {
+    await provisionStatus({ stored: xfer.stored });
+  }
+  await pumpImport();
+}
+
+// Parts sent to a station that then dropped its session are gone
+async function resendImport(olderThanMs) {
+  if (!xfer || xfer.op !== "import") return;
+  const now = Date.now();
+  for (const { t, sentAtMs } of [...xfer.inFlight.values()]) {
+    if (now - sentAtMs < olderThanMs) continue;
+    console.log(`[Bridge] Template ${t.slot} unanswered — resending`);
+    await sendTemplate(t);
+  }
+}
+
+const templateTimer = setInterval(async () => {
+  try {
+    if (xfer && xfer.op === "import") await resendImport(TEMPLATE_ACK_TIMEOUT_MS);
+    if (xfer && xfer.op === "export" && Date.now() - xfer.lastAtMs > TEMPLATE_STALL_MS) {
+      console.log(`[Bridge] Template export stalled — asking again from slot ${xfer.lastSlot + 1}`);
+      xfer.lastAtMs = Date.now();
+      await mqttPublish(T_TPL_CMD, JSON.stringify({ op: "export", from: xfer.lastSlot + 1 }));
+    }
+  } catch (e) {
+    console.error("[Bridge] Template transfer error:", e.message);
+  }
+}, 1000);
+
+// ================================================================
+//  Roster sync — /students as a numbered change log, so a station
+//  picks up dashboard edits and one that was away catches up in a
+//  single message.
+//
+//    /roster/version   the latest change number
+//    /roster/log/{v}   {slot, name, regNum} or {slot, deleted: true}
+//
+//  Every /students value is diffed against the roster the log builds
+//  up and each slot that differs gets the next number. A station
+//  announces the version it holds on fp/rosterVersion (at connect and
+//  after each delta) and is answered on fp/rosterDelta with
+//    {"from":v, "to":w, "part":0, "of":1,
+//     "up":[[slot,"name","regNum"],...], "del":[slot,...]}
+//  holding each slot changed in (v, w] once, as it stands at w, with
+//  w the latest version. Past ROSTER_DELTA_MAX slots or one station
+//  MQTT buffer the delta is split into parts; the station moves to w
+//  with the last. A station ahead of the log (the log was wiped) is
+//  sent to: 0 and reloads from the start.
+// ================================================================
+const ROSTER_DELTA_MAX = 12;      // as the ESP32's ROSTER_DELTA_MAX
+const ROSTER_DELTA_BYTES = 480;   // ESP32 MQTT buffer less header and topic
+const ROSTER_MAX_SLOT = 999;       // as the ESP32's ROSTER_MAX_SLOT
+
+const roster = { version: 0, log: [], view: new Map() };   // log[v - 1] is change v
+
+function rosterApply(e) {
+  if (!e) return;
+  if (e.deleted) roster.view.delete(e.slot);
+  else roster.view.set(e.slot, e);
+}
+
+async function loadRoster() {
+  const r = (await db.ref("/roster").once("value")).val() || {};
+  const log = r.log || {};
+  roster.version = r.version || 0;
+  for (let v = 1; v <= roster.version; v++) {
+    roster.log.push(log[v] || null);   // a missing entry changes nothing
+    rosterApply(log[v]);
+  }
+  console.log(`[Bridge] Roster log at v${roster.version}, ${roster.view.size} students`);
+}
+
+// Log appends run one at a time, after the log is loaded
+let rosterChain = loadRoster().catch((e) => console.error("[Bridge] Roster log load error:", e.message));
+
+async function onStudents(students) {
+  const want = new Map();
+  for (const [key, s] of Object.entries(students || {})) {
+    const slot = Number(key);
+    if (!s || !Number.isInteger(slot) || slot < 1 || slot > ROSTER_MAX_SLOT) continue;
+    want.set(slot, {
+      slot,
+      name: String(s.name || "").slice(0, STUDENT_NAME_MAX),
+      regNum: String(s.regNum || "").slice(0, STUDENT_REG_MAX),
+    });
+  }
+  const changes = [];
+  for (const [slot, e] of want) {
+    const held = roster.view.get(slot);
+    if (!held || held.name !== e.name || held.regNum !== e.regNum) changes.push(e);
+  }
+  for (const slot of roster.view.keys()) {
+    if (!want.has(slot)) changes.push({ slot, deleted: true });
+  }
+  if (!changes.length) return;
+
+  const from = roster.version;
+  const updates = {};
+  for (const e of changes) {
+    roster.version++;
+    roster.log.push(e);
+    rosterApply(e);
+    updates[`log/${roster.version}`] = e;
+  }
+  updates.version = roster.version;
+  await db.ref("/roster").update(updates);
+  console.log(`[Bridge] Roster v${from} → v${roster.version} (${changes.length} changes)`);
+  await sendRosterDelta(from);
+}
+
+function rosterEntryBytes(e) {
+  return Buffer.byteLength(e.deleted ? String(e.slot) : JSON.stringify([e.slot, e.name, e.regNum])) + 1;
+}
+
+function rosterDelta(from) {
+  const to = roster.version;
+  if (from > to) return [{ from, to: 0, part: 0, of: 1, up: [], del: [] }];
+  const slots = new Map();
+  for (let v = from + 1; v <= to; v++) {
+    const e = roster.log[v - 1];
+    if (e) slots.set(e.slot, e);
+  }
+  const parts = [];
+  let part = null;
+  let bytes = 0;
+  for (const e of [...slots.values()].sort((a, b) => a.slot - b.slot)) {
+    const n = rosterEntryBytes(e);
+    if (!part || part.up.length + part.del.length === ROSTER_DELTA_MAX || bytes + n > ROSTER_DELTA_BYTES) {
+      part = { from, to, part: parts.length, of: 0, up: [], del: [] };
+      parts.push(part);
+      bytes = 80;   // {"from":..,"to":..,"part":..,"of":..,"up":[],"del":[]}
+    }
+    if (e.deleted) part.del.push(e.slot);
+    else part.up.push([e.slot, e.name, e.regNum]);
+    bytes += n;
+  }
+  if (!parts.length) parts.push({ from, to, part: 0, of: 0, up: [], del: [] });
+  for (const p of parts) p.of = parts.length;
+  return parts;
+}
+
+async function sendRosterDelta(from) {
+  for (const part of rosterDelta(from)) await mqttPublish(T_ROSTER_DELTA, JSON.stringify(part));
+}
+
+async function onRosterVersion(data) {
+  await rosterChain;
+  if (data.error) {
+    // Resending the same delta would fail the same way
+    console.warn(`[Bridge] Station rejected roster delta at v${data.v}: ${data.error}`);
+    await db.ref("/roster/stationError").set({ v: data.v, error: data.error, atMs: Date.now() });
+    return;
+  }
+  if (!Number.isInteger(data.v) || data.v === roster.version) return;
+  await sendRosterDelta(data.v);
+}
+
+// ================================================================
+//  Station commands — fleet operations without reflashing. Push
+//  { op, ...args, to? } under /commands:
+//    delete    { slot }                            model + roster entry
+//    intervals { pollMs, idlePollMs, heartbeatMs, repeatMs } any of them
+//    flush                                         send the offline queue
+//    metrics                                       fp/metrics snapshot
+//    orphans                                       slots of models with no roster entry
+//  `to` is a station's MQTT client ID; without it every station acts.
+//  Each command is published on fp/cmd and removed; every station's
+//  answer (fp/cmdAck) goes to /commandResults/{station}/{op}. Sent at
+//  QoS 0, like enroll: a command is not held for a station that is
+//  offline, whoever issued it sends it again.
+// ================================================================
+const CMD_OPS = new Set(["delete", "intervals", "flush", "metrics", "orphans"]);
+
+async function onCommand(snap) {
+  const cmd = snap.val();
+  await snap.ref.remove();
+  if (!cmd || !CMD_OPS.has(cmd.op)) {
+    console.warn("[Bridge] /commands: unknown op", cmd && cmd.op);
+    return;
+  }
+  await mqttPublish(T_CMD, JSON.stringify(cmd), { qos: 0 });
+  console.log("[Bridge] Command sent →", cmd.op, cmd.to || "(all stations)");
+}
+
+async function onCommandAck(data) {
+  if (!data.station || !CMD_OPS.has(data.op)) return;
+  await db.ref(`/commandResults/${sanitizeKey(data.station)}/${data.op}`)
+    .set({ ...data, receivedAtMs: Date.now() });
+}
+
 // ================================================================
 //  MQTT connect
 // ================================================================
@@ -128,7 +526,8 @@ const mqttClient = mqtt.connect(mqttUrl, {
 
 mqttClient.on("connect", () => {
   console.log("[MQTT] Connected to HiveMQ Cloud");
-  const subs = [T_ATTENDANCE, T_ENROLLED, T_HEARTBEAT, T_MESSAGE, T_STATE_ACK];
+  const subs = [T_ATTENDANCE, T_ATT_BATCH, T_ENROLLED, T_HEARTBEAT, T_MESSAGE, T_STATE_ACK, T_ONLINE,
+    T_TPL_OUT, T_TPL_STORED, T_ROSTER_VER, T_METRICS, T_CMD_ACK];
   mqttClient.subscribe(subs, { qos: 1 }, (err) => {
     if (err) console.error("[MQTT] Subscribe error:", err.message);
     else console.log("[MQTT] Subscribed →", subs.join(", "));
@@ -149,11 +548,27 @@ mqttClient.on("message", async (topic, buf) => {
 
   try {
 
+    // ── fp/online ─────────────────────────────────────────────
+    //  "online" (retained) on every connect, "offline" as the will
+    if (topic === T_ONLINE) {
+      const online = raw === "online";
+      await db.ref("/online").set(online);
+      if (online) lastStatusWriteMs = 0;   // next message refreshes /status at once
+      if (online) await resendImport(0);
+      console.log(`[Firebase] Station ${online ? "online" : "OFFLINE (will)"}`);
+      return;
+    }
+
+    // Every other topic from the station counts as a heartbeat
+    if (topic !== T_HEARTBEAT) await noteStationAlive(null);
+
     // ── fp/attendance ─────────────────────────────────────────
     if (topic === T_ATTENDANCE) {
       const data = JSON.parse(raw);
 
-      if (!data.id || !data.name || !data.timestamp) {
+      // name/regNum are optional: replayed offline scans carry only the
+      // slot id and are joined against /students below
+      if (!data.id || !data.timestamp) {
         console.warn("[Bridge] fp/attendance: missing required fields — skipping");
         return;
       }
@@ -191,6 +606,12 @@ mqttClient.on("message", async (topic, buf) => {
         return;
       }
 
+      if (!data.name) {
+        const student = await lookupStudent(data.id);
+        data.name = student.name;
+        data.regNum = data.regNum || student.regNum;
+      }
+
       // ── Write to Firebase ─────────────────────────────────
       await db.ref(path).set({
         id: data.id,
@@ -205,6 +626,79 @@ mqttClient.on("message", async (topic, buf) => {
       return;
     }
 
+    // ── fp/attendanceBatch ────────────────────────────────────
+    //  Offline backlog replay: { records: [[seq, id, "timestamp"], ...] }
+    //  Scans taken before NTP arrive already dated from the station's
+    //  boot clock; an empty timestamp means that could not be done.
+    //  Same validation and de-duplication as fp/attendance, but the
+    //  existence checks and student lookups run in parallel and the
+    //  whole batch lands in one multi-path update. Once that update is
+    //  durable every seq is confirmed on fp/attendanceAck; the ESP32
+    //  keeps (and resends) anything it never sees acked.
+    if (topic === T_ATT_BATCH) {
+      const data = JSON.parse(raw);
+      const records = Array.isArray(data.records) ? data.records : [];
+      const receivedAt = new Date().toISOString();
+      const receivedAtMs = Date.now();
+      const updates = {};
+      const valid = [];
+      const acks = [];
+
+      for (const entry of records) {
+        const [seq, id, timestamp] = Array.isArray(entry) ? entry : [];
+        if (Number.isInteger(seq)) acks.push(seq);
+        const tsCheck = validateTimestamp(timestamp);
+        if (!id || !tsCheck.ok) {
+          // "" is a scan from a boot that lost power before it ever got
+          // NTP time, so its uptime stamp could not be converted
+          const reason = !id ? "missing id"
+            : timestamp === "" ? "undated: station had no clock for that boot" : tsCheck.reason;
+          console.warn(`[Bridge] fp/attendanceBatch: REJECTED record — ${reason}`);
+          updates[`/attendance_quarantine/${db.ref("/attendance_quarantine").push().key}`] = {
+            raw: { id: id || null, timestamp: timestamp || null },
+            reason,
+            receivedAt,
+          };
+          continue;
+        }
+        valid.push({ id, timestamp, epochMs: tsCheck.epochMs,
+          path: `/attendance/${id}_${sanitizeKey(timestamp)}` });
+      }
+
+      const ids = [...new Set(valid.map((r) => r.id))];
+      const [exists, students] = await Promise.all([
+        Promise.all(valid.map((r) => attendanceRecordExists(r.path))),
+        Promise.all(ids.map(lookupStudent)),
+      ]);
+      const byId = new Map(ids.map((id, i) => [id, students[i]]));
+
+      let written = 0;
+      valid.forEach((r, i) => {
+        if (exists[i] || updates[r.path]) {
+          console.log(`[Bridge] Duplicate attendance — skipping ${r.path}`);
+          return;
+        }
+        const student = byId.get(r.id);
+        updates[r.path] = {
+          id: r.id,
+          name: student.name,
+          regNum: student.regNum,
+          timestamp: r.timestamp,
+          timestampMs: r.epochMs,
+          receivedAt,
+          receivedAtMs,
+        };
+        written++;
+      });
+
+      if (Object.keys(updates).length > 0) await db.ref().update(updates);
+      console.log(`[Firebase] Attendance batch written — ${written}/${records.length} records`);
+      // Duplicates and quarantined records are acked too: resending them
+      // would not change the outcome
+      if (acks.length > 0) await mqttPublish(T_ATT_ACK, JSON.stringify({ acks }));
+      return;
+    }
+
     // ── fp/enrolled ───────────────────────────────────────────
     if (topic === T_ENROLLED) {
       const data = JSON.parse(raw);
@@ -236,26 +730,87 @@ mqttClient.on("message", async (topic, buf) => {
     }
 
     // ── fp/heartbeat ──────────────────────────────────────────
-    //  Now receives JSON: { ts: "...", synced: true/false }
-    //  Writes both the ESP32 timestamp and bridge-received time.
+    //  Now receives JSON: { ts, synced, heap, heapMin, heapBlock, driftMs, driftPpm,
+    //                       scans, matchMs, matchMaxMs, repeats }
+    //  ts is missing while the station has no NTP time.
     if (topic === T_HEARTBEAT) {
       let espTs = null;
       let synced = false;
+      let heap = null;
+      let clock = null;
+      let capture = null;
       try {
         const hb = JSON.parse(raw);
         espTs = hb.ts || null;
         synced = hb.synced || false;
+        if (Number.isFinite(hb.heap)) {
+          heap = {
+            free: hb.heap,
+            min: Number.isFinite(hb.heapMin) ? hb.heapMin : null,
+            largestBlock: Number.isFinite(hb.heapBlock) ? hb.heapBlock : null,
+          };
+        }
+        if (Number.isFinite(hb.driftMs)) {
+          clock = { driftMs: hb.driftMs, driftPpm: Number.isFinite(hb.driftPpm) ? hb.driftPpm : null };
+        }
+        if (Number.isFinite(hb.scans)) {
+          capture = { scans: hb.scans, matchMs: hb.matchMs ?? null, matchMaxMs: hb.matchMaxMs ?? null,
+            repeats: hb.repeats ?? 0 };
+        }
       } catch {
         // Legacy: plain timestamp string
         espTs = raw;
         synced = true;
       }
 
-      // /status stores only the last heartbeat timestamp string
+      // /status stores only the station's last timestamp string
       // so the Firebase branch stays clean: status: "2026-03-24T10:49:14+05:30"
-      if (espTs && validateTimestamp(espTs).ok) {
-        await db.ref("/status").set(espTs);
+      // /telemetry/heap keeps the latest heap figures next to it, so a
+      // falling min or largestBlock on a long-running station is visible.
+      // /telemetry/clock is how far the device clock drifted between NTP syncs.
+      // /telemetry/capture is finger-detected → matched time since the last
+      // heartbeat that had scans, and how many were repeats the station
+      // welcomed without sending.
+      // All ride along with the next throttled /status write.
+      const telemetry = {};
+      if (heap) telemetry["/telemetry/heap"] = { ...heap, receivedAtMs: Date.now() };
+      if (clock) telemetry["/telemetry/clock"] = clock;
+      if (capture) telemetry["/telemetry/capture"] = capture;
+      await noteStationAlive(espTs, telemetry);
+      return;
+    }
+
+    // ── fp/metrics ────────────────────────────────────────────
+    //  One window of stage latencies (µs) and counters, once a minute:
+    //  { s, loop: [n, p50, p99, max], image, tz, search, clock, publish,
+    //    commit, connect, match, nomatch, offline, syncFail, resumed, ovhPpm,
+    //    bootMs, firstScanMs }
+    //  Stages that did not run in the window are left out. Stored as
+    //  /telemetry/metrics, replaced by each window. A snapshot asked
+    //  for on fp/cmd carries "open": true, the window so far.
+    if (topic === T_METRICS) {
+      const m = JSON.parse(raw);
+      const stages = {};
+      for (const name of ["loop", "image", "tz", "search", "clock", "publish", "commit", "connect"]) {
+        const v = m[name];
+        if (Array.isArray(v) && v.length === 4) {
+          stages[name] = { n: v[0], p50Us: v[1], p99Us: v[2], maxUs: v[3] };
+        }
       }
+      await db.ref("/telemetry/metrics").set({
+        windowS: m.s ?? null,
+        open: m.open === true,
+        stages,
+        match: m.match ?? 0,
+        nomatch: m.nomatch ?? 0,
+        offline: m.offline ?? 0,
+        syncFail: m.syncFail ?? 0,
+        tlsResumed: m.resumed ?? 0,
+        overheadPpm: m.ovhPpm ?? null,
+        bootMs: m.bootMs ?? null,
+        firstScanMs: m.firstScanMs || null,
+        receivedAtMs: Date.now(),
+      });
       return;
     }
 
@@ -271,6 +826,28 @@ mqttClient.on("message", async (topic, buf) => {
       return;
     }
 
+    // ── fp/templateOut / fp/templateStored ────────────────────
+    if (topic === T_TPL_OUT) {
+      await onTemplateOut(JSON.parse(raw));
+      return;
+    }
+    if (topic === T_TPL_STORED) {
+      await onTemplateStored(JSON.parse(raw));
+      return;
+    }
+
+    // ── fp/rosterVersion ──────────────────────────────────────
+    if (topic === T_ROSTER_VER) {
+      await onRosterVersion(JSON.parse(raw));
+      return;
+    }
+
+    // ── fp/cmdAck ─────────────────────────────────────────────
+    if (topic === T_CMD_ACK) {
+      await onCommandAck(JSON.parse(raw));
+      return;
+    }
+
     // ── fp/stateAck ───────────────────────────────────────────
     if (topic === T_STATE_ACK) {
       await db.ref("/systemState").set(raw);
@@ -329,11 +906,14 @@ db.ref("/systemState").on("value", async (snap) => {
       name: enrollData.name,
       regNum: enrollData.regNum,
     });
-    await mqttPublish(T_ENROLL_DATA, dataPayload);
+    // QoS 0: the station keeps a persistent session, and a QoS 1
+    // enroll queued at the broker would start an enrollment long after
+    // the admin gave up on it. Offline, the dashboard just retries.
+    await mqttPublish(T_ENROLL_DATA, dataPayload, { qos: 0 });
 
     await new Promise(r => setTimeout(r, 300));
 
-    await mqttPublish(T_SYS_STATE, "ENROLL");
+    await mqttPublish(T_SYS_STATE, "ENROLL", { qos: 0 });
     console.log("[Bridge] Enroll command dispatched →", enrollData.name, enrollData.regNum);
 
   } catch (e) {
@@ -349,12 +929,51 @@ db.ref("/systemState").on("value", (snap) => {
   if (state === "VERIFY") lastPublishedState = "VERIFY";
 });
 
+// Template transfers (see Template transfer above)
+db.ref("/provision/op").on("value", async (snap) => {
+  const op = snap.val();
+  if (!op || (xfer && xfer.op === op)) return;
+  try {
+    if (op === "export") await startExport();
+    else if (op === "import") await startImport();
+    else if (op === "stop") {
+      if (xfer && xfer.op === "export") await mqttPublish(T_TPL_CMD, JSON.stringify({ op: "stop" }));
+      xfer = null;
+      await db.ref("/provision/op").remove();
+      await provisionStatus({ state: "stopped", finishedAtMs: Date.now() });
+    } else {
+      console.warn(`[Bridge] /provision/op: unknown "${op}"`);
+    }
+  } catch (e) {
+    console.error("[Bridge] Provision error:", e.message);
+    xfer = null;
+    await provisionStatus({ state: "error", error: e.message });
+  }
+});
+
+// Roster changes (see Roster sync above)
+db.ref("/students").on("value", (snap) => {
+  const students = snap.val();
+  rosterChain = rosterChain
+    .then(() => onStudents(students))
+    .catch((e) => console.error("[Bridge] Roster sync error:", e.message));
+});
+
+// Station commands (see Station commands above)
+db.ref("/commands").on("child_added", (snap) => {
+  onCommand(snap).catch((e) => console.error("[Bridge] Command error:", e.message));
+});
+
 // ================================================================
 //  Graceful shutdown
 // ================================================================
 async function shutdown(signal) {
   console.log(`\n[Bridge] ${signal} received — shutting down...`);
   db.ref("/systemState").off();
+  db.ref("/provision/op").off();
+  db.ref("/students").off();
+  db.ref("/commands").off();
+  clearInterval(templateTimer);
   mqttClient.end(true, {}, () => console.log("[MQTT] Client closed"));
   await admin.app().delete();
   console.log("[Bridge] Shutdown complete");